@@ -18,21 +18,165 @@
 
 #pragma once
 
+#include <cstdint>
+#include <vector>
+#include <future>
+
+class ThreadPool;
+class ImageStreamReader;
+
+// Luminance & light level statistics of an HDR (RGBA32F) image, see Image::CalculateStatistics()
+struct FImageStatistics
+{
+    // Luminance histogram over [2^-16, 2^16): each power of two is split into HISTOGRAM_BINS_PER_STOP linear bins,
+    // the first & the last bins also count the values below & above the range.
+    static constexpr int HISTOGRAM_MIN_LOG2_LUMINANCE = -16;
+    static constexpr int HISTOGRAM_MAX_LOG2_LUMINANCE = 16;
+    static constexpr int HISTOGRAM_BINS_PER_STOP = 4;
+    static constexpr int HISTOGRAM_NUM_BINS = (HISTOGRAM_MAX_LOG2_LUMINANCE - HISTOGRAM_MIN_LOG2_LUMINANCE) * HISTOGRAM_BINS_PER_STOP;
+
+    // Relative luminance (Rec.709): 0.2126R + 0.7152G + 0.0722B, negative & NaN luminances count as 0.
+    float    MaxLuminance = 0.0f;
+    float    AvgLuminance = 0.0f;
+    float    MedianLuminance = 0.0f;
+    float    P99Luminance = 0.0f;    // 99th percentile
+    float    MaxChannelValue = 0.0f; // max of R, G & B: the max light level
+    uint64_t NumPixels = 0;
+    uint32_t LuminanceHistogram[HISTOGRAM_NUM_BINS] = {};
+
+    // estimated from the histogram, @Percentile in [0, 1]
+    float GetLuminancePercentile(float Percentile) const;
+    static float GetHistogramBinLowerBound(int iBin);
+};
+
+// All the mip levels of an image in a single allocation, see Image::GenerateMipChain()
+struct FMipChain
+{
+    struct FLevel
+    {
+        size_t Offset = 0; // bytes from pData, 16-byte aligned
+        int Width = 0;
+        int Height = 0;
+    };
+
+    inline bool   IsValid() const { return pData != nullptr && !Levels.empty(); }
+    inline int    GetNumLevels() const { return static_cast<int>(Levels.size()); }
+    inline void*  GetLevelData(int iLevel) const { return static_cast<unsigned char*>(pData) + Levels[iLevel].Offset; }
+    inline size_t GetLevelSizeInBytes(int iLevel) const { return static_cast<size_t>(Levels[iLevel].Width) * Levels[iLevel].Height * BytesPerPixel; }
+    void Destroy(); // Destroy must be called following a GenerateMipChain() to prevent memory leak
+
+    void* pData = nullptr;
+    size_t SizeInBytes = 0;
+    int BytesPerPixel = 0;
+    std::vector<FLevel> Levels; // Levels[0] is a copy of the source image
+};
+
+// Where the pixels of an Image come from, Image::Destroy() frees them accordingly
+enum class EImageAllocator : uint8_t
+{
+    MALLOC = 0,        // malloc(), for the images put together outside of Image
+    STBI,              // stb_image, allocates through the PixelBufferPool
+    TINYEXR,           // tinyexr's malloc()
+    PIXEL_BUFFER_POOL, // see PixelBufferPool.h
+};
+
+// Pixel format of an Image. HDR files are decoded to RGBA32F unless another HDR format is requested on load.
+// The packed formats match DXGI_FORMAT_R16G16B16A16_FLOAT, DXGI_FORMAT_R11G11B10_FLOAT & DXGI_FORMAT_R9G9B9E5_SHAREDEXP.
+enum class EImageFormat : uint8_t
+{
+    UNKNOWN = 0, // inferred from Image::BytesPerPixel: RGBA32F if > 4, RGBA8 otherwise
+    RGBA8,
+    RGBA32F,
+    RGBA16F,     // 8 bytes/pixel
+    R11G11B10F,  // 4 bytes/pixel, no alpha, unsigned
+    RGB9E5,      // 4 bytes/pixel, no alpha, unsigned, shared exponent
+};
+inline int GetBytesPerPixel(EImageFormat Format)
+{
+    switch (Format)
+    {
+    case EImageFormat::RGBA32F: return 16;
+    case EImageFormat::RGBA16F: return 8;
+    case EImageFormat::RGBA8:
+    case EImageFormat::R11G11B10F:
+    case EImageFormat::RGB9E5 : return 4;
+    default: return 0;
+    }
+}
+inline bool IsHDRFormat(EImageFormat Format) { return Format != EImageFormat::UNKNOWN && Format != EImageFormat::RGBA8; }
+
+// Dimensions & format of an image file, see Image::QueryInfo()
+struct FImageInfo
+{
+    inline bool IsValid() const { return Width > 0 && Height > 0; }
+
+    int Width = 0;
+    int Height = 0;
+    int NumChannels = 0;   // channels stored in the file, the loaded image is always RGBA
+    int BytesPerPixel = 0; // of the image loaded in the default format (RGBA8 or RGBA32F), see GetBytesPerPixel()
+    bool bHDR = false;
+};
+
 struct Image
 {
-    static Image LoadFromFile(const char* pFilePath);
+    // @pThreadPool is used for calculating the statistics of HDR images if provided.
+    // The file is memory-mapped (see MappedFile) and decoded in place with LoadFromMemory(),
+    // or loaded from its ImageCache entry without decoding if the cache is enabled & the entry is up to date.
+    // HDR images are stored in @HDRFormat, see LoadFromMemory().
+    static Image LoadFromFile(const char* pFilePath, ThreadPool* pThreadPool = nullptr, EImageFormat HDRFormat = EImageFormat::RGBA32F);
+    // Decodes the contents of an image file already in memory, @pFilePath is only used for the file format (extension) & errors.
+    // HDR images other than RGBA32F are decoded in bands of rows with ImageStreamReader & each band is converted with ConvertPixels(),
+    // so the RGBA32F image is never held in memory as a whole.
+    static Image LoadFromMemory(const void* pFileData, size_t FileSize, const char* pFilePath, ThreadPool* pThreadPool = nullptr, EImageFormat HDRFormat = EImageFormat::RGBA32F);
     static Image CreateEmptyImage(size_t bytes);
 
-    static Image CreateResizedImage(const Image& img, unsigned TargetWidth, unsigned TargetHeight);
-    inline static Image CreateHalfResolutionFromImage(const Image& img) { return CreateResizedImage(img, img.x >> 1, img.y >> 1); }
+    // Reads the dimensions & format from the file header without decoding the pixels, returns an invalid FImageInfo on failure.
+    static FImageInfo QueryInfo(const char* pFilePath);
+    static FImageInfo QueryInfo(const void* pFileData, size_t FileSize, const char* pFilePath);
 
-    bool SaveToDisk(const char* pStrPath) const;
-    void Destroy();  // Destroy must be called following a LoadFromFile() to prevent memory leak
+    // Converts @NumPixels RGBA32F pixels into @Format: RGBA32F, RGBA16F (F16C on AVX2 CPUs that report it, SSE2 otherwise), R11G11B10F or RGB9E5 (SSE2).
+    // Floats are rounded to nearest even. The unsigned packed formats turn NaNs & negative values into 0 & clamp to their largest finite value.
+    static bool ConvertPixels(const float* pRGBA32F, void* pDst, size_t NumPixels, EImageFormat Format);
+    // Converts an RGBA32F image into @Format, splitting the rows across @pThreadPool if provided.
+    static Image CreateConvertedImage(const Image& img, EImageFormat Format, ThreadPool* pThreadPool = nullptr);
+
+    static Image CreateResizedImage(const Image& img, unsigned TargetWidth, unsigned TargetHeight, ThreadPool* pThreadPool = nullptr);
+    inline static Image CreateHalfResolutionFromImage(const Image& img, ThreadPool* pThreadPool = nullptr) { return CreateResizedImage(img, img.x >> 1, img.y >> 1, pThreadPool); }
+
+    // Resizes @img into the caller-provided @pDst of TargetWidth * TargetHeight * GetBytesPerPixel(img.GetFormat()) bytes.
+    // RGBA8 images are resampled with a separable cubic filter in linear space (decoded from sRGB if @bSRGB, alpha is linear),
+    // using SSE2 and splitting the destination rows across @pThreadPool if provided. HDR images are resized with stb_image_resize.
+    static bool ResizeImage(const Image& img, void* pDst, unsigned TargetWidth, unsigned TargetHeight, ThreadPool* pThreadPool = nullptr, bool bSRGB = true);
+    // Streaming pass over @Stream from its first row with the same filters, RGBA32F included: only the source rows
+    // under the vertical filter & a band of @NumRowsPerBand decoded rows (0: ~1M pixels) are held in memory.
+    static bool ResizeImage(ImageStreamReader& Stream, void* pDst, unsigned TargetWidth, unsigned TargetHeight, ThreadPool* pThreadPool = nullptr, bool bSRGB = true, int NumRowsPerBand = 0);
+
+    // Encodes the image by its file extension: .png (RGBA8, filtered & deflated), .hdr (RGBA32F, RLE'd RGBE) or .exr (RGBA32F, ZIP-compressed FLOAT).
+    // The rows are encoded in strips of ~256K pixels across @pThreadPool if provided, then the file is written on the calling thread.
+    bool SaveToDisk(const char* pStrPath, ThreadPool* pThreadPool = nullptr) const;
+    // Takes ownership of @img & saves it on @WorkerThreadPool without blocking the calling thread, @img is destroyed once written.
+    // The future holds the result of SaveToDisk().
+    static std::future<bool> SaveToDiskAsync(Image&& img, const char* pStrPath, ThreadPool& WorkerThreadPool);
+    void Destroy();  // Destroy must be called following a LoadFromFile() to prevent memory leak, or see UniqueImage
 
     inline bool IsValid() const { return pData != nullptr && x != 0 && y != 0; }
-    inline bool IsHDR() const { return BytesPerPixel > 4; }
+    inline EImageFormat GetFormat() const { return Format != EImageFormat::UNKNOWN ? Format : (BytesPerPixel > 4 ? EImageFormat::RGBA32F : EImageFormat::RGBA8); }
+    inline bool IsHDR() const { return IsHDRFormat(GetFormat()); }
     inline size_t GetSizeInBytes() const { return BytesPerPixel * x * y; }
 
+    // Calculates the statistics of an RGBA32F image in a single read of its pixels, with the widest SIMD instruction set
+    // the CPU supports (see VQSystemInfo::GetSIMDLevel()), split into blocks of rows across @pThreadPool if provided.
+    static FImageStatistics CalculateStatistics(const float* pRGBA, int Width, int Height, ThreadPool* pThreadPool = nullptr);
+    inline FImageStatistics CalculateStatistics(ThreadPool* pThreadPool = nullptr) const { return CalculateStatistics(static_cast<const float*>(pData), Width, Height, pThreadPool); }
+    // Streaming pass over the remaining rows of an HDR @Stream, holding @NumRowsPerBand rows at a time (0: ~1M pixels).
+    static FImageStatistics CalculateStatistics(ImageStreamReader& Stream, ThreadPool* pThreadPool = nullptr, int NumRowsPerBand = 0);
+
+    // Generates @NumMips levels (0: CalculateMipLevelCount()) of an RGBA8 or RGBA32F image, each level filtered from the previous one
+    // with a 2x2 box filter, or a 3-tap weighted box filter along the odd dimensions of non-power-of-two levels.
+    // RGBA8 images are averaged as stored, without sRGB conversion. Rows of each level are split across @pThreadPool if provided.
+    static FMipChain GenerateMipChain(const Image& img, ThreadPool* pThreadPool = nullptr, int NumMips = 0);
+    inline FMipChain GenerateMipChain(ThreadPool* pThreadPool = nullptr, int NumMips = 0) const { return GenerateMipChain(*this, pThreadPool, NumMips); }
+
     static unsigned short CalculateMipLevelCount(unsigned __int64 w, unsigned __int64 h);
     inline unsigned short CalculateMipLevelCount() const { return CalculateMipLevelCount(this->Width, this->Height); };
 
@@ -41,4 +185,34 @@ struct Image
     int BytesPerPixel = 0;
     void* pData = nullptr;
     float MaxLuminance = 0.0f;
+    EImageAllocator Allocator = EImageAllocator::MALLOC;
+    EImageFormat Format = EImageFormat::UNKNOWN; // see GetFormat()
+};
+
+// Move-only owner of an Image: destroys it with the deleter matching its EImageAllocator when it goes out of scope.
+class UniqueImage
+{
+public:
+    UniqueImage() = default;
+    explicit UniqueImage(Image&& img) : mImage(img) { img = Image(); }
+    UniqueImage(UniqueImage&& other) noexcept : mImage(other.Release()) {}
+    UniqueImage& operator=(UniqueImage&& other) noexcept { if (this != &other) Reset(other.Release()); return *this; }
+    UniqueImage(const UniqueImage&) = delete;
+    UniqueImage& operator=(const UniqueImage&) = delete;
+    ~UniqueImage() { mImage.Destroy(); }
+
+    inline static UniqueImage LoadFromFile(const char* pFilePath, ThreadPool* pThreadPool = nullptr, EImageFormat HDRFormat = EImageFormat::RGBA32F) { return UniqueImage(Image::LoadFromFile(pFilePath, pThreadPool, HDRFormat)); }
+
+    // hands the ownership over to the caller, who has to Destroy() the returned image
+    inline Image Release() { Image img = mImage; mImage = Image(); return img; }
+    inline void  Reset(Image&& img = Image()) { mImage.Destroy(); mImage = img; img = Image(); }
+
+    inline const Image& Get() const { return mImage; }
+    inline const Image* operator->() const { return &mImage; }
+    inline const Image& operator*() const { return mImage; }
+    inline void*        GetData() { return mImage.pData; }
+    inline explicit operator bool() const { return mImage.IsValid(); }
+
+private:
+    Image mImage;
 };
\ No newline at end of file
@@ -0,0 +1,108 @@
+//	VQUtils
+//	Copyright(C) 2020 - Volkan Ilbeyli
+//
+//	This program is free software : you can redistribute it and / or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+//	Contact: volkanilbeyli@gmail.com
+
+#pragma once
+
+#include "Image.h"
+
+#include <string>
+#include <cstdint>
+
+class ThreadPool;
+class MappedFile;
+
+enum class EImageCacheValidation
+{
+    // the entry is stale if the size or the last write time of the source file differs from the ones it was made from
+    TIMESTAMP = 0,
+
+    // the entry is stale if the contents of the source file hash differently, reads the whole source file
+    CONTENT_HASH,
+};
+
+struct FImageCacheSettings
+{
+    std::string Directory; // cache files are written here, the cache is disabled if empty
+    EImageCacheValidation Validation = EImageCacheValidation::TIMESTAMP;
+    bool bStoreMipChain = false; // generates & stores the full mip chain along with the image, see ImageCache::LoadMipChain()
+};
+
+// Size & last write time of a source file
+struct FImageCacheSourceStamp
+{
+    uint64_t Size = 0;
+    int64_t  WriteTime = 0;
+};
+
+// Header of a cache file, followed by NumMips FMipChain::FLevel entries & the pixel data at DataOffset.
+// The pixel data holds the mip levels the same way as FMipChain, level 0 being the image itself.
+struct FImageCacheHeader
+{
+    static constexpr uint32_t MAGIC = 0x43495156; // "VQIC"
+    static constexpr uint32_t VERSION = 1;
+
+    uint32_t Magic = MAGIC;
+    uint32_t Version = VERSION;
+    int32_t  Width = 0;
+    int32_t  Height = 0;
+    int32_t  BytesPerPixel = 0; // GetBytesPerPixel(Format)
+    float    MaxLuminance = 0.0f;
+    uint32_t NumMips = 0;
+    uint32_t Format = 0;        // EImageFormat of the pixel data, as loaded from the source file
+    uint64_t SourceSize = 0;
+    int64_t  SourceWriteTime = 0;
+    uint64_t SourceHash = 0;
+    uint64_t DataOffset = 0;
+    uint64_t DataSize = 0;
+};
+
+//
+// On-disk cache of decoded images: Image::LoadFromFile() & ImageLoader load the raw pixels of an up to date cache
+// entry from a single memory-mapped cache file instead of decoding the source file, and write the entry after decoding
+// a source file that doesn't have one. Initialize() before loading any images, the settings aren't synchronized.
+//
+namespace ImageCache
+{
+    void Initialize(const FImageCacheSettings& Settings);
+    void Destroy();
+    bool IsEnabled();
+
+    // <Directory>/<hash of the absolute source path>_<source file name>.vqimg
+    std::string GetCacheFilePath(const std::string& SourceFilePath);
+
+    // Maps the cache file of @SourceFilePath into @CacheFile, returns false if there's no valid & up to date entry.
+    // HDR entries are only used if they're stored in @HDRFormat or in RGBA32F, which converts into any HDR format.
+    bool OpenEntry(const std::string& SourceFilePath, MappedFile& CacheFile, EImageFormat HDRFormat = EImageFormat::RGBA32F);
+
+    // read from an entry opened with OpenEntry(), no decoding involved: the pixels are copied out of the mapped file,
+    // or converted into @HDRFormat straight from the mapped file (see Image::CreateConvertedImage()) for RGBA32F entries.
+    FImageInfo GetInfo(const MappedFile& CacheFile);
+    Image      LoadImage(const MappedFile& CacheFile, EImageFormat HDRFormat = EImageFormat::RGBA32F, ThreadPool* pThreadPool = nullptr);
+    FMipChain  LoadMipChain(const MappedFile& CacheFile); // invalid if the entry was stored without the mip chain
+
+    // Returns false if the source file doesn't exist. Take the stamp before reading the source file & pass it to Store():
+    // if the file changes while it's read & decoded, the entry gets the old stamp and is stale rather than up to date with the old pixels.
+    bool GetSourceStamp(const std::string& SourceFilePath, FImageCacheSourceStamp& Stamp);
+
+    // Writes the entry of @SourceFilePath decoded into @img from @pSourceData, stamped with @SourceStamp taken before reading it.
+    // Nothing is written if the stamp's size differs from @SourceSize. @pThreadPool is used for generating the mip chain
+    // if FImageCacheSettings::bStoreMipChain. The file is written under a temporary name & renamed once complete.
+    bool Store(const std::string& SourceFilePath, const FImageCacheSourceStamp& SourceStamp, const void* pSourceData, size_t SourceSize, const Image& img, ThreadPool* pThreadPool = nullptr);
+
+    uint64_t HashFileContents(const void* pData, size_t Size);
+}
@@ -0,0 +1,134 @@
+//	VQUtils
+//	Copyright(C) 2020 - Volkan Ilbeyli
+//
+//	This program is free software : you can redistribute it and / or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+//	Contact: volkanilbeyli@gmail.com
+
+#pragma once
+
+#include "Image.h"
+#include "MappedFile.h"
+#include "ImageCache.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <future>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+
+class ThreadPool;
+
+struct FImageLoaderSettings
+{
+	// Max bytes of file data & decoded pixels of the images in flight, i.e. read or being decoded but not yet handed over.
+	// The reader waits for the decodes to catch up once the budget is reached, an image larger than the budget is loaded on its own.
+	size_t MemoryBudget = 512ull * 1024 * 1024;
+
+	// HDR images are loaded in this format, see Image::LoadFromMemory()
+	EImageFormat HDRFormat = EImageFormat::RGBA32F;
+};
+
+struct FImageLoaderStats
+{
+	size_t   NumImagesLoaded = 0;
+	size_t   NumImagesFailed = 0;
+	uint64_t NumBytesRead = 0;     // file data
+	uint64_t NumBytesDecoded = 0;  // pixel data
+	double   ElapsedSeconds = 0.0; // time spent with images in flight
+	size_t   PeakBytesInFlight = 0;
+
+	inline double GetReadMBps()        const { return ElapsedSeconds > 0.0 ? NumBytesRead    / (1024.0 * 1024.0) / ElapsedSeconds : 0.0; }
+	inline double GetDecodedMBps()     const { return ElapsedSeconds > 0.0 ? NumBytesDecoded / (1024.0 * 1024.0) / ElapsedSeconds : 0.0; }
+	inline double GetImagesPerSecond() const { return ElapsedSeconds > 0.0 ? (NumImagesLoaded + NumImagesFailed) / ElapsedSeconds : 0.0; }
+};
+
+//
+// Loads batches of image files asynchronously: a reader thread maps the files into memory in submission order
+// & prefetches their pages while the decodes (Image::LoadFromMemory()) run on the decode ThreadPool, overlapping I/O with decoding.
+//
+// Usage:
+//
+//   ImageLoader loader;
+//   loader.Initialize(WorkerThreadPool);
+//   std::vector<std::future<Image>> Images = loader.LoadAsync({ "a.png", "b.hdr" });
+//   ...
+//   Image img = Images[0].get(); // invalid Image (pData == nullptr) if the file couldn't be loaded
+//
+class ImageLoader
+{
+public:
+	// Called on a decode thread once image @iImage of the batch (index into FilePaths) is loaded, takes ownership of @img.
+	using FnOnImageLoaded = std::function<void(size_t iImage, Image&& img)>;
+
+	ImageLoader() = default;
+	~ImageLoader() { Destroy(); }
+	ImageLoader(const ImageLoader&) = delete;
+	ImageLoader(ImageLoader&&) = delete;
+	ImageLoader& operator=(const ImageLoader&) = delete;
+	ImageLoader& operator=(ImageLoader&&) = delete;
+
+	void Initialize(ThreadPool& DecodeThreadPool, const FImageLoaderSettings& Settings = {});
+	void Destroy(); // waits for the images in flight, no-op if not initialized or already destroyed
+
+	std::vector<std::future<Image>> LoadAsync(const std::vector<std::string>& FilePaths);
+	void                            LoadAsync(const std::vector<std::string>& FilePaths, FnOnImageLoaded fnOnImageLoaded);
+
+	void WaitIdle();
+	bool IsIdle() const;
+
+	FImageLoaderStats GetStats() const;
+	void ResetStats();
+
+private:
+	struct FLoadRequest
+	{
+		std::string         FilePath;
+		size_t              iImage = 0;
+		std::promise<Image> Promise;         // either the promise or the callback is used
+		FnOnImageLoaded     fnOnImageLoaded;
+		MappedFile          File;            // the source file, or its ImageCache entry if bCached
+		bool                bCached = false;
+		bool                bStoreInCache = false;
+		FImageCacheSourceStamp SourceStamp;  // taken before the source file is mapped
+		size_t              NumBytesReserved = 0;
+	};
+
+	void Enqueue(const std::vector<FLoadRequest*>& Requests);
+	void ReadFiles(); // reader thread
+	void Decode(FLoadRequest* pRequest);
+	void Complete(FLoadRequest* pRequest, Image&& img);
+
+	// blocks the reader until @NumBytes fits into the budget along with the other images in flight
+	void ReserveMemory(FLoadRequest* pRequest, size_t NumBytes);
+
+	ThreadPool*          mpDecodeThreadPool = nullptr;
+	FImageLoaderSettings mSettings;
+	std::thread          mReaderThread;
+	bool                 mbExiting = false;
+
+	mutable std::mutex        mMutex;
+	std::condition_variable   mcvReader;       // new requests & freed memory
+	std::condition_variable   mcvIdle;
+	std::deque<FLoadRequest*> mReadQueue;
+	size_t                    mNumPendingImages = 0;
+	size_t                    mNumBytesInFlight = 0;
+	FImageLoaderStats         mStats;
+	std::chrono::steady_clock::time_point mBusyStartTime;
+};
@@ -0,0 +1,82 @@
+//	VQUtils
+//	Copyright(C) 2020 - Volkan Ilbeyli
+//
+//	This program is free software : you can redistribute it and / or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+//	Contact: volkanilbeyli@gmail.com
+
+#pragma once
+
+#include "Image.h"
+#include "MappedFile.h"
+
+#include <string>
+#include <memory>
+
+//
+// Decodes an image file top to bottom in bands of rows, for processing images that don't fit into memory decoded.
+// Only the file mapping & a few rows of decoder state are held at a time: the pages of the mapped file are read in
+// as they're decoded & can be dropped by the OS afterwards.
+//
+// Rows are output in the same format as Image::LoadFromFile(): RGBA8, or RGBA32F for HDR images.
+// Non-interlaced PNG, Radiance HDR & EXR (a scanline block or a row of tiles at a time) files are decoded as they're read.
+// JPG & interlaced PNG files (& the other formats stb_image reads) are decoded as a whole on Open() & served from memory,
+// IsStreaming() returns false for those.
+//
+// Usage:
+//
+//   ImageStreamReader Stream;
+//   Stream.Open("panorama.hdr");
+//   std::vector<float> Band(Stream.GetInfo().Width * 4 * 64);
+//   while (int NumRows = Stream.ReadRows(Band.data(), 64)) { ... }
+//
+// See also the streaming overloads of Image::CalculateStatistics() & Image::ResizeImage().
+//
+class ImageStreamReader
+{
+public:
+	struct FDecoder; // format specific, see ImageStream.cpp
+
+	ImageStreamReader();
+	ImageStreamReader(const ImageStreamReader&) = delete;
+	ImageStreamReader& operator=(const ImageStreamReader&) = delete;
+	~ImageStreamReader();
+
+	bool Open(const std::string& FilePath);
+	// Decodes a file already in memory, @pFileData has to outlive the reader. @FilePath is only used for the file format (extension) & errors.
+	bool Open(const void* pFileData, size_t FileSize, const std::string& FilePath);
+	void Close();
+
+	inline bool              IsOpen()          const { return mpDecoder != nullptr; }
+	inline const FImageInfo& GetInfo()         const { return mInfo; }
+	inline int               GetNumRowsRead()  const { return mNumRowsRead; }
+	inline size_t            GetRowSizeInBytes() const { return static_cast<size_t>(mInfo.Width) * mInfo.BytesPerPixel; }
+	bool                     IsStreaming()     const;
+
+	// Decodes the next (up to) @NumRows rows into @pDst of NumRows * GetRowSizeInBytes() bytes.
+	// Returns the number of rows decoded, 0 once all the rows are read or if the file is corrupt.
+	int ReadRows(void* pDst, int NumRows);
+
+	// bytes held by the decoder, excluding the file mapping & the caller's row buffers
+	size_t GetWorkingMemorySize() const;
+
+private:
+	bool OpenDecoder(const unsigned char* pFileData, size_t FileSize);
+
+	MappedFile               mFile;
+	FImageInfo               mInfo;
+	std::unique_ptr<FDecoder> mpDecoder;
+	int                      mNumRowsRead = 0;
+	std::string              mFilePath;
+};
@@ -18,23 +18,77 @@
 
 #pragma once
 
+#include "LogRecord.h"
+
 #include <string_view>
+#include <atomic>
 
 namespace Settings { struct Logger; }
 
 
-#define VARIADIC_LOG_FN(FN_NAME)\
+// Info/Warning/Error(format, args...): filtered by the threshold of the default category
+#define VARIADIC_LOG_FN(FN_NAME, RECORD_TYPE)\
 template<class... Args>\
 void FN_NAME(const char* format, Args&&... args)\
 {\
-	char msg[LEN_MSG_BUFFER];\
-	sprintf_s(msg, format, args...);\
-	##FN_NAME(std::string_view(msg));\
+	if (IsEnabled(CATEGORY_DEFAULT, RECORD_TYPE))\
+		Write(RECORD_TYPE, format, args...);\
+}
+
+// InfoDeferred/WarningDeferred/ErrorDeferred(format, args...), see WriteDeferred()
+#define DEFERRED_LOG_FN(FN_NAME, RECORD_TYPE)\
+template<class... Args>\
+void FN_NAME##Deferred(const char* format, Args&&... args)\
+{\
+	if (IsEnabled(CATEGORY_DEFAULT, RECORD_TYPE))\
+		WriteDeferred(RECORD_TYPE, format, args...);\
+}
+
+//
+// Log categories
+//
+// Declares a category type for the VQ_LOG_* macros below, in a header shared by the files logging with it.
+// Messages below @CompileTimeLevel (or VQ_LOG_MIN_LEVEL) are stripped at compile time, arguments included,
+// the others are filtered at runtime against the category's threshold, see Log::SetCategoryLevel().
+//
+//   VQ_LOG_CATEGORY(LogRenderer, Log::LOG_LEVEL_INFO);
+//   ...
+//   VQ_LOG_INFO(LogRenderer, "Created %d PSOs", NumPSOs); // -> "[LogRenderer] Created 12 PSOs"
+//
+// @format must be a string literal, the category name is prepended to it at compile time.
+//
+#define VQ_LOG_CATEGORY(NAME, MIN_LEVEL)\
+struct NAME\
+{\
+	static constexpr Log::ELogLevel COMPILE_TIME_LEVEL = MIN_LEVEL;\
+	static Log::CategoryID GetID() { static const Log::CategoryID ID = Log::RegisterCategory(#NAME); return ID; }\
 }
 
+// Global compile-time threshold as an ELogLevel value: 0=INFO, 1=WARNING, 2=ERROR, 3=NONE
+#ifndef VQ_LOG_MIN_LEVEL
+#define VQ_LOG_MIN_LEVEL 0
+#endif
+
+#define VQ_LOG_IMPL(CATEGORY, RECORD_TYPE, WRITE_FN, format, ...)\
+do\
+{\
+	if constexpr (int(RECORD_TYPE) >= VQ_LOG_MIN_LEVEL && int(RECORD_TYPE) >= int(CATEGORY::COMPILE_TIME_LEVEL))\
+	{\
+		if (Log::IsEnabled(CATEGORY::GetID(), RECORD_TYPE))\
+			Log::WRITE_FN(RECORD_TYPE, "[" #CATEGORY "] " format, ##__VA_ARGS__);\
+	}\
+} while (0)
+
+#define VQ_LOG_INFO(CATEGORY, format, ...)             VQ_LOG_IMPL(CATEGORY, Log::RECORD_INFO   , Write        , format, ##__VA_ARGS__)
+#define VQ_LOG_WARNING(CATEGORY, format, ...)          VQ_LOG_IMPL(CATEGORY, Log::RECORD_WARNING, Write        , format, ##__VA_ARGS__)
+#define VQ_LOG_ERROR(CATEGORY, format, ...)            VQ_LOG_IMPL(CATEGORY, Log::RECORD_ERROR  , Write        , format, ##__VA_ARGS__)
+#define VQ_LOG_INFO_DEFERRED(CATEGORY, format, ...)    VQ_LOG_IMPL(CATEGORY, Log::RECORD_INFO   , WriteDeferred, format, ##__VA_ARGS__)
+#define VQ_LOG_WARNING_DEFERRED(CATEGORY, format, ...) VQ_LOG_IMPL(CATEGORY, Log::RECORD_WARNING, WriteDeferred, format, ##__VA_ARGS__)
+#define VQ_LOG_ERROR_DEFERRED(CATEGORY, format, ...)   VQ_LOG_IMPL(CATEGORY, Log::RECORD_ERROR  , WriteDeferred, format, ##__VA_ARGS__)
+
 namespace Log
 {
-	enum Mode : unsigned	// unused.
+	enum Mode : unsigned	// output selection, see SetMode()
 	{
 		NONE				= 0,	// Visual Studio Output Window
 		CONSOLE				= 1,	// Separate Console Window
@@ -43,20 +97,141 @@ namespace Log
 		CONSOLE_AND_FILE	= CONSOLE | FILE,	// Both Console Window & Log File
 	};
 
+	// Selects the outputs the messages are written to, the debugger output is always written to.
+	// Initialize() selects the console & the log file based on its arguments.
+	void SetMode(Mode mode);
+	Mode GetMode();
+
+	// Appends the microseconds to the timestamps of the lines: [YYYY_MM_DD-HH:MM:SS.uuuuuu]
+	void SetTimestampMicroseconds(bool bEnabled);
+
+	//---------------------------------------------------------------------------------------------
+
+	// Severity thresholds: a category drops the messages below its level.
+	enum ELogLevel : uint8_t
+	{
+		LOG_LEVEL_INFO    = RECORD_INFO,
+		LOG_LEVEL_WARNING = RECORD_WARNING,
+		LOG_LEVEL_ERROR   = RECORD_ERROR,
+		LOG_LEVEL_NONE, // drops everything
+	};
+
+	using CategoryID = uint8_t;
+	constexpr CategoryID CATEGORY_DEFAULT = 0; // Info(), Warning(), Error() & their deferred variants
+	constexpr size_t     MAX_NUM_CATEGORIES = 64;
+
+	// runtime thresholds indexed by CategoryID, zero initialized: everything is enabled by default
+	inline std::atomic<uint8_t> sCategoryLevels[MAX_NUM_CATEGORIES];
+
+	inline bool IsEnabled(CategoryID Category, ERecordType Type) { return Type >= sCategoryLevels[Category].load(std::memory_order_relaxed); }
+
+	// Returns the ID of the category named @pName, registering it if it doesn't exist yet.
+	// Categories registered past MAX_NUM_CATEGORIES share CATEGORY_DEFAULT.
+	CategoryID RegisterCategory(const char* pName);
+
+	// Sets the threshold of all the categories, including the ones registered later on.
+	void SetLevel(ELogLevel Level);
+
+	// Sets the threshold of the category named @pName, which can be called before the category is first used.
+	void SetCategoryLevel(const char* pName, ELogLevel Level);
+
 	//---------------------------------------------------------------------------------------------
 
 	constexpr size_t LEN_MSG_BUFFER = 4096;
+	constexpr size_t LEN_DEFERRED_ARGS_BUFFER = 256;
 
 	//---------------------------------------------------------------------------------------------
 
-	void Initialize(bool bLogConsole, bool bLogFile, std::string_view LogFilePath);
+	// What to do with a message when the calling thread's async log buffer is full.
+	// GetNumDroppedMessages() returns the number of messages discarded with either DROP or COUNT.
+	enum class EOverflowPolicy
+	{
+		BLOCK = 0, // wait for the logger thread to make room
+		DROP,      // discard the message
+		COUNT,     // discard the message & log the number of discarded messages later on
+	};
+
+	// Async logging: Info/Warning/Error write the timestamped message into a lock-free buffer of the
+	// calling thread and return, a dedicated logger thread formats & writes them out in batches.
+	struct FAsyncSettings
+	{
+		bool            bEnabled = false;
+		EOverflowPolicy OverflowPolicy = EOverflowPolicy::BLOCK;
+		size_t          ThreadBufferSize = 64 * 1024; // bytes per logging thread
+		unsigned        FlushIntervalMs = 10;         // max time a message waits in the buffers
+
+		// Writes the log file in the binary format (see LogRecord.h), deferred messages are then
+		// only formatted for the console & debugger outputs. Use DecodeBinaryLogFile() to read it.
+		bool            bBinaryLogFile = false;
+	};
+
+	// Log file output & rotation, see LogFileSink.h
+	struct FLogFileSettings
+	{
+		// Writes into a preallocated, memory-mapped file region instead of an std::ofstream: the write cost
+		// is a memcpy without periodic flushes, and the records written before a crash survive it.
+		bool     bMemoryMapped = false;
+
+		size_t   MaxFileSize = 0;             // bytes, continues in a new file once exceeded. 0: no limit
+		unsigned RotationIntervalMinutes = 0; // continues in a new file after this long. 0: never
+		unsigned MaxNumFiles = 0;             // deletes the oldest files when rotating past this many. 0: keeps all
+	};
+
+	//---------------------------------------------------------------------------------------------
+
+	void Initialize(bool bLogConsole, bool bLogFile, std::string_view LogFilePath
+		, const FAsyncSettings& AsyncSettings = FAsyncSettings()
+		, const FLogFileSettings& FileSettings = FLogFileSettings()
+	);
 	void Destroy();
 
+	// Blocks until the messages logged before the call are written out & the log file is flushed.
+	void Flush();
+	size_t GetNumDroppedMessages();
+
+	// Writes the message without checking the thresholds, used by the functions & macros below once they filter.
+	void Write(ERecordType Type, std::string_view s);
+
+	template<class... Args>
+	void Write(ERecordType Type, const char* format, Args&&... args)
+	{
+		char msg[LEN_MSG_BUFFER];
+		sprintf_s(msg, format, args...);
+		Write(Type, std::string_view(msg));
+	}
+
 	void Info(std::string_view s);
 	void Error(std::string_view s);
 	void Warning(std::string_view s);
 	
-	VARIADIC_LOG_FN(Error)
-	VARIADIC_LOG_FN(Warning)
-	VARIADIC_LOG_FN(Info)
+	VARIADIC_LOG_FN(Error  , RECORD_ERROR)
+	VARIADIC_LOG_FN(Warning, RECORD_WARNING)
+	VARIADIC_LOG_FN(Info   , RECORD_INFO)
+
+	// Deferred formatting: the calling thread only copies the format string address & the raw argument
+	// bytes into its async buffer, formatting is done by the logger thread or the binary log decoder.
+	// @format must have static storage duration, i.e. a string literal.
+	//
+	// e.g. Log::InfoDeferred("Loaded %s in %.2fms", pFileName, ms);
+	//
+	bool TryLogDeferred(ERecordType Type, const char* format, const void* pArgBytes, size_t NumArgBytes);
+
+	// Formats on the calling thread as Write() does if async logging is disabled or the arguments don't fit.
+	template<class... Args>
+	void WriteDeferred(ERecordType Type, const char* format, Args&&... args)
+	{
+		const size_t NumArgBytes = GetDeferredArgsSize(args...);
+		if (NumArgBytes <= LEN_DEFERRED_ARGS_BUFFER)
+		{
+			unsigned char ArgBytes[LEN_DEFERRED_ARGS_BUFFER];
+			EncodeDeferredArgs(ArgBytes, args...);
+			if (TryLogDeferred(Type, format, ArgBytes, NumArgBytes))
+				return;
+		}
+		Write(Type, format, args...);
+	}
+
+	DEFERRED_LOG_FN(Error  , RECORD_ERROR)
+	DEFERRED_LOG_FN(Warning, RECORD_WARNING)
+	DEFERRED_LOG_FN(Info   , RECORD_INFO)
 }
\ No newline at end of file
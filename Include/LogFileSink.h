@@ -0,0 +1,95 @@
+//	VQUtils
+//	Copyright(C) 2020 - Volkan Ilbeyli
+//
+//	This program is free software : you can redistribute it and / or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+//	Contact: volkanilbeyli@gmail.com
+
+#pragma once
+
+#include "Log.h"
+
+#include <string>
+#include <string_view>
+#include <fstream>
+#include <functional>
+#include <chrono>
+
+namespace Log
+{
+	//
+	// Log file output, either an std::ofstream or a preallocated file region mapped into memory & written with memcpy.
+	//
+	// Memory-mapped files are crash-safe: the OS writes out the pages of a mapped file even if the process crashes,
+	// and Write() publishes the first byte of its data last, so a file left behind by a crash holds all the completed
+	// writes followed by zero bytes. The file is truncated to its contents on Close().
+	//
+	// Rotation: the sink continues in a new file named <file>_<N><ext> when a write doesn't fit into
+	// FLogFileSettings::MaxFileSize, or once the file is open for longer than RotationIntervalMinutes.
+	//
+	class LogFileSink
+	{
+	public:
+		// writes the beginning of a file, called with an empty @PreviousFilePath for the first file & on each rotation
+		using FileHeaderFn = std::function<void(std::string& Header, const std::string& FilePath, const std::string& PreviousFilePath)>;
+
+		LogFileSink() = default;
+		LogFileSink(const LogFileSink&) = delete;
+		LogFileSink& operator=(const LogFileSink&) = delete;
+		~LogFileSink() { Close(); }
+
+		bool Open(const std::string& FilePath, bool bBinary, const FLogFileSettings& Settings, FileHeaderFn fnWriteHeader);
+		void Close();
+		inline bool IsOpen() const { return mbOpen; }
+
+		// @Data holds complete lines or binary chunks, must not start with a zero byte
+		void Write(std::string_view Data);
+
+		// hands the written data over to the OS: flushes the ofstream buffer, or starts writing the dirty pages to disk
+		void Flush();
+
+		inline const std::string& GetFilePath() const { return mFilePath; }
+		inline size_t GetNumRotations() const { return mNumRotations; }
+
+		// mapped region size of the memory-mapped files without a size limit, grown by this much when full
+		static constexpr size_t MAPPED_REGION_GROWTH = 16 * 1024 * 1024;
+
+	private:
+		bool OpenFile(const std::string& FilePath);
+		void CloseFile();
+		bool MapRegion(size_t Size);
+		void Rotate();
+		void WriteToFile(std::string_view Data);
+
+		FLogFileSettings mSettings;
+		FileHeaderFn     mfnWriteHeader;
+		bool             mbBinary = false;
+		bool             mbOpen = false;
+		std::string      mBaseFilePath; // the rotated files are named after the first one
+		std::string      mFilePath;
+		size_t           mNumRotations = 0;
+		size_t           mFileSize = 0;     // bytes written into the current file
+		size_t           mHeaderSize = 0;   // bytes written by mfnWriteHeader into the current file
+		std::chrono::steady_clock::time_point mFileOpenTime;
+
+		// ofstream
+		std::ofstream    mFile;
+
+		// memory-mapped
+		void*            mhFile = nullptr;    // HANDLE
+		void*            mhMapping = nullptr; // HANDLE
+		char*            mpMappedData = nullptr;
+		size_t           mMappedSize = 0;
+	};
+}
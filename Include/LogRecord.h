@@ -0,0 +1,154 @@
+//	VQUtils
+//	Copyright(C) 2020 - Volkan Ilbeyli
+//
+//	This program is free software : you can redistribute it and / or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+//	Contact: volkanilbeyli@gmail.com
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+//
+// Binary log records: deferred formatting & the binary log file format
+//
+namespace Log
+{
+	enum ERecordType : uint8_t
+	{
+		RECORD_INFO = 0,
+		RECORD_WARNING,
+		RECORD_ERROR,
+
+		RECORD_PADDING, // async buffers: marks the skipped tail of the ring buffer
+	};
+
+	//---------------------------------------------------------------------------------------------
+	// Deferred formatting
+	//---------------------------------------------------------------------------------------------
+	// The printf arguments of a deferred message are encoded as a sequence of [EDeferredArgType][value]
+	// pairs, values are stored unaligned. Strings are copied, other pointers are stored as addresses.
+	//
+	enum EDeferredArgType : uint8_t
+	{
+		DEFERRED_ARG_INT32 = 0,
+		DEFERRED_ARG_UINT32,
+		DEFERRED_ARG_INT64,
+		DEFERRED_ARG_UINT64,
+		DEFERRED_ARG_DOUBLE,
+		DEFERRED_ARG_POINTER,
+		DEFERRED_ARG_STRING, // uint32 length + characters, no null terminator
+	};
+
+	template<class T> struct TDeferredArgUnsupported : std::false_type {};
+
+	template<class T>
+	inline size_t GetDeferredArgSize(const T& arg)
+	{
+		using U = std::decay_t<T>;
+		if constexpr (std::is_same_v<U, char*> || std::is_same_v<U, const char*>)
+			return 1 + sizeof(uint32_t) + (arg ? strlen(arg) : 0);
+		else if constexpr (std::is_pointer_v<U> || std::is_null_pointer_v<U>)
+			return 1 + sizeof(uint64_t);
+		else if constexpr (std::is_floating_point_v<U>)
+			return 1 + sizeof(double);
+		else if constexpr (std::is_integral_v<U> || std::is_enum_v<U>)
+			return 1 + (sizeof(U) <= sizeof(uint32_t) ? sizeof(uint32_t) : sizeof(uint64_t));
+		else
+			static_assert(TDeferredArgUnsupported<U>::value, "Unsupported deferred log argument type");
+	}
+
+	template<class T>
+	inline unsigned char* EncodeDeferredArg(unsigned char* pDst, const T& arg)
+	{
+		using U = std::decay_t<T>;
+		auto fnWrite = [&pDst](EDeferredArgType Type, const void* pValue, size_t NumBytes)
+		{
+			*pDst++ = Type;
+			memcpy(pDst, pValue, NumBytes);
+			pDst += NumBytes;
+		};
+
+		if constexpr (std::is_same_v<U, char*> || std::is_same_v<U, const char*>)
+		{
+			const uint32_t Length = arg ? static_cast<uint32_t>(strlen(arg)) : 0;
+			fnWrite(DEFERRED_ARG_STRING, &Length, sizeof(Length));
+			memcpy(pDst, arg, Length);
+			pDst += Length;
+		}
+		else if constexpr (std::is_pointer_v<U> || std::is_null_pointer_v<U>)
+		{
+			const uint64_t Address = reinterpret_cast<uint64_t>(static_cast<const void*>(arg));
+			fnWrite(DEFERRED_ARG_POINTER, &Address, sizeof(Address));
+		}
+		else if constexpr (std::is_floating_point_v<U>)
+		{
+			const double Value = static_cast<double>(arg);
+			fnWrite(DEFERRED_ARG_DOUBLE, &Value, sizeof(Value));
+		}
+		else if constexpr (sizeof(U) <= sizeof(uint32_t))
+		{
+			// bool, char, short & int are promoted to int in printf, the same goes for their unsigned variants
+			if constexpr (std::is_enum_v<U> || std::is_signed_v<U>) { const int32_t  Value = static_cast<int32_t>(arg);  fnWrite(DEFERRED_ARG_INT32 , &Value, sizeof(Value)); }
+			else                                                     { const uint32_t Value = static_cast<uint32_t>(arg); fnWrite(DEFERRED_ARG_UINT32, &Value, sizeof(Value)); }
+		}
+		else
+		{
+			if constexpr (std::is_enum_v<U> || std::is_signed_v<U>) { const int64_t  Value = static_cast<int64_t>(arg);  fnWrite(DEFERRED_ARG_INT64 , &Value, sizeof(Value)); }
+			else                                                     { const uint64_t Value = static_cast<uint64_t>(arg); fnWrite(DEFERRED_ARG_UINT64, &Value, sizeof(Value)); }
+		}
+		return pDst;
+	}
+
+	template<class... Args>
+	inline size_t GetDeferredArgsSize(const Args&... args) { return (size_t(0) + ... + GetDeferredArgSize(args)); }
+
+	template<class... Args>
+	inline void EncodeDeferredArgs(unsigned char* pDst, const Args&... args) { ((pDst = EncodeDeferredArg(pDst, args)), ...); }
+
+	// appends @format formatted with the encoded arguments to @out, same as sprintf would.
+	// Conversions without a matching argument are written out as-is.
+	void FormatDeferredMessage(std::string& out, const char* format, const void* pArgBytes, size_t NumArgBytes);
+
+	//---------------------------------------------------------------------------------------------
+	// Binary log file
+	//---------------------------------------------------------------------------------------------
+	// File header followed by chunks, each starting with an EBinaryLogChunk byte:
+	//
+	// - CHUNK_FORMAT_STRING: uint64 id, uint32 length, characters
+	//                        Written once for each format string before the first record referencing it.
+	// - CHUNK_RECORD       : int64 timestamp (std::chrono::system_clock ticks), uint8 ERecordType,
+	//                        uint8 bDeferred, uint32 payload size, payload
+	//                        Payload is either the message text, or uint64 format string id + encoded arguments.
+	// - CHUNK_TEXT         : uint32 length, characters. Written out verbatim when decoded.
+	// - CHUNK_END          : zero bytes, the unwritten region of a memory-mapped log file left behind by a crash.
+	//
+	constexpr char     BINARY_LOG_FILE_MAGIC[8] = { 'V', 'Q', 'L', 'O', 'G', 'B', 'I', 'N' };
+	constexpr uint32_t BINARY_LOG_FILE_VERSION = 1;
+
+	enum EBinaryLogChunk : uint8_t
+	{
+		CHUNK_END = 0,
+		CHUNK_FORMAT_STRING,
+		CHUNK_RECORD,
+		CHUNK_TEXT,
+	};
+
+	// Decodes a binary log file into the same text format the text log file would have.
+	// Returns false if the file can't be read or isn't a binary log file, a truncated last chunk is ignored.
+	bool DecodeBinaryLogFile(const std::string& BinaryLogFilePath, const std::string& TextLogFilePath);
+}
@@ -0,0 +1,57 @@
+//	VQUtils
+//	Copyright(C) 2020 - Volkan Ilbeyli
+//
+//	This program is free software : you can redistribute it and / or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+//	Contact: volkanilbeyli@gmail.com
+
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+//
+// Read-only view of a whole file mapped into memory, for decoding files in place without reading them into a buffer first.
+// The pages are read in on first access, hinted for sequential access: FILE_FLAG_SEQUENTIAL_SCAN on Windows,
+// madvise(MADV_SEQUENTIAL) on POSIX systems.
+//
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+	~MappedFile() { Close(); }
+
+	// returns false if the file can't be opened or is empty
+	bool Open(const std::string& FilePath);
+	void Close();
+
+	// asks the OS to start reading the whole file in the background, without waiting for it
+	void Prefetch() const;
+
+	inline bool                 IsOpen()  const { return mpData != nullptr; }
+	inline const unsigned char* GetData() const { return mpData; }
+	inline size_t               GetSize() const { return mSize; }
+
+private:
+	const unsigned char* mpData = nullptr;
+	size_t               mSize = 0;
+#ifdef _WIN32
+	void*                mhFile = nullptr;    // HANDLE
+	void*                mhMapping = nullptr; // HANDLE
+#endif
+};
@@ -1,6 +1,9 @@
 #pragma once
 #include <mutex>
 #include <queue>
+#include <atomic>
+#include <cstdint>
+#include <cassert>
 
 // --------------------------------------------------------------------------------------------------------------------------------------
 //
@@ -17,8 +20,9 @@ public:
 	ConcurrentQueue(void (*pfnProcess)(T&)) : mpfnProcess(pfnProcess) {}
 
 	void Enqueue(const T& item);
-	void Enqueue(const T&& item);
-	T Dequeue();
+	void Enqueue(T&& item);
+	T Dequeue(); // returns a default constructed T if the queue is empty
+	bool TryDequeue(T& item);
 
 	void ProcessItems();
 
@@ -36,7 +40,7 @@ inline void ConcurrentQueue<T>::Enqueue(const T& item)
 }
 
 template<class T>
-inline void ConcurrentQueue<T>::Enqueue(const T&& item)
+inline void ConcurrentQueue<T>::Enqueue(T&& item)
 {
 	std::lock_guard<std::mutex> lk(mMtx);
 	mQueue.push(std::move(item));
@@ -44,11 +48,21 @@ inline void ConcurrentQueue<T>::Enqueue(const T&& item)
 
 template<class T>
 inline T ConcurrentQueue<T>::Dequeue()
+{
+	T item{};
+	TryDequeue(item);
+	return item;
+}
+
+template<class T>
+inline bool ConcurrentQueue<T>::TryDequeue(T& item)
 {
 	std::lock_guard<std::mutex> lk(mMtx);
-	T item = mQueue.front();
+	if (mQueue.empty())
+		return false;
+	item = std::move(mQueue.front());
 	mQueue.pop();
-	return item;
+	return true;
 }
 
 template<class T>
@@ -56,12 +70,245 @@ inline void ConcurrentQueue<T>::ProcessItems()
 {
 	if (!mpfnProcess)
 		return;
-	
+
 	std::unique_lock<std::mutex> lk(mMtx);
-	do
+	while (!mQueue.empty())
 	{
-		T&& item = std::move(mQueue.front());
+		T item = std::move(mQueue.front());
 		mQueue.pop();
 		mpfnProcess(item);
-	} while (!mQueue.empty());
+	}
+}
+
+
+// --------------------------------------------------------------------------------------------------------------------------------------
+//
+// BoundedConcurrentQueue
+//
+//---------------------------------------------------------------------------------------------------------------------------------------
+//
+// Lock-free, fixed capacity, multi-producer multi-consumer ring buffer.
+// Alternative to ConcurrentQueue<T> for hot producer/consumer paths where the capacity can be bounded.
+//
+// Each cell carries a sequence number that tells whether the cell is ready to be written into for
+// the current lap of the producers, or ready to be read by the current lap of the consumers.
+// Producers and consumers only contend on a CAS of their own position counter.
+//
+// - TryEnqueue() returns false when the queue is full, TryDequeue() returns false when it's empty.
+// - Bulk variants claim as many consecutive cells as are available with a single CAS
+//   and return the number of items transferred.
+//
+// src: https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+//
+template<class T>
+class BoundedConcurrentQueue
+{
+public:
+	// @Capacity is rounded up to the next power of two
+	BoundedConcurrentQueue(size_t Capacity, void (*pfnProcess)(T&) = nullptr);
+	~BoundedConcurrentQueue() { delete[] mpCells; }
+
+	BoundedConcurrentQueue(const BoundedConcurrentQueue&) = delete;
+	BoundedConcurrentQueue& operator=(const BoundedConcurrentQueue&) = delete;
+
+	bool TryEnqueue(const T& item);
+	bool TryEnqueue(T&& item);
+	bool TryDequeue(T& item);
+
+	size_t TryEnqueueBulk(const T* pItems, size_t NumItems);
+	size_t TryDequeueBulk(T* pItems, size_t MaxNumItems);
+
+	// dequeues & processes items until the queue is observed empty
+	void ProcessItems();
+
+	inline size_t GetCapacity() const { return mMask + 1; }
+	inline size_t GetSizeApprox() const
+	{
+		const size_t EnqueuePos = mEnqueuePos.load(std::memory_order_relaxed);
+		const size_t DequeuePos = mDequeuePos.load(std::memory_order_relaxed);
+		return EnqueuePos > DequeuePos ? EnqueuePos - DequeuePos : 0;
+	}
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t> Sequence;
+		T Data;
+	};
+	template<class TItem> bool TryEnqueueImpl(TItem&& item);
+
+	// producers & consumers write into their own position, keep them on separate cache lines
+	alignas(64) Cell*               mpCells;
+	size_t                          mMask;
+	void                          (*mpfnProcess)(T&);
+	alignas(64) std::atomic<size_t> mEnqueuePos;
+	alignas(64) std::atomic<size_t> mDequeuePos;
+};
+
+template<class T>
+inline BoundedConcurrentQueue<T>::BoundedConcurrentQueue(size_t Capacity, void (*pfnProcess)(T&))
+	: mpfnProcess(pfnProcess)
+	, mEnqueuePos(0)
+	, mDequeuePos(0)
+{
+	size_t PowerOfTwoCapacity = 2;
+	while (PowerOfTwoCapacity < Capacity)
+		PowerOfTwoCapacity <<= 1;
+
+	mMask = PowerOfTwoCapacity - 1;
+	mpCells = new Cell[PowerOfTwoCapacity];
+	for (size_t i = 0; i < PowerOfTwoCapacity; ++i)
+		mpCells[i].Sequence.store(i, std::memory_order_relaxed);
+}
+
+template<class T>
+inline bool BoundedConcurrentQueue<T>::TryEnqueue(const T& item) { return TryEnqueueImpl(item); }
+template<class T>
+inline bool BoundedConcurrentQueue<T>::TryEnqueue(T&& item) { return TryEnqueueImpl(std::move(item)); }
+
+template<class T>
+template<class TItem>
+inline bool BoundedConcurrentQueue<T>::TryEnqueueImpl(TItem&& item)
+{
+	Cell* pCell = nullptr;
+	size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		pCell = &mpCells[pos & mMask];
+		const size_t seq = pCell->Sequence.load(std::memory_order_acquire);
+		const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+		if (diff == 0)
+		{
+			if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0)
+		{
+			return false; // full
+		}
+		else
+		{
+			pos = mEnqueuePos.load(std::memory_order_relaxed); // another producer got ahead of us
+		}
+	}
+
+	pCell->Data = std::forward<TItem>(item);
+	pCell->Sequence.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+template<class T>
+inline bool BoundedConcurrentQueue<T>::TryDequeue(T& item)
+{
+	Cell* pCell = nullptr;
+	size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		pCell = &mpCells[pos & mMask];
+		const size_t seq = pCell->Sequence.load(std::memory_order_acquire);
+		const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+		if (diff == 0)
+		{
+			if (mDequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0)
+		{
+			return false; // empty
+		}
+		else
+		{
+			pos = mDequeuePos.load(std::memory_order_relaxed); // another consumer got ahead of us
+		}
+	}
+
+	item = std::move(pCell->Data);
+	pCell->Sequence.store(pos + mMask + 1, std::memory_order_release); // ready for the next lap of producers
+	return true;
+}
+
+template<class T>
+inline size_t BoundedConcurrentQueue<T>::TryEnqueueBulk(const T* pItems, size_t NumItems)
+{
+	// A free cell can only change state after its position is claimed by a producer,
+	// hence counting the free cells from pos and then CAS'ing pos forward is safe.
+	size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+	size_t NumClaimed = 0;
+	for (;;)
+	{
+		NumClaimed = 0;
+		while (NumClaimed < NumItems && NumClaimed <= mMask)
+		{
+			const size_t i = pos + NumClaimed;
+			if (mpCells[i & mMask].Sequence.load(std::memory_order_acquire) != i)
+				break;
+			++NumClaimed;
+		}
+		if (NumClaimed == 0)
+		{
+			// either full, or another producer claimed pos already
+			const size_t CurrPos = mEnqueuePos.load(std::memory_order_relaxed);
+			if (CurrPos == pos)
+				return 0; // full
+			pos = CurrPos;
+			continue;
+		}
+		if (mEnqueuePos.compare_exchange_weak(pos, pos + NumClaimed, std::memory_order_relaxed))
+			break;
+	}
+
+	for (size_t i = 0; i < NumClaimed; ++i)
+	{
+		Cell& cell = mpCells[(pos + i) & mMask];
+		cell.Data = pItems[i];
+		cell.Sequence.store(pos + i + 1, std::memory_order_release);
+	}
+	return NumClaimed;
+}
+
+template<class T>
+inline size_t BoundedConcurrentQueue<T>::TryDequeueBulk(T* pItems, size_t MaxNumItems)
+{
+	size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+	size_t NumClaimed = 0;
+	for (;;)
+	{
+		NumClaimed = 0;
+		while (NumClaimed < MaxNumItems && NumClaimed <= mMask)
+		{
+			const size_t i = pos + NumClaimed;
+			if (mpCells[i & mMask].Sequence.load(std::memory_order_acquire) != i + 1)
+				break;
+			++NumClaimed;
+		}
+		if (NumClaimed == 0)
+		{
+			const size_t CurrPos = mDequeuePos.load(std::memory_order_relaxed);
+			if (CurrPos == pos)
+				return 0; // empty
+			pos = CurrPos;
+			continue;
+		}
+		if (mDequeuePos.compare_exchange_weak(pos, pos + NumClaimed, std::memory_order_relaxed))
+			break;
+	}
+
+	for (size_t i = 0; i < NumClaimed; ++i)
+	{
+		Cell& cell = mpCells[(pos + i) & mMask];
+		pItems[i] = std::move(cell.Data);
+		cell.Sequence.store(pos + i + mMask + 1, std::memory_order_release);
+	}
+	return NumClaimed;
+}
+
+template<class T>
+inline void BoundedConcurrentQueue<T>::ProcessItems()
+{
+	if (!mpfnProcess)
+		return;
+
+	T item;
+	while (TryDequeue(item))
+		mpfnProcess(item);
 }
@@ -0,0 +1,125 @@
+#pragma once
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <type_traits>
+#include <new>
+
+// --------------------------------------------------------------------------------------------------------------------------------------
+//
+// Pooled Task
+//
+//---------------------------------------------------------------------------------------------------------------------------------------
+//
+// Lightweight completion handle for ThreadPool::Dispatch(), in place of std::future<>.
+// Counts the tasks dispatched with it that are yet to complete, can be reused once IsDone().
+// Must outlive the tasks dispatched with it.
+//
+class TaskCounter
+{
+public:
+	inline bool IsDone() const { return mNumPendingTasks.load(std::memory_order_acquire) == 0; }
+	inline int  GetNumPendingTasks() const { return mNumPendingTasks.load(std::memory_order_relaxed); }
+
+	// yields until all the tasks complete, without running any tasks on the calling thread.
+	inline void Wait() const { while (!IsDone()) std::this_thread::yield(); }
+
+	inline void OnTaskAdded() { mNumPendingTasks.fetch_add(1, std::memory_order_relaxed); }
+	inline void OnTaskComplete() { mNumPendingTasks.fetch_sub(1, std::memory_order_release); }
+
+private:
+	std::atomic<int> mNumPendingTasks = 0;
+};
+
+class TaskAllocator;
+
+//
+// Type-erased void() callable stored in a fixed size block from a TaskAllocator.
+// Callables that fit into the inline storage (captures up to INLINE_STORAGE_SIZE bytes) don't allocate,
+// larger ones fall back to the heap for the callable only.
+//
+struct alignas(64) FPooledTask
+{
+	static constexpr size_t SIZE = 128;
+	static constexpr size_t INLINE_STORAGE_SIZE = SIZE - 5 * sizeof(void*);
+	static constexpr size_t INLINE_STORAGE_ALIGNMENT = 16;
+
+	// allocates the task from the calling thread's TaskAllocator
+	template<class TFunc>
+	static FPooledTask* Create(TFunc&& fn, TaskCounter* pCounter = nullptr);
+
+	// runs the task, releases it and then signals its counter.
+	static void Run(FPooledTask* pTask);
+
+	// releases the task without running it, its counter is still signaled so that waiters don't hang.
+	static void Discard(FPooledTask* pTask);
+
+	alignas(INLINE_STORAGE_ALIGNMENT) unsigned char Storage[INLINE_STORAGE_SIZE];
+	void (*pfnInvoke)(void* pStorage);
+	void (*pfnDestroy)(void* pStorage);
+	TaskCounter*   pCounter;
+	TaskAllocator* pOwner;
+	FPooledTask*   pNext; // free list link
+};
+static_assert(sizeof(FPooledTask) == FPooledTask::SIZE, "FPooledTask must fill its block exactly");
+
+//
+// Per-thread free list of FPooledTask blocks, grown in slabs.
+//
+// - Allocate() is only called by the owner thread and doesn't take any locks.
+// - Free() can be called from any thread: the owner pushes into its local free list, other threads
+//   push into a lock-free remote free list which the owner reclaims all at once when it runs out.
+// - Allocators of exited threads are handed over to new threads rather than destroyed,
+//   as the tasks they allocated may still be in flight.
+//
+class TaskAllocator
+{
+public:
+	static TaskAllocator& GetThreadLocal();
+
+	TaskAllocator() = default;
+	TaskAllocator(const TaskAllocator&) = delete;
+	TaskAllocator& operator=(const TaskAllocator&) = delete;
+
+	FPooledTask* Allocate();
+	void Free(FPooledTask* pTask);
+
+	// number of slabs allocated by all the TaskAllocators, for profiling
+	static size_t GetNumSlabAllocations();
+
+	static constexpr size_t NUM_TASKS_PER_SLAB = 256;
+
+private:
+	void AllocateSlab();
+
+	FPooledTask*                              mpFreeList = nullptr; // owner thread only
+	std::vector<std::unique_ptr<FPooledTask[]>> mSlabs;
+	alignas(64) std::atomic<FPooledTask*>     mpRemoteFreeList = nullptr;
+};
+
+template<class TFunc>
+inline FPooledTask* FPooledTask::Create(TFunc&& fn, TaskCounter* pCounter)
+{
+	using TCallable = std::decay_t<TFunc>;
+
+	FPooledTask* pTask = TaskAllocator::GetThreadLocal().Allocate();
+	if constexpr (sizeof(TCallable) <= INLINE_STORAGE_SIZE && alignof(TCallable) <= INLINE_STORAGE_ALIGNMENT)
+	{
+		new (pTask->Storage) TCallable(std::forward<TFunc>(fn));
+		pTask->pfnInvoke  = [](void* pStorage) { (*static_cast<TCallable*>(pStorage))(); };
+		pTask->pfnDestroy = [](void* pStorage) { static_cast<TCallable*>(pStorage)->~TCallable(); };
+	}
+	else
+	{
+		new (pTask->Storage) TCallable*(new TCallable(std::forward<TFunc>(fn)));
+		pTask->pfnInvoke  = [](void* pStorage) { (**static_cast<TCallable**>(pStorage))(); };
+		pTask->pfnDestroy = [](void* pStorage) { delete *static_cast<TCallable**>(pStorage); };
+	}
+
+	pTask->pCounter = pCounter;
+	if (pCounter)
+		pCounter->OnTaskAdded();
+	return pTask;
+}
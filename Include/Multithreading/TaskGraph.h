@@ -0,0 +1,81 @@
+#pragma once
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+// --------------------------------------------------------------------------------------------------------------------------------------
+//
+// Task Graph
+//
+//---------------------------------------------------------------------------------------------------------------------------------------
+//
+// A DAG of tasks executed on a ThreadPool, where each node is scheduled once all of its predecessors complete.
+// Nodes never block waiting on each other: the thread that completes the last predecessor of a node
+// schedules it, running one of the newly ready nodes inline and adding the rest to the pool.
+//
+// The graph is built once (AddNode/AddEdge) and can be submitted any number of times, e.g. once per frame.
+// Submit() only resets the preallocated per-node counters, and nodes are scheduled through ThreadPool::Dispatch(),
+// so executing the graph doesn't allocate memory once the pool's task allocators are warmed up.
+//
+// Usage:
+//
+//   TaskGraph g;
+//   TaskGraph::NodeID a = g.AddNode([]() { /* ... */ });
+//   TaskGraph::NodeID b = g.AddNode([]() { /* ... */ });
+//   g.AddEdge(a, b); // b runs after a
+//
+//   // each frame
+//   g.Submit(pool);
+//   ...
+//   g.Wait();
+//
+class TaskGraph
+{
+public:
+	using NodeID = uint32_t;
+
+	TaskGraph() = default;
+	TaskGraph(const TaskGraph&) = delete;
+	TaskGraph& operator=(const TaskGraph&) = delete;
+
+	// build interface, must not be called while the graph is executing
+	NodeID AddNode(std::function<void()> fn);
+	void   AddEdge(NodeID Predecessor, NodeID Successor);
+	void   Clear();
+
+	inline size_t GetNumNodes() const { return mNodeTasks.size(); }
+
+	// Schedules the nodes without predecessors on @pool and returns immediately.
+	// The graph must not be submitted again before it completes.
+	void Submit(ThreadPool& pool, ETaskPriority priority = ETaskPriority::NORMAL);
+
+	// returns once all the nodes have completed, without running any nodes on the calling thread.
+	void Wait() const;
+	inline bool IsComplete() const { return mNumNodesRemaining.load(std::memory_order_acquire) == 0; }
+
+private:
+	// builds the flattened successor lists & validates the graph, called on Submit() after the graph changes
+	bool Finalize();
+	void ScheduleNode(NodeID node);
+	void RunNode(NodeID node);
+
+	// build data
+	std::vector<std::function<void()>>  mNodeTasks;
+	std::vector<std::pair<NodeID, NodeID>> mEdges;
+	bool mbDirty = true;
+
+	// execution data (flattened successor list: successors of node i are mSuccessors[mSuccessorOffsets[i] .. mSuccessorOffsets[i+1]])
+	std::vector<NodeID>                   mSuccessorOffsets;
+	std::vector<NodeID>                   mSuccessors;
+	std::vector<NodeID>                   mRootNodes;
+	std::vector<uint32_t>                 mNumPredecessors;
+	std::unique_ptr<std::atomic<uint32_t>[]> mNumPendingPredecessors;
+	std::atomic<size_t>                   mNumNodesRemaining = 0;
+
+	ThreadPool*   mpPool = nullptr;
+	ETaskPriority mPriority = ETaskPriority::NORMAL;
+};
@@ -1,9 +1,13 @@
 #pragma once
 #include "EventSignal.h"
+#include "WorkStealingQueue.h"
+#include "PooledTask.h"
 
 #include <atomic>
 #include <queue>
 #include <future>
+#include <memory>
+#include <algorithm>
 
 // --------------------------------------------------------------------------------------------------------------------------------------
 //
@@ -23,7 +27,6 @@ enum class ETaskPriority
 	CRITICAL = 5,
 	REAL_TIME = 6
 };
-using Task = std::function<void()>;
 class TaskQueue
 {
 
@@ -32,7 +35,8 @@ class TaskQueue
 public:
 	template<class T>
 	void AddTask(std::shared_ptr<T>& pTask, ETaskPriority priority = ETaskPriority::NORMAL);
-	bool TryPopTask(Task& task);
+	void AddTask(FPooledTask* pTask, ETaskPriority priority = ETaskPriority::NORMAL);
+	bool TryPopTask(FPooledTask*& pTask);
 
 	inline bool IsQueueEmpty()      const { std::unique_lock<std::mutex> lock(mutex); return queue.empty(); }
 	inline int  GetNumActiveTasks() const { return activeTasks; }
@@ -43,7 +47,7 @@ public:
 private:
 	struct TaskEntry
 	{
-		Task task;
+		FPooledTask* pTask;
 		ETaskPriority priority;
 		uint64_t sequence; // for maintaining order within same priority
 	};
@@ -65,13 +69,70 @@ private:
 template<class T>
 inline void TaskQueue::AddTask(std::shared_ptr<T>& pTask, ETaskPriority priority)
 {
-	std::unique_lock<std::mutex> lock(mutex);
-	queue.push(TaskEntry{ [=]() { (*pTask)(); }, priority, sequenceCounter++ });
-	++activeTasks;
+	AddTask(FPooledTask::Create([pTask]() { (*pTask)(); }), priority);
 }
 
 
 
+//
+// Range dispenser for ThreadPool::ParallelFor/ParallelReduce.
+//
+// Participants claim chunks of [begin, end) from a shared atomic cursor until the range is exhausted,
+// so the threads that finish early simply claim more chunks instead of idling (lazy splitting).
+// Chunk size starts large and shrinks towards @grain as the range is consumed (guided scheduling),
+// keeping the number of atomic operations low while still balancing irregular work at the tail.
+//
+struct FParallelRange
+{
+	FParallelRange(size_t begin, size_t end, size_t grain, size_t NumParticipants)
+		: Begin(begin), End(end), Grain(grain), NumParticipants(NumParticipants), Cursor(begin), NumItemsCompleted(0), NumParticipantsJoined(0) {}
+
+	bool TryClaimChunk(size_t& ChunkBegin, size_t& ChunkEnd);
+	inline void OnChunkComplete(size_t NumItems) { NumItemsCompleted.fetch_add(NumItems, std::memory_order_acq_rel); }
+	inline bool IsComplete() const { return NumItemsCompleted.load(std::memory_order_acquire) == End - Begin; }
+
+	const size_t Begin;
+	const size_t End;
+	const size_t Grain;
+	const size_t NumParticipants;
+	alignas(64) std::atomic<size_t> Cursor;
+	alignas(64) std::atomic<size_t> NumItemsCompleted;
+	std::atomic<size_t> NumParticipantsJoined;
+};
+inline bool FParallelRange::TryClaimChunk(size_t& ChunkBegin, size_t& ChunkEnd)
+{
+	size_t i = Cursor.load(std::memory_order_relaxed);
+	size_t ChunkSize = 0;
+	do
+	{
+		if (i >= End)
+			return false;
+		const size_t NumRemaining = End - i;
+		ChunkSize = std::min(NumRemaining, std::max(Grain, NumRemaining / (2 * NumParticipants)));
+	} while (!Cursor.compare_exchange_weak(i, i + ChunkSize, std::memory_order_relaxed));
+
+	ChunkBegin = i;
+	ChunkEnd = i + ChunkSize;
+	return true;
+}
+
+
+//
+// Scheduling strategies for the ThreadPool
+//
+enum class EThreadPoolScheduler
+{
+	// All workers pop from the single mutex-guarded TaskQueue
+	SHARED_QUEUE = 0,
+
+	// Each worker owns a WorkStealingQueue. Tasks added from a worker thread are pushed
+	// into that worker's own queue (LIFO, lock-free), idle workers steal from the others.
+	// Tasks added from outside the pool go through the shared TaskQueue so that
+	// ETaskPriority ordering still holds for cross-thread submissions.
+	WORK_STEALING,
+};
+
+
 //
 // A Collection of threads picking up tasks from its queue and executes on threads
 // src: https://www.youtube.com/watch?v=eWTGtp3HXiw
@@ -81,10 +142,10 @@ class ThreadPool
 public:
 	const static size_t sHardwareThreadCount;
 
-	void Initialize(size_t numWorkers, const std::string& ThreadPoolName, unsigned int MarkerColor = 0xFFAAAAAA);
+	void Initialize(size_t numWorkers, const std::string& ThreadPoolName, unsigned int MarkerColor = 0xFFAAAAAA, EThreadPoolScheduler Scheduler = EThreadPoolScheduler::SHARED_QUEUE);
 	void Destroy();
 
-	inline int GetNumActiveTasks() const { return IsExiting() ? 0 : mTaskQueue.GetNumActiveTasks(); };
+	inline int GetNumActiveTasks() const { return IsExiting() ? 0 : (mTaskQueue.GetNumActiveTasks() + mNumActiveLocalTasks.load()); };
 	inline size_t GetThreadPoolSize() const { return mWorkers.size(); }
 	
 	inline std::string GetThreadPoolName() const { return mThreadPoolName; }
@@ -92,6 +153,10 @@ public:
 	void RunRemainingTasksOnThisThread();
 
 	inline bool IsExiting() const { return mbStopWorkers.load(); }
+	inline EThreadPoolScheduler GetScheduler() const { return mScheduler; }
+
+	// returns true if the calling thread is one of this pool's workers
+	bool IsWorkerThread() const;
 
 	// Adds a task to the thread pool and returns the std::future<> 
 	// containing the return type of the added task.
@@ -99,14 +164,58 @@ public:
 	template<class T>
 	auto AddTask(T task, ETaskPriority priority = ETaskPriority::NORMAL) -> std::future<decltype(task())>;
 
+	// Adds a fire-and-forget task to the thread pool. Unlike AddTask(), doesn't allocate memory once
+	// the calling thread's TaskAllocator is warmed up, provided the captures of @task fit into
+	// FPooledTask::INLINE_STORAGE_SIZE. Completion can be tracked through the optional @pCounter.
+	//
+	template<class TFunc>
+	void Dispatch(TFunc&& task, ETaskPriority priority = ETaskPriority::NORMAL, TaskCounter* pCounter = nullptr);
+
+	// Calls @fn(i) for each i in [begin, end) using the workers and the calling thread.
+	// Work is split lazily in chunks of at least @grain items (see FParallelRange).
+	// Returns once all the items are processed. Safe to call from within a task of this pool
+	// as the calling thread can process the whole range by itself if the workers are busy.
+	//
+	template<class TFunc>
+	void ParallelFor(size_t begin, size_t end, size_t grain, TFunc&& fn);
+
+	// Reduces [begin, end) with @fnAccumulate(T accumulator, size_t i) -> T on each participating thread,
+	// starting from @identity, then combines the per-thread results with @fnCombine(T, T) -> T.
+	// @fnCombine should be associative, the order of combination isn't specified.
+	//
+	template<class T, class TFuncAccumulate, class TFuncCombine>
+	T ParallelReduce(size_t begin, size_t end, size_t grain, const T& identity, TFuncAccumulate&& fnAccumulate, TFuncCombine&& fnCombine);
+
 private:
+	// runs @fnParticipate(FParallelRange&, ChunkBegin, ChunkEnd) with the first chunk claimed by each of up to
+	// (@NumParticipants-1) workers and the calling thread, returns once all the items in @pRange are processed.
+	template<class TFunc>
+	void RunParallelRange(const std::shared_ptr<FParallelRange>& pRange, TFunc&& fnParticipate);
+
+	// pushes the task into the calling worker's local queue if work stealing, into the shared queue otherwise
+	void EnqueueTask(FPooledTask* pTask, ETaskPriority priority);
+
 	void Execute(); // workers run Execute();
+	void ExecuteWorkStealing(size_t iWorker);
+
+	// work stealing: pushes the task into the calling worker's local queue,
+	// returns false if the calling thread isn't a worker of this pool.
+	bool TryPushLocalTask(FPooledTask* pTask);
+	bool TryStealLocalTask(size_t iWorker, FPooledTask*& pTask);
+	void RunLocalTask(FPooledTask* pTask);
+	bool HasQueuedTasks() const;
 
 	EventSignal              mSignal;
 	std::atomic<bool>        mbStopWorkers;
 	TaskQueue                mTaskQueue;
 	std::vector<std::thread> mWorkers;
 	std::string              mThreadPoolName;
+	EThreadPoolScheduler     mScheduler = EThreadPoolScheduler::SHARED_QUEUE;
+
+	// work stealing
+	std::vector<std::unique_ptr<WorkStealingQueue<FPooledTask*>>> mLocalQueues; // one per worker
+	std::atomic<int>         mNumQueuedLocalTasks = 0; // pushed & not yet popped/stolen
+	std::atomic<int>         mNumActiveLocalTasks = 0; // pushed & not yet completed
 
 public:
 	unsigned int             mMarkerColor;
@@ -129,12 +238,118 @@ auto ThreadPool::AddTask(T task, ETaskPriority priority) -> std::future<decltype
 	// use a shared_ptr<> of packaged tasks here as we execute them in the thread pool workers as well
 	// as accesing its get_future() on the thread that calls this AddTask() function.
 	auto pTask = std::make_shared< std::packaged_task<task_return_t()>>(std::move(task));
-	mTaskQueue.AddTask(pTask, priority);
-	//Log::Info("[%s] TaskQueue::AddTask()", this->mThreadPoolName.c_str());
+	std::future<task_return_t> future = pTask->get_future();
+
+	EnqueueTask(FPooledTask::Create([pTask]() { (*pTask)(); }), priority);
+	return future;
+}
+
+template<class TFunc>
+void ThreadPool::Dispatch(TFunc&& task, ETaskPriority priority, TaskCounter* pCounter)
+{
+	EnqueueTask(FPooledTask::Create(std::forward<TFunc>(task), pCounter), priority);
+}
+
+template<class TFunc>
+void ThreadPool::RunParallelRange(const std::shared_ptr<FParallelRange>& pRange, TFunc&& fnParticipate)
+{
+	// Helper tasks hold a reference to the range so that the ones picked up late, after the range
+	// has been exhausted by the others, can still safely find out there's nothing left to do.
+	// @fnParticipate lives on this thread's stack: it is only called after claiming a chunk,
+	// which prevents this function from returning until the chunk is reported complete.
+	// For the same reason, @fnParticipate must not access its captures after reporting its
+	// last chunk complete, hence the range is passed in as a parameter.
+	std::remove_reference_t<TFunc>* pfnParticipate = &fnParticipate;
+	for (size_t i = 1; i < pRange->NumParticipants; ++i)
+	{
+		Dispatch([pRange, pfnParticipate]()
+		{
+			size_t ChunkBegin = 0, ChunkEnd = 0;
+			if (pRange->TryClaimChunk(ChunkBegin, ChunkEnd))
+				(*pfnParticipate)(*pRange, ChunkBegin, ChunkEnd);
+		});
+	}
+
+	size_t ChunkBegin = 0, ChunkEnd = 0;
+	if (pRange->TryClaimChunk(ChunkBegin, ChunkEnd))
+		fnParticipate(*pRange, ChunkBegin, ChunkEnd);
+
+	// wait for the chunks claimed by the other threads
+	while (!pRange->IsComplete())
+		std::this_thread::yield();
+}
+
+template<class TFunc>
+void ThreadPool::ParallelFor(size_t begin, size_t end, size_t grain, TFunc&& fn)
+{
+	if (end <= begin)
+		return;
+	grain = std::max<size_t>(grain, 1);
+
+	const size_t NumChunksMax = (end - begin + grain - 1) / grain;
+	const size_t NumParticipants = std::min(GetThreadPoolSize() + 1, NumChunksMax);
+	if (NumParticipants <= 1)
+	{
+		for (size_t i = begin; i < end; ++i)
+			fn(i);
+		return;
+	}
+
+	std::shared_ptr<FParallelRange> pRange = std::make_shared<FParallelRange>(begin, end, grain, NumParticipants);
+	RunParallelRange(pRange, [&fn](FParallelRange& Range, size_t ChunkBegin, size_t ChunkEnd)
+	{
+		do
+		{
+			for (size_t i = ChunkBegin; i < ChunkEnd; ++i)
+				fn(i);
+			Range.OnChunkComplete(ChunkEnd - ChunkBegin);
+		} while (Range.TryClaimChunk(ChunkBegin, ChunkEnd));
+	});
+}
+
+template<class T, class TFuncAccumulate, class TFuncCombine>
+T ThreadPool::ParallelReduce(size_t begin, size_t end, size_t grain, const T& identity, TFuncAccumulate&& fnAccumulate, TFuncCombine&& fnCombine)
+{
+	if (end <= begin)
+		return identity;
+	grain = std::max<size_t>(grain, 1);
+
+	const size_t NumChunksMax = (end - begin + grain - 1) / grain;
+	const size_t NumParticipants = std::min(GetThreadPoolSize() + 1, NumChunksMax);
+	if (NumParticipants <= 1)
+	{
+		T result = identity;
+		for (size_t i = begin; i < end; ++i)
+			result = fnAccumulate(result, i);
+		return result;
+	}
+
+	// each participant accumulates into its own slot, combined on the calling thread at the end
+	std::vector<T> PartialResults(NumParticipants, identity);
+
+	std::shared_ptr<FParallelRange> pRange = std::make_shared<FParallelRange>(begin, end, grain, NumParticipants);
+	RunParallelRange(pRange, [&fnAccumulate, &PartialResults, &identity](FParallelRange& Range, size_t ChunkBegin, size_t ChunkEnd)
+	{
+		const size_t iParticipant = Range.NumParticipantsJoined.fetch_add(1, std::memory_order_relaxed);
+		size_t NumItemsProcessed = 0;
+		T result = identity;
+		do
+		{
+			for (size_t i = ChunkBegin; i < ChunkEnd; ++i)
+				result = fnAccumulate(result, i);
+			NumItemsProcessed += ChunkEnd - ChunkBegin;
+		} while (Range.TryClaimChunk(ChunkBegin, ChunkEnd));
+
+		// publish the partial result before reporting the items as complete
+		PartialResults[iParticipant] = std::move(result);
+		Range.OnChunkComplete(NumItemsProcessed);
+	});
 
-	mSignal.NotifyOne();
-	//Log::Info("[%s] EventSignal::NotifyOne()", this->mThreadPoolName.c_str());
-	return pTask->get_future();
+	T result = identity;
+	const size_t NumParticipantsJoined = pRange->NumParticipantsJoined.load();
+	for (size_t i = 0; i < NumParticipantsJoined; ++i)
+		result = fnCombine(result, PartialResults[i]);
+	return result;
 }
 
 std::vector<std::pair<size_t, size_t>> PartitionWorkItemsIntoRanges(size_t NumWorkItems, size_t NumWorkerThreadCount);
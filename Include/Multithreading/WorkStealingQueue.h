@@ -0,0 +1,143 @@
+#pragma once
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <cassert>
+#include <type_traits>
+
+// --------------------------------------------------------------------------------------------------------------------------------------
+//
+// Work Stealing Queue
+//
+//---------------------------------------------------------------------------------------------------------------------------------------
+//
+// Chase-Lev work-stealing deque.
+//
+// - The owner thread Push()es and Pop()s from the bottom end (LIFO), without taking any locks.
+// - Any other thread can Steal() from the top end (FIFO), contending only on a single CAS.
+// - The ring buffer grows when full. Retired buffers are kept alive until the queue is destroyed
+//   as a concurrent Steal() might still be reading from them.
+//
+// T is stored in std::atomic<T> slots, hence should be a trivially copyable type, e.g. a pointer.
+//
+// src: Le, Pop, Cohen, Nardelli - Correct and Efficient Work-Stealing for Weak Memory Models (PPoPP'13)
+//
+template<class T>
+class WorkStealingQueue
+{
+	static_assert(std::is_trivially_copyable<T>::value, "WorkStealingQueue<T> requires a trivially copyable T");
+public:
+	explicit WorkStealingQueue(int64_t InitialCapacity = 1024);
+	~WorkStealingQueue();
+
+	WorkStealingQueue(const WorkStealingQueue&) = delete;
+	WorkStealingQueue& operator=(const WorkStealingQueue&) = delete;
+
+	// owner thread only
+	void Push(T item);
+	bool Pop(T& item);
+
+	// any thread
+	bool Steal(T& item);
+
+	inline bool    IsEmpty() const { return GetSizeApprox() <= 0; }
+	inline int64_t GetSizeApprox() const { return mBottom.load(std::memory_order_relaxed) - mTop.load(std::memory_order_relaxed); }
+
+private:
+	struct RingBuffer
+	{
+		RingBuffer(int64_t capacity) : Capacity(capacity), Mask(capacity - 1), pItems(new std::atomic<T>[capacity]) { assert((capacity & Mask) == 0); }
+		~RingBuffer() { delete[] pItems; }
+
+		inline T    Get(int64_t i) const { return pItems[i & Mask].load(std::memory_order_relaxed); }
+		inline void Put(int64_t i, T item) { pItems[i & Mask].store(item, std::memory_order_relaxed); }
+		RingBuffer* Grow(int64_t bottom, int64_t top) const
+		{
+			RingBuffer* pNew = new RingBuffer(Capacity * 2);
+			for (int64_t i = top; i != bottom; ++i)
+				pNew->Put(i, Get(i));
+			return pNew;
+		}
+
+		int64_t Capacity;
+		int64_t Mask;
+		std::atomic<T>* pItems;
+	};
+
+	// top & bottom are written by different threads, keep them on separate cache lines
+	alignas(64) std::atomic<int64_t>     mTop;
+	alignas(64) std::atomic<int64_t>     mBottom;
+	alignas(64) std::atomic<RingBuffer*> mpBuffer;
+	std::vector<RingBuffer*>             mRetiredBuffers; // owner thread only
+};
+
+template<class T>
+inline WorkStealingQueue<T>::WorkStealingQueue(int64_t InitialCapacity)
+	: mTop(0)
+	, mBottom(0)
+	, mpBuffer(new RingBuffer(InitialCapacity))
+{}
+
+template<class T>
+inline WorkStealingQueue<T>::~WorkStealingQueue()
+{
+	for (RingBuffer* pBuffer : mRetiredBuffers)
+		delete pBuffer;
+	delete mpBuffer.load();
+}
+
+template<class T>
+inline void WorkStealingQueue<T>::Push(T item)
+{
+	const int64_t b = mBottom.load(std::memory_order_relaxed);
+	const int64_t t = mTop.load(std::memory_order_acquire);
+	RingBuffer* pBuffer = mpBuffer.load(std::memory_order_relaxed);
+	if (b - t > pBuffer->Capacity - 1) // full
+	{
+		mRetiredBuffers.push_back(pBuffer);
+		pBuffer = pBuffer->Grow(b, t);
+		mpBuffer.store(pBuffer, std::memory_order_release);
+	}
+	pBuffer->Put(b, item);
+	mBottom.store(b + 1, std::memory_order_release); // publish the item to the thieves
+}
+
+template<class T>
+inline bool WorkStealingQueue<T>::Pop(T& item)
+{
+	const int64_t b = mBottom.load(std::memory_order_relaxed) - 1;
+	RingBuffer* pBuffer = mpBuffer.load(std::memory_order_relaxed);
+	mBottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t t = mTop.load(std::memory_order_relaxed);
+
+	if (t > b) // empty
+	{
+		mBottom.store(b + 1, std::memory_order_relaxed);
+		return false;
+	}
+
+	item = pBuffer->Get(b);
+	if (t == b) // last item: race against the thieves
+	{
+		const bool bWon = mTop.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		mBottom.store(b + 1, std::memory_order_relaxed);
+		return bWon;
+	}
+	return true;
+}
+
+template<class T>
+inline bool WorkStealingQueue<T>::Steal(T& item)
+{
+	int64_t t = mTop.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	const int64_t b = mBottom.load(std::memory_order_acquire);
+
+	if (t >= b) // empty
+		return false;
+
+	RingBuffer* pBuffer = mpBuffer.load(std::memory_order_acquire);
+	item = pBuffer->Get(t);
+	return mTop.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
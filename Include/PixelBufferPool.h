@@ -0,0 +1,56 @@
+//	VQUtils
+//	Copyright(C) 2020 - Volkan Ilbeyli
+//
+//	This program is free software : you can redistribute it and / or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+//	Contact: volkanilbeyli@gmail.com
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+struct FPixelBufferPoolStats
+{
+    uint64_t NumAllocations = 0;       // Allocate() & Reallocate() calls
+    uint64_t NumSystemAllocations = 0; // allocations that went to malloc, the rest were reused from the pool
+    uint64_t NumSystemFrees = 0;       // buffers returned to free() instead of the pool
+    size_t   NumBytesCached = 0;       // bytes of the free buffers held by the pool
+    size_t   PeakBytesCached = 0;
+};
+
+//
+// Size-bucketed cache of the pixel buffers of images & mip chains: freed buffers are kept in the bucket of their size
+// & handed out again to the allocations of the same bucket, so load/resize/free cycles don't go to the system allocator.
+//
+// Each power of two is split into 4 buckets (at most 25% wasted), allocations below MIN_POOLED_SIZE go to malloc directly.
+// Buffers are 16-byte aligned, the same as malloc, & carry their bucket in a header: Free() needs no size.
+// The pool holds up to the MaxCachedBytes of free buffers, the buffers freed beyond that go back to the system.
+// Thread-safe, each bucket has its own lock.
+//
+namespace PixelBufferPool
+{
+    constexpr size_t MIN_POOLED_SIZE = 64 * 1024;
+
+    void* Allocate(size_t Size);
+    void* Reallocate(void* p, size_t NewSize); // realloc() semantics, @p can be null
+    void  Free(void* p);                       // @p can be null
+
+    void   SetMaxCachedBytes(size_t MaxCachedBytes); // 0 disables caching, the default is 256MB
+    size_t GetMaxCachedBytes();
+    void   Trim(); // returns all the free buffers to the system
+
+    FPixelBufferPoolStats GetStats();
+    void ResetStats();
+}
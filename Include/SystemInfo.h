@@ -186,6 +186,13 @@ namespace VQSystemInfo
 	FRAMInfo                  GetRAMInfo();
 	FSystemInfo               GetSystemInfo();
 
+	// Widest SIMD instruction set supported by the CPU & enabled by the OS, for picking code paths at runtime.
+	// Detected with CPUID on the first call, cheap to call afterwards.
+	enum class ESIMDLevel { SCALAR = 0, SSE2, SSE42, AVX2 };
+	ESIMDLevel                GetSIMDLevel();
+	// F16C half <-> float conversions (VCVTPS2PH/VCVTPH2PS), reported separately from AVX2 by CPUID & also needing the OS' AVX support.
+	bool                      HasF16C();
+
 	// std::string GetFormattedSize(unsigned long long Bytes); // GetFormattedSize(1048576) -> "1MB"
 	std::string PrintSystemInfo(const FSystemInfo& i, const bool bDetailed = false);
 
@@ -24,6 +24,8 @@
 #pragma once
 
 #include <chrono>
+#include <string_view>
+#include <cstdint>
 
 using TimeStamp = std::chrono::time_point<std::chrono::system_clock>;	// TimeStamp != std::time_t
 using Duration  = std::chrono::duration<float>;
@@ -60,3 +62,30 @@ private:
 	bool      bIsStopped;
 };
 
+
+//
+// Formats TimeStamps as "YYYY_MM_DD-HH:MM:SS[.uuuuuu]", the same format as GetTimeAsString() in utils.h.
+// The rendered date, hour & minute are cached: localtime is only called when the minute changes,
+// otherwise only the second & microsecond digits are re-rendered.
+// Not thread-safe, use one formatter per thread, e.g. GetThreadLocal().
+//
+class TimestampFormatter
+{
+public:
+	static TimestampFormatter& GetThreadLocal();
+
+	// Current wall clock time, read on every call so that system clock adjustments (NTP, DST, manual changes)
+	// are reflected: the cached part is the formatting in Format(), not the clock read.
+	static TimeStamp Now();
+
+	// returns a view into the internal buffer, valid until the next call
+	std::string_view Format(TimeStamp Time, bool bMicroseconds = false);
+
+private:
+	static constexpr size_t LEN_BUFFER = 48;
+
+	int64_t mCachedMinute = INT64_MIN; // minutes since epoch of the rendered prefix
+	int64_t mCachedSecond = -1;
+	size_t  mPrefixLength = 0;         // "YYYY_MM_DD-HH:MM:"
+	char    mBuffer[LEN_BUFFER];
+};
@@ -21,8 +21,13 @@
 #include <string>
 #include <string_view>
 #include <vector>
+#include <iterator>
+#include <initializer_list>
+#include <cstring>
+#include <cstdint>
 #include <codecvt>
 #include <utility>
+#include <ctime>
 
 // TODO: dont pollute global namespace
 #define RANGE(c)  std::begin(c) , std::end(c)
@@ -33,8 +38,125 @@ using PWSTR = wchar_t*;
 
 namespace StrUtil
 {
-	bool IsNumber(const std::string& s);
+	// Set of delimiter characters as a 256-bit mask: testing a character is a single bit lookup,
+	// regardless of the number of delimiters.
+	struct FDelimiterSet
+	{
+		FDelimiterSet() = default;
+		explicit FDelimiterSet(char c) { Add(c); }
+		explicit FDelimiterSet(std::initializer_list<char> Delimiters) { for (char c : Delimiters) Add(c); }
+		explicit FDelimiterSet(const std::vector<char>& Delimiters) { for (char c : Delimiters) Add(c); }
+
+		inline void Add(char c) { const unsigned char u = static_cast<unsigned char>(c); Bits[u >> 6] |= 1ull << (u & 63); }
+		inline bool Contains(char c) const { const unsigned char u = static_cast<unsigned char>(c); return (Bits[u >> 6] >> (u & 63)) & 1; }
+
+		unsigned long long Bits[4] = {};
+	};
 
+	// Lazy range over the tokens of @s separated by a delimiter or a FDelimiterSet, yielding std::string_views into @s
+	// without allocating. Empty tokens are skipped, same as split(). @s has to outlive the range & its iterators.
+	// A single delimiter is searched with memchr(), a set with the bitmask.
+	//
+	//   for (std::string_view Token : StrUtil::SplitView(Line, StrUtil::FDelimiterSet{ ' ', '\t', ',' }))
+	//       ...
+	//
+	class SplitView
+	{
+	public:
+		class Iterator
+		{
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type        = std::string_view;
+			using difference_type   = std::ptrdiff_t;
+			using pointer           = const std::string_view*;
+			using reference         = const std::string_view&;
+
+			Iterator() = default;
+			Iterator(const SplitView* pView, const char* pCursor) : mpView(pView), mpCursor(pCursor) { ++*this; }
+
+			inline reference operator*()  const { return mToken; }
+			inline pointer   operator->() const { return &mToken; }
+			inline Iterator& operator++()    { mToken = mpView->NextToken(mpCursor); return *this; }
+			inline Iterator  operator++(int) { Iterator it = *this; ++*this; return it; }
+			inline bool operator==(const Iterator& other) const { return mToken.data() == other.mToken.data(); }
+			inline bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+		private:
+			const SplitView* mpView = nullptr;
+			const char*      mpCursor = nullptr;
+			std::string_view mToken; // data() is null past the last token
+		};
+
+		SplitView(std::string_view s, char Delimiter = ' ') : mString(s), mDelimiter(Delimiter), mbSingleDelimiter(true) {}
+		SplitView(std::string_view s, const FDelimiterSet& Delimiters) : mString(s), mDelimiters(Delimiters), mbSingleDelimiter(false) {}
+
+		inline Iterator begin() const { return Iterator(this, mString.data()); }
+		inline Iterator end()   const { return Iterator(); }
+
+		size_t Count() const; // number of tokens, walks the string
+		std::vector<std::string_view> ToVector() const;
+
+	private:
+		// returns the token at or after @pCursor & moves @pCursor past it, an empty view with null data() once the string is exhausted
+		inline std::string_view NextToken(const char*& pCursor) const
+		{
+			const char* pEnd = mString.data() + mString.size();
+			if (mbSingleDelimiter)
+			{
+				while (pCursor != pEnd && *pCursor == mDelimiter)
+					++pCursor;
+				if (pCursor == pEnd)
+					return std::string_view();
+				const char* pTokenBegin = pCursor;
+				const void* pDelimiter = memchr(pCursor, mDelimiter, pEnd - pCursor);
+				pCursor = pDelimiter ? static_cast<const char*>(pDelimiter) : pEnd;
+				return std::string_view(pTokenBegin, pCursor - pTokenBegin);
+			}
+
+			while (pCursor != pEnd && mDelimiters.Contains(*pCursor))
+				++pCursor;
+			if (pCursor == pEnd)
+				return std::string_view();
+			const char* pTokenBegin = pCursor;
+			while (pCursor != pEnd && !mDelimiters.Contains(*pCursor))
+				++pCursor;
+			return std::string_view(pTokenBegin, pCursor - pTokenBegin);
+		}
+
+		std::string_view mString;
+		FDelimiterSet    mDelimiters;
+		char             mDelimiter = ' ';
+		bool             mbSingleDelimiter = true;
+	};
+
+	// true if @s is non-empty and all its characters are decimal digits
+	bool IsNumber(std::string_view s);
+
+	// Locale-independent parsers in the manner of std::from_chars(): parsing starts at the first character of @s (no whitespace
+	// is skipped) and stops at the first character that doesn't belong to the number, NumCharsConsumed tells where.
+	// Value is left 0 when Error isn't NONE.
+	//  - integers: optional '+'/'-' & decimal digits, runs of 8+ digits are converted 8/16 at a time
+	//  - floats  : optional '+'/'-', decimal or scientific notation, inf & nan, correctly rounded
+	//  - bools   : true/false (case-insensitive) or 1/0
+	//  - hex     : optional 0x/0X prefix & hexadecimal digits
+	enum class EParseError : uint8_t { NONE, INVALID, OUT_OF_RANGE };
+	template<class T> struct FParseResult
+	{
+		T           Value = T();
+		EParseError Error = EParseError::INVALID;
+		size_t      NumCharsConsumed = 0;
+		inline explicit operator bool() const { return Error == EParseError::NONE; }
+	};
+	FParseResult<int>      TryParseInt   (std::string_view s);
+	FParseResult<int64_t>  TryParseInt64 (std::string_view s);
+	FParseResult<uint64_t> TryParseUInt64(std::string_view s);
+	FParseResult<float>    TryParseFloat (std::string_view s);
+	FParseResult<double>   TryParseDouble(std::string_view s);
+	FParseResult<bool>     TryParseBool  (std::string_view s);
+	FParseResult<uint64_t> TryParseHex   (std::string_view s);
+
+	// leading & trailing whitespace is skipped, returns false/0 if @s doesn't start with a number
 	bool  ParseBool (const std::string& s);
 	int   ParseInt  (const std::string& s);
 	float ParseFloat(const std::string& s);
@@ -49,30 +171,133 @@ namespace StrUtil
 		return split(s, delimiters);
 	}
 
-	std::string trim(const std::string& s);
+	// Whitespace trimming & case conversion are ASCII-only: " \n\r\t\f\v" are trimmed and A-Z/a-z converted, other bytes
+	// (including UTF-8 sequences) are left as is. Strings of 16+ characters are processed with SSE2/AVX2 depending on
+	// VQSystemInfo::GetSIMDLevel().
+	std::string      trim(std::string_view s);
+	std::string_view TrimView(std::string_view s); // @s without its leading & trailing whitespace, no copy
+	void             TrimInPlace(std::string& s);
 
 	void MakeLowercase(std::string& str);
-	std::string GetLowercased(const std::string& str);
-	
-	std::string GetUppercased(const std::string& str);
+	void MakeLowercase(char* pStr, size_t Length);
+	void MakeUppercase(std::string& str);
+	void MakeUppercase(char* pStr, size_t Length);
+	std::string GetLowercased(std::string_view str);
+	std::string GetUppercased(std::string_view str);
+
+	// UTF-8 <-> UTF-16 / UTF-32 transcoding. Input is validated: overlong or truncated UTF-8 sequences, unpaired UTF-16
+	// surrogates, surrogate code points & code points past U+10FFFF are invalid. Runs of ASCII characters are converted
+	// 16/32 at a time with SSE2/AVX2 depending on VQSystemInfo::GetSIMDLevel().
+	//
+	// The buffer versions stop at the first invalid sequence or when the next code point doesn't fit in @DstSize code units,
+	// the result tells where: converting a long string in chunks continues from NumCharsRead. Nothing is null terminated.
+	// The std::string versions replace each invalid code unit with U+FFFD.
+	// std::wstring is UTF-16 on Windows and UTF-32 elsewhere.
+	enum class EUnicodeError : uint8_t { NONE, INVALID_SEQUENCE, BUFFER_TOO_SMALL };
+	struct FTranscodeResult
+	{
+		EUnicodeError Error = EUnicodeError::NONE;
+		size_t        NumCharsRead = 0;    // source code units converted
+		size_t        NumCharsWritten = 0; // destination code units written
+		inline explicit operator bool() const { return Error == EUnicodeError::NONE; }
+	};
+	FTranscodeResult UTF8ToUTF16(std::string_view Src, char16_t* pDst, size_t DstSize);
+	FTranscodeResult UTF8ToUTF32(std::string_view Src, char32_t* pDst, size_t DstSize);
+	FTranscodeResult UTF16ToUTF8(std::u16string_view Src, char* pDst, size_t DstSize);
+	FTranscodeResult UTF32ToUTF8(std::u32string_view Src, char* pDst, size_t DstSize);
+
+	// number of code units the conversion of valid input writes, for sizing the destination buffer
+	size_t GetUTF16Length(std::string_view Utf8);
+	size_t GetUTF32Length(std::string_view Utf8);
+	size_t GetUTF8Length(std::u16string_view Utf16);
+	size_t GetUTF8Length(std::u32string_view Utf32);
+
+	std::u16string ToUTF16(std::string_view Utf8);
+	std::u32string ToUTF32(std::string_view Utf8);
+	std::wstring   ToWide (std::string_view Utf8);
+	std::string    ToUTF8 (std::u16string_view Utf16);
+	std::string    ToUTF8 (std::u32string_view Utf32);
+	std::string    ToUTF8 (std::wstring_view Wide);
+
+	// previous names of ToUTF8() / ToWide()
+	inline std::string  UnicodeToASCII(const PWSTR pwstr) { return ToUTF8(std::wstring_view(pwstr)); }
+	inline std::wstring ASCIIToUnicode(const std::string& str) { return ToWide(str); }
+	inline std::wstring ASCIIToUnicode(const char* str) { return ToWide(str); }
+	template<unsigned STR_SIZE>
+	std::string UnicodeToASCII(const WCHAR wchars[STR_SIZE])
+	{
+		size_t Length = 0;
+		while (Length < STR_SIZE && wchars[Length] != L'\0')
+			++Length;
+		return ToUTF8(std::wstring_view(wchars, Length));
+	}
 
-	std::string  CommaSeparatedNumber(const std::string& num);
+	// Fixed-capacity null-terminated string stored inline, for formatting without heap allocations.
+	// Writes past the capacity are truncated.
+	template<size_t CAPACITY>
+	class FInlineString
+	{
+	public:
+		FInlineString() = default;
+		FInlineString(std::string_view s) { Append(s); }
+
+		inline void Append(std::string_view s)
+		{
+			const size_t NumChars = s.size() < CAPACITY - mSize ? s.size() : CAPACITY - mSize;
+			memcpy(mData + mSize, s.data(), NumChars);
+			Commit(NumChars);
+		}
+		inline void Clear() { mSize = 0; mData[0] = '\0'; }
+
+		// unused capacity including the null terminator, for formatting in place followed by Commit()
+		inline char*  GetWriteBuffer()           { return mData + mSize; }
+		inline size_t GetWriteBufferSize() const { return CAPACITY - mSize + 1; }
+		inline void   Commit(size_t NumChars)    { mSize += NumChars; mData[mSize] = '\0'; }
+
+		inline const char*      c_str() const { return mData; }
+		inline const char*      data()  const { return mData; }
+		inline size_t           size()  const { return mSize; }
+		inline bool             empty() const { return mSize == 0; }
+		inline operator std::string_view() const { return std::string_view(mData, mSize); }
+		static constexpr size_t capacity() { return CAPACITY; }
+
+	private:
+		char   mData[CAPACITY + 1] = {};
+		size_t mSize = 0;
+	};
+
+	enum class EByteUnits : uint8_t
+	{
+		JEDEC, // powers of 1024: KB, MB, GB...
+		IEC,   // powers of 1024: KiB, MiB, GiB...
+		SI     // powers of 1000: kB, MB, GB...
+	};
 
-	       std::string  UnicodeToASCII(const PWSTR pwstr); // https://codingtidbit.com/2020/02/09/c17-codecvt_utf8-is-deprecated/
-	//inline std::string  UnicodeToASCII(const std::wstring& wstr) { return UnicodeToASCII(wstr.c_str()); }
-	inline std::wstring ASCIIToUnicode(const std::string& str) { return std::wstring(str.begin(), str.end()); }
-	inline std::wstring ASCIIToUnicode(const char* str) { return std::wstring(str, str + strlen(str)); }
+	// The char buffer versions write at most @BufferSize - 1 characters & a null terminator, and return the number of
+	// characters written. Digits are generated with std::to_chars(), nothing is allocated.
+	//
+	//   FormatByte(Buffer, sizeof(Buffer), 1024)                        -> "1024B", the unit changes above the base
+	//   FormatByte(Buffer, sizeof(Buffer), 3670016)                     -> "4MB"
+	//   FormatByte(Buffer, sizeof(Buffer), 3670016, 2, EByteUnits::IEC) -> "3.50MiB"
+	//   CommaSeparatedNumber(Buffer, sizeof(Buffer), -1234567)         -> "-1,234,567"
+	//
+	size_t FormatByte(char* pBuffer, size_t BufferSize, unsigned long long Bytes, int Precision = 0, EByteUnits Units = EByteUnits::JEDEC);
+	size_t CommaSeparatedNumber(char* pBuffer, size_t BufferSize, long long Number, char Separator = ',');
+	size_t CommaSeparatedNumber(char* pBuffer, size_t BufferSize, std::string_view Digits, char Separator = ',');
 
-	template<unsigned STR_SIZE>
-	std::string UnicodeToASCII(const WCHAR wchars[STR_SIZE])
+	template<size_t N> FInlineString<N>& FormatByte(FInlineString<N>& Out, unsigned long long Bytes, int Precision = 0, EByteUnits Units = EByteUnits::JEDEC)
+	{
+		Out.Commit(FormatByte(Out.GetWriteBuffer(), Out.GetWriteBufferSize(), Bytes, Precision, Units));
+		return Out;
+	}
+	template<size_t N> FInlineString<N>& CommaSeparatedNumber(FInlineString<N>& Out, long long Number, char Separator = ',')
 	{
-		char ascii[STR_SIZE];
-		size_t numCharsConverted = 0;
-		wcstombs_s(&numCharsConverted, ascii, wchars, STR_SIZE);
-		return std::string(ascii);
+		Out.Commit(CommaSeparatedNumber(Out.GetWriteBuffer(), Out.GetWriteBufferSize(), Number, Separator));
+		return Out;
 	}
 
 	std::string FormatByte(unsigned long long bytes);
+	std::string CommaSeparatedNumber(const std::string& num);
 }
 
 
@@ -130,6 +355,7 @@ namespace DirectoryUtil
 // returns current time in format "YYYY-MM-DD_HH-MM-SS"
 std::string GetCurrentTimeAsString();
 std::string GetCurrentTimeAsStringWithBrackets();
+std::string GetTimeAsString(std::time_t Time); // same format as GetCurrentTimeAsString()
 
 
 namespace MathUtil
@@ -19,6 +19,15 @@
 #include "Image.h"
 #include "Log.h"
 #include "utils.h"
+#include "MappedFile.h"
+#include "ImageCache.h"
+#include "ImageStream.h"
+#include "PixelBufferPool.h"
+
+// stb_image's output & its temporary decode buffers are reused across loads
+#define STBI_MALLOC(sz)       PixelBufferPool::Allocate(sz)
+#define STBI_REALLOC(p,newsz) PixelBufferPool::Reallocate(p, newsz)
+#define STBI_FREE(p)          PixelBufferPool::Free(p)
 
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
@@ -27,76 +36,119 @@
 #include "../Libs/stb/stb_image_write.h"
 #include "../Libs/stb/stb_image_resize.h"
 
-#include "../Libs/miniz/miniz.h"
-#define TINYEXR_USE_MINIZ 0
-#define TINYEXR_IMPLEMENTATION
-#include "../Libs/tinyexr/tinyexr.h"
+#include "../Libs/tinyexr/tinyexr.h" // implemented in ImageStream.cpp
 
 #include <vector>
 #include <set>
 #include <cmath>
 #include <cassert>
+#include <climits>
+#include <algorithm>
 
-static const std::set<std::string> S_HDR_FORMATS = { "hdr", "exr" };
-static bool IsHDRFileExtension(const std::string& ext) { return S_HDR_FORMATS.find(ext) != S_HDR_FORMATS.end(); }
-
-static float CalculateMaxLuminance(const float* pData, int width, int height, int numComponents)
-{
-    float MaxLuminance = 0.0f;
-    float MaxLuminance2 = 0.0f;
-    float MaxLuminance3 = 0.0f;
-    float MaxLightLevel = 0.0f;
-    float LuminanceSum = 0.0f;
-    
-    for(int h=0; h< height; ++h) // row
-    for(int w = 0; w < width; ++w) // col
-    {
-        const int pxIndex = (w  + width * h) * numComponents;
-        const float& r = pData[pxIndex + 0];
-        const float& g = pData[pxIndex + 1];
-        const float& b = pData[pxIndex + 2];
-
-        // https://en.wikipedia.org/wiki/Relative_luminance
-        const float lum = 0.2126f * r + 0.7152f * g + 0.0722f * b;
-        if (lum > MaxLuminance) 
-            MaxLuminance = lum;
+// Compares load+resize+destroy cycles with & without the PixelBufferPool, runs once on the first Image::CreateResizedImage().
+#define IMAGE_RUN_POOL_BENCHMARK 0
 
-        const float lum2 = 0.299f * r + 0.587f * g + 0.114f * b;
-        if (lum2 > MaxLuminance2)
-            MaxLuminance2 = lum2;
+#if IMAGE_RUN_POOL_BENCHMARK
+#include <chrono>
+#endif
 
-        const float lum3 = std::sqrtf(0.299f * r * r + 0.587f * g * g + 0.114f * b * b);
-        if (lum3 > MaxLuminance3)
-            MaxLuminance3 = lum3;
+// HDR images loaded into formats other than RGBA32F are decoded in bands of about this many pixels (4MB of RGBA32F)
+constexpr size_t CONVERT_NUM_PIXELS_PER_BAND = 256 * 1024;
 
+static const std::set<std::string> S_HDR_FORMATS = { "hdr", "exr" };
+static bool IsHDRFileExtension(const std::string& ext) { return S_HDR_FORMATS.find(ext) != S_HDR_FORMATS.end(); }
 
+// sets the fields that depend on the decoded pixels
+static void OnImageDecoded(Image& img, int NumImageComponents, bool bHDR, ThreadPool* pThreadPool)
+{
+    img.BytesPerPixel = bHDR 
+        ? NumImageComponents * 4 // HDR=RGBA32F -> 16 Bytes/Pixel = 4 Bytes / component
+        : NumImageComponents;    // SDR=RGBA8   -> 4  Bytes/Pixel = 1 Byte  / component
+    img.Format = bHDR ? EImageFormat::RGBA32F : EImageFormat::RGBA8;
 
-        if (MaxLightLevel <= r)
-            MaxLightLevel = r;
-        if (MaxLightLevel <= g)
-            MaxLightLevel = g;
-        if (MaxLightLevel <= b)
-            MaxLightLevel = b;
+    if (img.pData && bHDR)
+    {
+        img.MaxLuminance = img.CalculateStatistics(pThreadPool).MaxLuminance;
+    }
+}
 
+// Decodes an HDR file band by band & converts each band into @Format, the RGBA32F image is never held as a whole
+static Image LoadHDRInFormat(const void* pFileData, size_t FileSize, const char* pFilePath, EImageFormat Format, ThreadPool* pThreadPool)
+{
+    ImageStreamReader Stream;
+    if (!Stream.Open(pFileData, FileSize, pFilePath))
+        return Image();
+    const FImageInfo& Info = Stream.GetInfo();
 
-        LuminanceSum += lum;;
+    Image img = Image::CreateEmptyImage(static_cast<size_t>(Info.Width) * Info.Height * GetBytesPerPixel(Format));
+    if (!img.pData)
+    {
+        Log::Error("Error allocating image: %s", pFilePath);
+        return Image();
     }
+    img.Width = Info.Width;
+    img.Height = Info.Height;
+    img.BytesPerPixel = GetBytesPerPixel(Format);
+    img.Format = Format;
+
+    const int NumRowsPerBand = static_cast<int>(std::max<size_t>(1, CONVERT_NUM_PIXELS_PER_BAND / Info.Width));
+    std::vector<float> Band(static_cast<size_t>(Info.Width) * 4 * NumRowsPerBand);
+    unsigned char* pDst = static_cast<unsigned char*>(img.pData);
+    while (const int NumRows = Stream.ReadRows(Band.data(), NumRowsPerBand))
+    {
+        const size_t NumPixels = static_cast<size_t>(Info.Width) * NumRows;
+        img.MaxLuminance = std::max(img.MaxLuminance, Image::CalculateStatistics(Band.data(), Info.Width, NumRows, pThreadPool).MaxLuminance);
+        if (!Image::ConvertPixels(Band.data(), pDst, NumPixels, Format))
+            break;
+        pDst += NumPixels * img.BytesPerPixel;
+    }
+    if (Stream.GetNumRowsRead() != Info.Height || pDst != static_cast<unsigned char*>(img.pData) + img.GetSizeInBytes())
+    {
+        Log::Error("Error loading file: %s", pFilePath);
+        img.Destroy();
+        return Image();
+    }
+    return img;
+}
 
-    // calc avg lum
-    LuminanceSum /= width * height; // TODO:
+Image Image::LoadFromFile(const char* pFilePath, ThreadPool* pThreadPool, EImageFormat HDRFormat)
+{
+    MappedFile File;
+    if (ImageCache::OpenEntry(pFilePath, File, HDRFormat))
+    {
+        return ImageCache::LoadImage(File, HDRFormat, pThreadPool);
+    }
 
-    return MaxLuminance;
+    FImageCacheSourceStamp SourceStamp; // taken before the file is read
+    const bool bStoreInCache = ImageCache::IsEnabled() && ImageCache::GetSourceStamp(pFilePath, SourceStamp);
+    if (!File.Open(pFilePath))
+    {
+        Log::Error("Error loading file: %s", pFilePath);
+        return Image();
+    }
+    Image img = LoadFromMemory(File.GetData(), File.GetSize(), pFilePath, pThreadPool, HDRFormat);
+    if (bStoreInCache)
+    {
+        ImageCache::Store(pFilePath, SourceStamp, File.GetData(), File.GetSize(), img, pThreadPool);
+    }
+    return img;
 }
 
-Image Image::LoadFromFile(const char* pFilePath)
+Image Image::LoadFromMemory(const void* pFileData, size_t FileSize, const char* pFilePath, ThreadPool* pThreadPool, EImageFormat HDRFormat)
 {
-    constexpr int reqComp = 0;
-
     const std::string Extension = DirectoryUtil::GetFileExtension(pFilePath);
-
-
     const bool bEXR = Extension == "exr";
     const bool bHDR = IsHDRFileExtension(Extension);
+    if (bHDR && HDRFormat != EImageFormat::RGBA32F)
+    {
+        if (!IsHDRFormat(HDRFormat))
+        {
+            Log::Error("Image::LoadFromMemory(): HDRFormat=%d isn't an HDR format : %s", static_cast<int>(HDRFormat), pFilePath);
+            return Image();
+        }
+        return LoadHDRInFormat(pFileData, FileSize, pFilePath, HDRFormat, pThreadPool);
+    }
+    const stbi_uc* pBytes = static_cast<const stbi_uc*>(pFileData);
 
     Image img;
 
@@ -106,10 +158,17 @@ Image Image::LoadFromFile(const char* pFilePath)
         int width;
         int height;
         const char* err = nullptr;
-        int ret = LoadEXR((float**)&img.pData, &width, &height, pFilePath, &err);
-        if (ret != TINYEXR_SUCCESS) 
+        int ret = LoadEXRFromMemory((float**)&img.pData, &width, &height, pBytes, FileSize, &err);
+        if (ret == TINYEXR_SUCCESS)
+        {
+            img.x = width;
+            img.y = height;
+            NumImageComponents = 4; // LoadEXRFromMemory() always outputs RGBA32F
+            img.Allocator = EImageAllocator::TINYEXR;
+        }
+        else
         {
-            if (err) 
+            if (err)
             {
                 Log::Error("Couldn't load EXR file: %s\n", err);
                 FreeEXRErrorMessage(err); // Free error message.
@@ -118,63 +177,145 @@ Image Image::LoadFromFile(const char* pFilePath)
     }
     else
     {
+        assert(FileSize <= INT_MAX);
         img.pData = bHDR
-            ? (void*)stbi_loadf(pFilePath, &img.x, &img.y, &NumImageComponents, 4)
-            : (void*)stbi_load(pFilePath, &img.x, &img.y, &NumImageComponents, 4);
+            ? (void*)stbi_loadf_from_memory(pBytes, static_cast<int>(FileSize), &img.x, &img.y, &NumImageComponents, 4)
+            : (void*)stbi_load_from_memory(pBytes, static_cast<int>(FileSize), &img.x, &img.y, &NumImageComponents, 4);
+        NumImageComponents = 4; // stbi outputs the requested RGBA, NumImageComponents holds the channels in the file
+        img.Allocator = EImageAllocator::STBI;
     }
 
     if (img.pData == nullptr)
     {
         Log::Error("Error loading file: %s", pFilePath);
     }
-    img.BytesPerPixel = bHDR 
-        ? NumImageComponents * 4 // HDR=RGBA32F -> 16 Bytes/Pixel = 4 Bytes / component
-        : NumImageComponents;    // SDR=RGBA8   -> 4  Bytes/Pixel = 1 Byte  / component
+    OnImageDecoded(img, NumImageComponents, bHDR, pThreadPool);
+    return img;
+}
 
-    if (img.pData && bHDR)
+FImageInfo Image::QueryInfo(const char* pFilePath)
+{
+    MappedFile File; // only the pages of the header are read in
+    if (!File.Open(pFilePath))
     {
-        img.MaxLuminance = CalculateMaxLuminance(static_cast<const float*>(img.pData), img.Width, img.Height, 4);
+        Log::Error("Error querying file info: %s", pFilePath);
+        return FImageInfo();
     }
+    return QueryInfo(File.GetData(), File.GetSize(), pFilePath);
+}
 
-    return img;
+FImageInfo Image::QueryInfo(const void* pFileData, size_t FileSize, const char* pFilePath)
+{
+    const std::string Extension = DirectoryUtil::GetFileExtension(pFilePath);
+    const stbi_uc* pBytes = static_cast<const stbi_uc*>(pFileData);
+
+    FImageInfo Info;
+    Info.bHDR = IsHDRFileExtension(Extension);
+    Info.BytesPerPixel = GetBytesPerPixel(Info.bHDR ? EImageFormat::RGBA32F : EImageFormat::RGBA8);
+
+    if (Extension == "exr")
+    {
+        EXRVersion Version;
+        EXRHeader Header;
+        InitEXRHeader(&Header);
+        if (ParseEXRVersionFromMemory(&Version, pBytes, FileSize) == TINYEXR_SUCCESS
+        &&  ParseEXRHeaderFromMemory(&Header, &Version, pBytes, FileSize, nullptr) == TINYEXR_SUCCESS)
+        {
+            Info.Width  = Header.data_window.max_x - Header.data_window.min_x + 1;
+            Info.Height = Header.data_window.max_y - Header.data_window.min_y + 1;
+            Info.NumChannels = Header.num_channels;
+        }
+        FreeEXRHeader(&Header); // a header that failed to parse may hold the channels & attributes read so far
+    }
+    else
+    {
+        const int Size = static_cast<int>(std::min<size_t>(FileSize, INT_MAX)); // the header is at the beginning
+        if (!stbi_info_from_memory(pBytes, Size, &Info.Width, &Info.Height, &Info.NumChannels))
+            Info = FImageInfo();
+    }
+
+    if (!Info.IsValid())
+    {
+        Log::Error("Error querying file info: %s", pFilePath);
+    }
+    return Info;
 }
 
 Image Image::CreateEmptyImage(size_t bytes)
 {
     Image img;
-    img.pData = (void*)malloc(bytes);
+    img.pData = PixelBufferPool::Allocate(bytes);
+    img.Allocator = EImageAllocator::PIXEL_BUFFER_POOL;
     return img;
 }
 
-Image Image::CreateResizedImage(const Image& img, unsigned TargetWidth, unsigned TargetHeight)
+#if IMAGE_RUN_POOL_BENCHMARK
+static void RUN_IMAGE_POOL_BENCHMARK(ThreadPool* pThreadPool)
+{
+    constexpr int WIDTH = 2048;
+    constexpr int HEIGHT = 2048;
+    constexpr int NUM_ITERATIONS = 20;
+
+    std::vector<uint8_t> Pixels(static_cast<size_t>(WIDTH) * HEIGHT * 4);
+    for (size_t i = 0; i < Pixels.size(); ++i)
+        Pixels[i] = static_cast<uint8_t>((i * 2654435761u) >> 24);
+    int PNGSize = 0;
+    unsigned char* pPNG = stbi_write_png_to_mem(Pixels.data(), WIDTH * 4, WIDTH, HEIGHT, 4, &PNGSize);
+    if (!pPNG)
+        return;
+
+    auto fnMeasure = [&](size_t MaxCachedBytes, FPixelBufferPoolStats& Stats) -> double
+    {
+        const size_t MaxCachedBytesPrev = PixelBufferPool::GetMaxCachedBytes();
+        PixelBufferPool::SetMaxCachedBytes(MaxCachedBytes);
+        PixelBufferPool::Trim();
+        PixelBufferPool::ResetStats();
+        const auto t0 = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < NUM_ITERATIONS; ++i)
+        {
+            UniqueImage Source(Image::LoadFromMemory(pPNG, PNGSize, "benchmark.png", pThreadPool));
+            UniqueImage Resized(Image::CreateResizedImage(Source.Get(), WIDTH / 2, HEIGHT / 2, pThreadPool));
+        }
+        const auto t1 = std::chrono::high_resolution_clock::now();
+        Stats = PixelBufferPool::GetStats();
+        PixelBufferPool::SetMaxCachedBytes(MaxCachedBytesPrev);
+        return std::chrono::duration<double, std::milli>(t1 - t0).count() / NUM_ITERATIONS;
+    };
+
+    FPixelBufferPoolStats StatsMalloc, StatsPool;
+    const double msMalloc = fnMeasure(0, StatsMalloc);
+    const double msPool = fnMeasure(PixelBufferPool::GetMaxCachedBytes(), StatsPool);
+    STBIW_FREE(pPNG);
+
+    Log::Info("Image Pool Benchmark: %dx%d PNG load + resize + destroy, %d iterations", WIDTH, HEIGHT, NUM_ITERATIONS);
+    Log::Info("  malloc : %8.2fms/iteration | %llu allocations, %llu from the system", msMalloc, StatsMalloc.NumAllocations, StatsMalloc.NumSystemAllocations);
+    Log::Info("  pooled : %8.2fms/iteration | %llu allocations, %llu from the system, peak cached %.2f MB"
+        , msPool, StatsPool.NumAllocations, StatsPool.NumSystemAllocations, StatsPool.PeakBytesCached / (1024.0 * 1024.0)
+    );
+}
+#endif
+
+Image Image::CreateResizedImage(const Image& img, unsigned TargetWidth, unsigned TargetHeight, ThreadPool* pThreadPool)
 {
+#if IMAGE_RUN_POOL_BENCHMARK
+    static bool sbBenchmarkRun = false;
+    if (!sbBenchmarkRun)
+    {
+        sbBenchmarkRun = true;
+        RUN_IMAGE_POOL_BENCHMARK(pThreadPool);
+    }
+#endif
+
     assert(TargetWidth > 0 && TargetHeight > 0);
     const int TargetResolution = TargetHeight * TargetWidth;
-    const int TargetImageSizeInBytes = TargetResolution * (img.IsHDR() ? 16 : 4); // HDR is 16bytes/px (RGBA32F), SDR is 4bytes/px (RGBA8)
+    const int TargetImageSizeInBytes = TargetResolution * GetBytesPerPixel(img.GetFormat()); // the resized image keeps the source format
     assert(TargetImageSizeInBytes > 0);
 
     // create downsample image
     Image NewImage = CreateEmptyImage(TargetImageSizeInBytes);
 
     // 'resize' input image
-    int rc = 0;
-    if (img.IsHDR())
-    {
-        const int NUM_CHANNELS = 4; // RGBA
-        const int STRIDE_BYTES_INPUT = 0;
-        const int STRIDE_BYTES_OUTPUT = 0;
-        rc = stbir_resize_float(reinterpret_cast<const float*>(     img.pData),   img.Width,   img.Height, STRIDE_BYTES_INPUT,
-                                reinterpret_cast<      float*>(NewImage.pData), TargetWidth, TargetHeight, STRIDE_BYTES_OUTPUT,
-                                NUM_CHANNELS
-        );
-    }
-    else
-    {
-        rc = -1;
-        assert(false); // TODO: impl
-    }
-
-    if (rc <= 0)
+    if (!ResizeImage(img, NewImage.pData, TargetWidth, TargetHeight, pThreadPool))
     {
         Log::Error("Error resizing image ");
     }
@@ -184,46 +325,23 @@ Image Image::CreateResizedImage(const Image& img, unsigned TargetWidth, unsigned
         NewImage.Height = TargetHeight;
         NewImage.MaxLuminance = img.MaxLuminance;
         NewImage.BytesPerPixel = img.BytesPerPixel;
+        NewImage.Format = img.GetFormat();
     }
 
     return NewImage;
 }
 
-bool Image::SaveToDisk(const char* pStrPath) const
-{
-    if (this->GetSizeInBytes() == 0)
-    {
-        Log::Warning("Image::SaveToDisk() failed: ImageSize=0 : %s", pStrPath);
-        return false;
-    }
-
-    const std::string Folder = DirectoryUtil::GetFolderPath(pStrPath);
-    DirectoryUtil::CreateFolderIfItDoesntExist(Folder);
-
-    const std::string Extension = DirectoryUtil::GetFileExtension(pStrPath);
-    const bool bHDR = IsHDRFileExtension(Extension);
-
-    int rc = 0;
-    if (bHDR)
-    {
-        const int comp = 4; // HDR is 4 bytes / component (RGBA32F)
-        rc = stbi_write_hdr(pStrPath, this->x, this->y, comp, reinterpret_cast<const float*>(this->pData));
-    }
-    else
-    {
-        assert(false); // TODO: test
-        const int comp = this->BytesPerPixel;
-        rc = stbi_write_png(pStrPath, this->x, this->y, comp, this->pData, 0); 
-    }
-
-    return rc != 0; // 0 is err?
-}
-
 void Image::Destroy()
 { 
 	if (pData) 
 	{ 
-		stbi_image_free(pData); 
+		switch (Allocator)
+		{
+		case EImageAllocator::STBI             : stbi_image_free(pData); break;
+		case EImageAllocator::PIXEL_BUFFER_POOL: PixelBufferPool::Free(pData); break;
+		case EImageAllocator::TINYEXR          : // tinyexr allocates with malloc()
+		case EImageAllocator::MALLOC           : free(pData); break;
+		}
 		pData = nullptr; 
 	} 
 }
@@ -0,0 +1,376 @@
+//	VQUtils
+//	Copyright(C) 2020 - Volkan Ilbeyli
+//
+//	This program is free software : you can redistribute it and / or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+//	Contact: volkanilbeyli@gmail.com
+
+#include "ImageCache.h"
+#include "MappedFile.h"
+#include "PixelBufferPool.h"
+#include "Log.h"
+#include "utils.h"
+
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+
+// Loads a generated set of PNG files with Image::LoadFromFile() with & without their cache entries, runs once on Initialize().
+#define IMAGE_RUN_CACHE_BENCHMARK 0
+
+#if IMAGE_RUN_CACHE_BENCHMARK
+#include "../Libs/stb/stb_image_write.h"
+#include <chrono>
+#include <random>
+#endif
+
+static_assert(sizeof(FImageCacheHeader) == 72, "FImageCacheHeader is written to & read from the cache files as is");
+static_assert(sizeof(FMipChain::FLevel) == 16, "FMipChain::FLevel is written to & read from the cache files as is");
+
+static constexpr uint64_t DATA_ALIGNMENT = 64;
+
+static FImageCacheSettings sSettings;
+static bool                sbEnabled = false;
+
+static bool ReadHeader(const MappedFile& CacheFile, FImageCacheHeader& Header)
+{
+    if (!CacheFile.IsOpen() || CacheFile.GetSize() < sizeof(FImageCacheHeader))
+        return false;
+    memcpy(&Header, CacheFile.GetData(), sizeof(FImageCacheHeader));
+
+    const uint64_t LevelsEnd = sizeof(FImageCacheHeader) + static_cast<uint64_t>(Header.NumMips) * sizeof(FMipChain::FLevel);
+    return Header.Magic == FImageCacheHeader::MAGIC
+        && Header.Version == FImageCacheHeader::VERSION
+        && Header.Width > 0 && Header.Height > 0
+        && Header.BytesPerPixel > 0 && Header.BytesPerPixel == GetBytesPerPixel(static_cast<EImageFormat>(Header.Format))
+        && Header.NumMips > 0
+        && Header.DataOffset >= LevelsEnd
+        && Header.DataOffset + Header.DataSize <= CacheFile.GetSize()
+        && static_cast<uint64_t>(Header.Width) * Header.Height * Header.BytesPerPixel <= Header.DataSize;
+}
+
+#if IMAGE_RUN_CACHE_BENCHMARK
+static void RUN_IMAGE_CACHE_BENCHMARK()
+{
+    constexpr int NUM_IMAGES = 32;
+    constexpr int IMAGE_SIZE = 1024;
+
+    const std::string Folder = sSettings.Directory + "/Benchmark/";
+    DirectoryUtil::CreateFolderIfItDoesntExist(Folder);
+    std::vector<std::string> FilePaths;
+    {
+        std::mt19937 rng(42);
+        std::vector<unsigned char> PixelsRGBA8(IMAGE_SIZE * IMAGE_SIZE * 4);
+        for (int i = 0; i < NUM_IMAGES; ++i)
+        {
+            for (size_t p = 0; p < PixelsRGBA8.size(); ++p)
+                PixelsRGBA8[p] = static_cast<unsigned char>((p / 4 % IMAGE_SIZE) / 4 + i + (rng() & 7));
+            FilePaths.push_back(Folder + "img" + std::to_string(i) + ".png");
+            stbi_write_png(FilePaths.back().c_str(), IMAGE_SIZE, IMAGE_SIZE, 4, PixelsRGBA8.data(), 0);
+            std::remove(ImageCache::GetCacheFilePath(FilePaths.back()).c_str());
+        }
+    }
+
+    auto fnMeasure = [&]()
+    {
+        const auto t0 = std::chrono::steady_clock::now();
+        for (const std::string& FilePath : FilePaths)
+        {
+            Image img = Image::LoadFromFile(FilePath.c_str());
+            img.Destroy();
+        }
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    };
+    const double msDecodeAndStore = fnMeasure(); // no entries yet
+    const double msCached = fnMeasure();
+
+    Log::Info("ImageCache Benchmark: %d %dx%d PNGs, %s validation%s", NUM_IMAGES, IMAGE_SIZE, IMAGE_SIZE
+        , sSettings.Validation == EImageCacheValidation::CONTENT_HASH ? "content hash" : "timestamp"
+        , sSettings.bStoreMipChain ? ", with mip chains" : ""
+    );
+    Log::Info("  decode + store : %8.2fms", msDecodeAndStore);
+    Log::Info("  cached         : %8.2fms", msCached);
+}
+#endif
+
+namespace ImageCache
+{
+
+void Initialize(const FImageCacheSettings& Settings)
+{
+    sSettings = Settings;
+    sbEnabled = !sSettings.Directory.empty();
+    if (sbEnabled)
+    {
+        DirectoryUtil::CreateFolderIfItDoesntExist(sSettings.Directory);
+#if IMAGE_RUN_CACHE_BENCHMARK
+        RUN_IMAGE_CACHE_BENCHMARK();
+#endif
+    }
+}
+
+void Destroy()
+{
+    sbEnabled = false;
+    sSettings = FImageCacheSettings();
+}
+
+bool IsEnabled() { return sbEnabled; }
+
+bool GetSourceStamp(const std::string& SourceFilePath, FImageCacheSourceStamp& Stamp)
+{
+    std::error_code ec;
+    Stamp.Size = std::filesystem::file_size(SourceFilePath, ec);
+    if (ec)
+        return false;
+    Stamp.WriteTime = static_cast<int64_t>(std::filesystem::last_write_time(SourceFilePath, ec).time_since_epoch().count());
+    return !ec;
+}
+
+std::string GetCacheFilePath(const std::string& SourceFilePath)
+{
+    std::error_code ec;
+    const std::filesystem::path AbsolutePath = std::filesystem::absolute(SourceFilePath, ec);
+    const size_t PathHash = std::hash<std::string>()(ec ? SourceFilePath : AbsolutePath.string());
+
+    char HashString[17];
+    snprintf(HashString, sizeof(HashString), "%016llx", static_cast<unsigned long long>(PathHash));
+    return sSettings.Directory + "/" + HashString + "_" + DirectoryUtil::GetFileNameFromPath(SourceFilePath) + ".vqimg";
+}
+
+bool OpenEntry(const std::string& SourceFilePath, MappedFile& CacheFile, EImageFormat HDRFormat)
+{
+    if (!sbEnabled || !CacheFile.Open(GetCacheFilePath(SourceFilePath)))
+        return false;
+
+    FImageCacheHeader Header;
+    if (!ReadHeader(CacheFile, Header))
+    {
+        Log::Warning("ImageCache: invalid cache file for %s", SourceFilePath.c_str());
+        CacheFile.Close();
+        return false;
+    }
+
+    const EImageFormat Format = static_cast<EImageFormat>(Header.Format);
+    if (IsHDRFormat(Format) && Format != EImageFormat::RGBA32F && Format != HDRFormat)
+    {
+        CacheFile.Close(); // packed formats don't convert into each other, decode the source again
+        return false;
+    }
+
+    bool bUpToDate = false;
+    if (sSettings.Validation == EImageCacheValidation::CONTENT_HASH)
+    {
+        MappedFile SourceFile;
+        bUpToDate = SourceFile.Open(SourceFilePath)
+            && SourceFile.GetSize() == Header.SourceSize
+            && HashFileContents(SourceFile.GetData(), SourceFile.GetSize()) == Header.SourceHash;
+    }
+    else
+    {
+        FImageCacheSourceStamp Stamp;
+        bUpToDate = GetSourceStamp(SourceFilePath, Stamp)
+            && Stamp.Size == Header.SourceSize
+            && Stamp.WriteTime == Header.SourceWriteTime;
+    }
+
+    if (!bUpToDate)
+        CacheFile.Close();
+    return bUpToDate;
+}
+
+FImageInfo GetInfo(const MappedFile& CacheFile)
+{
+    FImageInfo Info;
+    FImageCacheHeader Header;
+    if (!ReadHeader(CacheFile, Header))
+        return Info;
+    Info.Width = Header.Width;
+    Info.Height = Header.Height;
+    Info.NumChannels = 4;
+    Info.BytesPerPixel = Header.BytesPerPixel;
+    Info.bHDR = IsHDRFormat(static_cast<EImageFormat>(Header.Format));
+    return Info;
+}
+
+Image LoadImage(const MappedFile& CacheFile, EImageFormat HDRFormat, ThreadPool* pThreadPool)
+{
+    Image img;
+    FImageCacheHeader Header;
+    if (!ReadHeader(CacheFile, Header))
+        return img;
+
+    const EImageFormat Format = static_cast<EImageFormat>(Header.Format);
+    if (Format == EImageFormat::RGBA32F && HDRFormat != EImageFormat::RGBA32F)
+    {
+        Image View; // not owned
+        View.Width = Header.Width;
+        View.Height = Header.Height;
+        View.BytesPerPixel = Header.BytesPerPixel;
+        View.Format = EImageFormat::RGBA32F;
+        View.MaxLuminance = Header.MaxLuminance;
+        View.pData = const_cast<unsigned char*>(CacheFile.GetData() + Header.DataOffset);
+        return Image::CreateConvertedImage(View, HDRFormat, pThreadPool);
+    }
+
+    const size_t SizeInBytes = static_cast<size_t>(Header.Width) * Header.Height * Header.BytesPerPixel;
+    img.pData = PixelBufferPool::Allocate(SizeInBytes);
+    img.Allocator = EImageAllocator::PIXEL_BUFFER_POOL;
+    if (!img.pData)
+    {
+        Log::Error("ImageCache: couldn't allocate %llu bytes", static_cast<unsigned long long>(SizeInBytes));
+        return img;
+    }
+    memcpy(img.pData, CacheFile.GetData() + Header.DataOffset, SizeInBytes); // level 0 is at the beginning of the data
+    img.Width = Header.Width;
+    img.Height = Header.Height;
+    img.BytesPerPixel = Header.BytesPerPixel;
+    img.Format = Format;
+    img.MaxLuminance = Header.MaxLuminance;
+    return img;
+}
+
+FMipChain LoadMipChain(const MappedFile& CacheFile)
+{
+    FMipChain Chain;
+    FImageCacheHeader Header;
+    if (!ReadHeader(CacheFile, Header))
+        return Chain;
+    if (Header.NumMips < Image::CalculateMipLevelCount(Header.Width, Header.Height))
+        return Chain; // stored without the mip chain
+
+    Chain.Levels.resize(Header.NumMips);
+    memcpy(Chain.Levels.data(), CacheFile.GetData() + sizeof(FImageCacheHeader), Header.NumMips * sizeof(FMipChain::FLevel));
+    for (const FMipChain::FLevel& Level : Chain.Levels)
+    {
+        if (Level.Offset + static_cast<uint64_t>(Level.Width) * Level.Height * Header.BytesPerPixel > Header.DataSize)
+        {
+            Log::Error("ImageCache: invalid mip level in the cache file");
+            return FMipChain();
+        }
+    }
+
+    Chain.pData = PixelBufferPool::Allocate(Header.DataSize);
+    if (!Chain.pData)
+    {
+        Log::Error("ImageCache: couldn't allocate %llu bytes", static_cast<unsigned long long>(Header.DataSize));
+        return FMipChain();
+    }
+    memcpy(Chain.pData, CacheFile.GetData() + Header.DataOffset, Header.DataSize);
+    Chain.SizeInBytes = Header.DataSize;
+    Chain.BytesPerPixel = Header.BytesPerPixel;
+    return Chain;
+}
+
+bool Store(const std::string& SourceFilePath, const FImageCacheSourceStamp& SourceStamp, const void* pSourceData, size_t SourceSize, const Image& img, ThreadPool* pThreadPool)
+{
+    if (!sbEnabled || !img.IsValid())
+        return false;
+    if (SourceStamp.Size != SourceSize)
+        return false; // the file changed between the stamp & the read
+
+    const EImageFormat Format = img.GetFormat();
+    FImageCacheHeader Header;
+    Header.Width = img.Width;
+    Header.Height = img.Height;
+    Header.BytesPerPixel = GetBytesPerPixel(Format);
+    Header.Format = static_cast<uint32_t>(Format);
+    Header.MaxLuminance = img.MaxLuminance;
+    Header.SourceSize = SourceSize;
+    Header.SourceWriteTime = SourceStamp.WriteTime;
+    if (sSettings.Validation == EImageCacheValidation::CONTENT_HASH)
+        Header.SourceHash = HashFileContents(pSourceData, SourceSize);
+
+    FMipChain Chain; // only RGBA8 & RGBA32F have mip chains, the other formats store level 0
+    if (sSettings.bStoreMipChain && (Format == EImageFormat::RGBA8 || Format == EImageFormat::RGBA32F))
+        Chain = img.GenerateMipChain(pThreadPool);
+
+    const void* pData = img.pData;
+    std::vector<FMipChain::FLevel> Levels(1);
+    Levels[0].Width = img.Width;
+    Levels[0].Height = img.Height;
+    Header.DataSize = img.GetSizeInBytes();
+    if (Chain.IsValid())
+    {
+        pData = Chain.pData;
+        Levels = Chain.Levels;
+        Header.DataSize = Chain.SizeInBytes;
+    }
+    Header.NumMips = static_cast<uint32_t>(Levels.size());
+    Header.DataOffset = (sizeof(FImageCacheHeader) + Levels.size() * sizeof(FMipChain::FLevel) + DATA_ALIGNMENT - 1) & ~(DATA_ALIGNMENT - 1);
+
+    // readers never see a partially written entry: the complete file replaces the old one
+    const std::string CacheFilePath = GetCacheFilePath(SourceFilePath);
+    const std::string TempFilePath = CacheFilePath + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    bool bWritten = false;
+    {
+        std::ofstream File(TempFilePath, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (File)
+        {
+            const char Padding[DATA_ALIGNMENT] = {};
+            const size_t PaddingSize = static_cast<size_t>(Header.DataOffset) - sizeof(FImageCacheHeader) - Levels.size() * sizeof(FMipChain::FLevel);
+            File.write(reinterpret_cast<const char*>(&Header), sizeof(Header));
+            File.write(reinterpret_cast<const char*>(Levels.data()), Levels.size() * sizeof(FMipChain::FLevel));
+            File.write(Padding, PaddingSize);
+            File.write(static_cast<const char*>(pData), Header.DataSize);
+            bWritten = static_cast<bool>(File);
+        }
+    }
+    Chain.Destroy();
+
+    std::error_code ec;
+    if (bWritten)
+        std::filesystem::rename(TempFilePath, CacheFilePath, ec);
+    if (!bWritten || ec)
+    {
+        Log::Warning("ImageCache: couldn't write the cache file %s", CacheFilePath.c_str());
+        std::filesystem::remove(TempFilePath, ec);
+        return false;
+    }
+    return true;
+}
+
+uint64_t HashFileContents(const void* pData, size_t Size)
+{
+    // 4 independent multiply-rotate lanes over 8-byte words to keep the multipliers busy, mixed together at the end
+    constexpr uint64_t PRIME0 = 0x9E3779B185EBCA87ull;
+    constexpr uint64_t PRIME1 = 0xC2B2AE3D27D4EB4Full;
+    auto fnRotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+    auto fnRound = [&](uint64_t Acc, uint64_t Word) { return fnRotl(Acc + Word * PRIME1, 31) * PRIME0; };
+
+    const unsigned char* p = static_cast<const unsigned char*>(pData);
+    const unsigned char* const pEnd = p + Size;
+    uint64_t Lanes[4] = { PRIME0 + PRIME1, PRIME1, 0, 0 - PRIME0 };
+    for (; pEnd - p >= 32; p += 32)
+    {
+        uint64_t Words[4];
+        memcpy(Words, p, sizeof(Words));
+        for (int i = 0; i < 4; ++i)
+            Lanes[i] = fnRound(Lanes[i], Words[i]);
+    }
+
+    uint64_t Hash = fnRotl(Lanes[0], 1) + fnRotl(Lanes[1], 7) + fnRotl(Lanes[2], 12) + fnRotl(Lanes[3], 18) + Size;
+    for (; p < pEnd; ++p)
+        Hash = fnRotl(Hash ^ (*p * PRIME1), 11) * PRIME0;
+
+    Hash ^= Hash >> 33; Hash *= PRIME1;
+    Hash ^= Hash >> 29; Hash *= PRIME0;
+    Hash ^= Hash >> 32;
+    return Hash;
+}
+
+}
@@ -0,0 +1,388 @@
+//	VQUtils
+//	Copyright(C) 2020 - Volkan Ilbeyli
+//
+//	This program is free software : you can redistribute it and / or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+//	Contact: volkanilbeyli@gmail.com
+
+#include "Image.h"
+#include "SystemInfo.h"
+#include "Multithreading/ThreadPool.h"
+#include "Log.h"
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Measures Image::ConvertPixels() on a 4K RGBA32F buffer for each format & SIMD level, runs once on the first call.
+#define IMAGE_RUN_FORMAT_BENCHMARK 0
+
+#if IMAGE_RUN_FORMAT_BENCHMARK
+#include <vector>
+#include <chrono>
+#include <random>
+#endif
+
+using VQSystemInfo::ESIMDLevel;
+
+// images are split into blocks of rows of about this many pixels for multithreading
+constexpr size_t NUM_PIXELS_PER_BLOCK = 64 * 1024;
+
+// largest finite values of the unsigned packed floats: 5-bit exponent & 6, 5 or 9-bit mantissa
+constexpr float MAX_FLOAT11 = 65024.0f;
+constexpr float MAX_FLOAT10 = 64512.0f;
+constexpr float MAX_RGB9E5  = 65408.0f;
+constexpr float MIN_RGB9E5  = 1.0f / (1 << 16); // smallest shared exponent
+
+static_assert(sizeof(float) == sizeof(uint32_t), "");
+static inline uint32_t AsUInt(float f) { uint32_t u; memcpy(&u, &f, sizeof(u)); return u; }
+static inline float    AsFloat(uint32_t u) { float f; memcpy(&f, &u, sizeof(f)); return f; }
+
+// the packed formats are unsigned: NaNs & negative values become 0, values above the largest finite value are clamped to it
+static inline float ClampUnsigned(float f, float MaxValue) { return f > 0.0f ? std::min(f, MaxValue) : 0.0f; }
+
+//
+// Scalar
+//
+// https://gist.github.com/rygorous/2156668: float_to_half_fast3_rtne(), round to nearest even,
+// overflows become Inf, NaNs become quiet NaNs.
+static uint16_t FloatToHalf(float f)
+{
+    uint32_t u = AsUInt(f);
+    const uint32_t Sign = u & 0x80000000u;
+    u ^= Sign;
+
+    uint32_t h;
+    if (u >= 0x47800000u) // (127 + 16) << 23: Inf, NaN or too large
+    {
+        h = u > 0x7F800000u ? 0x7E00 : 0x7C00;
+    }
+    else if (u < 0x38800000u) // (127 - 14) << 23: subnormal or zero, rounded by the float addition
+    {
+        const uint32_t MagicBits = ((127 - 15) + (23 - 10) + 1) << 23;
+        h = AsUInt(AsFloat(u) + AsFloat(MagicBits)) - MagicBits;
+    }
+    else
+    {
+        const uint32_t MantissaOdd = (u >> 13) & 1;
+        h = (u + (static_cast<uint32_t>(15 - 127) << 23) + 0xFFF + MantissaOdd) >> 13; // rebias the exponent & round
+    }
+    return static_cast<uint16_t>(h | (Sign >> 16));
+}
+
+// unsigned float with a 5-bit exponent & MANTISSA_BITS of mantissa from @f in [0, largest finite value], same rounding as FloatToHalf()
+template<int MANTISSA_BITS>
+static inline uint32_t ClampedFloatToPackedFloat(float f)
+{
+    constexpr int SHIFT = 23 - MANTISSA_BITS;
+    const uint32_t u = AsUInt(f);
+    if (u < 0x38800000u)
+    {
+        const uint32_t MagicBits = ((127 - 15) + SHIFT + 1) << 23;
+        return AsUInt(f + AsFloat(MagicBits)) - MagicBits;
+    }
+    const uint32_t MantissaOdd = (u >> SHIFT) & 1;
+    return (u + (static_cast<uint32_t>(15 - 127) << 23) + ((1u << (SHIFT - 1)) - 1) + MantissaOdd) >> SHIFT;
+}
+
+static void ConvertPixels_RGBA16F_Scalar(const float* pRGBA, void* pDst, size_t NumPixels)
+{
+    uint16_t* pOut = static_cast<uint16_t*>(pDst);
+    for (size_t i = 0; i < NumPixels * 4; ++i)
+        pOut[i] = FloatToHalf(pRGBA[i]);
+}
+
+static void ConvertPixels_R11G11B10F_Scalar(const float* pRGBA, void* pDst, size_t NumPixels)
+{
+    uint32_t* pOut = static_cast<uint32_t*>(pDst);
+    for (size_t i = 0; i < NumPixels; ++i)
+    {
+        const float* p = pRGBA + i * 4;
+        pOut[i] = ClampedFloatToPackedFloat<6>(ClampUnsigned(p[0], MAX_FLOAT11))
+            | (ClampedFloatToPackedFloat<6>(ClampUnsigned(p[1], MAX_FLOAT11)) << 11)
+            | (ClampedFloatToPackedFloat<5>(ClampUnsigned(p[2], MAX_FLOAT10)) << 22);
+    }
+}
+
+// DirectXMath's XMStoreFloat3SE(): the shared exponent is taken from the largest channel, rounded up if its 9-bit mantissa rounds up
+static void ConvertPixels_RGB9E5_Scalar(const float* pRGBA, void* pDst, size_t NumPixels)
+{
+    uint32_t* pOut = static_cast<uint32_t*>(pDst);
+    for (size_t i = 0; i < NumPixels; ++i)
+    {
+        const float* p = pRGBA + i * 4;
+        const float r = ClampUnsigned(p[0], MAX_RGB9E5);
+        const float g = ClampUnsigned(p[1], MAX_RGB9E5);
+        const float b = ClampUnsigned(p[2], MAX_RGB9E5);
+        const float MaxChannel = std::max(std::max(r, g), std::max(b, MIN_RGB9E5));
+        const uint32_t Exponent = (AsUInt(MaxChannel) + 0x4000) >> 23;
+        const float Scale = AsFloat(0x83000000u - (Exponent << 23));
+        pOut[i] = static_cast<uint32_t>(std::lrint(r * Scale))
+            | (static_cast<uint32_t>(std::lrint(g * Scale)) << 9)
+            | (static_cast<uint32_t>(std::lrint(b * Scale)) << 18)
+            | ((Exponent - 0x6F) << 27);
+    }
+}
+
+//
+// SSE2
+//
+static inline __m128i Select(__m128i Mask, __m128i a, __m128i b) { return _mm_or_si128(_mm_and_si128(Mask, a), _mm_andnot_si128(Mask, b)); }
+
+// FloatToHalf() of 4 floats into the low 16 bits of each lane, sign extended
+static inline __m128i FloatToHalf_SSE2(__m128 f)
+{
+    const __m128  Sign = _mm_and_ps(f, _mm_set1_ps(-0.0f));
+    const __m128i u = _mm_castps_si128(_mm_xor_ps(f, Sign));
+    const __m128i MagicBits = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+
+    const __m128i bRegular = _mm_cmplt_epi32(u, _mm_set1_epi32(0x47800000));
+    const __m128i bSubnormal = _mm_cmplt_epi32(u, _mm_set1_epi32(0x38800000));
+    const __m128i bNaN = _mm_cmpgt_epi32(u, _mm_set1_epi32(0x7F800000));
+    const __m128i InfOrNaN = _mm_or_si128(_mm_set1_epi32(0x7C00), _mm_and_si128(bNaN, _mm_set1_epi32(0x200)));
+
+    const __m128i Subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(u), _mm_castsi128_ps(MagicBits))), MagicBits);
+    const __m128i MantissaOdd = _mm_and_si128(_mm_srli_epi32(u, 13), _mm_set1_epi32(1));
+    const __m128i Normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(u, _mm_set1_epi32(static_cast<int>((static_cast<uint32_t>(15 - 127) << 23) + 0xFFF))), MantissaOdd), 13);
+
+    const __m128i h = Select(bRegular, Select(bSubnormal, Subnormal, Normal), InfOrNaN);
+    return _mm_or_si128(h, _mm_srai_epi32(_mm_castps_si128(Sign), 16));
+}
+
+template<int MANTISSA_BITS>
+static inline __m128i ClampedFloatToPackedFloat_SSE2(__m128 f)
+{
+    constexpr int SHIFT = 23 - MANTISSA_BITS;
+    const __m128i u = _mm_castps_si128(f);
+    const __m128i MagicBits = _mm_set1_epi32(((127 - 15) + SHIFT + 1) << 23);
+    const __m128i Subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(f, _mm_castsi128_ps(MagicBits))), MagicBits);
+    const __m128i MantissaOdd = _mm_and_si128(_mm_srli_epi32(u, SHIFT), _mm_set1_epi32(1));
+    const __m128i Normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(u, _mm_set1_epi32(static_cast<int>((static_cast<uint32_t>(15 - 127) << 23) + ((1u << (SHIFT - 1)) - 1)))), MantissaOdd), SHIFT);
+    return Select(_mm_cmplt_epi32(u, _mm_set1_epi32(0x38800000)), Subnormal, Normal);
+}
+
+static void ConvertPixels_RGBA16F_SSE2(const float* pRGBA, void* pDst, size_t NumPixels)
+{
+    uint16_t* pOut = static_cast<uint16_t*>(pDst);
+    size_t i = 0;
+    for (; i + 2 <= NumPixels; i += 2)
+    {
+        const __m128i h0 = FloatToHalf_SSE2(_mm_loadu_ps(pRGBA + i * 4 + 0));
+        const __m128i h1 = FloatToHalf_SSE2(_mm_loadu_ps(pRGBA + i * 4 + 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pOut + i * 4), _mm_packs_epi32(h0, h1)); // sign extended halves pack without saturating
+    }
+    ConvertPixels_RGBA16F_Scalar(pRGBA + i * 4, pOut + i * 4, NumPixels - i);
+}
+
+static void ConvertPixels_R11G11B10F_SSE2(const float* pRGBA, void* pDst, size_t NumPixels)
+{
+    uint32_t* pOut = static_cast<uint32_t*>(pDst);
+    const __m128 vZero = _mm_setzero_ps();
+    const __m128 vMax11 = _mm_set1_ps(MAX_FLOAT11);
+    const __m128 vMax10 = _mm_set1_ps(MAX_FLOAT10);
+    size_t i = 0;
+    for (; i + 4 <= NumPixels; i += 4)
+    {
+        __m128 r = _mm_loadu_ps(pRGBA + i * 4 + 0);
+        __m128 g = _mm_loadu_ps(pRGBA + i * 4 + 4);
+        __m128 b = _mm_loadu_ps(pRGBA + i * 4 + 8);
+        __m128 a = _mm_loadu_ps(pRGBA + i * 4 + 12);
+        _MM_TRANSPOSE4_PS(r, g, b, a);
+
+        // _mm_max_ps() returns its second operand for NaNs
+        r = _mm_min_ps(_mm_max_ps(r, vZero), vMax11);
+        g = _mm_min_ps(_mm_max_ps(g, vZero), vMax11);
+        b = _mm_min_ps(_mm_max_ps(b, vZero), vMax10);
+        const __m128i Packed = _mm_or_si128(ClampedFloatToPackedFloat_SSE2<6>(r)
+            , _mm_or_si128(_mm_slli_epi32(ClampedFloatToPackedFloat_SSE2<6>(g), 11), _mm_slli_epi32(ClampedFloatToPackedFloat_SSE2<5>(b), 22)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pOut + i), Packed);
+    }
+    ConvertPixels_R11G11B10F_Scalar(pRGBA + i * 4, pOut + i, NumPixels - i);
+}
+
+static void ConvertPixels_RGB9E5_SSE2(const float* pRGBA, void* pDst, size_t NumPixels)
+{
+    uint32_t* pOut = static_cast<uint32_t*>(pDst);
+    const __m128 vZero = _mm_setzero_ps();
+    const __m128 vMax = _mm_set1_ps(MAX_RGB9E5);
+    const __m128 vMin = _mm_set1_ps(MIN_RGB9E5);
+    size_t i = 0;
+    for (; i + 4 <= NumPixels; i += 4)
+    {
+        __m128 r = _mm_loadu_ps(pRGBA + i * 4 + 0);
+        __m128 g = _mm_loadu_ps(pRGBA + i * 4 + 4);
+        __m128 b = _mm_loadu_ps(pRGBA + i * 4 + 8);
+        __m128 a = _mm_loadu_ps(pRGBA + i * 4 + 12);
+        _MM_TRANSPOSE4_PS(r, g, b, a);
+
+        r = _mm_min_ps(_mm_max_ps(r, vZero), vMax);
+        g = _mm_min_ps(_mm_max_ps(g, vZero), vMax);
+        b = _mm_min_ps(_mm_max_ps(b, vZero), vMax);
+        const __m128  MaxChannel = _mm_max_ps(_mm_max_ps(r, g), _mm_max_ps(b, vMin));
+        const __m128i Exponent = _mm_srli_epi32(_mm_add_epi32(_mm_castps_si128(MaxChannel), _mm_set1_epi32(0x4000)), 23);
+        const __m128  Scale = _mm_castsi128_ps(_mm_sub_epi32(_mm_set1_epi32(static_cast<int>(0x83000000u)), _mm_slli_epi32(Exponent, 23)));
+
+        // _mm_cvtps_epi32() rounds to nearest even
+        const __m128i Packed = _mm_or_si128(
+              _mm_or_si128(_mm_cvtps_epi32(_mm_mul_ps(r, Scale)), _mm_slli_epi32(_mm_cvtps_epi32(_mm_mul_ps(g, Scale)), 9))
+            , _mm_or_si128(_mm_slli_epi32(_mm_cvtps_epi32(_mm_mul_ps(b, Scale)), 18), _mm_slli_epi32(_mm_sub_epi32(Exponent, _mm_set1_epi32(0x6F)), 27)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pOut + i), Packed);
+    }
+    ConvertPixels_RGB9E5_Scalar(pRGBA + i * 4, pOut + i, NumPixels - i);
+}
+
+//
+// AVX2: the hardware F16C conversion, only picked if CPUID reports F16C as well (VQSystemInfo::HasF16C())
+//
+static void ConvertPixels_RGBA16F_AVX2(const float* pRGBA, void* pDst, size_t NumPixels)
+{
+    uint16_t* pOut = static_cast<uint16_t*>(pDst);
+    size_t i = 0;
+    for (; i + 4 <= NumPixels; i += 4)
+    {
+        const __m128i h0 = _mm256_cvtps_ph(_mm256_loadu_ps(pRGBA + i * 4 + 0), _MM_FROUND_TO_NEAREST_INT);
+        const __m128i h1 = _mm256_cvtps_ph(_mm256_loadu_ps(pRGBA + i * 4 + 8), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pOut + i * 4 + 0), h0);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pOut + i * 4 + 8), h1);
+    }
+    _mm256_zeroupper();
+    ConvertPixels_RGBA16F_SSE2(pRGBA + i * 4, pOut + i * 4, NumPixels - i);
+}
+
+using FnConvertPixels = void(*)(const float* pRGBA, void* pDst, size_t NumPixels);
+static void ConvertPixels_RGBA32F(const float* pRGBA, void* pDst, size_t NumPixels) { memcpy(pDst, pRGBA, NumPixels * 16); }
+
+static FnConvertPixels GetConvertPixelsFunction(EImageFormat Format, ESIMDLevel SIMDLevel)
+{
+    const bool bSSE2 = SIMDLevel != ESIMDLevel::SCALAR;
+    switch (Format)
+    {
+    case EImageFormat::RGBA32F   : return ConvertPixels_RGBA32F;
+    case EImageFormat::RGBA16F   : return (SIMDLevel == ESIMDLevel::AVX2 && VQSystemInfo::HasF16C()) ? ConvertPixels_RGBA16F_AVX2 : (bSSE2 ? ConvertPixels_RGBA16F_SSE2 : ConvertPixels_RGBA16F_Scalar);
+    case EImageFormat::R11G11B10F: return bSSE2 ? ConvertPixels_R11G11B10F_SSE2 : ConvertPixels_R11G11B10F_Scalar;
+    case EImageFormat::RGB9E5    : return bSSE2 ? ConvertPixels_RGB9E5_SSE2 : ConvertPixels_RGB9E5_Scalar;
+    default: break;
+    }
+    return nullptr;
+}
+
+#if IMAGE_RUN_FORMAT_BENCHMARK
+static void RUN_IMAGE_FORMAT_BENCHMARK()
+{
+    constexpr int WIDTH = 3840;
+    constexpr int HEIGHT = 2160;
+    constexpr int NUM_ITERATIONS = 10;
+    constexpr size_t NUM_PIXELS = static_cast<size_t>(WIDTH) * HEIGHT;
+
+    std::vector<float> PixelsRGBA32F(NUM_PIXELS * 4);
+    std::vector<uint8_t> Output(NUM_PIXELS * 16);
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> Distribution(0.0f, 64.0f);
+    for (float& f : PixelsRGBA32F)
+        f = Distribution(rng);
+
+    const ESIMDLevel SupportedSIMDLevel = VQSystemInfo::GetSIMDLevel();
+    const ESIMDLevel SIMDLevels[] = { ESIMDLevel::SCALAR, ESIMDLevel::SSE2, ESIMDLevel::AVX2 };
+    const char* SIMDLevelNames[] = { "Scalar", "SSE2", "AVX2" };
+    const EImageFormat Formats[] = { EImageFormat::RGBA16F, EImageFormat::R11G11B10F, EImageFormat::RGB9E5 };
+    const char* FormatNames[] = { "RGBA16F", "R11G11B10F", "RGB9E5" };
+
+    Log::Info("Image Format Conversion Benchmark: %dx%d RGBA32F (%.1f MB)", WIDTH, HEIGHT, PixelsRGBA32F.size() * sizeof(float) / (1024.0 * 1024.0));
+    for (int iFormat = 0; iFormat < 3; ++iFormat)
+    {
+        for (int iLevel = 0; iLevel < 3; ++iLevel)
+        {
+            if (SIMDLevels[iLevel] > SupportedSIMDLevel)
+                continue;
+            const FnConvertPixels fnConvert = GetConvertPixelsFunction(Formats[iFormat], SIMDLevels[iLevel]);
+            fnConvert(PixelsRGBA32F.data(), Output.data(), NUM_PIXELS); // warm up
+            const auto t0 = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < NUM_ITERATIONS; ++i)
+                fnConvert(PixelsRGBA32F.data(), Output.data(), NUM_PIXELS);
+            const auto t1 = std::chrono::high_resolution_clock::now();
+            const double ms = std::chrono::duration<double, std::milli>(t1 - t0).count() / NUM_ITERATIONS;
+            Log::Info("  %-10s %-6s : %7.2fms | %6.2f GB/s read | %.1f MB", FormatNames[iFormat], SIMDLevelNames[iLevel]
+                , ms, PixelsRGBA32F.size() * sizeof(float) / (ms * 1e6), NUM_PIXELS * GetBytesPerPixel(Formats[iFormat]) / (1024.0 * 1024.0));
+        }
+    }
+}
+#endif
+
+bool Image::ConvertPixels(const float* pRGBA32F, void* pDst, size_t NumPixels, EImageFormat Format)
+{
+#if IMAGE_RUN_FORMAT_BENCHMARK
+    static bool sbBenchmarkRun = false;
+    if (!sbBenchmarkRun)
+    {
+        sbBenchmarkRun = true;
+        RUN_IMAGE_FORMAT_BENCHMARK();
+    }
+#endif
+
+    const FnConvertPixels fnConvert = GetConvertPixelsFunction(Format, VQSystemInfo::GetSIMDLevel());
+    if (!fnConvert)
+    {
+        Log::Error("Image::ConvertPixels(): unsupported target format %d", static_cast<int>(Format));
+        return false;
+    }
+    fnConvert(pRGBA32F, pDst, NumPixels);
+    return true;
+}
+
+Image Image::CreateConvertedImage(const Image& img, EImageFormat Format, ThreadPool* pThreadPool)
+{
+    if (!img.IsValid() || img.GetFormat() != EImageFormat::RGBA32F)
+    {
+        Log::Error("Image::CreateConvertedImage(): expects a valid RGBA32F image");
+        return Image();
+    }
+    const FnConvertPixels fnConvert = GetConvertPixelsFunction(Format, VQSystemInfo::GetSIMDLevel());
+    if (!fnConvert)
+    {
+        Log::Error("Image::CreateConvertedImage(): unsupported target format %d", static_cast<int>(Format));
+        return Image();
+    }
+
+    Image NewImage = CreateEmptyImage(static_cast<size_t>(img.Width) * img.Height * GetBytesPerPixel(Format));
+    if (!NewImage.pData)
+        return Image();
+    NewImage.Width = img.Width;
+    NewImage.Height = img.Height;
+    NewImage.BytesPerPixel = GetBytesPerPixel(Format);
+    NewImage.Format = Format;
+    NewImage.MaxLuminance = img.MaxLuminance;
+
+    const float* pSrc = static_cast<const float*>(img.pData);
+    uint8_t* pDst = static_cast<uint8_t*>(NewImage.pData);
+    const size_t NumRowsPerBlock = std::max<size_t>(1, NUM_PIXELS_PER_BLOCK / img.Width);
+    const size_t NumBlocks = (img.Height + NumRowsPerBlock - 1) / NumRowsPerBlock;
+    auto fnConvertBlock = [&](size_t iBlock)
+    {
+        const size_t RowBegin = iBlock * NumRowsPerBlock;
+        const size_t NumRows = std::min(NumRowsPerBlock, img.Height - RowBegin);
+        fnConvert(pSrc + RowBegin * img.Width * 4, pDst + RowBegin * img.Width * NewImage.BytesPerPixel, NumRows * img.Width);
+    };
+    if (pThreadPool && NumBlocks > 1)
+    {
+        pThreadPool->ParallelFor(0, NumBlocks, 1, fnConvertBlock);
+    }
+    else
+    {
+        for (size_t iBlock = 0; iBlock < NumBlocks; ++iBlock)
+            fnConvertBlock(iBlock);
+    }
+    return NewImage;
+}
@@ -0,0 +1,307 @@
+//	VQUtils
+//	Copyright(C) 2020 - Volkan Ilbeyli
+//
+//	This program is free software : you can redistribute it and / or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+//	Contact: volkanilbeyli@gmail.com
+
+#include "ImageLoader.h"
+#include "ImageCache.h"
+#include "Multithreading/ThreadPool.h"
+#include "Log.h"
+#include "utils.h"
+
+#ifndef VC_EXTRALEAN
+#define VC_EXTRALEAN
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+
+#include <algorithm>
+#include <cassert>
+
+// Loads a generated set of PNG & HDR files with Image::LoadFromFile() one at a time vs. ImageLoader, runs once on Initialize().
+#define IMAGELOADER_RUN_BENCHMARK 0
+
+#if IMAGELOADER_RUN_BENCHMARK
+#include "../Libs/stb/stb_image_write.h"
+#include <random>
+#endif
+
+#if IMAGELOADER_RUN_BENCHMARK
+static void RUN_IMAGELOADER_BENCHMARK(ThreadPool& DecodeThreadPool, const FImageLoaderSettings& Settings)
+{
+	constexpr int NUM_IMAGES_PER_FORMAT = 32;
+	constexpr int IMAGE_SIZE = 1024;
+
+	// noisy gradients: PNGs that don't compress to nothing
+	const std::string Folder = DirectoryUtil::GetSpecialFolderPath(DirectoryUtil::ESpecialFolder::APPDATA) + "\\VQUtils\\ImageLoaderBenchmark\\";
+	DirectoryUtil::CreateFolderIfItDoesntExist(Folder);
+	std::vector<std::string> FilePaths;
+	{
+		std::mt19937 rng(42);
+		std::vector<unsigned char> PixelsRGBA8(IMAGE_SIZE * IMAGE_SIZE * 4);
+		std::vector<float> PixelsRGB32F(IMAGE_SIZE * IMAGE_SIZE * 3);
+		for (int i = 0; i < NUM_IMAGES_PER_FORMAT; ++i)
+		{
+			for (size_t p = 0; p < PixelsRGBA8.size(); ++p)
+				PixelsRGBA8[p] = static_cast<unsigned char>((p / 4 % IMAGE_SIZE) / 4 + i + (rng() & 7));
+			for (size_t p = 0; p < PixelsRGB32F.size(); ++p)
+				PixelsRGB32F[p] = (p / 3 % IMAGE_SIZE) / 64.0f + (rng() & 255) / 256.0f;
+
+			FilePaths.push_back(Folder + "img" + std::to_string(i) + ".png");
+			stbi_write_png(FilePaths.back().c_str(), IMAGE_SIZE, IMAGE_SIZE, 4, PixelsRGBA8.data(), 0);
+			FilePaths.push_back(Folder + "img" + std::to_string(i) + ".hdr");
+			stbi_write_hdr(FilePaths.back().c_str(), IMAGE_SIZE, IMAGE_SIZE, 3, PixelsRGB32F.data());
+		}
+	}
+
+	// file cache is warm for both runs, written just above
+	const auto t0 = std::chrono::steady_clock::now();
+	for (const std::string& FilePath : FilePaths)
+	{
+		Image img = Image::LoadFromFile(FilePath.c_str());
+		img.Destroy();
+	}
+	const double SecondsSequential = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+	ImageLoader Loader;
+	Loader.Initialize(DecodeThreadPool, Settings);
+	Loader.LoadAsync(FilePaths, [](size_t, Image&& img) { img.Destroy(); });
+	Loader.WaitIdle();
+	const FImageLoaderStats Stats = Loader.GetStats();
+	Loader.Destroy();
+
+	Log::Info("ImageLoader Benchmark: %d images (%dx%d PNG & HDR), %d decode threads, %lluMB budget"
+		, static_cast<int>(FilePaths.size()), IMAGE_SIZE, IMAGE_SIZE, static_cast<int>(DecodeThreadPool.GetThreadPoolSize())
+		, static_cast<unsigned long long>(Settings.MemoryBudget >> 20)
+	);
+	Log::Info("  Image::LoadFromFile() : %8.2fms | %6.1f images/s", SecondsSequential * 1000.0, FilePaths.size() / SecondsSequential);
+	Log::Info("  ImageLoader           : %8.2fms | %6.1f images/s | read %.1fMB/s | decoded %.1fMB/s | peak in flight %.1fMB | %d failed"
+		, Stats.ElapsedSeconds * 1000.0, Stats.GetImagesPerSecond(), Stats.GetReadMBps(), Stats.GetDecodedMBps()
+		, Stats.PeakBytesInFlight / (1024.0 * 1024.0), static_cast<int>(Stats.NumImagesFailed)
+	);
+}
+#endif
+
+void ImageLoader::Initialize(ThreadPool& DecodeThreadPool, const FImageLoaderSettings& Settings)
+{
+#if IMAGELOADER_RUN_BENCHMARK
+	static bool sbBenchmarkRun = false;
+	if (!sbBenchmarkRun)
+	{
+		sbBenchmarkRun = true;
+		RUN_IMAGELOADER_BENCHMARK(DecodeThreadPool, Settings);
+	}
+#endif
+	assert(!mReaderThread.joinable());
+	mpDecodeThreadPool = &DecodeThreadPool;
+	mSettings = Settings;
+	mbExiting = false;
+	mReaderThread = std::thread(&ImageLoader::ReadFiles, this);
+}
+
+void ImageLoader::Destroy()
+{
+	if (!mReaderThread.joinable())
+		return;
+
+	WaitIdle();
+	{
+		std::lock_guard<std::mutex> lk(mMutex);
+		mbExiting = true;
+	}
+	mcvReader.notify_one();
+	mReaderThread.join();
+	mpDecodeThreadPool = nullptr;
+}
+
+std::vector<std::future<Image>> ImageLoader::LoadAsync(const std::vector<std::string>& FilePaths)
+{
+	std::vector<std::future<Image>> Futures;
+	Futures.reserve(FilePaths.size());
+
+	std::vector<FLoadRequest*> Requests(FilePaths.size());
+	for (size_t i = 0; i < FilePaths.size(); ++i)
+	{
+		Requests[i] = new FLoadRequest();
+		Requests[i]->FilePath = FilePaths[i];
+		Requests[i]->iImage = i;
+		Futures.push_back(Requests[i]->Promise.get_future());
+	}
+
+	Enqueue(Requests);
+	return Futures;
+}
+
+void ImageLoader::LoadAsync(const std::vector<std::string>& FilePaths, FnOnImageLoaded fnOnImageLoaded)
+{
+	std::vector<FLoadRequest*> Requests(FilePaths.size());
+	for (size_t i = 0; i < FilePaths.size(); ++i)
+	{
+		Requests[i] = new FLoadRequest();
+		Requests[i]->FilePath = FilePaths[i];
+		Requests[i]->iImage = i;
+		Requests[i]->fnOnImageLoaded = fnOnImageLoaded;
+	}
+
+	Enqueue(Requests);
+}
+
+void ImageLoader::Enqueue(const std::vector<FLoadRequest*>& Requests)
+{
+	if (Requests.empty())
+		return;
+	{
+		std::lock_guard<std::mutex> lk(mMutex);
+		if (mNumPendingImages == 0)
+			mBusyStartTime = std::chrono::steady_clock::now();
+		mNumPendingImages += Requests.size();
+		mReadQueue.insert(mReadQueue.end(), Requests.begin(), Requests.end());
+	}
+	mcvReader.notify_one();
+}
+
+void ImageLoader::WaitIdle()
+{
+	std::unique_lock<std::mutex> lk(mMutex);
+	mcvIdle.wait(lk, [this]() { return mNumPendingImages == 0; });
+}
+
+bool ImageLoader::IsIdle() const
+{
+	std::lock_guard<std::mutex> lk(mMutex);
+	return mNumPendingImages == 0;
+}
+
+FImageLoaderStats ImageLoader::GetStats() const
+{
+	std::lock_guard<std::mutex> lk(mMutex);
+	FImageLoaderStats Stats = mStats;
+	if (mNumPendingImages > 0) // include the current batch
+		Stats.ElapsedSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - mBusyStartTime).count();
+	return Stats;
+}
+
+void ImageLoader::ResetStats()
+{
+	std::lock_guard<std::mutex> lk(mMutex);
+	mStats = {};
+	mStats.PeakBytesInFlight = mNumBytesInFlight;
+	mBusyStartTime = std::chrono::steady_clock::now();
+}
+
+void ImageLoader::ReserveMemory(FLoadRequest* pRequest, size_t NumBytes)
+{
+	std::unique_lock<std::mutex> lk(mMutex);
+
+	// the request's own reservation is in flight as well: an image that doesn't fit the budget waits for the others to complete
+	mcvReader.wait(lk, [&]()
+	{
+		return mNumBytesInFlight == pRequest->NumBytesReserved
+			|| mNumBytesInFlight + NumBytes <= mSettings.MemoryBudget;
+	});
+	mNumBytesInFlight += NumBytes;
+	pRequest->NumBytesReserved += NumBytes;
+	mStats.PeakBytesInFlight = std::max(mStats.PeakBytesInFlight, mNumBytesInFlight);
+}
+
+void ImageLoader::ReadFiles()
+{
+	SetThreadDescription(GetCurrentThread(), L"ImageLoader_Reader");
+	while (true)
+	{
+		FLoadRequest* pRequest = nullptr;
+		{
+			std::unique_lock<std::mutex> lk(mMutex);
+			mcvReader.wait(lk, [this]() { return mbExiting || !mReadQueue.empty(); });
+			if (mReadQueue.empty())
+				return; // exiting
+			pRequest = mReadQueue.front();
+			mReadQueue.pop_front();
+		}
+
+		pRequest->bCached = ImageCache::OpenEntry(pRequest->FilePath, pRequest->File, mSettings.HDRFormat);
+		pRequest->bStoreInCache = !pRequest->bCached && ImageCache::IsEnabled() && ImageCache::GetSourceStamp(pRequest->FilePath, pRequest->SourceStamp);
+		if (!pRequest->bCached && !pRequest->File.Open(pRequest->FilePath))
+		{
+			Log::Error("ImageLoader: couldn't open file %s", pRequest->FilePath.c_str());
+			Complete(pRequest, Image());
+			continue;
+		}
+
+		// the mapped pages count against the budget once they're read in
+		ReserveMemory(pRequest, pRequest->File.GetSize());
+		pRequest->File.Prefetch(); // reads the file in the background while the previous images decode
+
+		const FImageInfo Info = pRequest->bCached
+			? ImageCache::GetInfo(pRequest->File)
+			: Image::QueryInfo(pRequest->File.GetData(), pRequest->File.GetSize(), pRequest->FilePath.c_str());
+		const int BytesPerPixel = Info.bHDR ? GetBytesPerPixel(mSettings.HDRFormat) : Info.BytesPerPixel;
+		ReserveMemory(pRequest, static_cast<size_t>(Info.Width) * Info.Height * BytesPerPixel);
+		mpDecodeThreadPool->Dispatch([this, pRequest]() { Decode(pRequest); });
+	}
+}
+
+void ImageLoader::Decode(FLoadRequest* pRequest)
+{
+	if (pRequest->bCached)
+	{
+		Complete(pRequest, ImageCache::LoadImage(pRequest->File, mSettings.HDRFormat, mpDecodeThreadPool));
+		return;
+	}
+
+	Image img = Image::LoadFromMemory(pRequest->File.GetData(), pRequest->File.GetSize(), pRequest->FilePath.c_str(), mpDecodeThreadPool, mSettings.HDRFormat);
+	if (pRequest->bStoreInCache)
+		ImageCache::Store(pRequest->FilePath, pRequest->SourceStamp, pRequest->File.GetData(), pRequest->File.GetSize(), img, mpDecodeThreadPool);
+	Complete(pRequest, std::move(img));
+}
+
+void ImageLoader::Complete(FLoadRequest* pRequest, Image&& img)
+{
+	const bool   bLoaded = img.IsValid();
+	const size_t NumBytesRead = pRequest->File.GetSize();
+	const size_t NumBytesDecoded = bLoaded ? img.GetSizeInBytes() : 0;
+	const size_t NumBytesReserved = pRequest->NumBytesReserved;
+
+	// unmap the file before handing over the image
+	pRequest->File.Close();
+	if (pRequest->fnOnImageLoaded)
+		pRequest->fnOnImageLoaded(pRequest->iImage, std::move(img));
+	else
+		pRequest->Promise.set_value(std::move(img));
+	delete pRequest;
+
+	{
+		std::lock_guard<std::mutex> lk(mMutex);
+		mNumBytesInFlight -= NumBytesReserved;
+		mStats.NumBytesRead += NumBytesRead;
+		mStats.NumBytesDecoded += NumBytesDecoded;
+		++(bLoaded ? mStats.NumImagesLoaded : mStats.NumImagesFailed);
+
+		// signalled under the lock, before the last pending image lets WaitIdle() & Destroy() return:
+		// the loader may be freed as soon as mMutex is released
+		mcvReader.notify_one();
+		if (--mNumPendingImages == 0)
+		{
+			mStats.ElapsedSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - mBusyStartTime).count();
+			mcvIdle.notify_all();
+		}
+	}
+}
@@ -0,0 +1,345 @@
+//	VQUtils
+//	Copyright(C) 2020 - Volkan Ilbeyli
+//
+//	This program is free software : you can redistribute it and / or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+//	Contact: volkanilbeyli@gmail.com
+
+#include "Image.h"
+#include "Multithreading/ThreadPool.h"
+#include "Log.h"
+#include "PixelBufferPool.h"
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <type_traits>
+#include <cstdlib>
+#include <cstring>
+
+// Compares Image::GenerateMipChain() against resizing the source image for each level, runs once on the first call.
+#define IMAGE_RUN_MIPCHAIN_BENCHMARK 0
+
+#if IMAGE_RUN_MIPCHAIN_BENCHMARK
+#include "../Libs/stb/stb_image_resize.h"
+#include <chrono>
+#include <random>
+#endif
+
+constexpr size_t MIP_LEVEL_ALIGNMENT = 16;
+
+// levels are split into rows of at least this many pixels for multithreading, smaller levels are processed on the calling thread.
+constexpr size_t NUM_PIXELS_PER_TASK = 16 * 1024;
+
+//
+// Filter taps
+//
+// Even dimensions are halved with a 2-tap box filter. An odd dimension 2n+1 is reduced to n with a 3-tap filter
+// whose weights slide across the output so that each source texel contributes equally to the level:
+//   dst[x] = ((n-x) * src[2x] + n * src[2x+1] + (x+1) * src[2x+2]) / (2n+1)
+//
+struct FFilterTaps
+{
+    int   NumTaps;
+    float Weights[3];
+};
+
+static inline FFilterTaps GetFilterTaps(int SrcSize, int DstSize, int iDst)
+{
+    if ((SrcSize & 1) == 0)
+        return { 2, { 0.5f, 0.5f, 0.0f } };
+
+    const float Denom = static_cast<float>(SrcSize);
+    return { 3, { (DstSize - iDst) / Denom, DstSize / Denom, (iDst + 1) / Denom } };
+}
+
+//
+// Pixel load/store as 4 floats
+//
+static inline __m128 LoadPixel(const float* pSrc) { return _mm_loadu_ps(pSrc); }
+static inline void  StorePixel(float* pDst, __m128 px) { _mm_storeu_ps(pDst, px); }
+
+static inline __m128 LoadPixel(const uint8_t* pSrc)
+{
+    int32_t RGBA;
+    memcpy(&RGBA, pSrc, sizeof(RGBA));
+    const __m128i zero = _mm_setzero_si128();
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(RGBA), zero), zero));
+}
+static inline void StorePixel(uint8_t* pDst, __m128 px)
+{
+    const __m128i px32 = _mm_cvtps_epi32(px); // rounds to nearest
+    const __m128i px16 = _mm_packs_epi32(px32, px32);
+    const int32_t RGBA = _mm_cvtsi128_si32(_mm_packus_epi16(px16, px16));
+    memcpy(pDst, &RGBA, sizeof(RGBA));
+}
+
+//
+// Row kernels: each call writes a single row of the destination level
+//
+static void DownsampleRow_Box_RGBA32F(const float* pSrcRow0, const float* pSrcRow1, float* pDstRow, int DstWidth)
+{
+    const __m128 vQuarter = _mm_set1_ps(0.25f);
+    for (int x = 0; x < DstWidth; ++x)
+    {
+        const __m128 Top    = _mm_add_ps(_mm_loadu_ps(pSrcRow0 + x * 8), _mm_loadu_ps(pSrcRow0 + x * 8 + 4));
+        const __m128 Bottom = _mm_add_ps(_mm_loadu_ps(pSrcRow1 + x * 8), _mm_loadu_ps(pSrcRow1 + x * 8 + 4));
+        _mm_storeu_ps(pDstRow + x * 4, _mm_mul_ps(_mm_add_ps(Top, Bottom), vQuarter));
+    }
+}
+
+// 4 destination pixels per iteration: the 2x2 sums are calculated in 16-bit, then rounded with (sum + 2) >> 2
+static void DownsampleRow_Box_RGBA8(const uint8_t* pSrcRow0, const uint8_t* pSrcRow1, uint8_t* pDstRow, int DstWidth)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i vTwo = _mm_set1_epi16(2);
+    auto fnSum2x2 = [&](__m128i Top, __m128i Bottom) -> __m128i // 2x 16-byte source rows -> 2 destination pixels in 16-bit
+    {
+        const __m128i Lo = _mm_add_epi16(_mm_unpacklo_epi8(Top, zero), _mm_unpacklo_epi8(Bottom, zero)); // px0 | px1
+        const __m128i Hi = _mm_add_epi16(_mm_unpackhi_epi8(Top, zero), _mm_unpackhi_epi8(Bottom, zero)); // px2 | px3
+        return _mm_add_epi16(_mm_unpacklo_epi64(Lo, Hi), _mm_unpackhi_epi64(Lo, Hi));                    // px0+px1 | px2+px3
+    };
+
+    int x = 0;
+    for (; x + 4 <= DstWidth; x += 4)
+    {
+        const __m128i* pTop    = reinterpret_cast<const __m128i*>(pSrcRow0 + x * 8);
+        const __m128i* pBottom = reinterpret_cast<const __m128i*>(pSrcRow1 + x * 8);
+        const __m128i Sum01 = fnSum2x2(_mm_loadu_si128(pTop + 0), _mm_loadu_si128(pBottom + 0));
+        const __m128i Sum23 = fnSum2x2(_mm_loadu_si128(pTop + 1), _mm_loadu_si128(pBottom + 1));
+        const __m128i Avg01 = _mm_srli_epi16(_mm_add_epi16(Sum01, vTwo), 2);
+        const __m128i Avg23 = _mm_srli_epi16(_mm_add_epi16(Sum23, vTwo), 2);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDstRow + x * 4), _mm_packus_epi16(Avg01, Avg23));
+    }
+    for (; x < DstWidth; ++x)
+    for (int c = 0; c < 4; ++c)
+    {
+        const int Sum = pSrcRow0[x * 8 + c] + pSrcRow0[x * 8 + 4 + c] + pSrcRow1[x * 8 + c] + pSrcRow1[x * 8 + 4 + c];
+        pDstRow[x * 4 + c] = static_cast<uint8_t>((Sum + 2) >> 2);
+    }
+}
+
+// non-power-of-two levels: up to 3x3 taps per destination pixel
+template<class TChannel>
+static void DownsampleRow_Weighted(const TChannel* pSrc, int SrcWidth, int SrcHeight, TChannel* pDstRow, int DstWidth, int DstHeight, int y)
+{
+    const FFilterTaps TapsY = GetFilterTaps(SrcHeight, DstHeight, y);
+    for (int x = 0; x < DstWidth; ++x)
+    {
+        const FFilterTaps TapsX = GetFilterTaps(SrcWidth, DstWidth, x);
+        __m128 Sum = _mm_setzero_ps();
+        for (int ty = 0; ty < TapsY.NumTaps; ++ty)
+        {
+            const TChannel* pSrcRow = pSrc + static_cast<size_t>(y * 2 + ty) * SrcWidth * 4;
+            __m128 RowSum = _mm_setzero_ps();
+            for (int tx = 0; tx < TapsX.NumTaps; ++tx)
+                RowSum = _mm_add_ps(RowSum, _mm_mul_ps(LoadPixel(pSrcRow + (x * 2 + tx) * 4), _mm_set1_ps(TapsX.Weights[tx])));
+            Sum = _mm_add_ps(Sum, _mm_mul_ps(RowSum, _mm_set1_ps(TapsY.Weights[ty])));
+        }
+        StorePixel(pDstRow + x * 4, Sum);
+    }
+}
+
+template<class TChannel>
+static void DownsampleRow(const TChannel* pSrc, int SrcWidth, int SrcHeight, TChannel* pDst, int DstWidth, int DstHeight, int y)
+{
+    TChannel* pDstRow = pDst + static_cast<size_t>(y) * DstWidth * 4;
+    if ((SrcWidth & 1) || (SrcHeight & 1))
+    {
+        DownsampleRow_Weighted(pSrc, SrcWidth, SrcHeight, pDstRow, DstWidth, DstHeight, y);
+        return;
+    }
+
+    const TChannel* pSrcRow0 = pSrc + static_cast<size_t>(y * 2) * SrcWidth * 4;
+    const TChannel* pSrcRow1 = pSrcRow0 + static_cast<size_t>(SrcWidth) * 4;
+    if constexpr (std::is_same_v<TChannel, float>) DownsampleRow_Box_RGBA32F(pSrcRow0, pSrcRow1, pDstRow, DstWidth);
+    else                                           DownsampleRow_Box_RGBA8(pSrcRow0, pSrcRow1, pDstRow, DstWidth);
+}
+
+template<class TChannel>
+static void GenerateMipLevels(FMipChain& Chain, const void* pSource, ThreadPool* pThreadPool)
+{
+    const size_t RowSizeInBytes0 = static_cast<size_t>(Chain.Levels[0].Width) * Chain.BytesPerPixel;
+    auto fnForEachRow = [pThreadPool](int NumRows, int RowWidth, auto&& fnRow)
+    {
+        const size_t NumRowsPerTask = std::max<size_t>(1, NUM_PIXELS_PER_TASK / RowWidth);
+        if (pThreadPool && static_cast<size_t>(NumRows) > NumRowsPerTask)
+        {
+            pThreadPool->ParallelFor(0, NumRows, NumRowsPerTask, [&](size_t y) { fnRow(static_cast<int>(y)); });
+        }
+        else
+        {
+            for (int y = 0; y < NumRows; ++y)
+                fnRow(y);
+        }
+    };
+
+    if (Chain.Levels.size() == 1)
+    {
+        fnForEachRow(Chain.Levels[0].Height, Chain.Levels[0].Width, [&](int y)
+        {
+            memcpy(static_cast<unsigned char*>(Chain.pData) + y * RowSizeInBytes0, static_cast<const unsigned char*>(pSource) + y * RowSizeInBytes0, RowSizeInBytes0);
+        });
+        return;
+    }
+
+    for (size_t iLevel = 1; iLevel < Chain.Levels.size(); ++iLevel)
+    {
+        const FMipChain::FLevel& Src = Chain.Levels[iLevel - 1];
+        const FMipChain::FLevel& Dst = Chain.Levels[iLevel];
+        TChannel* pDst = static_cast<TChannel*>(Chain.GetLevelData(static_cast<int>(iLevel)));
+
+        // the first level is filtered from the source image while it's being copied into the chain:
+        // destination row y copies the source rows 2y & 2y+1 it reads, the last row also copies the remaining odd row.
+        const bool bCopySourceRows = iLevel == 1;
+        const TChannel* pSrc = static_cast<const TChannel*>(bCopySourceRows ? pSource : Chain.GetLevelData(static_cast<int>(iLevel - 1)));
+
+        fnForEachRow(Dst.Height, Src.Width, [&](int y)
+        {
+            if (bCopySourceRows)
+            {
+                const size_t RowBegin = static_cast<size_t>(y) * 2;
+                const size_t RowEnd = y == Dst.Height - 1 ? Src.Height : RowBegin + 2;
+                memcpy(static_cast<unsigned char*>(Chain.pData) + RowBegin * RowSizeInBytes0
+                    , static_cast<const unsigned char*>(pSource) + RowBegin * RowSizeInBytes0
+                    , (RowEnd - RowBegin) * RowSizeInBytes0
+                );
+            }
+            DownsampleRow(pSrc, Src.Width, Src.Height, pDst, Dst.Width, Dst.Height, y);
+        });
+    }
+}
+
+#if IMAGE_RUN_MIPCHAIN_BENCHMARK
+static void RUN_IMAGE_MIPCHAIN_BENCHMARK(ThreadPool* pThreadPool)
+{
+    constexpr int WIDTH = 3840;
+    constexpr int HEIGHT = 2160;
+    constexpr int NUM_ITERATIONS = 5;
+
+    std::vector<float> PixelsRGBA32F(static_cast<size_t>(WIDTH) * HEIGHT * 4);
+    std::vector<uint8_t> PixelsRGBA8(PixelsRGBA32F.size());
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> Distribution(0.0f, 4.0f);
+    for (size_t i = 0; i < PixelsRGBA32F.size(); ++i)
+    {
+        PixelsRGBA32F[i] = Distribution(rng);
+        PixelsRGBA8[i] = static_cast<uint8_t>(PixelsRGBA32F[i] * 63.0f);
+    }
+
+    auto fnMeasure = [&](auto&& fnRun) -> double
+    {
+        fnRun(); // warm up
+        const auto t0 = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < NUM_ITERATIONS; ++i)
+            fnRun();
+        const auto t1 = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(t1 - t0).count() / NUM_ITERATIONS;
+    };
+
+    const int NumMips = Image::CalculateMipLevelCount(WIDTH, HEIGHT);
+    Log::Info("Image Mip Chain Benchmark: %dx%d, %d mips", WIDTH, HEIGHT, NumMips);
+    for (int bHDR = 1; bHDR >= 0; --bHDR)
+    {
+        Image img;
+        img.Width = WIDTH;
+        img.Height = HEIGHT;
+        img.BytesPerPixel = bHDR ? 16 : 4;
+        img.pData = bHDR ? static_cast<void*>(PixelsRGBA32F.data()) : static_cast<void*>(PixelsRGBA8.data());
+
+        // each level resized from the source into its own allocation
+        const double msReference = fnMeasure([&]()
+        {
+            for (int iMip = 1; iMip < NumMips; ++iMip)
+            {
+                const int w = WIDTH >> iMip;
+                const int h = HEIGHT >> iMip;
+                void* pMip = malloc(static_cast<size_t>(w) * h * img.BytesPerPixel);
+                if (bHDR) stbir_resize_float(PixelsRGBA32F.data(), WIDTH, HEIGHT, 0, static_cast<float*>(pMip), w, h, 0, 4);
+                else      stbir_resize_uint8(PixelsRGBA8.data(), WIDTH, HEIGHT, 0, static_cast<unsigned char*>(pMip), w, h, 0, 4);
+                free(pMip);
+            }
+        });
+        const double msSerial = fnMeasure([&]() { FMipChain Chain = img.GenerateMipChain(); Chain.Destroy(); });
+        const double msPool = pThreadPool ? fnMeasure([&]() { FMipChain Chain = img.GenerateMipChain(pThreadPool); Chain.Destroy(); }) : 0.0;
+
+        Log::Info("  %-7s : stbir per level %8.2fms | GenerateMipChain %8.2fms | GenerateMipChain+ThreadPool %8.2fms (incl. copying level 0)"
+            , bHDR ? "RGBA32F" : "RGBA8", msReference, msSerial, msPool
+        );
+        img.pData = nullptr; // not owned
+    }
+}
+#endif
+
+FMipChain Image::GenerateMipChain(const Image& img, ThreadPool* pThreadPool, int NumMips)
+{
+#if IMAGE_RUN_MIPCHAIN_BENCHMARK
+    static bool sbBenchmarkRun = false;
+    if (!sbBenchmarkRun)
+    {
+        sbBenchmarkRun = true;
+        RUN_IMAGE_MIPCHAIN_BENCHMARK(pThreadPool);
+    }
+#endif
+
+    FMipChain Chain;
+    if (!img.IsValid())
+    {
+        Log::Error("Image::GenerateMipChain(): invalid image");
+        return Chain;
+    }
+    if (img.GetFormat() != EImageFormat::RGBA8 && img.GetFormat() != EImageFormat::RGBA32F)
+    {
+        Log::Error("Image::GenerateMipChain(): only RGBA8 & RGBA32F images are supported");
+        return Chain;
+    }
+
+    const int NumMipsMax = CalculateMipLevelCount(img.Width, img.Height);
+    NumMips = (NumMips <= 0 || NumMips > NumMipsMax) ? NumMipsMax : NumMips;
+
+    Chain.BytesPerPixel = img.IsHDR() ? 16 : 4; // HDR is 16bytes/px (RGBA32F), SDR is 4bytes/px (RGBA8)
+    Chain.Levels.resize(NumMips);
+    for (int iMip = 0; iMip < NumMips; ++iMip)
+    {
+        FMipChain::FLevel& Level = Chain.Levels[iMip];
+        Level.Offset = Chain.SizeInBytes;
+        Level.Width = std::max(1, img.Width >> iMip);
+        Level.Height = std::max(1, img.Height >> iMip);
+        Chain.SizeInBytes += (Chain.GetLevelSizeInBytes(iMip) + MIP_LEVEL_ALIGNMENT - 1) & ~(MIP_LEVEL_ALIGNMENT - 1);
+    }
+
+    Chain.pData = PixelBufferPool::Allocate(Chain.SizeInBytes);
+    if (!Chain.pData)
+    {
+        Log::Error("Image::GenerateMipChain(): couldn't allocate %llu bytes", static_cast<unsigned long long>(Chain.SizeInBytes));
+        Chain.Levels.clear();
+        Chain.SizeInBytes = 0;
+        return Chain;
+    }
+
+    if (img.IsHDR()) GenerateMipLevels<float>(Chain, img.pData, pThreadPool);
+    else             GenerateMipLevels<uint8_t>(Chain, img.pData, pThreadPool);
+    return Chain;
+}
+
+void FMipChain::Destroy()
+{
+    if (pData)
+    {
+        PixelBufferPool::Free(pData);
+        pData = nullptr;
+    }
+    SizeInBytes = 0;
+    Levels.clear();
+}
@@ -0,0 +1,477 @@
+//	VQUtils
+//	Copyright(C) 2020 - Volkan Ilbeyli
+//
+//	This program is free software : you can redistribute it and / or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+//	Contact: volkanilbeyli@gmail.com
+
+#include "Image.h"
+#include "ImageStream.h"
+#include "Multithreading/ThreadPool.h"
+#include "Log.h"
+
+#include "../Libs/stb/stb_image_resize.h"
+
+#include <emmintrin.h>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+
+// Compares the RGBA8 path of Image::ResizeImage() against stbir_resize_uint8_srgb(), runs once on the first call.
+#define IMAGE_RUN_RESIZE_BENCHMARK 0
+
+#if IMAGE_RUN_RESIZE_BENCHMARK
+#include <chrono>
+#include <random>
+#endif
+
+// destination rows are split into bands of at least this many pixels for multithreading
+constexpr size_t NUM_PIXELS_PER_BAND = 16 * 1024;
+
+// streamed images are read in bands of about this many pixels by default
+constexpr size_t STREAM_NUM_PIXELS_PER_BAND = 1024 * 1024;
+
+//
+// sRGB <-> linear lookup tables
+//
+// Decoding is exact with a 256-entry table. Encoding quantizes the linear value to LINEAR_TO_SRGB_LUT_SIZE steps first,
+// which is within 1 of the exact sRGB value in the darkest values where the sRGB curve is steepest, exact elsewhere.
+//
+constexpr int LINEAR_TO_SRGB_LUT_SIZE = 1 << 14;
+
+struct FColorLUTs
+{
+    float   ToLinear[256];
+    uint8_t FromLinear[LINEAR_TO_SRGB_LUT_SIZE];
+};
+
+static float SRGBToLinear(float c) { return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f); }
+static float LinearToSRGB(float c) { return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f; }
+
+static const FColorLUTs& GetColorLUTs(bool bSRGB)
+{
+    static const FColorLUTs sLUTs[2] = // [0]: linear, [1]: sRGB
+    {
+        []() { FColorLUTs luts; for (int i = 0; i < 256; ++i) luts.ToLinear[i] = i / 255.0f; for (int i = 0; i < LINEAR_TO_SRGB_LUT_SIZE; ++i) luts.FromLinear[i] = static_cast<uint8_t>(i * 255.0f / (LINEAR_TO_SRGB_LUT_SIZE - 1) + 0.5f); return luts; }(),
+        []() { FColorLUTs luts; for (int i = 0; i < 256; ++i) luts.ToLinear[i] = SRGBToLinear(i / 255.0f); for (int i = 0; i < LINEAR_TO_SRGB_LUT_SIZE; ++i) luts.FromLinear[i] = static_cast<uint8_t>(LinearToSRGB(static_cast<float>(i) / (LINEAR_TO_SRGB_LUT_SIZE - 1)) * 255.0f + 0.5f); return luts; }(),
+    };
+    return sLUTs[bSRGB ? 1 : 0];
+}
+
+//
+// Filter
+//
+// Cubic filters, the same defaults stb_image_resize uses: Mitchell-Netravali (B = C = 1/3) for downsampling with little
+// blurring & ringing, Catmull-Rom (B = 0, C = 1/2) for upsampling to keep the edges sharp.
+// The filter is widened by the scale factor when downsampling so that it covers all the source pixels in its footprint.
+//
+constexpr float FILTER_SUPPORT = 2.0f;
+
+static float CubicFilter(float x, float B, float C)
+{
+    x = std::fabs(x);
+    if (x < 1.0f) return ((12.0f - 9.0f * B - 6.0f * C) * x * x * x + (-18.0f + 12.0f * B + 6.0f * C) * x * x + (6.0f - 2.0f * B)) / 6.0f;
+    if (x < 2.0f) return ((-B - 6.0f * C) * x * x * x + (6.0f * B + 30.0f * C) * x * x + (-12.0f * B - 48.0f * C) * x + (8.0f * B + 24.0f * C)) / 6.0f;
+    return 0.0f;
+}
+
+// Source pixels contributing to each destination pixel along one axis: [First, First + NumTaps) with Weights[i * MaxNumTaps + tap].
+// Taps falling outside the source are clamped to the edge pixels.
+struct FFilterContributors
+{
+    std::vector<int>   First;
+    std::vector<int>   NumTaps;
+    std::vector<float> Weights;
+    int MaxNumTaps = 0;
+
+    void Calculate(int SrcSize, int DstSize)
+    {
+        const float Scale = static_cast<float>(SrcSize) / DstSize;
+        const float FilterScale = std::max(Scale, 1.0f);
+        const float Support = FILTER_SUPPORT * FilterScale;
+        const bool bUpsampling = DstSize > SrcSize;
+        const float B = bUpsampling ? 0.0f : 1.0f / 3.0f;
+        const float C = bUpsampling ? 0.5f : 1.0f / 3.0f;
+
+        MaxNumTaps = static_cast<int>(std::ceil(Support * 2.0f)) + 1;
+        First.resize(DstSize);
+        NumTaps.resize(DstSize);
+        Weights.assign(static_cast<size_t>(DstSize) * MaxNumTaps, 0.0f);
+
+        for (int i = 0; i < DstSize; ++i)
+        {
+            const float Center = (i + 0.5f) * Scale - 0.5f;
+            const int Begin = std::max(static_cast<int>(std::ceil(Center - Support)), 0);
+            const int End = std::min(static_cast<int>(std::floor(Center + Support)), SrcSize - 1) + 1;
+            float* pWeights = &Weights[static_cast<size_t>(i) * MaxNumTaps];
+
+            // the edge pixels get the weights of the taps outside the source, normalized by the total weight below
+            float WeightSum = 0.0f;
+            for (int s = static_cast<int>(std::ceil(Center - Support)); s <= static_cast<int>(std::floor(Center + Support)); ++s)
+            {
+                const float w = CubicFilter((s - Center) / FilterScale, B, C);
+                pWeights[std::min(std::max(s, Begin), End - 1) - Begin] += w;
+                WeightSum += w;
+            }
+            for (int t = 0; t < End - Begin; ++t)
+                pWeights[t] /= WeightSum;
+
+            First[i] = Begin;
+            NumTaps[i] = End - Begin;
+            assert(NumTaps[i] <= MaxNumTaps);
+        }
+    }
+};
+
+//
+// Resampling
+//
+struct FResizeContext
+{
+    const uint8_t* pSrc;
+    uint8_t*       pDst;
+    int SrcWidth, SrcHeight;
+    int DstWidth, DstHeight;
+    const FColorLUTs* pLUTs;
+    FFilterContributors ContributorsX;
+    FFilterContributors ContributorsY;
+};
+
+// scratch memory for the rows a thread is working on, reused across calls
+struct FResizeRowCache
+{
+    std::vector<float> LinearRow;        // source row in linear float RGBA
+    std::vector<float> FilteredRows;     // ring buffer of horizontally filtered source rows
+    std::vector<int>   FilteredRowIndices;
+    std::vector<float> OutputRow;        // vertically filtered destination row
+};
+static thread_local FResizeRowCache tRowCache;
+
+// Colors are weighted by alpha while filtering so that transparent pixels don't bleed into their neighbors.
+// A tiny epsilon is added to alpha, the same as stb_image_resize, to keep the colors of fully transparent areas.
+constexpr float ALPHA_EPSILON = 1.0f / (1ull << 40) / (1ull << 40);
+
+static void DecodeRow(const uint8_t* pSrcRow, int Width, const FColorLUTs& luts, float* pDst)
+{
+    const float* pToLinear = luts.ToLinear;
+    for (int x = 0; x < Width; ++x)
+    {
+        const float Alpha = pSrcRow[x * 4 + 3] * (1.0f / 255.0f) + ALPHA_EPSILON; // alpha is always linear
+        pDst[x * 4 + 0] = pToLinear[pSrcRow[x * 4 + 0]] * Alpha;
+        pDst[x * 4 + 1] = pToLinear[pSrcRow[x * 4 + 1]] * Alpha;
+        pDst[x * 4 + 2] = pToLinear[pSrcRow[x * 4 + 2]] * Alpha;
+        pDst[x * 4 + 3] = Alpha;
+    }
+}
+
+static void FilterRowHorizontal(const float* pLinearRow, const FFilterContributors& Contributors, int DstWidth, float* pDst)
+{
+    for (int x = 0; x < DstWidth; ++x)
+    {
+        const float* pSrc = pLinearRow + static_cast<size_t>(Contributors.First[x]) * 4;
+        const float* pWeights = &Contributors.Weights[static_cast<size_t>(x) * Contributors.MaxNumTaps];
+        __m128 Sum = _mm_setzero_ps();
+        for (int t = 0; t < Contributors.NumTaps[x]; ++t)
+            Sum = _mm_add_ps(Sum, _mm_mul_ps(_mm_loadu_ps(pSrc + t * 4), _mm_set1_ps(pWeights[t])));
+        _mm_storeu_ps(pDst + x * 4, Sum);
+    }
+}
+
+static void EncodeRow(const float* pLinearRow, int Width, const FColorLUTs& luts, uint8_t* pDstRow)
+{
+    const __m128  vZero = _mm_setzero_ps();
+    const __m128  vOne = _mm_set1_ps(1.0f);
+    const __m128  vScale = _mm_setr_ps(LINEAR_TO_SRGB_LUT_SIZE - 1, LINEAR_TO_SRGB_LUT_SIZE - 1, LINEAR_TO_SRGB_LUT_SIZE - 1, 255.0f);
+    const __m128  vHalf = _mm_set1_ps(0.5f);
+    const __m128  vColorMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+    alignas(16) int32_t Indices[4];
+    for (int x = 0; x < Width; ++x)
+    {
+        // un-weight the colors by alpha, then clamp the negative lobes' under/overshoots, NaNs become 0
+        const __m128 Weighted = _mm_loadu_ps(pLinearRow + x * 4);
+        const __m128 Alpha = _mm_shuffle_ps(Weighted, Weighted, _MM_SHUFFLE(3, 3, 3, 3));
+        const __m128 InvAlpha = _mm_andnot_ps(_mm_cmpeq_ps(Alpha, vZero), _mm_div_ps(vOne, Alpha));
+        const __m128 Unweighted = _mm_or_ps(_mm_and_ps(_mm_mul_ps(Weighted, InvAlpha), vColorMask), _mm_andnot_ps(vColorMask, Weighted));
+        const __m128 px = _mm_min_ps(_mm_max_ps(Unweighted, vZero), vOne);
+        _mm_store_si128(reinterpret_cast<__m128i*>(Indices), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(px, vScale), vHalf)));
+        pDstRow[x * 4 + 0] = luts.FromLinear[Indices[0]];
+        pDstRow[x * 4 + 1] = luts.FromLinear[Indices[1]];
+        pDstRow[x * 4 + 2] = luts.FromLinear[Indices[2]];
+        pDstRow[x * 4 + 3] = static_cast<uint8_t>(Indices[3]);
+    }
+}
+
+// @pDst += @pSrc * @Weight, @NumFloats is a multiple of 4
+static inline void AccumulateWeightedRow(const float* pSrc, float Weight, size_t NumFloats, float* pDst)
+{
+    const __m128 w = _mm_set1_ps(Weight);
+    for (size_t i = 0; i < NumFloats; i += 4)
+        _mm_storeu_ps(pDst + i, _mm_add_ps(_mm_loadu_ps(pDst + i), _mm_mul_ps(_mm_loadu_ps(pSrc + i), w)));
+}
+
+// Writes the destination rows [RowBegin, RowEnd). Horizontally filtered source rows are kept in a ring buffer
+// large enough for the vertical filter taps, so each source row is decoded & filtered once per band.
+static void ResizeRows(const FResizeContext& ctx, int RowBegin, int RowEnd)
+{
+    FResizeRowCache& cache = tRowCache;
+    const size_t FilteredRowSize = static_cast<size_t>(ctx.DstWidth) * 4;
+    const int NumRingRows = ctx.ContributorsY.MaxNumTaps;
+    cache.LinearRow.resize(static_cast<size_t>(ctx.SrcWidth) * 4);
+    cache.FilteredRows.resize(FilteredRowSize * NumRingRows);
+    cache.FilteredRowIndices.assign(NumRingRows, -1);
+    cache.OutputRow.resize(FilteredRowSize);
+
+    for (int y = RowBegin; y < RowEnd; ++y)
+    {
+        const int First = ctx.ContributorsY.First[y];
+        const int NumTaps = ctx.ContributorsY.NumTaps[y];
+        const float* pWeights = &ctx.ContributorsY.Weights[static_cast<size_t>(y) * ctx.ContributorsY.MaxNumTaps];
+
+        std::fill(cache.OutputRow.begin(), cache.OutputRow.end(), 0.0f);
+
+        for (int t = 0; t < NumTaps; ++t)
+        {
+            const int SrcRow = First + t;
+            const int iRing = SrcRow % NumRingRows;
+            float* pFilteredRow = &cache.FilteredRows[iRing * FilteredRowSize];
+            if (cache.FilteredRowIndices[iRing] != SrcRow)
+            {
+                DecodeRow(ctx.pSrc + static_cast<size_t>(SrcRow) * ctx.SrcWidth * 4, ctx.SrcWidth, *ctx.pLUTs, cache.LinearRow.data());
+                FilterRowHorizontal(cache.LinearRow.data(), ctx.ContributorsX, ctx.DstWidth, pFilteredRow);
+                cache.FilteredRowIndices[iRing] = SrcRow;
+            }
+
+            AccumulateWeightedRow(pFilteredRow, pWeights[t], FilteredRowSize, cache.OutputRow.data());
+        }
+
+        EncodeRow(cache.OutputRow.data(), ctx.DstWidth, *ctx.pLUTs, ctx.pDst + static_cast<size_t>(y) * ctx.DstWidth * 4);
+    }
+}
+
+static void ResizeRGBA8(const uint8_t* pSrc, int SrcWidth, int SrcHeight, uint8_t* pDst, int DstWidth, int DstHeight, ThreadPool* pThreadPool, bool bSRGB)
+{
+    // the filter tables are only read by the band tasks while this thread waits for them
+    static thread_local FResizeContext tContext;
+    FResizeContext& ctx = tContext;
+    ctx.pSrc = pSrc;
+    ctx.pDst = pDst;
+    ctx.SrcWidth = SrcWidth;
+    ctx.SrcHeight = SrcHeight;
+    ctx.DstWidth = DstWidth;
+    ctx.DstHeight = DstHeight;
+    ctx.pLUTs = &GetColorLUTs(bSRGB);
+    ctx.ContributorsX.Calculate(SrcWidth, DstWidth);
+    ctx.ContributorsY.Calculate(SrcHeight, DstHeight);
+
+    const int NumRowsPerBand = static_cast<int>(std::max<size_t>(1, NUM_PIXELS_PER_BAND / DstWidth));
+    const int NumBands = (DstHeight + NumRowsPerBand - 1) / NumRowsPerBand;
+    auto fnResizeBand = [&ctx, NumRowsPerBand](size_t iBand)
+    {
+        const int RowBegin = static_cast<int>(iBand) * NumRowsPerBand;
+        ResizeRows(ctx, RowBegin, std::min(RowBegin + NumRowsPerBand, ctx.DstHeight));
+    };
+
+    if (pThreadPool && NumBands > 1)
+    {
+        pThreadPool->ParallelFor(0, NumBands, 1, fnResizeBand);
+    }
+    else
+    {
+        for (int iBand = 0; iBand < NumBands; ++iBand)
+            fnResizeBand(iBand);
+    }
+}
+
+//
+// Streaming
+//
+// The source rows are decoded from the stream in bands & filtered horizontally into a ring buffer as they arrive,
+// then the destination rows whose source rows have all arrived are filtered vertically out of the ring buffer.
+// The ring buffer holds the rows under the vertical filter plus a band, so a band never overwrites the rows still needed.
+// RGBA32F rows are filtered as they are, without alpha weighting, the same as stbir_resize_float().
+//
+static bool ResizeStream(ImageStreamReader& Stream, uint8_t* pDst, int DstWidth, int DstHeight, ThreadPool* pThreadPool, bool bSRGB, int NumRowsPerBand)
+{
+    const FImageInfo& Info = Stream.GetInfo();
+    const bool bHDR = Info.bHDR;
+    const int SrcWidth = Info.Width;
+    const FColorLUTs& luts = GetColorLUTs(bSRGB);
+    FFilterContributors ContributorsX;
+    FFilterContributors ContributorsY;
+    ContributorsX.Calculate(SrcWidth, DstWidth);
+    ContributorsY.Calculate(Info.Height, DstHeight);
+
+    if (NumRowsPerBand <= 0)
+        NumRowsPerBand = static_cast<int>(std::max<size_t>(1, STREAM_NUM_PIXELS_PER_BAND / SrcWidth));
+    const size_t SrcRowSize = Stream.GetRowSizeInBytes();
+    const size_t DstRowSize = static_cast<size_t>(DstWidth) * (bHDR ? 16 : 4);
+    const size_t FilteredRowSize = static_cast<size_t>(DstWidth) * 4;
+    const int NumRingRows = ContributorsY.MaxNumTaps + NumRowsPerBand;
+    std::vector<uint8_t> Band(SrcRowSize * NumRowsPerBand);
+    std::vector<float> FilteredRows(FilteredRowSize * NumRingRows);
+
+    int NumSrcRowsRead = 0;
+    auto fnFilterSrcRow = [&](size_t iRow)
+    {
+        const uint8_t* pSrcRow = Band.data() + iRow * SrcRowSize;
+        float* pFilteredRow = &FilteredRows[((NumSrcRowsRead + iRow) % NumRingRows) * FilteredRowSize];
+        if (bHDR)
+        {
+            FilterRowHorizontal(reinterpret_cast<const float*>(pSrcRow), ContributorsX, DstWidth, pFilteredRow);
+            return;
+        }
+        FResizeRowCache& cache = tRowCache;
+        cache.LinearRow.resize(static_cast<size_t>(SrcWidth) * 4);
+        DecodeRow(pSrcRow, SrcWidth, luts, cache.LinearRow.data());
+        FilterRowHorizontal(cache.LinearRow.data(), ContributorsX, DstWidth, pFilteredRow);
+    };
+    auto fnFilterDstRow = [&](size_t y)
+    {
+        FResizeRowCache& cache = tRowCache;
+        cache.OutputRow.assign(FilteredRowSize, 0.0f);
+        const float* pWeights = &ContributorsY.Weights[y * ContributorsY.MaxNumTaps];
+        for (int t = 0; t < ContributorsY.NumTaps[y]; ++t)
+        {
+            const int SrcRow = ContributorsY.First[y] + t;
+            AccumulateWeightedRow(&FilteredRows[(SrcRow % NumRingRows) * FilteredRowSize], pWeights[t], FilteredRowSize, cache.OutputRow.data());
+        }
+        if (bHDR) memcpy(pDst + y * DstRowSize, cache.OutputRow.data(), DstRowSize);
+        else      EncodeRow(cache.OutputRow.data(), DstWidth, luts, pDst + y * DstRowSize);
+    };
+    auto fnRun = [pThreadPool](size_t Begin, size_t End, size_t Grain, const auto& fn)
+    {
+        if (pThreadPool && End - Begin > Grain)
+            pThreadPool->ParallelFor(Begin, End, Grain, fn);
+        else
+            for (size_t i = Begin; i < End; ++i)
+                fn(i);
+    };
+
+    int NextDstRow = 0;
+    while (NextDstRow < DstHeight)
+    {
+        const int NumRows = Stream.ReadRows(Band.data(), NumRowsPerBand);
+        if (NumRows == 0)
+            return false;
+        fnRun(0, NumRows, std::max<size_t>(1, NUM_PIXELS_PER_BAND / SrcWidth), fnFilterSrcRow);
+        NumSrcRowsRead += NumRows;
+
+        int DstRowEnd = NextDstRow;
+        while (DstRowEnd < DstHeight && ContributorsY.First[DstRowEnd] + ContributorsY.NumTaps[DstRowEnd] <= NumSrcRowsRead)
+            ++DstRowEnd;
+        fnRun(NextDstRow, DstRowEnd, std::max<size_t>(1, NUM_PIXELS_PER_BAND / DstWidth), fnFilterDstRow);
+        NextDstRow = DstRowEnd;
+    }
+    return true;
+}
+
+#if IMAGE_RUN_RESIZE_BENCHMARK
+static void RUN_IMAGE_RESIZE_BENCHMARK(ThreadPool* pThreadPool)
+{
+    constexpr int SRC_WIDTH = 3840;
+    constexpr int SRC_HEIGHT = 2160;
+    constexpr int NUM_ITERATIONS = 5;
+    struct FResolution { int Width, Height; };
+    const FResolution DstResolutions[] = { { 1920, 1080 }, { 1024, 1024 }, { 256, 144 }, { 5120, 2880 } };
+
+    std::vector<uint8_t> Src(static_cast<size_t>(SRC_WIDTH) * SRC_HEIGHT * 4);
+    std::mt19937 rng(42);
+    for (size_t i = 0; i < Src.size(); ++i)
+        Src[i] = static_cast<uint8_t>(((i / 4 % SRC_WIDTH) ^ (i / 4 / SRC_WIDTH)) + (rng() & 15)); // pattern + noise
+
+    auto fnMeasure = [&](auto&& fnRun) -> double
+    {
+        fnRun(); // warm up
+        const auto t0 = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < NUM_ITERATIONS; ++i)
+            fnRun();
+        const auto t1 = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(t1 - t0).count() / NUM_ITERATIONS;
+    };
+
+    Log::Info("Image Resize Benchmark: RGBA8 sRGB %dx%d ->", SRC_WIDTH, SRC_HEIGHT);
+    for (const FResolution& Dst : DstResolutions)
+    {
+        std::vector<uint8_t> Reference(static_cast<size_t>(Dst.Width) * Dst.Height * 4);
+        std::vector<uint8_t> Resized(Reference.size());
+        const double msReference = fnMeasure([&]() { stbir_resize_uint8_srgb(Src.data(), SRC_WIDTH, SRC_HEIGHT, 0, Reference.data(), Dst.Width, Dst.Height, 0, 4, 3, 0); });
+        const double msSerial = fnMeasure([&]() { ResizeRGBA8(Src.data(), SRC_WIDTH, SRC_HEIGHT, Resized.data(), Dst.Width, Dst.Height, nullptr, true); });
+        const double msPool = pThreadPool ? fnMeasure([&]() { ResizeRGBA8(Src.data(), SRC_WIDTH, SRC_HEIGHT, Resized.data(), Dst.Width, Dst.Height, pThreadPool, true); }) : 0.0;
+
+        int MaxDiff = 0;
+        for (size_t i = 0; i < Resized.size(); ++i)
+            MaxDiff = std::max(MaxDiff, std::abs(Resized[i] - Reference[i]));
+        Log::Info("  %4dx%-4d : stbir %8.2fms | ResizeImage %8.2fms | ResizeImage+ThreadPool %8.2fms | max diff vs stbir: %d"
+            , Dst.Width, Dst.Height, msReference, msSerial, msPool, MaxDiff
+        );
+    }
+}
+#endif
+
+bool Image::ResizeImage(const Image& img, void* pDst, unsigned TargetWidth, unsigned TargetHeight, ThreadPool* pThreadPool, bool bSRGB)
+{
+#if IMAGE_RUN_RESIZE_BENCHMARK
+    static bool sbBenchmarkRun = false;
+    if (!sbBenchmarkRun)
+    {
+        sbBenchmarkRun = true;
+        RUN_IMAGE_RESIZE_BENCHMARK(pThreadPool);
+    }
+#endif
+    assert(TargetWidth > 0 && TargetHeight > 0);
+    if (!img.IsValid() || !pDst || TargetWidth == 0 || TargetHeight == 0)
+    {
+        Log::Error("Image::ResizeImage(): invalid parameters");
+        return false;
+    }
+    if (img.GetFormat() != EImageFormat::RGBA8 && img.GetFormat() != EImageFormat::RGBA32F)
+    {
+        Log::Error("Image::ResizeImage(): only RGBA8 & RGBA32F images are supported");
+        return false;
+    }
+
+    if (img.IsHDR())
+    {
+        const int NUM_CHANNELS = 4; // RGBA
+        const int STRIDE_BYTES_INPUT = 0;
+        const int STRIDE_BYTES_OUTPUT = 0;
+        const int rc = stbir_resize_float(reinterpret_cast<const float*>(img.pData),   img.Width,   img.Height, STRIDE_BYTES_INPUT,
+                                          reinterpret_cast<      float*>(pDst)     , TargetWidth, TargetHeight, STRIDE_BYTES_OUTPUT,
+                                          NUM_CHANNELS
+        );
+        return rc > 0;
+    }
+
+    ResizeRGBA8(static_cast<const uint8_t*>(img.pData), img.Width, img.Height, static_cast<uint8_t*>(pDst), TargetWidth, TargetHeight, pThreadPool, bSRGB);
+    return true;
+}
+
+bool Image::ResizeImage(ImageStreamReader& Stream, void* pDst, unsigned TargetWidth, unsigned TargetHeight, ThreadPool* pThreadPool, bool bSRGB, int NumRowsPerBand)
+{
+    assert(TargetWidth > 0 && TargetHeight > 0);
+    if (!Stream.IsOpen() || Stream.GetNumRowsRead() != 0 || !pDst || TargetWidth == 0 || TargetHeight == 0)
+    {
+        Log::Error("Image::ResizeImage(): invalid parameters");
+        return false;
+    }
+
+    if (!ResizeStream(Stream, static_cast<uint8_t*>(pDst), TargetWidth, TargetHeight, pThreadPool, bSRGB, NumRowsPerBand))
+    {
+        Log::Error("Image::ResizeImage(): couldn't read the stream");
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,720 @@
+//	VQUtils
+//	Copyright(C) 2020 - Volkan Ilbeyli
+//
+//	This program is free software : you can redistribute it and / or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+//	Contact: volkanilbeyli@gmail.com
+
+#include "Image.h"
+#include "Multithreading/ThreadPool.h"
+#include "Log.h"
+#include "utils.h"
+
+#include "../Libs/miniz/miniz.h"
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+
+// Compares the encoders of Image::SaveToDisk() against stb_image_write, in memory, runs once on the first call.
+#define IMAGE_RUN_SAVE_BENCHMARK 0
+
+#if IMAGE_RUN_SAVE_BENCHMARK
+#include "../Libs/stb/stb_image_write.h"
+#include <chrono>
+#endif
+
+// images are encoded in horizontal strips of at least this many pixels, each strip is a task when a ThreadPool is provided.
+constexpr size_t NUM_PIXELS_PER_STRIP = 256 * 1024;
+constexpr int    DEFLATE_LEVEL = 1; // greedy parsing: several times faster than the default level, for ~10% larger files
+constexpr int    EXR_NUM_LINES_PER_BLOCK = 16; // ZIP_COMPRESSION
+
+// encoded file as a list of buffers, written in order
+using FEncodedFile = std::vector<std::vector<uint8_t>>;
+
+static void AppendU32BE(std::vector<uint8_t>& Out, uint32_t v)
+{
+    const uint8_t Bytes[4] = { uint8_t(v >> 24), uint8_t(v >> 16), uint8_t(v >> 8), uint8_t(v) };
+    Out.insert(Out.end(), Bytes, Bytes + 4);
+}
+template<class T> static void AppendLE(std::vector<uint8_t>& Out, T v)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "");
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&v); // x86/x64 only
+    Out.insert(Out.end(), p, p + sizeof(T));
+}
+static void AppendString(std::vector<uint8_t>& Out, const char* pStr, bool bNullTerminate)
+{
+    Out.insert(Out.end(), pStr, pStr + strlen(pStr) + (bNullTerminate ? 1 : 0));
+}
+
+// Splits @NumRows into strips of whole @RowAlignment-row groups, a single strip without @pThreadPool.
+static size_t CalculateNumRowsPerStrip(int Width, int NumRows, int RowAlignment, const ThreadPool* pThreadPool)
+{
+    if (!pThreadPool)
+        return NumRows;
+    const size_t NumGroupsPerStrip = std::max<size_t>(1, NUM_PIXELS_PER_STRIP / (static_cast<size_t>(Width) * RowAlignment));
+    return std::min<size_t>(NumRows, NumGroupsPerStrip * RowAlignment);
+}
+
+template<class TFunc>
+static void ForEachStrip(size_t NumStrips, ThreadPool* pThreadPool, TFunc&& fnEncodeStrip)
+{
+    if (pThreadPool && NumStrips > 1)
+    {
+        pThreadPool->ParallelFor(0, NumStrips, 1, fnEncodeStrip);
+    }
+    else
+    {
+        for (size_t i = 0; i < NumStrips; ++i)
+            fnEncodeStrip(i);
+    }
+}
+
+//
+// PNG
+//
+// Each strip is filtered & deflated independently, ending with a sync flush that byte-aligns the stream (the last one with the
+// final block), so the strips concatenate into a single zlib stream. Each strip goes into its own IDAT chunk with its own CRC,
+// the zlib header is prepended to the first strip and the Adler-32 of the stream, combined from the strips, is written in the last IDAT.
+// The back-references don't reach across the strips, costing a little compression ratio at each strip boundary.
+//
+static inline uint8_t Paeth(int a, int b, int c)
+{
+    const int p = a + b - c;
+    const int pa = std::abs(p - a);
+    const int pb = std::abs(p - b);
+    const int pc = std::abs(p - c);
+    return static_cast<uint8_t>(pa <= pb && pa <= pc ? a : (pb <= pc ? b : c));
+}
+
+// Filters a row into @pDst, returns the sum of the absolute values of the filtered bytes as signed bytes
+template<int FILTER>
+static size_t FilterPNGRow(uint8_t* pDst, const uint8_t* pRow, const uint8_t* pPrevRow, size_t RowSize, size_t bpp)
+{
+    auto fnPredict = [](int a, int b, int c) -> uint8_t
+    {
+        if constexpr (FILTER == 0) return 0;
+        if constexpr (FILTER == 1) return static_cast<uint8_t>(a);
+        if constexpr (FILTER == 2) return static_cast<uint8_t>(b);
+        if constexpr (FILTER == 3) return static_cast<uint8_t>((a + b) >> 1);
+        if constexpr (FILTER == 4) return Paeth(a, b, c);
+    };
+
+    size_t Score = 0;
+    for (size_t i = 0; i < bpp; ++i) // no left neighbours
+    {
+        pDst[i] = static_cast<uint8_t>(pRow[i] - fnPredict(0, pPrevRow[i], 0));
+        Score += std::abs(static_cast<int8_t>(pDst[i]));
+    }
+    for (size_t i = bpp; i < RowSize; ++i)
+    {
+        pDst[i] = static_cast<uint8_t>(pRow[i] - fnPredict(pRow[i - bpp], pPrevRow[i], pPrevRow[i - bpp]));
+        Score += std::abs(static_cast<int8_t>(pDst[i]));
+    }
+    return Score;
+}
+
+// Writes the filter type byte & the filtered row into @pDst, choosing the filter with the minimum sum of absolute differences.
+// @pPrevRow is a row of zeros for the first row of the image.
+static void FilterPNGRow(uint8_t* pDst, const uint8_t* pRow, const uint8_t* pPrevRow, size_t RowSize, size_t bpp, std::vector<uint8_t>& Scratch)
+{
+    using FnFilterRow = size_t(*)(uint8_t*, const uint8_t*, const uint8_t*, size_t, size_t);
+    static const FnFilterRow FILTERS[5] = { FilterPNGRow<0>, FilterPNGRow<1>, FilterPNGRow<2>, FilterPNGRow<3>, FilterPNGRow<4> };
+
+    Scratch.resize(RowSize);
+    size_t BestScore = SIZE_MAX;
+    for (int Filter = 0; Filter < 5; ++Filter)
+    {
+        const size_t Score = FILTERS[Filter](Scratch.data(), pRow, pPrevRow, RowSize, bpp);
+        if (Score < BestScore)
+        {
+            BestScore = Score;
+            pDst[0] = static_cast<uint8_t>(Filter);
+            memcpy(pDst + 1, Scratch.data(), RowSize);
+        }
+    }
+}
+
+static mz_bool AppendDeflateOutput(const void* pBuf, int Len, void* pUser)
+{
+    std::vector<uint8_t>& Out = *static_cast<std::vector<uint8_t>*>(pUser);
+    Out.insert(Out.end(), static_cast<const uint8_t*>(pBuf), static_cast<const uint8_t*>(pBuf) + Len);
+    return MZ_TRUE;
+}
+
+static void BeginPNGChunk(std::vector<uint8_t>& Out, const char* pType)
+{
+    AppendU32BE(Out, 0); // length, patched in EndPNGChunk()
+    Out.insert(Out.end(), pType, pType + 4);
+}
+static void EndPNGChunk(std::vector<uint8_t>& Out, size_t ChunkBegin)
+{
+    const size_t DataSize = Out.size() - ChunkBegin - 8;
+    for (int i = 0; i < 4; ++i)
+        Out[ChunkBegin + i] = static_cast<uint8_t>(DataSize >> (24 - 8 * i));
+    AppendU32BE(Out, static_cast<uint32_t>(mz_crc32(MZ_CRC32_INIT, &Out[ChunkBegin + 4], DataSize + 4)));
+}
+
+// zlib's adler32_combine(): Adler-32 of the concatenation of two buffers from their checksums & the length of the second
+static uint32_t CombineAdler32(uint32_t Adler1, uint32_t Adler2, size_t Len2)
+{
+    constexpr uint32_t BASE = 65521;
+    const uint32_t Rem = static_cast<uint32_t>(Len2 % BASE);
+    uint32_t Sum1 = Adler1 & 0xFFFF;
+    uint32_t Sum2 = (Rem * Sum1) % BASE;
+    Sum1 += (Adler2 & 0xFFFF) + BASE - 1;
+    Sum2 += ((Adler1 >> 16) & 0xFFFF) + ((Adler2 >> 16) & 0xFFFF) + BASE - Rem;
+    if (Sum1 >= BASE) Sum1 -= BASE;
+    if (Sum1 >= BASE) Sum1 -= BASE;
+    if (Sum2 >= (BASE << 1)) Sum2 -= (BASE << 1);
+    if (Sum2 >= BASE) Sum2 -= BASE;
+    return Sum1 | (Sum2 << 16);
+}
+
+static bool EncodePNG(const Image& img, ThreadPool* pThreadPool, FEncodedFile& File)
+{
+    static const uint8_t COLOR_TYPES[5] = { 0, 0 /*gray*/, 4 /*gray+alpha*/, 2 /*RGB*/, 6 /*RGBA*/ };
+    const int NumComponents = img.BytesPerPixel;
+    if (NumComponents < 1 || NumComponents > 4)
+    {
+        Log::Error("EncodePNG(): unsupported BytesPerPixel=%d", img.BytesPerPixel);
+        return false;
+    }
+
+    const size_t RowSize = static_cast<size_t>(img.Width) * NumComponents;
+    const size_t NumRowsPerStrip = CalculateNumRowsPerStrip(img.Width, img.Height, 1, pThreadPool);
+    const size_t NumStrips = (img.Height + NumRowsPerStrip - 1) / NumRowsPerStrip;
+    const uint8_t* pPixels = static_cast<const uint8_t*>(img.pData);
+
+    File.resize(NumStrips + 2);
+
+    std::vector<uint8_t>& Header = File.front();
+    const uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    Header.insert(Header.end(), SIGNATURE, SIGNATURE + 8);
+    BeginPNGChunk(Header, "IHDR");
+    AppendU32BE(Header, img.Width);
+    AppendU32BE(Header, img.Height);
+    const uint8_t IHDR[5] = { 8 /*bit depth*/, COLOR_TYPES[NumComponents], 0 /*deflate*/, 0 /*adaptive filtering*/, 0 /*no interlace*/ };
+    Header.insert(Header.end(), IHDR, IHDR + 5);
+    EndPNGChunk(Header, 8);
+
+    std::vector<uint32_t> StripAdlers(NumStrips, 0);
+    std::vector<size_t>   StripSizes(NumStrips, 0);
+    std::vector<char>     StripResults(NumStrips, 0);
+    const mz_uint Flags = tdefl_create_comp_flags_from_zip_params(DEFLATE_LEVEL, -MZ_DEFAULT_WINDOW_BITS, MZ_DEFAULT_STRATEGY); // raw deflate
+    ForEachStrip(NumStrips, pThreadPool, [&](size_t iStrip)
+    {
+        const size_t RowBegin = iStrip * NumRowsPerStrip;
+        const size_t RowEnd = std::min<size_t>(RowBegin + NumRowsPerStrip, img.Height);
+        const bool bLastStrip = iStrip == NumStrips - 1;
+
+        std::vector<uint8_t> Filtered((RowEnd - RowBegin) * (RowSize + 1));
+        std::vector<uint8_t> Scratch;
+        const std::vector<uint8_t> ZeroRow(RowBegin == 0 ? RowSize : 0, 0);
+        for (size_t y = RowBegin; y < RowEnd; ++y)
+        {
+            const uint8_t* pRow = pPixels + y * RowSize;
+            FilterPNGRow(&Filtered[(y - RowBegin) * (RowSize + 1)], pRow, y > 0 ? pRow - RowSize : ZeroRow.data(), RowSize, NumComponents, Scratch);
+        }
+        StripAdlers[iStrip] = static_cast<uint32_t>(mz_adler32(MZ_ADLER32_INIT, Filtered.data(), Filtered.size()));
+        StripSizes[iStrip] = Filtered.size();
+
+        std::vector<uint8_t>& Out = File[1 + iStrip];
+        Out.reserve(Filtered.size() / 2 + 64);
+        BeginPNGChunk(Out, "IDAT");
+        if (iStrip == 0)
+        {
+            Out.push_back(0x78); // zlib header: deflate, 32K window
+            Out.push_back(0x01); // FLEVEL 0 (fastest) for DEFLATE_LEVEL 1, FCHECK
+        }
+
+        tdefl_compressor* pCompressor = tdefl_compressor_alloc();
+        if (!pCompressor)
+            return;
+        tdefl_init(pCompressor, AppendDeflateOutput, &Out, static_cast<int>(Flags));
+        const tdefl_status Status = tdefl_compress_buffer(pCompressor, Filtered.data(), Filtered.size(), bLastStrip ? TDEFL_FINISH : TDEFL_SYNC_FLUSH);
+        tdefl_compressor_free(pCompressor);
+
+        EndPNGChunk(Out, 0);
+        StripResults[iStrip] = Status == (bLastStrip ? TDEFL_STATUS_DONE : TDEFL_STATUS_OKAY);
+    });
+    if (std::find(StripResults.begin(), StripResults.end(), 0) != StripResults.end())
+    {
+        Log::Error("EncodePNG(): deflate failed");
+        return false;
+    }
+
+    uint32_t Adler = MZ_ADLER32_INIT;
+    for (size_t iStrip = 0; iStrip < NumStrips; ++iStrip)
+        Adler = CombineAdler32(Adler, StripAdlers[iStrip], StripSizes[iStrip]);
+
+    std::vector<uint8_t>& Footer = File.back();
+    BeginPNGChunk(Footer, "IDAT");
+    AppendU32BE(Footer, Adler);
+    EndPNGChunk(Footer, 0);
+    const size_t IENDBegin = Footer.size();
+    BeginPNGChunk(Footer, "IEND");
+    EndPNGChunk(Footer, IENDBegin);
+    return true;
+}
+
+//
+// HDR (Radiance RGBE)
+//
+// Same scanline encoding as stbi_write_hdr(): each scanline is RLE-encoded on its own, so the strips are simply concatenated.
+//
+static void FloatToRGBE(uint8_t* pRGBE, float r, float g, float b)
+{
+    const float MaxComponent = std::max(r, std::max(g, b));
+    if (MaxComponent < 1e-32f)
+    {
+        pRGBE[0] = pRGBE[1] = pRGBE[2] = pRGBE[3] = 0;
+        return;
+    }
+    int Exponent = 0;
+    const float Normalize = static_cast<float>(frexp(MaxComponent, &Exponent)) * 256.0f / MaxComponent;
+    pRGBE[0] = static_cast<uint8_t>(std::max(r, 0.0f) * Normalize);
+    pRGBE[1] = static_cast<uint8_t>(std::max(g, 0.0f) * Normalize);
+    pRGBE[2] = static_cast<uint8_t>(std::max(b, 0.0f) * Normalize);
+    pRGBE[3] = static_cast<uint8_t>(Exponent + 128);
+}
+
+static void EncodeRGBEScanline(std::vector<uint8_t>& Out, const float* pRow, int Width, int NumComponents, std::vector<uint8_t>& Scratch)
+{
+    auto fnToRGBE = [&](int x, uint8_t* pRGBE)
+    {
+        const float* p = pRow + static_cast<size_t>(x) * NumComponents;
+        if (NumComponents >= 3) FloatToRGBE(pRGBE, p[0], p[1], p[2]);
+        else                    FloatToRGBE(pRGBE, p[0], p[0], p[0]);
+    };
+
+    // RLE isn't used for images too small or large
+    if (Width < 8 || Width >= 32768)
+    {
+        uint8_t RGBE[4];
+        for (int x = 0; x < Width; ++x)
+        {
+            fnToRGBE(x, RGBE);
+            Out.insert(Out.end(), RGBE, RGBE + 4);
+        }
+        return;
+    }
+
+    // separate the components, then RLE each
+    Scratch.resize(static_cast<size_t>(Width) * 4);
+    for (int x = 0; x < Width; ++x)
+    {
+        uint8_t RGBE[4];
+        fnToRGBE(x, RGBE);
+        for (int c = 0; c < 4; ++c)
+            Scratch[x + static_cast<size_t>(Width) * c] = RGBE[c];
+    }
+
+    const uint8_t ScanlineHeader[4] = { 2, 2, static_cast<uint8_t>(Width >> 8), static_cast<uint8_t>(Width & 0xFF) };
+    Out.insert(Out.end(), ScanlineHeader, ScanlineHeader + 4);
+    for (int c = 0; c < 4; ++c)
+    {
+        const uint8_t* pComponent = &Scratch[static_cast<size_t>(Width) * c];
+        int x = 0;
+        while (x < Width)
+        {
+            // find the next run of at least 3 bytes
+            int r = x;
+            while (r + 2 < Width && !(pComponent[r] == pComponent[r + 1] && pComponent[r] == pComponent[r + 2]))
+                ++r;
+            const bool bRun = r + 2 < Width;
+            if (!bRun)
+                r = Width;
+
+            // dump the bytes up to the run
+            while (x < r)
+            {
+                const int Len = std::min(r - x, 128);
+                Out.push_back(static_cast<uint8_t>(Len));
+                Out.insert(Out.end(), pComponent + x, pComponent + x + Len);
+                x += Len;
+            }
+
+            if (bRun)
+            {
+                while (r < Width && pComponent[r] == pComponent[x])
+                    ++r;
+                while (x < r)
+                {
+                    const int Len = std::min(r - x, 127);
+                    Out.push_back(static_cast<uint8_t>(Len + 128));
+                    Out.push_back(pComponent[x]);
+                    x += Len;
+                }
+            }
+        }
+    }
+}
+
+static bool EncodeHDR(const Image& img, ThreadPool* pThreadPool, FEncodedFile& File)
+{
+    const int NumComponents = img.BytesPerPixel / 4;
+    if (NumComponents < 1 || NumComponents > 4)
+    {
+        Log::Error("EncodeHDR(): unsupported BytesPerPixel=%d", img.BytesPerPixel);
+        return false;
+    }
+
+    const size_t NumRowsPerStrip = CalculateNumRowsPerStrip(img.Width, img.Height, 1, pThreadPool);
+    const size_t NumStrips = (img.Height + NumRowsPerStrip - 1) / NumRowsPerStrip;
+    const float* pPixels = static_cast<const float*>(img.pData);
+
+    File.resize(NumStrips + 1);
+    char Header[256];
+    snprintf(Header, sizeof(Header), "#?RADIANCE\n# Written by VQUtils\nFORMAT=32-bit_rle_rgbe\nEXPOSURE=          1.0000000000000\n\n-Y %d +X %d\n", img.Height, img.Width);
+    AppendString(File.front(), Header, false);
+
+    ForEachStrip(NumStrips, pThreadPool, [&](size_t iStrip)
+    {
+        const size_t RowBegin = iStrip * NumRowsPerStrip;
+        const size_t RowEnd = std::min<size_t>(RowBegin + NumRowsPerStrip, img.Height);
+        std::vector<uint8_t>& Out = File[1 + iStrip];
+        std::vector<uint8_t> Scratch;
+        Out.reserve((RowEnd - RowBegin) * img.Width * 4);
+        for (size_t y = RowBegin; y < RowEnd; ++y)
+            EncodeRGBEScanline(Out, pPixels + y * img.Width * NumComponents, img.Width, NumComponents, Scratch);
+    });
+    return true;
+}
+
+//
+// OpenEXR
+//
+// Single-part scanline file of FLOAT channels with ZIP_COMPRESSION: blocks of 16 scanlines, each deflated on its own,
+// so the blocks of a strip are compressed by a single task & the offset table is filled once all the strips are done.
+//
+static void AppendEXRAttribute(std::vector<uint8_t>& Out, const char* pName, const char* pType, const void* pValue, int32_t Size)
+{
+    AppendString(Out, pName, true);
+    AppendString(Out, pType, true);
+    AppendLE(Out, Size);
+    Out.insert(Out.end(), static_cast<const uint8_t*>(pValue), static_cast<const uint8_t*>(pValue) + Size);
+}
+
+// Appends the chunk of the scanline block starting at @y: int y, int DataSize, data
+static bool EncodeEXRBlock(std::vector<uint8_t>& Out, const float* pPixels, int Width, int NumComponents, int y, int NumLines, const int* pChannels, std::vector<uint8_t>& Raw, std::vector<uint8_t>& Reordered)
+{
+    // scanlines of the block, each with the channels one after another in alphabetical order
+    const size_t ChannelRowSize = static_cast<size_t>(Width) * sizeof(float);
+    Raw.resize(ChannelRowSize * NumComponents * NumLines);
+    uint8_t* pRaw = Raw.data();
+    for (int iLine = 0; iLine < NumLines; ++iLine)
+    {
+        const float* pRow = pPixels + static_cast<size_t>(y + iLine) * Width * NumComponents;
+        for (int iChannel = 0; iChannel < NumComponents; ++iChannel)
+        {
+            float* pDst = reinterpret_cast<float*>(pRaw);
+            for (int x = 0; x < Width; ++x)
+                pDst[x] = pRow[static_cast<size_t>(x) * NumComponents + pChannels[iChannel]];
+            pRaw += ChannelRowSize;
+        }
+    }
+
+    // the even bytes followed by the odd ones, then the differences of the consecutive bytes
+    const size_t RawSize = Raw.size();
+    Reordered.resize(RawSize);
+    const size_t HalfSize = (RawSize + 1) / 2;
+    for (size_t i = 0; i < RawSize; ++i)
+        Reordered[(i & 1) ? HalfSize + (i >> 1) : (i >> 1)] = Raw[i];
+    for (size_t i = RawSize - 1; i > 0; --i)
+        Reordered[i] = static_cast<uint8_t>(int(Reordered[i]) - int(Reordered[i - 1]) + (128 + 256));
+
+    const size_t ChunkBegin = Out.size();
+    AppendLE(Out, static_cast<int32_t>(y));
+    AppendLE(Out, static_cast<int32_t>(0)); // DataSize, patched below
+    const size_t DataBegin = Out.size();
+
+    mz_ulong CompressedSize = mz_compressBound(static_cast<mz_ulong>(RawSize));
+    Out.resize(DataBegin + CompressedSize);
+    if (mz_compress2(&Out[DataBegin], &CompressedSize, Reordered.data(), static_cast<mz_ulong>(RawSize), DEFLATE_LEVEL) != MZ_OK)
+        return false;
+
+    // blocks that don't compress are stored as is, the readers tell them apart from their size
+    if (CompressedSize >= RawSize)
+    {
+        memcpy(&Out[DataBegin], Raw.data(), RawSize);
+        CompressedSize = static_cast<mz_ulong>(RawSize);
+    }
+    Out.resize(DataBegin + CompressedSize);
+    const int32_t DataSize = static_cast<int32_t>(CompressedSize);
+    memcpy(&Out[ChunkBegin + 4], &DataSize, sizeof(DataSize));
+    return true;
+}
+
+static bool EncodeEXR(const Image& img, ThreadPool* pThreadPool, FEncodedFile& File)
+{
+    static const char* CHANNEL_NAMES_RGBA[4] = { "A", "B", "G", "R" };
+    static const int   CHANNELS_RGBA[4] = { 3, 2, 1, 0 };
+    static const char* CHANNEL_NAMES_RGB[3] = { "B", "G", "R" };
+    static const int   CHANNELS_RGB[3] = { 2, 1, 0 };
+    static const char* CHANNEL_NAMES_Y[1] = { "Y" };
+    static const int   CHANNELS_Y[1] = { 0 };
+
+    const int NumComponents = img.BytesPerPixel / 4;
+    if (NumComponents != 1 && NumComponents != 3 && NumComponents != 4)
+    {
+        Log::Error("EncodeEXR(): unsupported BytesPerPixel=%d", img.BytesPerPixel);
+        return false;
+    }
+    const char* const* pChannelNames = NumComponents == 4 ? CHANNEL_NAMES_RGBA : (NumComponents == 3 ? CHANNEL_NAMES_RGB : CHANNEL_NAMES_Y);
+    const int*         pChannels     = NumComponents == 4 ? CHANNELS_RGBA      : (NumComponents == 3 ? CHANNELS_RGB      : CHANNELS_Y);
+
+    const int NumBlocks = (img.Height + EXR_NUM_LINES_PER_BLOCK - 1) / EXR_NUM_LINES_PER_BLOCK;
+    const size_t NumRowsPerStrip = CalculateNumRowsPerStrip(img.Width, img.Height, EXR_NUM_LINES_PER_BLOCK, pThreadPool);
+    const size_t NumStrips = (img.Height + NumRowsPerStrip - 1) / NumRowsPerStrip;
+    const float* pPixels = static_cast<const float*>(img.pData);
+
+    // header, offset table & the blocks of each strip
+    File.resize(2 + NumStrips);
+    std::vector<uint8_t>& Header = File[0];
+    std::vector<uint8_t>& OffsetTable = File[1];
+    OffsetTable.resize(NumBlocks * sizeof(uint64_t));
+
+    AppendLE(Header, static_cast<uint32_t>(20000630)); // magic
+    AppendLE(Header, static_cast<uint32_t>(2));        // version 2, single-part scanline
+
+    std::vector<uint8_t> ChannelList;
+    for (int iChannel = 0; iChannel < NumComponents; ++iChannel)
+    {
+        AppendString(ChannelList, pChannelNames[iChannel], true);
+        AppendLE(ChannelList, static_cast<int32_t>(2)); // FLOAT
+        AppendLE(ChannelList, static_cast<uint32_t>(0)); // pLinear & reserved
+        AppendLE(ChannelList, static_cast<int32_t>(1)); // xSampling
+        AppendLE(ChannelList, static_cast<int32_t>(1)); // ySampling
+    }
+    ChannelList.push_back(0);
+
+    const uint8_t Compression = 3; // ZIP_COMPRESSION
+    const uint8_t LineOrder = 0;   // INCREASING_Y
+    const int32_t Window[4] = { 0, 0, img.Width - 1, img.Height - 1 };
+    const float   PixelAspectRatio = 1.0f;
+    const float   ScreenWindowCenter[2] = { 0.0f, 0.0f };
+    const float   ScreenWindowWidth = 1.0f;
+    AppendEXRAttribute(Header, "channels", "chlist", ChannelList.data(), static_cast<int32_t>(ChannelList.size()));
+    AppendEXRAttribute(Header, "compression", "compression", &Compression, 1);
+    AppendEXRAttribute(Header, "dataWindow", "box2i", Window, sizeof(Window));
+    AppendEXRAttribute(Header, "displayWindow", "box2i", Window, sizeof(Window));
+    AppendEXRAttribute(Header, "lineOrder", "lineOrder", &LineOrder, 1);
+    AppendEXRAttribute(Header, "pixelAspectRatio", "float", &PixelAspectRatio, sizeof(float));
+    AppendEXRAttribute(Header, "screenWindowCenter", "v2f", ScreenWindowCenter, sizeof(ScreenWindowCenter));
+    AppendEXRAttribute(Header, "screenWindowWidth", "float", &ScreenWindowWidth, sizeof(float));
+    Header.push_back(0);
+
+    std::vector<uint64_t> BlockOffsetsInStrip(NumBlocks, 0);
+    std::vector<char>     StripResults(NumStrips, 0);
+    ForEachStrip(NumStrips, pThreadPool, [&](size_t iStrip)
+    {
+        const int RowBegin = static_cast<int>(iStrip * NumRowsPerStrip);
+        const int RowEnd = std::min(static_cast<int>(RowBegin + NumRowsPerStrip), img.Height);
+        std::vector<uint8_t>& Out = File[2 + iStrip];
+        std::vector<uint8_t> Raw, Reordered;
+        bool bSucceeded = true;
+        for (int y = RowBegin; y < RowEnd && bSucceeded; y += EXR_NUM_LINES_PER_BLOCK)
+        {
+            BlockOffsetsInStrip[y / EXR_NUM_LINES_PER_BLOCK] = Out.size();
+            bSucceeded = EncodeEXRBlock(Out, pPixels, img.Width, NumComponents, y, std::min(EXR_NUM_LINES_PER_BLOCK, RowEnd - y), pChannels, Raw, Reordered);
+        }
+        StripResults[iStrip] = bSucceeded;
+    });
+    if (std::find(StripResults.begin(), StripResults.end(), 0) != StripResults.end())
+    {
+        Log::Error("EncodeEXR(): compression failed");
+        return false;
+    }
+
+    uint64_t StripOffset = Header.size() + OffsetTable.size();
+    uint64_t* pOffsets = reinterpret_cast<uint64_t*>(OffsetTable.data());
+    for (size_t iStrip = 0; iStrip < NumStrips; ++iStrip)
+    {
+        const int BlockBegin = static_cast<int>(iStrip * NumRowsPerStrip / EXR_NUM_LINES_PER_BLOCK);
+        const int BlockEnd = std::min(NumBlocks, static_cast<int>(((iStrip + 1) * NumRowsPerStrip + EXR_NUM_LINES_PER_BLOCK - 1) / EXR_NUM_LINES_PER_BLOCK)); // the last block may be partial
+        for (int iBlock = BlockBegin; iBlock < BlockEnd; ++iBlock)
+            pOffsets[iBlock] = StripOffset + BlockOffsetsInStrip[iBlock];
+        StripOffset += File[2 + iStrip].size();
+    }
+    return true;
+}
+
+//
+// Image
+//
+enum class EImageFileFormat { UNKNOWN, PNG, HDR, EXR };
+static EImageFileFormat GetImageFileFormat(const char* pFilePath)
+{
+    const std::string Extension = StrUtil::GetLowercased(DirectoryUtil::GetFileExtension(pFilePath));
+    if (Extension == "png") return EImageFileFormat::PNG;
+    if (Extension == "hdr") return EImageFileFormat::HDR;
+    if (Extension == "exr") return EImageFileFormat::EXR;
+    return EImageFileFormat::UNKNOWN;
+}
+
+static bool EncodeImage(const Image& img, EImageFileFormat Format, ThreadPool* pThreadPool, FEncodedFile& File)
+{
+    switch (Format)
+    {
+    case EImageFileFormat::PNG: return EncodePNG(img, pThreadPool, File);
+    case EImageFileFormat::HDR: return EncodeHDR(img, pThreadPool, File);
+    case EImageFileFormat::EXR: return EncodeEXR(img, pThreadPool, File);
+    default: return false;
+    }
+}
+
+#if IMAGE_RUN_SAVE_BENCHMARK
+static void RUN_IMAGE_SAVE_BENCHMARK(ThreadPool* pThreadPool)
+{
+    constexpr int WIDTH = 3840;
+    constexpr int HEIGHT = 2160;
+    constexpr int NUM_ITERATIONS = 3;
+
+    // smooth gradients with some noise, closer to a captured frame than pure noise or flat colors
+    std::vector<uint8_t> PixelsRGBA8(static_cast<size_t>(WIDTH) * HEIGHT * 4);
+    std::vector<float>   PixelsRGBA32F(PixelsRGBA8.size());
+    uint32_t Seed = 42;
+    for (int y = 0; y < HEIGHT; ++y)
+    for (int x = 0; x < WIDTH; ++x)
+    {
+        Seed = Seed * 1664525u + 1013904223u;
+        const size_t i = (static_cast<size_t>(y) * WIDTH + x) * 4;
+        const float Noise = (Seed >> 24) / 255.0f * 0.05f;
+        const float RGBA[4] = { float(x) / WIDTH + Noise, float(y) / HEIGHT, 0.5f + Noise, 1.0f };
+        for (int c = 0; c < 4; ++c)
+        {
+            PixelsRGBA32F[i + c] = RGBA[c] * 4.0f;
+            PixelsRGBA8[i + c] = static_cast<uint8_t>(std::min(RGBA[c], 1.0f) * 255.0f);
+        }
+    }
+
+    auto fnMeasure = [&](auto&& fnRun) -> double
+    {
+        fnRun(); // warm up
+        const auto t0 = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < NUM_ITERATIONS; ++i)
+            fnRun();
+        const auto t1 = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(t1 - t0).count() / NUM_ITERATIONS;
+    };
+    auto fnGetSize = [](const FEncodedFile& File) { size_t Size = 0; for (const auto& Buffer : File) Size += Buffer.size(); return Size; };
+    auto fnWriteToVector = [](void* pContext, void* pData, int Size) { auto* pOut = static_cast<std::vector<uint8_t>*>(pContext); pOut->insert(pOut->end(), (uint8_t*)pData, (uint8_t*)pData + Size); };
+
+    Log::Info("Image Save Benchmark: %dx%d, encoding in memory", WIDTH, HEIGHT);
+    for (EImageFileFormat Format : { EImageFileFormat::PNG, EImageFileFormat::HDR, EImageFileFormat::EXR })
+    {
+        Image img;
+        img.Width = WIDTH;
+        img.Height = HEIGHT;
+        img.BytesPerPixel = Format == EImageFileFormat::PNG ? 4 : 16;
+        img.pData = Format == EImageFileFormat::PNG ? static_cast<void*>(PixelsRGBA8.data()) : static_cast<void*>(PixelsRGBA32F.data());
+
+        size_t ReferenceSize = 0;
+        const double msReference = Format == EImageFileFormat::EXR ? 0.0 : fnMeasure([&]()
+        {
+            std::vector<uint8_t> Out;
+            if (Format == EImageFileFormat::PNG) stbi_write_png_to_func(fnWriteToVector, &Out, WIDTH, HEIGHT, 4, PixelsRGBA8.data(), 0);
+            else                                 stbi_write_hdr_to_func(fnWriteToVector, &Out, WIDTH, HEIGHT, 4, PixelsRGBA32F.data());
+            ReferenceSize = Out.size();
+        });
+        size_t SizeSerial = 0, SizeParallel = 0;
+        const double msSerial = fnMeasure([&]() { FEncodedFile File; EncodeImage(img, Format, nullptr, File); SizeSerial = fnGetSize(File); });
+        const double msParallel = pThreadPool ? fnMeasure([&]() { FEncodedFile File; EncodeImage(img, Format, pThreadPool, File); SizeParallel = fnGetSize(File); }) : 0.0;
+
+        const char* pFormatNames[] = { "", "PNG", "HDR", "EXR" };
+        Log::Info("  %s : stb_image_write %8.2fms (%6.2f MB) | serial %8.2fms (%6.2f MB) | ThreadPool %8.2fms (%6.2f MB)"
+            , pFormatNames[static_cast<int>(Format)]
+            , msReference, ReferenceSize / (1024.0 * 1024.0)
+            , msSerial, SizeSerial / (1024.0 * 1024.0)
+            , msParallel, SizeParallel / (1024.0 * 1024.0)
+        );
+        img.pData = nullptr; // not owned
+    }
+}
+#endif
+
+bool Image::SaveToDisk(const char* pStrPath, ThreadPool* pThreadPool) const
+{
+#if IMAGE_RUN_SAVE_BENCHMARK
+    static bool sbBenchmarkRun = false;
+    if (!sbBenchmarkRun)
+    {
+        sbBenchmarkRun = true;
+        RUN_IMAGE_SAVE_BENCHMARK(pThreadPool);
+    }
+#endif
+
+    if (this->GetSizeInBytes() == 0 || pData == nullptr)
+    {
+        Log::Warning("Image::SaveToDisk() failed: ImageSize=0 : %s", pStrPath);
+        return false;
+    }
+
+    const EImageFileFormat Format = GetImageFileFormat(pStrPath);
+    if (Format == EImageFileFormat::UNKNOWN)
+    {
+        Log::Error("Image::SaveToDisk(): unsupported file format: %s", pStrPath);
+        return false;
+    }
+    if ((Format == EImageFileFormat::PNG) == this->IsHDR())
+    {
+        Log::Error("Image::SaveToDisk(): %s image can't be saved as %s", this->IsHDR() ? "HDR" : "SDR", pStrPath);
+        return false;
+    }
+    if (this->IsHDR() && this->GetFormat() != EImageFormat::RGBA32F)
+    {
+        Log::Error("Image::SaveToDisk(): HDR images are saved from RGBA32F, see Image::CreateConvertedImage() : %s", pStrPath);
+        return false;
+    }
+
+    FEncodedFile File;
+    if (!EncodeImage(*this, Format, pThreadPool, File))
+    {
+        Log::Error("Image::SaveToDisk(): couldn't encode %s", pStrPath);
+        return false;
+    }
+
+    const std::string Folder = DirectoryUtil::GetFolderPath(pStrPath);
+    DirectoryUtil::CreateFolderIfItDoesntExist(Folder);
+
+    std::ofstream OutFile(pStrPath, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!OutFile.is_open())
+    {
+        Log::Error("Image::SaveToDisk(): couldn't open %s for writing", pStrPath);
+        return false;
+    }
+    for (const std::vector<uint8_t>& Buffer : File)
+        OutFile.write(reinterpret_cast<const char*>(Buffer.data()), Buffer.size());
+    OutFile.close();
+    if (OutFile.fail())
+    {
+        Log::Error("Image::SaveToDisk(): couldn't write %s", pStrPath);
+        return false;
+    }
+    return true;
+}
+
+std::future<bool> Image::SaveToDiskAsync(Image&& img, const char* pStrPath, ThreadPool& WorkerThreadPool)
+{
+    return WorkerThreadPool.AddTask([Owner = UniqueImage(std::move(img)), FilePath = std::string(pStrPath), pThreadPool = &WorkerThreadPool]() mutable
+    {
+        return Owner.Get().SaveToDisk(FilePath.c_str(), pThreadPool);
+    });
+}
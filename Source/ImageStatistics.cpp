@@ -0,0 +1,445 @@
+//	VQUtils
+//	Copyright(C) 2020 - Volkan Ilbeyli
+//
+//	This program is free software : you can redistribute it and / or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+//	Contact: volkanilbeyli@gmail.com
+
+#include "Image.h"
+#include "ImageStream.h"
+#include "SystemInfo.h"
+#include "Multithreading/ThreadPool.h"
+#include "Log.h"
+
+#include <immintrin.h>
+
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <cstring>
+#include <cassert>
+
+// Measures Image::CalculateStatistics() on 4K & 8K RGBA32F buffers for each SIMD level, runs once on the first call.
+#define IMAGE_RUN_STATISTICS_BENCHMARK 0
+
+using VQSystemInfo::ESIMDLevel;
+
+// https://en.wikipedia.org/wiki/Relative_luminance
+constexpr float LUMINANCE_R = 0.2126f;
+constexpr float LUMINANCE_G = 0.7152f;
+constexpr float LUMINANCE_B = 0.0722f;
+
+// Histogram bin of a luminance clamped to [HISTOGRAM_MIN_VALUE, HISTOGRAM_MAX_VALUE] is read from its bits:
+// the exponent & the top 2 mantissa bits (bits >> 21) count the quarter-powers of two, minus those of the range minimum.
+static_assert(FImageStatistics::HISTOGRAM_BINS_PER_STOP == 4, "Histogram bin calculation reads 2 mantissa bits");
+constexpr uint32_t HISTOGRAM_BIN_BITS_OFFSET = (127 + FImageStatistics::HISTOGRAM_MIN_LOG2_LUMINANCE) << 2;
+constexpr float    HISTOGRAM_MIN_VALUE = 1.0f / (1 << -FImageStatistics::HISTOGRAM_MIN_LOG2_LUMINANCE);
+constexpr float    HISTOGRAM_MAX_VALUE = 65535.99609375f; // largest float below 2^HISTOGRAM_MAX_LOG2_LUMINANCE
+static_assert(FImageStatistics::HISTOGRAM_MAX_LOG2_LUMINANCE == 16, "Update HISTOGRAM_MAX_VALUE");
+
+// images are split into blocks of rows of about this many pixels for multithreading
+constexpr size_t NUM_PIXELS_PER_BLOCK = 64 * 1024;
+
+// streamed images are read in bands of about this many pixels (16MB of RGBA32F) by default
+constexpr size_t STREAM_NUM_PIXELS_PER_BAND = 1024 * 1024;
+
+namespace
+{
+    struct FStatisticsAccumulator
+    {
+        double   LuminanceSum = 0.0;
+        float    MaxLuminance = 0.0f;
+        float    MaxChannelValue = 0.0f;
+
+        // consecutive pixels increment different histograms, which breaks up the dependency chains
+        // of the increments when neighboring pixels fall into the same bin.
+        uint32_t Histograms[4][FImageStatistics::HISTOGRAM_NUM_BINS] = {};
+    };
+    using FnAccumulatePixels = void(*)(const float* pRGBA, size_t NumPixels, FStatisticsAccumulator& acc);
+}
+
+static inline uint32_t GetHistogramBin(float ClampedLuminance)
+{
+    uint32_t Bits;
+    memcpy(&Bits, &ClampedLuminance, sizeof(Bits));
+    return (Bits >> 21) - HISTOGRAM_BIN_BITS_OFFSET;
+}
+
+// the comparisons are ordered so that NaNs are discarded the same way as the SIMD versions' max/min
+static void AccumulatePixels_Scalar(const float* pRGBA, size_t NumPixels, FStatisticsAccumulator& acc)
+{
+    float LuminanceSum = 0.0f;
+    float MaxLuminance = acc.MaxLuminance;
+    float MaxChannelValue = acc.MaxChannelValue;
+    for (size_t i = 0; i < NumPixels; ++i)
+    {
+        const float r = pRGBA[i * 4 + 0];
+        const float g = pRGBA[i * 4 + 1];
+        const float b = pRGBA[i * 4 + 2];
+
+        float lum = LUMINANCE_R * r + LUMINANCE_G * g + LUMINANCE_B * b;
+        lum = lum > 0.0f ? lum : 0.0f;
+
+        LuminanceSum += lum;
+        MaxLuminance = lum > MaxLuminance ? lum : MaxLuminance;
+        MaxChannelValue = r > MaxChannelValue ? r : MaxChannelValue;
+        MaxChannelValue = g > MaxChannelValue ? g : MaxChannelValue;
+        MaxChannelValue = b > MaxChannelValue ? b : MaxChannelValue;
+
+        float HistogramLum = lum > HISTOGRAM_MIN_VALUE ? lum : HISTOGRAM_MIN_VALUE;
+        HistogramLum = HistogramLum < HISTOGRAM_MAX_VALUE ? HistogramLum : HISTOGRAM_MAX_VALUE;
+        ++acc.Histograms[i & 3][GetHistogramBin(HistogramLum)];
+    }
+    acc.LuminanceSum += LuminanceSum;
+    acc.MaxLuminance = MaxLuminance;
+    acc.MaxChannelValue = MaxChannelValue;
+}
+
+static inline float HorizontalMax(__m128 v)
+{
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(v);
+}
+static inline float HorizontalSum(__m128 v)
+{
+    v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(v);
+}
+
+// 4 pixels per iteration, transposed from RGBA to R, G & B vectors
+static void AccumulatePixels_SSE2(const float* pRGBA, size_t NumPixels, FStatisticsAccumulator& acc)
+{
+    const __m128  vLumR = _mm_set1_ps(LUMINANCE_R);
+    const __m128  vLumG = _mm_set1_ps(LUMINANCE_G);
+    const __m128  vLumB = _mm_set1_ps(LUMINANCE_B);
+    const __m128  vZero = _mm_setzero_ps();
+    const __m128  vHistogramMin = _mm_set1_ps(HISTOGRAM_MIN_VALUE);
+    const __m128  vHistogramMax = _mm_set1_ps(HISTOGRAM_MAX_VALUE);
+    const __m128i vBinOffset = _mm_set1_epi32(HISTOGRAM_BIN_BITS_OFFSET);
+
+    __m128 vLuminanceSum = vZero;
+    __m128 vMaxLuminance = _mm_set1_ps(acc.MaxLuminance);
+    __m128 vMaxChannelValue = _mm_set1_ps(acc.MaxChannelValue);
+    alignas(16) uint32_t Bins[4];
+
+    size_t i = 0;
+    for (; i + 4 <= NumPixels; i += 4)
+    {
+        __m128 r = _mm_loadu_ps(pRGBA + i * 4 + 0);
+        __m128 g = _mm_loadu_ps(pRGBA + i * 4 + 4);
+        __m128 b = _mm_loadu_ps(pRGBA + i * 4 + 8);
+        __m128 a = _mm_loadu_ps(pRGBA + i * 4 + 12);
+        _MM_TRANSPOSE4_PS(r, g, b, a);
+
+        __m128 lum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vLumR, r), _mm_mul_ps(vLumG, g)), _mm_mul_ps(vLumB, b));
+        lum = _mm_max_ps(lum, vZero); // returns the 2nd operand for NaNs
+
+        vLuminanceSum = _mm_add_ps(vLuminanceSum, lum);
+        vMaxLuminance = _mm_max_ps(lum, vMaxLuminance);
+        vMaxChannelValue = _mm_max_ps(r, vMaxChannelValue);
+        vMaxChannelValue = _mm_max_ps(g, vMaxChannelValue);
+        vMaxChannelValue = _mm_max_ps(b, vMaxChannelValue);
+
+        const __m128 HistogramLum = _mm_min_ps(_mm_max_ps(lum, vHistogramMin), vHistogramMax);
+        _mm_store_si128(reinterpret_cast<__m128i*>(Bins), _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(HistogramLum), 21), vBinOffset));
+        ++acc.Histograms[0][Bins[0]];
+        ++acc.Histograms[1][Bins[1]];
+        ++acc.Histograms[2][Bins[2]];
+        ++acc.Histograms[3][Bins[3]];
+    }
+
+    acc.LuminanceSum += HorizontalSum(vLuminanceSum);
+    acc.MaxLuminance = HorizontalMax(vMaxLuminance);
+    acc.MaxChannelValue = HorizontalMax(vMaxChannelValue);
+    AccumulatePixels_Scalar(pRGBA + i * 4, NumPixels - i, acc);
+}
+
+// 8 pixels per iteration: each 128-bit lane is transposed separately,
+// the pixel order within the R, G & B vectors doesn't matter for the statistics.
+static void AccumulatePixels_AVX2(const float* pRGBA, size_t NumPixels, FStatisticsAccumulator& acc)
+{
+    const __m256  vLumR = _mm256_set1_ps(LUMINANCE_R);
+    const __m256  vLumG = _mm256_set1_ps(LUMINANCE_G);
+    const __m256  vLumB = _mm256_set1_ps(LUMINANCE_B);
+    const __m256  vZero = _mm256_setzero_ps();
+    const __m256  vHistogramMin = _mm256_set1_ps(HISTOGRAM_MIN_VALUE);
+    const __m256  vHistogramMax = _mm256_set1_ps(HISTOGRAM_MAX_VALUE);
+    const __m256i vBinOffset = _mm256_set1_epi32(HISTOGRAM_BIN_BITS_OFFSET);
+
+    __m256 vLuminanceSum = vZero;
+    __m256 vMaxLuminance = _mm256_set1_ps(acc.MaxLuminance);
+    __m256 vMaxChannelValue = _mm256_set1_ps(acc.MaxChannelValue);
+    alignas(32) uint32_t Bins[8];
+
+    size_t i = 0;
+    for (; i + 8 <= NumPixels; i += 8)
+    {
+        const __m256 v0 = _mm256_loadu_ps(pRGBA + i * 4 + 0);  // px0 | px1
+        const __m256 v1 = _mm256_loadu_ps(pRGBA + i * 4 + 8);  // px2 | px3
+        const __m256 v2 = _mm256_loadu_ps(pRGBA + i * 4 + 16); // px4 | px5
+        const __m256 v3 = _mm256_loadu_ps(pRGBA + i * 4 + 24); // px6 | px7
+        const __m256 t0 = _mm256_unpacklo_ps(v0, v1); // r0 r2 g0 g2 | r1 r3 g1 g3
+        const __m256 t1 = _mm256_unpackhi_ps(v0, v1); // b0 b2 a0 a2 | b1 b3 a1 a3
+        const __m256 t2 = _mm256_unpacklo_ps(v2, v3); // r4 r6 g4 g6 | r5 r7 g5 g7
+        const __m256 t3 = _mm256_unpackhi_ps(v2, v3); // b4 b6 a4 a6 | b5 b7 a5 a7
+        const __m256 r = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)); // r0 r2 r4 r6 | r1 r3 r5 r7
+        const __m256 g = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+        const __m256 b = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+
+        __m256 lum = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vLumR, r), _mm256_mul_ps(vLumG, g)), _mm256_mul_ps(vLumB, b));
+        lum = _mm256_max_ps(lum, vZero); // returns the 2nd operand for NaNs
+
+        vLuminanceSum = _mm256_add_ps(vLuminanceSum, lum);
+        vMaxLuminance = _mm256_max_ps(lum, vMaxLuminance);
+        vMaxChannelValue = _mm256_max_ps(r, vMaxChannelValue);
+        vMaxChannelValue = _mm256_max_ps(g, vMaxChannelValue);
+        vMaxChannelValue = _mm256_max_ps(b, vMaxChannelValue);
+
+        const __m256 HistogramLum = _mm256_min_ps(_mm256_max_ps(lum, vHistogramMin), vHistogramMax);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(Bins), _mm256_sub_epi32(_mm256_srli_epi32(_mm256_castps_si256(HistogramLum), 21), vBinOffset));
+        ++acc.Histograms[0][Bins[0]];
+        ++acc.Histograms[1][Bins[1]];
+        ++acc.Histograms[2][Bins[2]];
+        ++acc.Histograms[3][Bins[3]];
+        ++acc.Histograms[0][Bins[4]];
+        ++acc.Histograms[1][Bins[5]];
+        ++acc.Histograms[2][Bins[6]];
+        ++acc.Histograms[3][Bins[7]];
+    }
+
+    const __m128 vLuminanceSum4 = _mm_add_ps(_mm256_castps256_ps128(vLuminanceSum), _mm256_extractf128_ps(vLuminanceSum, 1));
+    const __m128 vMaxLuminance4 = _mm_max_ps(_mm256_castps256_ps128(vMaxLuminance), _mm256_extractf128_ps(vMaxLuminance, 1));
+    const __m128 vMaxChannelValue4 = _mm_max_ps(_mm256_castps256_ps128(vMaxChannelValue), _mm256_extractf128_ps(vMaxChannelValue, 1));
+    acc.LuminanceSum += HorizontalSum(vLuminanceSum4);
+    acc.MaxLuminance = HorizontalMax(vMaxLuminance4);
+    acc.MaxChannelValue = HorizontalMax(vMaxChannelValue4);
+    _mm256_zeroupper();
+    AccumulatePixels_Scalar(pRGBA + i * 4, NumPixels - i, acc);
+}
+
+static FnAccumulatePixels GetAccumulatePixelsFunction(ESIMDLevel SIMDLevel)
+{
+    switch (SIMDLevel)
+    {
+    case ESIMDLevel::AVX2 : return AccumulatePixels_AVX2;
+    case ESIMDLevel::SSE42:
+    case ESIMDLevel::SSE2 : return AccumulatePixels_SSE2;
+    default: break;
+    }
+    return AccumulatePixels_Scalar;
+}
+
+// Accumulates @NumRows rows of @Width pixels into @Stats & @LuminanceSum, split into blocks of rows across @pThreadPool if provided.
+// The blocks are combined in order, the results don't depend on the thread count.
+static void AccumulateRows(const float* pRGBA, int Width, int NumRows, ThreadPool* pThreadPool, FnAccumulatePixels fnAccumulatePixels
+    , std::vector<FStatisticsAccumulator>& BlockAccumulators, FImageStatistics& Stats, double& LuminanceSum)
+{
+    const size_t RowSize = static_cast<size_t>(Width);
+    const size_t NumRowsPerBlock = std::max<size_t>(1, NUM_PIXELS_PER_BLOCK / RowSize);
+    const size_t NumBlocks = (NumRows + NumRowsPerBlock - 1) / NumRowsPerBlock;
+
+    // the luminance sum is accumulated in floats for each row, and in double across the rows
+    BlockAccumulators.assign(NumBlocks, FStatisticsAccumulator());
+    auto fnAccumulateBlock = [&](size_t iBlock)
+    {
+        const size_t RowBegin = iBlock * NumRowsPerBlock;
+        const size_t RowEnd = std::min<size_t>(RowBegin + NumRowsPerBlock, NumRows);
+        for (size_t iRow = RowBegin; iRow < RowEnd; ++iRow)
+            fnAccumulatePixels(pRGBA + iRow * RowSize * 4, RowSize, BlockAccumulators[iBlock]);
+    };
+    if (pThreadPool && NumBlocks > 1)
+    {
+        pThreadPool->ParallelFor(0, NumBlocks, 1, fnAccumulateBlock);
+    }
+    else
+    {
+        for (size_t iBlock = 0; iBlock < NumBlocks; ++iBlock)
+            fnAccumulateBlock(iBlock);
+    }
+
+    for (const FStatisticsAccumulator& acc : BlockAccumulators)
+    {
+        LuminanceSum += acc.LuminanceSum;
+        Stats.MaxLuminance = std::max(Stats.MaxLuminance, acc.MaxLuminance);
+        Stats.MaxChannelValue = std::max(Stats.MaxChannelValue, acc.MaxChannelValue);
+        for (int iBin = 0; iBin < FImageStatistics::HISTOGRAM_NUM_BINS; ++iBin)
+            Stats.LuminanceHistogram[iBin] += acc.Histograms[0][iBin] + acc.Histograms[1][iBin] + acc.Histograms[2][iBin] + acc.Histograms[3][iBin];
+    }
+    Stats.NumPixels += static_cast<uint64_t>(Width) * NumRows;
+}
+
+static void FinalizeStatistics(FImageStatistics& Stats, double LuminanceSum)
+{
+    if (Stats.NumPixels == 0)
+        return;
+    Stats.AvgLuminance = static_cast<float>(LuminanceSum / Stats.NumPixels);
+    Stats.MedianLuminance = Stats.GetLuminancePercentile(0.50f);
+    Stats.P99Luminance = Stats.GetLuminancePercentile(0.99f);
+}
+
+static FImageStatistics CalculateStatistics(const float* pRGBA, int Width, int Height, ThreadPool* pThreadPool, ESIMDLevel SIMDLevel)
+{
+    FImageStatistics Stats;
+    if (!pRGBA || Width <= 0 || Height <= 0)
+        return Stats;
+
+    std::vector<FStatisticsAccumulator> BlockAccumulators;
+    double LuminanceSum = 0.0;
+    AccumulateRows(pRGBA, Width, Height, pThreadPool, GetAccumulatePixelsFunction(SIMDLevel), BlockAccumulators, Stats, LuminanceSum);
+    FinalizeStatistics(Stats, LuminanceSum);
+    return Stats;
+}
+
+#if IMAGE_RUN_STATISTICS_BENCHMARK
+static float CalculateMaxLuminance_Reference(const float* pData, int width, int height) // scalar loop Image::LoadFromFile() used before
+{
+    float MaxLuminance = 0.0f;
+    for (int h = 0; h < height; ++h)
+    for (int w = 0; w < width; ++w)
+    {
+        const int pxIndex = (w + width * h) * 4;
+        const float lum = 0.2126f * pData[pxIndex + 0] + 0.7152f * pData[pxIndex + 1] + 0.0722f * pData[pxIndex + 2];
+        if (lum > MaxLuminance)
+            MaxLuminance = lum;
+    }
+    return MaxLuminance;
+}
+
+static void RUN_IMAGE_STATISTICS_BENCHMARK(ThreadPool* pThreadPool)
+{
+    struct FResolution { const char* pName; int Width, Height; };
+    const FResolution Resolutions[] = { { "4K", 3840, 2160 }, { "8K", 7680, 4320 } };
+    constexpr int NUM_ITERATIONS = 5;
+
+    const ESIMDLevel SupportedSIMDLevel = VQSystemInfo::GetSIMDLevel();
+    const ESIMDLevel SIMDLevels[] = { ESIMDLevel::SCALAR, ESIMDLevel::SSE2, ESIMDLevel::AVX2 };
+    const char* SIMDLevelNames[] = { "Scalar", "SSE2", "AVX2" };
+
+    for (const FResolution& Resolution : Resolutions)
+    {
+        // HDR environment map-like data: mostly dim pixels with a long tail of bright ones
+        std::vector<float> Pixels(static_cast<size_t>(Resolution.Width) * Resolution.Height * 4);
+        std::mt19937 rng(42);
+        std::exponential_distribution<float> Distribution(2.0f);
+        for (size_t i = 0; i < Pixels.size(); ++i)
+            Pixels[i] = (i & 3) == 3 ? 1.0f : Distribution(rng) * Distribution(rng) * 4.0f;
+
+        const double DataSizeGB = Pixels.size() * sizeof(float) / (1024.0 * 1024.0 * 1024.0);
+        auto fnMeasure = [&](auto&& fnCalculate) -> double
+        {
+            fnCalculate(); // warm up
+            const auto t0 = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < NUM_ITERATIONS; ++i)
+                fnCalculate();
+            const auto t1 = std::chrono::high_resolution_clock::now();
+            return std::chrono::duration<double, std::milli>(t1 - t0).count() / NUM_ITERATIONS;
+        };
+
+        Log::Info("Image Statistics Benchmark: %s RGBA32F (%dx%d, %.0fMB)", Resolution.pName, Resolution.Width, Resolution.Height, DataSizeGB * 1024.0);
+        float ReferenceMaxLuminance = 0.0f;
+        const double msReference = fnMeasure([&]() { ReferenceMaxLuminance = CalculateMaxLuminance_Reference(Pixels.data(), Resolution.Width, Resolution.Height); });
+        Log::Info("  %-28s : %8.2fms  %6.2fGB/s  max=%.4f", "Reference (max lum. only)", msReference, DataSizeGB / (msReference / 1000.0), ReferenceMaxLuminance);
+
+        for (int iThreading = 0; iThreading < (pThreadPool ? 2 : 1); ++iThreading)
+        for (int iLevel = 0; iLevel < _countof(SIMDLevels); ++iLevel)
+        {
+            if (SIMDLevels[iLevel] > SupportedSIMDLevel)
+                continue;
+            ThreadPool* pPool = iThreading == 0 ? nullptr : pThreadPool;
+            FImageStatistics Stats;
+            const double ms = fnMeasure([&]() { Stats = CalculateStatistics(Pixels.data(), Resolution.Width, Resolution.Height, pPool, SIMDLevels[iLevel]); });
+
+            char Name[64];
+            sprintf_s(Name, "%s%s", SIMDLevelNames[iLevel], pPool ? " + ThreadPool" : "");
+            Log::Info("  %-28s : %8.2fms  %6.2fGB/s  max=%.4f avg=%.4f p50=%.4f p99=%.4f maxch=%.4f"
+                , Name, ms, DataSizeGB / (ms / 1000.0)
+                , Stats.MaxLuminance, Stats.AvgLuminance, Stats.MedianLuminance, Stats.P99Luminance, Stats.MaxChannelValue
+            );
+        }
+    }
+}
+#endif
+
+FImageStatistics Image::CalculateStatistics(const float* pRGBA, int Width, int Height, ThreadPool* pThreadPool)
+{
+#if IMAGE_RUN_STATISTICS_BENCHMARK
+    static bool sbBenchmarkRun = false;
+    if (!sbBenchmarkRun)
+    {
+        sbBenchmarkRun = true;
+        RUN_IMAGE_STATISTICS_BENCHMARK(pThreadPool);
+    }
+#endif
+    return ::CalculateStatistics(pRGBA, Width, Height, pThreadPool, VQSystemInfo::GetSIMDLevel());
+}
+
+FImageStatistics Image::CalculateStatistics(ImageStreamReader& Stream, ThreadPool* pThreadPool, int NumRowsPerBand)
+{
+    FImageStatistics Stats;
+    const FImageInfo& Info = Stream.GetInfo();
+    if (!Stream.IsOpen() || !Info.bHDR)
+    {
+        Log::Error("Image::CalculateStatistics(): the stream isn't an open HDR image");
+        return Stats;
+    }
+
+    if (NumRowsPerBand <= 0)
+        NumRowsPerBand = static_cast<int>(std::max<size_t>(1, STREAM_NUM_PIXELS_PER_BAND / Info.Width));
+    std::vector<float> Band(static_cast<size_t>(Info.Width) * 4 * NumRowsPerBand);
+    std::vector<FStatisticsAccumulator> BlockAccumulators;
+    const FnAccumulatePixels fnAccumulatePixels = GetAccumulatePixelsFunction(VQSystemInfo::GetSIMDLevel());
+
+    double LuminanceSum = 0.0;
+    while (const int NumRows = Stream.ReadRows(Band.data(), NumRowsPerBand))
+    {
+        AccumulateRows(Band.data(), Info.Width, NumRows, pThreadPool, fnAccumulatePixels, BlockAccumulators, Stats, LuminanceSum);
+    }
+    FinalizeStatistics(Stats, LuminanceSum);
+    return Stats;
+}
+
+float FImageStatistics::GetHistogramBinLowerBound(int iBin)
+{
+    assert(iBin >= 0 && iBin <= HISTOGRAM_NUM_BINS);
+    const uint32_t Bits = (static_cast<uint32_t>(iBin) + HISTOGRAM_BIN_BITS_OFFSET) << 21;
+    float Value;
+    memcpy(&Value, &Bits, sizeof(Value));
+    return Value;
+}
+
+float FImageStatistics::GetLuminancePercentile(float Percentile) const
+{
+    if (NumPixels == 0)
+        return 0.0f;
+
+    // interpolates linearly within the bin the percentile falls into
+    const double TargetCount = std::min(std::max(Percentile, 0.0f), 1.0f) * static_cast<double>(NumPixels);
+    uint64_t CumulativeCount = 0;
+    for (int iBin = 0; iBin < HISTOGRAM_NUM_BINS; ++iBin)
+    {
+        const uint32_t Count = LuminanceHistogram[iBin];
+        if (Count > 0 && CumulativeCount + Count >= TargetCount)
+        {
+            const float Lower = iBin == 0 ? 0.0f : GetHistogramBinLowerBound(iBin);
+            const float Upper = iBin == HISTOGRAM_NUM_BINS - 1 ? MaxLuminance : std::min(GetHistogramBinLowerBound(iBin + 1), MaxLuminance);
+            const double t = (TargetCount - CumulativeCount) / Count;
+            return static_cast<float>(Lower + (Upper - Lower) * t);
+        }
+        CumulativeCount += Count;
+    }
+    return MaxLuminance;
+}
@@ -0,0 +1,953 @@
+//	VQUtils
+//	Copyright(C) 2020 - Volkan Ilbeyli
+//
+//	This program is free software : you can redistribute it and / or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+//	Contact: volkanilbeyli@gmail.com
+
+#include "ImageStream.h"
+#include "Log.h"
+#include "utils.h"
+
+#include "../Libs/miniz/miniz.h"
+// the implementation lives here for FEXRDecoder, which decodes the chunks with tinyexr's internal DecodePixelData()
+#define TINYEXR_USE_MINIZ 0
+#define TINYEXR_IMPLEMENTATION
+#include "../Libs/tinyexr/tinyexr.h"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+
+// Compares the streaming statistics & resize passes over a generated 16K x 8K HDR panorama against loading it whole,
+// reports the peak RSS after each. Runs once on the first ImageStreamReader::Open().
+#define IMAGE_RUN_STREAM_BENCHMARK 0
+
+#if IMAGE_RUN_STREAM_BENCHMARK
+#include "Multithreading/ThreadPool.h"
+#include <chrono>
+#include <fstream>
+#ifdef _WIN32
+#ifndef VC_EXTRALEAN
+#define VC_EXTRALEAN
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+#endif
+
+struct ImageStreamReader::FDecoder
+{
+    virtual ~FDecoder() = default;
+    virtual bool   ReadRow(void* pDst) = 0; // one row of RGBA8 or RGBA32F pixels
+    virtual bool   IsStreaming() const { return true; }
+    virtual size_t GetWorkingMemorySize() const = 0;
+};
+
+namespace
+{
+    //
+    // PNG, non-interlaced: the IDAT chunks are inflated one filtered row at a time & unfiltered against the previous row.
+    // Output matches stbi_load(..., 4): 16-bit samples are truncated to their high byte, gray samples below 8 bits are
+    // scaled to [0, 255], tRNS sets the palette alphas or the alpha of the pixels matching the color key.
+    //
+    class FPNGDecoder : public ImageStreamReader::FDecoder
+    {
+    public:
+        ~FPNGDecoder() override { if (mbInflateInitialized) mz_inflateEnd(&mStream); }
+
+        // returns false if the file isn't a PNG this decoder can stream
+        bool Initialize(const unsigned char* pFile, size_t FileSize, FImageInfo& Info);
+
+        bool ReadRow(void* pDst) override;
+        size_t GetWorkingMemorySize() const override { return mRows.capacity() + sizeof(mStream) + 32 * 1024 /* inflate window */; }
+
+    private:
+        static inline uint32_t ReadU32(const unsigned char* p) { return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3]; }
+        bool FindNextIDAT(); // points the inflate input at the next IDAT chunk's data
+        void Unfilter(unsigned char* pRow, const unsigned char* pPrevRow, int FilterType) const;
+        uint32_t GetSample(const unsigned char* pRow, size_t iSample) const;
+
+        const unsigned char* mpFile = nullptr;
+        size_t mFileSize = 0;
+        size_t mNextChunkOffset = 0;
+
+        mz_stream mStream = {};
+        bool mbInflateInitialized = false;
+
+        int mWidth = 0;
+        int mBitDepth = 0;
+        int mColorType = 0;
+        int mNumSamplesPerPixel = 0;
+        size_t mRowSize = 0;      // filtered row without the filter type byte
+        size_t mFilterStride = 0; // bytes per complete pixel, at least 1
+        std::vector<unsigned char> mRows; // 2x [filter type + row]: the current & the previous row, zeros before the first row
+        int miCurrentRow = 0;
+
+        unsigned char mPalette[256][4] = {};
+        bool mbHasColorKey = false;
+        uint32_t mColorKey[3] = {};
+    };
+
+    bool FPNGDecoder::Initialize(const unsigned char* pFile, size_t FileSize, FImageInfo& Info)
+    {
+        static const unsigned char PNG_SIGNATURE[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+        if (FileSize < 8 + 25 || memcmp(pFile, PNG_SIGNATURE, 8) != 0)
+            return false;
+        mpFile = pFile;
+        mFileSize = FileSize;
+
+        int NumPaletteEntries = 0;
+        for (size_t Offset = 8; Offset + 12 <= FileSize; )
+        {
+            const uint32_t Length = ReadU32(pFile + Offset);
+            const unsigned char* pType = pFile + Offset + 4;
+            const unsigned char* pData = pFile + Offset + 8;
+            if (Length > FileSize - Offset - 12)
+                return false;
+
+            if (memcmp(pType, "IHDR", 4) == 0)
+            {
+                if (Length < 13)
+                    return false;
+                mWidth = static_cast<int>(ReadU32(pData));
+                Info.Width = mWidth;
+                Info.Height = static_cast<int>(ReadU32(pData + 4));
+                mBitDepth = pData[8];
+                mColorType = pData[9];
+                const bool bInterlaced = pData[12] != 0;
+                switch (mColorType)
+                {
+                case 0: mNumSamplesPerPixel = 1; break; // gray
+                case 2: mNumSamplesPerPixel = 3; break; // RGB
+                case 3: mNumSamplesPerPixel = 1; break; // palette
+                case 4: mNumSamplesPerPixel = 2; break; // gray + alpha
+                case 6: mNumSamplesPerPixel = 4; break; // RGBA
+                default: return false;
+                }
+                const bool bValidBitDepth = mBitDepth == 8 || (mBitDepth == 16 && mColorType != 3) || (mBitDepth < 8 && (mColorType == 0 || mColorType == 3) && (mBitDepth & (mBitDepth - 1)) == 0);
+                if (bInterlaced || !bValidBitDepth || mWidth <= 0 || Info.Height <= 0)
+                    return false;
+                Info.NumChannels = mColorType == 3 ? 3 : mNumSamplesPerPixel;
+            }
+            else if (memcmp(pType, "PLTE", 4) == 0)
+            {
+                NumPaletteEntries = std::min<int>(256, Length / 3);
+                for (int i = 0; i < NumPaletteEntries; ++i)
+                {
+                    mPalette[i][0] = pData[i * 3 + 0];
+                    mPalette[i][1] = pData[i * 3 + 1];
+                    mPalette[i][2] = pData[i * 3 + 2];
+                    mPalette[i][3] = 255;
+                }
+            }
+            else if (memcmp(pType, "tRNS", 4) == 0)
+            {
+                if (mColorType == 3)
+                {
+                    for (uint32_t i = 0; i < std::min<uint32_t>(Length, 256); ++i)
+                        mPalette[i][3] = pData[i];
+                    Info.NumChannels = 4;
+                }
+                else if ((mColorType == 0 && Length >= 2) || (mColorType == 2 && Length >= 6))
+                {
+                    mbHasColorKey = true;
+                    for (int i = 0; i < (mColorType == 0 ? 1 : 3); ++i)
+                        mColorKey[i] = (uint32_t(pData[i * 2]) << 8) | pData[i * 2 + 1];
+                    ++Info.NumChannels;
+                }
+            }
+            else if (memcmp(pType, "IDAT", 4) == 0)
+            {
+                if (mWidth == 0 || (mColorType == 3 && NumPaletteEntries == 0))
+                    return false;
+                mNextChunkOffset = Offset;
+                break;
+            }
+            Offset += 12 + Length;
+        }
+        if (mNextChunkOffset == 0)
+            return false;
+
+        const size_t NumBitsPerPixel = static_cast<size_t>(mNumSamplesPerPixel) * mBitDepth;
+        mRowSize = (NumBitsPerPixel * mWidth + 7) / 8;
+        mFilterStride = std::max<size_t>(1, NumBitsPerPixel / 8);
+        mRows.resize((mRowSize + 1) * 2);
+
+        if (mz_inflateInit(&mStream) != MZ_OK)
+            return false;
+        mbInflateInitialized = true;
+        mStream.avail_in = 0;
+
+        Info.bHDR = false;
+        Info.BytesPerPixel = 4;
+        return true;
+    }
+
+    bool FPNGDecoder::FindNextIDAT()
+    {
+        while (mNextChunkOffset + 12 <= mFileSize)
+        {
+            const uint32_t Length = ReadU32(mpFile + mNextChunkOffset);
+            const unsigned char* pType = mpFile + mNextChunkOffset + 4;
+            if (Length > mFileSize - mNextChunkOffset - 12)
+                return false;
+            const size_t DataOffset = mNextChunkOffset + 8;
+            mNextChunkOffset += 12 + Length;
+            if (memcmp(pType, "IDAT", 4) == 0)
+            {
+                mStream.next_in = mpFile + DataOffset;
+                mStream.avail_in = Length;
+                return true;
+            }
+            if (memcmp(pType, "IEND", 4) == 0)
+                return false;
+        }
+        return false;
+    }
+
+    void FPNGDecoder::Unfilter(unsigned char* pRow, const unsigned char* pPrevRow, int FilterType) const
+    {
+        const size_t bpp = mFilterStride;
+        switch (FilterType)
+        {
+        case 0: break;
+        case 1: // Sub
+            for (size_t i = bpp; i < mRowSize; ++i) pRow[i] = static_cast<unsigned char>(pRow[i] + pRow[i - bpp]);
+            break;
+        case 2: // Up
+            for (size_t i = 0; i < mRowSize; ++i) pRow[i] = static_cast<unsigned char>(pRow[i] + pPrevRow[i]);
+            break;
+        case 3: // Average
+            for (size_t i = 0; i < bpp; ++i)        pRow[i] = static_cast<unsigned char>(pRow[i] + (pPrevRow[i] >> 1));
+            for (size_t i = bpp; i < mRowSize; ++i) pRow[i] = static_cast<unsigned char>(pRow[i] + ((pRow[i - bpp] + pPrevRow[i]) >> 1));
+            break;
+        case 4: // Paeth
+            for (size_t i = 0; i < mRowSize; ++i)
+            {
+                const int a = i >= bpp ? pRow[i - bpp] : 0;
+                const int b = pPrevRow[i];
+                const int c = i >= bpp ? pPrevRow[i - bpp] : 0;
+                const int p = a + b - c;
+                const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+                pRow[i] = static_cast<unsigned char>(pRow[i] + ((pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c)));
+            }
+            break;
+        }
+    }
+
+    inline uint32_t FPNGDecoder::GetSample(const unsigned char* pRow, size_t iSample) const
+    {
+        switch (mBitDepth)
+        {
+        case 8:  return pRow[iSample];
+        case 16: return (uint32_t(pRow[iSample * 2]) << 8) | pRow[iSample * 2 + 1];
+        default:
+        {
+            const size_t iBit = iSample * mBitDepth;
+            const int Shift = 8 - mBitDepth - static_cast<int>(iBit & 7);
+            return (pRow[iBit >> 3] >> Shift) & ((1u << mBitDepth) - 1);
+        }
+        }
+    }
+
+    bool FPNGDecoder::ReadRow(void* pDst)
+    {
+        unsigned char* pFilteredRow = mRows.data() + miCurrentRow * (mRowSize + 1);
+        unsigned char* pPrevRow = mRows.data() + (miCurrentRow ^ 1) * (mRowSize + 1);
+
+        // inflate may hold decompressed bytes that didn't fit into the previous row: the next IDAT is only needed once it runs dry
+        mStream.next_out = pFilteredRow;
+        mStream.avail_out = static_cast<unsigned int>(mRowSize + 1);
+        while (mStream.avail_out > 0)
+        {
+            const bool bHasInput = mStream.avail_in > 0 || FindNextIDAT();
+            const unsigned int NumBytesRemaining = mStream.avail_out;
+            const int ret = mz_inflate(&mStream, MZ_NO_FLUSH);
+            if (ret == MZ_STREAM_END && mStream.avail_out > 0)
+                return false;
+            if (ret != MZ_OK && ret != MZ_STREAM_END && ret != MZ_BUF_ERROR)
+                return false;
+            if (!bHasInput && mStream.avail_out == NumBytesRemaining)
+                return false; // truncated
+        }
+
+        const int FilterType = pFilteredRow[0];
+        if (FilterType > 4)
+            return false;
+        Unfilter(pFilteredRow + 1, pPrevRow + 1, FilterType);
+        const unsigned char* pRow = pFilteredRow + 1;
+
+        unsigned char* pOut = static_cast<unsigned char*>(pDst);
+        const int Shift16 = mBitDepth == 16 ? 8 : 0;
+        const uint32_t GrayScale = mBitDepth < 8 ? 255 / ((1u << mBitDepth) - 1) : 1;
+        for (int x = 0; x < mWidth; ++x, pOut += 4)
+        {
+            const size_t s = static_cast<size_t>(x) * mNumSamplesPerPixel;
+            switch (mColorType)
+            {
+            case 0:
+            {
+                const uint32_t g = GetSample(pRow, s);
+                pOut[0] = pOut[1] = pOut[2] = static_cast<unsigned char>((g >> Shift16) * GrayScale);
+                pOut[3] = (mbHasColorKey && g == mColorKey[0]) ? 0 : 255;
+                break;
+            }
+            case 2:
+            {
+                const uint32_t r = GetSample(pRow, s), g = GetSample(pRow, s + 1), b = GetSample(pRow, s + 2);
+                pOut[0] = static_cast<unsigned char>(r >> Shift16);
+                pOut[1] = static_cast<unsigned char>(g >> Shift16);
+                pOut[2] = static_cast<unsigned char>(b >> Shift16);
+                pOut[3] = (mbHasColorKey && r == mColorKey[0] && g == mColorKey[1] && b == mColorKey[2]) ? 0 : 255;
+                break;
+            }
+            case 3:
+                memcpy(pOut, mPalette[GetSample(pRow, s)], 4);
+                break;
+            case 4:
+                pOut[0] = pOut[1] = pOut[2] = static_cast<unsigned char>(GetSample(pRow, s) >> Shift16);
+                pOut[3] = static_cast<unsigned char>(GetSample(pRow, s + 1) >> Shift16);
+                break;
+            case 6:
+                for (int c = 0; c < 4; ++c)
+                    pOut[c] = static_cast<unsigned char>(GetSample(pRow, s + c) >> Shift16);
+                break;
+            }
+        }
+
+        miCurrentRow ^= 1;
+        return true;
+    }
+
+
+    //
+    // Radiance HDR (RGBE): scanlines are either flat or run-length encoded per component.
+    // Output matches stbi_loadf(..., 4), alpha is 1.
+    //
+    class FRadianceHDRDecoder : public ImageStreamReader::FDecoder
+    {
+    public:
+        bool Initialize(const unsigned char* pFile, size_t FileSize, FImageInfo& Info);
+
+        bool ReadRow(void* pDst) override;
+        size_t GetWorkingMemorySize() const override { return mScanline.capacity(); }
+
+    private:
+        bool ReadLine(std::string& Line);
+
+        const unsigned char* mpFile = nullptr;
+        size_t mFileSize = 0;
+        size_t mOffset = 0;
+        int mWidth = 0;
+        bool mbFlat = false;
+        std::vector<unsigned char> mScanline; // RGBE
+    };
+
+    bool FRadianceHDRDecoder::ReadLine(std::string& Line)
+    {
+        Line.clear();
+        while (mOffset < mFileSize && mpFile[mOffset] != '\n')
+            Line += static_cast<char>(mpFile[mOffset++]);
+        if (mOffset >= mFileSize)
+            return false;
+        ++mOffset; // '\n'
+        return true;
+    }
+
+    bool FRadianceHDRDecoder::Initialize(const unsigned char* pFile, size_t FileSize, FImageInfo& Info)
+    {
+        mpFile = pFile;
+        mFileSize = FileSize;
+
+        std::string Line;
+        if (!ReadLine(Line) || (Line != "#?RADIANCE" && Line != "#?RGBE"))
+            return false;
+        bool bValidFormat = false;
+        while (ReadLine(Line) && !Line.empty())
+        {
+            if (Line == "FORMAT=32-bit_rle_rgbe")
+                bValidFormat = true;
+        }
+        if (!bValidFormat || !ReadLine(Line))
+            return false;
+
+        // only the usual top to bottom, left to right orientation, the same as stb_image
+        int Height = 0;
+        if (sscanf(Line.c_str(), "-Y %d +X %d", &Height, &mWidth) != 2 || mWidth <= 0 || Height <= 0)
+            return false;
+
+        mScanline.resize(static_cast<size_t>(mWidth) * 4);
+        mbFlat = mWidth < 8 || mWidth >= 32768;
+        Info.Width = mWidth;
+        Info.Height = Height;
+        Info.NumChannels = 3;
+        Info.BytesPerPixel = 16;
+        Info.bHDR = true;
+        return true;
+    }
+
+    bool FRadianceHDRDecoder::ReadRow(void* pDst)
+    {
+        const size_t NumScanlineBytes = mScanline.size();
+        if (!mbFlat)
+        {
+            if (mOffset + 4 > mFileSize)
+                return false;
+            const unsigned char* p = mpFile + mOffset;
+            if (p[0] != 2 || p[1] != 2 || (p[2] & 0x80))
+            {
+                mbFlat = true; // not run-length encoded: these bytes are the first pixel, the same for the rest of the file
+            }
+            else
+            {
+                if (((p[2] << 8) | p[3]) != mWidth)
+                    return false;
+                mOffset += 4;
+                for (int c = 0; c < 4; ++c)
+                {
+                    for (int x = 0; x < mWidth; )
+                    {
+                        if (mOffset >= mFileSize)
+                            return false;
+                        int Count = mpFile[mOffset++];
+                        if (Count > 128) // run
+                        {
+                            Count -= 128;
+                            if (Count > mWidth - x || mOffset >= mFileSize)
+                                return false;
+                            const unsigned char Value = mpFile[mOffset++];
+                            for (int i = 0; i < Count; ++i)
+                                mScanline[static_cast<size_t>(x++) * 4 + c] = Value;
+                        }
+                        else // literals
+                        {
+                            if (Count == 0 || Count > mWidth - x || mOffset + Count > mFileSize)
+                                return false;
+                            for (int i = 0; i < Count; ++i)
+                                mScanline[static_cast<size_t>(x++) * 4 + c] = mpFile[mOffset++];
+                        }
+                    }
+                }
+            }
+        }
+        if (mbFlat)
+        {
+            if (mOffset + NumScanlineBytes > mFileSize)
+                return false;
+            memcpy(mScanline.data(), mpFile + mOffset, NumScanlineBytes);
+            mOffset += NumScanlineBytes;
+        }
+
+        float* pOut = static_cast<float*>(pDst);
+        for (int x = 0; x < mWidth; ++x, pOut += 4)
+        {
+            const unsigned char* rgbe = &mScanline[static_cast<size_t>(x) * 4];
+            const float f = rgbe[3] ? static_cast<float>(ldexp(1.0f, rgbe[3] - (128 + 8))) : 0.0f;
+            pOut[0] = rgbe[0] * f;
+            pOut[1] = rgbe[1] * f;
+            pOut[2] = rgbe[2] * f;
+            pOut[3] = 1.0f;
+        }
+        return true;
+    }
+
+
+    //
+    // OpenEXR, single part: the header & the offset table are parsed with tinyexr, then each scanline block (1, 16 or 32
+    // rows depending on the compression) or each row of tiles is decoded with tinyexr's DecodePixelData() when its first
+    // row is read. Only the first level of mipmapped/ripmapped tiled files is read.
+    // Output matches LoadEXRFromMemory(): a single channel is splat to RGBA, otherwise the R, G, B (& A, 1 if missing)
+    // channels are picked by name.
+    //
+    class FEXRDecoder : public ImageStreamReader::FDecoder
+    {
+    public:
+        ~FEXRDecoder() override { if (mbHeaderInitialized) FreeEXRHeader(&mHeader); } // parsed or not: a failed parse may have allocated
+
+        // returns false if the file isn't an EXR this decoder can stream
+        bool Initialize(const unsigned char* pFile, size_t FileSize, FImageInfo& Info);
+
+        bool ReadRow(void* pDst) override;
+        size_t GetWorkingMemorySize() const override { return (mBand.capacity() + mChannels.capacity()) * sizeof(float) + mOffsets.capacity() * sizeof(uint64_t); }
+
+    private:
+        bool DecodeScanlineBlock(int iBlock);
+        bool DecodeTileRow(int iTileRow);
+        void ConvertToRGBA(float* pDst, int iRow, int NumPixels, size_t ChannelStride) const; // from mChannels
+
+        const unsigned char* mpFile = nullptr;
+        size_t mFileSize = 0;
+
+        EXRHeader mHeader = {};
+        bool mbHeaderInitialized = false;
+        std::vector<size_t> mChannelOffsets; // in a pixel of the file, see tinyexr::ComputeChannelLayout()
+        size_t mPixelDataSize = 0;
+        int miChannelR = -1, miChannelG = -1, miChannelB = -1, miChannelA = -1;
+
+        int mWidth = 0;
+        int mHeight = 0;
+        int mBlockWidth = 0;  // scanlines: the image width, tiles: the tile width
+        int mBlockHeight = 0; // rows per scanline block or tile
+        int mNumTilesX = 0;
+        std::vector<uint64_t> mOffsets; // file offsets of the scanline blocks or of the first level's tiles
+
+        std::vector<float> mChannels; // [channel][mBlockHeight][mBlockWidth], one decoded block or tile
+        std::vector<float> mBand;     // RGBA32F rows of the current block or row of tiles
+        int miBandFirstRow = 0;
+        int mNumBandRows = 0;
+        int miCurrentRow = 0;
+    };
+
+    bool FEXRDecoder::Initialize(const unsigned char* pFile, size_t FileSize, FImageInfo& Info)
+    {
+        EXRVersion Version;
+        if (ParseEXRVersionFromMemory(&Version, pFile, FileSize) != TINYEXR_SUCCESS || Version.multipart || Version.non_image)
+            return false;
+        InitEXRHeader(&mHeader);
+        mbHeaderInitialized = true;
+        const char* err = nullptr;
+        if (ParseEXRHeaderFromMemory(&mHeader, &Version, pFile, FileSize, &err) != TINYEXR_SUCCESS)
+        {
+            if (err)
+            {
+                Log::Error("Couldn't parse EXR header: %s", err);
+                FreeEXRErrorMessage(err);
+            }
+            return false;
+        }
+        mpFile = pFile;
+        mFileSize = FileSize;
+
+        const int64_t Width  = int64_t(mHeader.data_window.max_x) - mHeader.data_window.min_x + 1;
+        const int64_t Height = int64_t(mHeader.data_window.max_y) - mHeader.data_window.min_y + 1;
+        if (Width <= 0 || Height <= 0 || Width > TINYEXR_DIMENSION_THRESHOLD || Height > TINYEXR_DIMENSION_THRESHOLD || mHeader.num_channels <= 0)
+            return false;
+        mWidth = static_cast<int>(Width);
+        mHeight = static_cast<int>(Height);
+
+        // HALF channels are decoded to FLOAT, every decoded sample is 4 bytes
+        for (int c = 0; c < mHeader.num_channels; ++c)
+        {
+            if (mHeader.pixel_types[c] == TINYEXR_PIXELTYPE_HALF)
+                mHeader.requested_pixel_types[c] = TINYEXR_PIXELTYPE_FLOAT;
+            const char* pName = mHeader.channels[c].name;
+            if      (strcmp(pName, "R") == 0) miChannelR = c;
+            else if (strcmp(pName, "G") == 0) miChannelG = c;
+            else if (strcmp(pName, "B") == 0) miChannelB = c;
+            else if (strcmp(pName, "A") == 0) miChannelA = c;
+        }
+        if (mHeader.num_channels == 1)
+            miChannelR = miChannelG = miChannelB = miChannelA = 0;
+        else if (miChannelR < 0 || miChannelG < 0 || miChannelB < 0)
+            return false;
+
+        int PixelDataSize = 0;
+        size_t ChannelOffset = 0;
+        if (!tinyexr::ComputeChannelLayout(&mChannelOffsets, &PixelDataSize, &ChannelOffset, mHeader.num_channels, mHeader.channels))
+            return false;
+        mPixelDataSize = static_cast<size_t>(PixelDataSize);
+
+        size_t NumBlocks = 0;
+        if (mHeader.tiled)
+        {
+            if (mHeader.tile_size_x <= 0 || mHeader.tile_size_y <= 0 || mHeader.tile_size_x > TINYEXR_DIMENSION_THRESHOLD || mHeader.tile_size_y > TINYEXR_DIMENSION_THRESHOLD)
+                return false;
+            mBlockWidth = mHeader.tile_size_x;
+            mBlockHeight = mHeader.tile_size_y;
+            mNumTilesX = (mWidth + mBlockWidth - 1) / mBlockWidth;
+            NumBlocks = static_cast<size_t>(mNumTilesX) * ((mHeight + mBlockHeight - 1) / mBlockHeight); // the first level comes first in the offset table
+        }
+        else
+        {
+            switch (mHeader.compression_type)
+            {
+            case TINYEXR_COMPRESSIONTYPE_ZIP: mBlockHeight = 16; break;
+            case TINYEXR_COMPRESSIONTYPE_PIZ: mBlockHeight = 32; break;
+            case TINYEXR_COMPRESSIONTYPE_ZFP: mBlockHeight = 16; break;
+            default:                          mBlockHeight = 1; break;
+            }
+            mBlockWidth = mWidth;
+            NumBlocks = static_cast<size_t>((mHeight + mBlockHeight - 1) / mBlockHeight);
+        }
+
+        // the offset table follows the magic number, the version & the header
+        const size_t OffsetTableStart = 8 + mHeader.header_len;
+        if (OffsetTableStart > FileSize || NumBlocks > (FileSize - OffsetTableStart) / sizeof(uint64_t))
+            return false;
+        mOffsets.resize(NumBlocks);
+        for (size_t i = 0; i < NumBlocks; ++i)
+        {
+            tinyexr::tinyexr_uint64 Offset;
+            memcpy(&Offset, pFile + OffsetTableStart + i * sizeof(uint64_t), sizeof(Offset));
+            tinyexr::swap8(&Offset);
+            if (Offset >= FileSize)
+                return false; // incomplete file, tinyexr reconstructs the table by walking the chunks: not worth it here
+            mOffsets[i] = Offset;
+        }
+
+        mChannels.resize(static_cast<size_t>(mHeader.num_channels) * mBlockWidth * mBlockHeight);
+        mBand.resize(static_cast<size_t>(mWidth) * mBlockHeight * 4);
+
+        Info.Width = mWidth;
+        Info.Height = mHeight;
+        Info.BytesPerPixel = 16;
+        Info.bHDR = true;
+        return true;
+    }
+
+    void FEXRDecoder::ConvertToRGBA(float* pDst, int iRow, int NumPixels, size_t ChannelStride) const
+    {
+        const float* pRow = mChannels.data() + static_cast<size_t>(iRow) * mBlockWidth;
+        const float* pR = pRow + miChannelR * ChannelStride;
+        const float* pG = pRow + miChannelG * ChannelStride;
+        const float* pB = pRow + miChannelB * ChannelStride;
+        const float* pA = miChannelA >= 0 ? pRow + miChannelA * ChannelStride : nullptr;
+        for (int x = 0; x < NumPixels; ++x, pDst += 4)
+        {
+            pDst[0] = pR[x];
+            pDst[1] = pG[x];
+            pDst[2] = pB[x];
+            pDst[3] = pA ? pA[x] : 1.0f;
+        }
+    }
+
+    bool FEXRDecoder::DecodeScanlineBlock(int iBlock)
+    {
+        // chunk: int32 y, int32 data size, data
+        const size_t Offset = mOffsets[iBlock];
+        if (mFileSize - Offset < 8)
+            return false;
+        int LineNo, DataSize;
+        memcpy(&LineNo, mpFile + Offset, sizeof(int));
+        memcpy(&DataSize, mpFile + Offset + 4, sizeof(int));
+        tinyexr::swap4(&LineNo);
+        tinyexr::swap4(&DataSize);
+        const int iFirstRow = iBlock * mBlockHeight;
+        if (int64_t(LineNo) - mHeader.data_window.min_y != iFirstRow || DataSize <= 0 || static_cast<size_t>(DataSize) > mFileSize - Offset - 8)
+            return false;
+
+        const int NumRows = std::min(mBlockHeight, mHeight - iFirstRow);
+        std::vector<unsigned char*> ChannelPtrs(mHeader.num_channels);
+        const size_t ChannelStride = static_cast<size_t>(mBlockWidth) * mBlockHeight;
+        for (int c = 0; c < mHeader.num_channels; ++c)
+            ChannelPtrs[c] = reinterpret_cast<unsigned char*>(mChannels.data() + c * ChannelStride);
+
+        // decoded top to bottom into the block, line order only affects the order of the chunks in the file
+        if (!tinyexr::DecodePixelData(ChannelPtrs.data(), mHeader.requested_pixel_types, mpFile + Offset + 8, static_cast<size_t>(DataSize)
+            , mHeader.compression_type, /*line_order*/ 0, mWidth, NumRows, /*x_stride*/ mWidth, /*y*/ 0, /*line_no*/ 0, NumRows
+            , mPixelDataSize, static_cast<size_t>(mHeader.num_custom_attributes), mHeader.custom_attributes
+            , static_cast<size_t>(mHeader.num_channels), mHeader.channels, mChannelOffsets))
+        {
+            return false;
+        }
+
+        for (int y = 0; y < NumRows; ++y)
+            ConvertToRGBA(mBand.data() + static_cast<size_t>(y) * mWidth * 4, y, mWidth, ChannelStride);
+        miBandFirstRow = iFirstRow;
+        mNumBandRows = NumRows;
+        return true;
+    }
+
+    bool FEXRDecoder::DecodeTileRow(int iTileRow)
+    {
+        const size_t ChannelStride = static_cast<size_t>(mBlockWidth) * mBlockHeight;
+        std::vector<unsigned char*> ChannelPtrs(mHeader.num_channels);
+        for (int c = 0; c < mHeader.num_channels; ++c)
+            ChannelPtrs[c] = reinterpret_cast<unsigned char*>(mChannels.data() + c * ChannelStride);
+
+        int NumRows = 0;
+        for (int iTileX = 0; iTileX < mNumTilesX; ++iTileX)
+        {
+            // chunk: int32 tile x, tile y, level x, level y, int32 data size, data
+            const size_t Offset = mOffsets[static_cast<size_t>(iTileRow) * mNumTilesX + iTileX];
+            if (mFileSize - Offset < 20)
+                return false;
+            int TileCoords[4], DataSize;
+            memcpy(TileCoords, mpFile + Offset, sizeof(TileCoords));
+            memcpy(&DataSize, mpFile + Offset + 16, sizeof(int));
+            for (int& Coord : TileCoords)
+                tinyexr::swap4(&Coord);
+            tinyexr::swap4(&DataSize);
+            if (TileCoords[0] != iTileX || TileCoords[1] != iTileRow || TileCoords[2] != 0 || TileCoords[3] != 0
+            ||  DataSize <= 0 || static_cast<size_t>(DataSize) > mFileSize - Offset - 20)
+            {
+                return false;
+            }
+
+            int TileWidth = 0, TileHeight = 0; // clipped to the image
+            if (!tinyexr::DecodeTiledPixelData(ChannelPtrs.data(), &TileWidth, &TileHeight, mHeader.requested_pixel_types, mpFile + Offset + 20, static_cast<size_t>(DataSize)
+                , mHeader.compression_type, /*line_order*/ 0, mWidth, mHeight, iTileX, iTileRow, mBlockWidth, mBlockHeight
+                , mPixelDataSize, static_cast<size_t>(mHeader.num_custom_attributes), mHeader.custom_attributes
+                , static_cast<size_t>(mHeader.num_channels), mHeader.channels, mChannelOffsets))
+            {
+                return false;
+            }
+
+            for (int y = 0; y < TileHeight; ++y)
+                ConvertToRGBA(mBand.data() + (static_cast<size_t>(y) * mWidth + static_cast<size_t>(iTileX) * mBlockWidth) * 4, y, TileWidth, ChannelStride);
+            NumRows = TileHeight;
+        }
+        miBandFirstRow = iTileRow * mBlockHeight;
+        mNumBandRows = NumRows;
+        return true;
+    }
+
+    bool FEXRDecoder::ReadRow(void* pDst)
+    {
+        if (miCurrentRow >= miBandFirstRow + mNumBandRows)
+        {
+            const int iBlock = miCurrentRow / mBlockHeight;
+            if (!(mHeader.tiled ? DecodeTileRow(iBlock) : DecodeScanlineBlock(iBlock)))
+                return false;
+        }
+        const size_t RowSize = static_cast<size_t>(mWidth) * 4;
+        memcpy(pDst, mBand.data() + static_cast<size_t>(miCurrentRow - miBandFirstRow) * RowSize, RowSize * sizeof(float));
+        ++miCurrentRow;
+        return true;
+    }
+
+
+    //
+    // JPG, interlaced PNG & the other formats stb_image reads: the whole image is decoded up front.
+    //
+    class FWholeImageDecoder : public ImageStreamReader::FDecoder
+    {
+    public:
+        ~FWholeImageDecoder() override { mImage.Destroy(); }
+
+        bool Initialize(const unsigned char* pFile, size_t FileSize, const std::string& FilePath, FImageInfo& Info)
+        {
+            mImage = Image::LoadFromMemory(pFile, FileSize, FilePath.c_str());
+            if (!mImage.IsValid())
+                return false;
+            Info.Width = mImage.Width;
+            Info.Height = mImage.Height;
+            Info.BytesPerPixel = mImage.BytesPerPixel;
+            Info.bHDR = mImage.IsHDR();
+            return true;
+        }
+
+        bool ReadRow(void* pDst) override
+        {
+            const size_t RowSize = static_cast<size_t>(mImage.Width) * mImage.BytesPerPixel;
+            memcpy(pDst, static_cast<const unsigned char*>(mImage.pData) + mNumRowsRead++ * RowSize, RowSize);
+            return true;
+        }
+        bool   IsStreaming() const override { return false; }
+        size_t GetWorkingMemorySize() const override { return mImage.GetSizeInBytes(); }
+
+    private:
+        Image  mImage;
+        size_t mNumRowsRead = 0;
+    };
+}
+
+#if IMAGE_RUN_STREAM_BENCHMARK
+static size_t GetPeakRSS()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS Counters = {};
+    GetProcessMemoryInfo(GetCurrentProcess(), &Counters, sizeof(Counters));
+    return Counters.PeakWorkingSetSize;
+#else
+    rusage Usage = {};
+    getrusage(RUSAGE_SELF, &Usage);
+    return static_cast<size_t>(Usage.ru_maxrss) * 1024;
+#endif
+}
+
+static void RUN_IMAGE_STREAM_BENCHMARK()
+{
+    constexpr int WIDTH = 16384;
+    constexpr int HEIGHT = 8192;
+    constexpr int TARGET_WIDTH = 2048;
+    constexpr int TARGET_HEIGHT = 1024;
+
+    // written a row at a time as flat RGBE scanlines, the whole image is never in memory before the measurements
+    const std::string FilePath = DirectoryUtil::GetSpecialFolderPath(DirectoryUtil::ESpecialFolder::APPDATA) + "/VQUtils/ImageStreamBenchmark/panorama.hdr";
+    DirectoryUtil::CreateFolderIfItDoesntExist(DirectoryUtil::GetFolderPath(FilePath));
+    {
+        std::ofstream File(FilePath, std::ios::out | std::ios::binary);
+        File << "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y " << HEIGHT << " +X " << WIDTH << "\n";
+        std::vector<unsigned char> Row(static_cast<size_t>(WIDTH) * 4);
+        for (int y = 0; y < HEIGHT; ++y)
+        {
+            for (int x = 0; x < WIDTH; ++x)
+            {
+                Row[x * 4 + 0] = static_cast<unsigned char>(128 + (x & 127));
+                Row[x * 4 + 1] = static_cast<unsigned char>(128 + (y & 127));
+                Row[x * 4 + 2] = static_cast<unsigned char>(128 + ((x ^ y) & 127));
+                Row[x * 4 + 3] = static_cast<unsigned char>(128 + ((x + y) % 5));
+            }
+            File.write(reinterpret_cast<const char*>(Row.data()), Row.size());
+        }
+    }
+
+    ThreadPool Workers;
+    Workers.Initialize(ThreadPool::sHardwareThreadCount - 1, "ImageStreamBenchmark");
+    std::vector<float> Resized(static_cast<size_t>(TARGET_WIDTH) * TARGET_HEIGHT * 4);
+    using Clock = std::chrono::steady_clock;
+    auto fnElapsedMs = [](Clock::time_point t0) { return std::chrono::duration<double, std::milli>(Clock::now() - t0).count(); };
+    const size_t PeakRSSBefore = GetPeakRSS();
+
+    // the streaming passes run first: the peak RSS only grows
+    Clock::time_point t0 = Clock::now();
+    FImageStatistics StreamStats;
+    size_t WorkingMemorySize = 0;
+    {
+        ImageStreamReader Stream;
+        Stream.Open(FilePath);
+        StreamStats = Image::CalculateStatistics(Stream, &Workers);
+        Stream.Close();
+        Stream.Open(FilePath);
+        Image::ResizeImage(Stream, Resized.data(), TARGET_WIDTH, TARGET_HEIGHT, &Workers);
+        WorkingMemorySize = Stream.GetWorkingMemorySize();
+    }
+    const double msStream = fnElapsedMs(t0);
+    const size_t PeakRSSStream = GetPeakRSS();
+
+    t0 = Clock::now();
+    Image img = Image::LoadFromFile(FilePath.c_str(), &Workers);
+    const FImageStatistics WholeStats = img.CalculateStatistics(&Workers);
+    Image::ResizeImage(img, Resized.data(), TARGET_WIDTH, TARGET_HEIGHT, &Workers);
+    img.Destroy();
+    const double msWhole = fnElapsedMs(t0);
+    const size_t PeakRSSWhole = GetPeakRSS();
+    Workers.Destroy();
+
+    constexpr double MB = 1024.0 * 1024.0;
+    Log::Info("ImageStream Benchmark: %dx%d HDR -> statistics & resize to %dx%d, %d threads", WIDTH, HEIGHT, TARGET_WIDTH, TARGET_HEIGHT, static_cast<int>(ThreadPool::sHardwareThreadCount));
+    Log::Info("  streaming   : %8.2fms | peak RSS %8.1fMB (+%.1fMB) | decoder %.1fKB | max lum %.3f", msStream, PeakRSSStream / MB, (PeakRSSStream - PeakRSSBefore) / MB, WorkingMemorySize / 1024.0, StreamStats.MaxLuminance);
+    Log::Info("  whole image : %8.2fms | peak RSS %8.1fMB (+%.1fMB) | max lum %.3f", msWhole, PeakRSSWhole / MB, (PeakRSSWhole - PeakRSSBefore) / MB, WholeStats.MaxLuminance);
+}
+#endif
+
+
+ImageStreamReader::ImageStreamReader() = default;
+ImageStreamReader::~ImageStreamReader() = default;
+
+bool ImageStreamReader::Open(const std::string& FilePath)
+{
+#if IMAGE_RUN_STREAM_BENCHMARK
+    static bool sbBenchmarkRun = false;
+    if (!sbBenchmarkRun)
+    {
+        sbBenchmarkRun = true;
+        RUN_IMAGE_STREAM_BENCHMARK();
+    }
+#endif
+    Close();
+    if (!mFile.Open(FilePath))
+    {
+        Log::Error("ImageStreamReader: couldn't open file %s", FilePath.c_str());
+        return false;
+    }
+    mFilePath = FilePath;
+    return OpenDecoder(mFile.GetData(), mFile.GetSize());
+}
+
+bool ImageStreamReader::Open(const void* pFileData, size_t FileSize, const std::string& FilePath)
+{
+    Close();
+    mFilePath = FilePath;
+    return OpenDecoder(static_cast<const unsigned char*>(pFileData), FileSize);
+}
+
+bool ImageStreamReader::OpenDecoder(const unsigned char* pFileData, size_t FileSize)
+{
+    // the file info is queried from the header even if the decoder below streams the file, for the channel count
+    mInfo = Image::QueryInfo(pFileData, FileSize, mFilePath.c_str());
+
+    const std::string Extension = DirectoryUtil::GetFileExtension(mFilePath);
+    std::unique_ptr<FPNGDecoder> pPNGDecoder;
+    std::unique_ptr<FRadianceHDRDecoder> pHDRDecoder;
+    std::unique_ptr<FEXRDecoder> pEXRDecoder;
+    if (Extension == "png" && (pPNGDecoder = std::make_unique<FPNGDecoder>())->Initialize(pFileData, FileSize, mInfo))
+    {
+        mpDecoder = std::move(pPNGDecoder);
+    }
+    else if (Extension == "hdr" && (pHDRDecoder = std::make_unique<FRadianceHDRDecoder>())->Initialize(pFileData, FileSize, mInfo))
+    {
+        mpDecoder = std::move(pHDRDecoder);
+    }
+    else if (Extension == "exr")
+    {
+        if ((pEXRDecoder = std::make_unique<FEXRDecoder>())->Initialize(pFileData, FileSize, mInfo))
+            mpDecoder = std::move(pEXRDecoder);
+    }
+    else
+    {
+        std::unique_ptr<FWholeImageDecoder> pDecoder = std::make_unique<FWholeImageDecoder>();
+        if (pDecoder->Initialize(pFileData, FileSize, mFilePath, mInfo))
+            mpDecoder = std::move(pDecoder);
+    }
+
+    if (!mpDecoder)
+    {
+        Log::Error("ImageStreamReader: couldn't decode file %s", mFilePath.c_str());
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void ImageStreamReader::Close()
+{
+    mpDecoder.reset();
+    mFile.Close();
+    mInfo = FImageInfo();
+    mNumRowsRead = 0;
+    mFilePath.clear();
+}
+
+bool ImageStreamReader::IsStreaming() const
+{
+    return mpDecoder && mpDecoder->IsStreaming();
+}
+
+int ImageStreamReader::ReadRows(void* pDst, int NumRows)
+{
+    if (!mpDecoder)
+        return 0;
+
+    const size_t RowSize = GetRowSizeInBytes();
+    NumRows = std::min(NumRows, mInfo.Height - mNumRowsRead);
+    for (int iRow = 0; iRow < NumRows; ++iRow)
+    {
+        if (!mpDecoder->ReadRow(static_cast<unsigned char*>(pDst) + iRow * RowSize))
+        {
+            Log::Error("ImageStreamReader: corrupt data at row %d of %s", mNumRowsRead, mFilePath.c_str());
+            mNumRowsRead = mInfo.Height; // nothing more to read
+            return 0;
+        }
+        ++mNumRowsRead;
+    }
+    return NumRows;
+}
+
+size_t ImageStreamReader::GetWorkingMemorySize() const
+{
+    return mpDecoder ? mpDecoder->GetWorkingMemorySize() : 0;
+}
@@ -17,12 +17,26 @@
 //	Contact: volkanilbeyli@gmail.com
 
 #include "Log.h"
+#include "LogFileSink.h"
 #include "utils.h"
+#include "Timer.h"
 
 #include <fstream>
 #include <iostream>
 #include <algorithm>
 #include <cassert>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <cstring>
+#include <unordered_set>
+#include <unordered_map>
+#include <iterator>
+#include <sstream>
+#include <iomanip>
 
 #include <fcntl.h>
 #include <io.h>
@@ -41,6 +55,18 @@
 // Calls error/warning/info with "Test" right after initialization
 #define LOG_RUN_UNIT_TEST 0
 
+// Measures Log::Info() call latency from multiple threads, sync vs async
+#define LOG_RUN_BENCHMARK 0
+
+// Measures the cost of the calls dropped by the runtime thresholds & the compile-time stripping
+#define LOG_RUN_FILTER_BENCHMARK 0
+
+// Measures the time per timestamp of TimestampFormatter vs localtime + stringstream
+#define LOG_RUN_TIMESTAMP_BENCHMARK 0
+
+// Measures the log file write throughput & latency, std::ofstream vs memory-mapped (writes temporary files next to the log file)
+#define LOG_RUN_FILE_SINK_BENCHMARK 0
+
 #define MAX_CONSOLE_LINES 500
 
 namespace Log
@@ -48,7 +74,739 @@ namespace Log
 using namespace std;
 
 constexpr const char* VQ_DEFAULT_LOGFILE_NAME = "VQLog.txt";
-static std::ofstream sOutFile;
+static LogFileSink   sLogFile;
+static FLogFileSettings sLogFileSettings;
+static std::mutex    sSinkMutex; // keeps the lines written by different threads from interleaving
+static bool          sbBinaryLogFile = false;
+static std::unordered_set<const char*> sBinaryLogFormatStrings; // format strings written into the binary log file, guarded by sSinkMutex, re-written on rotation
+static std::atomic<unsigned> sMode = Mode::CONSOLE; // the console is written to until Initialize()
+
+static const char* RECORD_TYPE_TAGS[] = { "   [INFO]\t: ", "  [WARNING]\t: ", "  [ERROR]\t: " };
+
+static std::atomic<bool> sbTimestampMicroseconds = false;
+
+static inline int64_t GetTimestamp() { return TimestampFormatter::Now().time_since_epoch().count(); }
+
+static void AppendLine(std::string& out, ERecordType Type, int64_t Timestamp, std::string_view s)
+{
+	const TimeStamp Time = TimeStamp(std::chrono::system_clock::duration(Timestamp));
+	out += '[';
+	out += TimestampFormatter::GetThreadLocal().Format(Time, sbTimestampMicroseconds.load(std::memory_order_relaxed));
+	out += ']';
+	out += RECORD_TYPE_TAGS[Type];
+	out += s;
+	out += '\n';
+}
+
+//
+// binary log file chunks, see LogRecord.h
+//
+template<class T> static inline void AppendBytes(std::string& out, const T& value) { out.append(reinterpret_cast<const char*>(&value), sizeof(T)); }
+static void AppendBinaryRecord(std::string& out, int64_t Timestamp, ERecordType Type, bool bDeferred, std::string_view Payload)
+{
+	out += static_cast<char>(CHUNK_RECORD);
+	AppendBytes(out, Timestamp);
+	out += static_cast<char>(Type);
+	out += static_cast<char>(bDeferred ? 1 : 0);
+	AppendBytes(out, static_cast<uint32_t>(Payload.size()));
+	out += Payload;
+}
+static void AppendBinaryText(std::string& out, std::string_view s)
+{
+	out += static_cast<char>(CHUNK_TEXT);
+	AppendBytes(out, static_cast<uint32_t>(s.size()));
+	out += s;
+}
+static void AppendBinaryFormatString(std::string& out, const char* format)
+{
+	const uint32_t Length = static_cast<uint32_t>(strlen(format));
+	out += static_cast<char>(CHUNK_FORMAT_STRING);
+	AppendBytes(out, reinterpret_cast<uint64_t>(format));
+	AppendBytes(out, Length);
+	out.append(format, Length);
+}
+
+// @Binary is written into the log file instead of @Text if the log file is binary, preceded by the @pFormats its deferred
+// records use that aren't in the file yet: a format string only counts as written once it's actually in the file
+static void WriteToSinks(const std::string& Text, const std::string& Binary, const std::vector<const char*>* pFormats = nullptr)
+{
+	const unsigned mode = sMode.load(std::memory_order_relaxed);
+	std::lock_guard<std::mutex> lk(sSinkMutex);
+	OutputDebugString(Text.c_str());				// vs
+	if ((mode & Mode::FILE) && sLogFile.IsOpen())	// file
+	{
+		std::string FormatChunks;
+		if (sbBinaryLogFile && pFormats)
+		{
+			for (const char* pFormat : *pFormats)
+				if (sBinaryLogFormatStrings.insert(pFormat).second)
+					AppendBinaryFormatString(FormatChunks, pFormat);
+		}
+		if (!FormatChunks.empty())
+			sLogFile.Write(FormatChunks + Binary);
+		else
+			sLogFile.Write(sbBinaryLogFile ? Binary : Text);
+	}
+	if (mode & Mode::CONSOLE)						// console
+		cout << Text;
+}
+
+//---------------------------------------------------------------------------------------------
+// Categories
+//---------------------------------------------------------------------------------------------
+static std::mutex                sCategoryMutex;
+static std::vector<std::string>  sCategoryNames = { "Default" }; // indexed by CategoryID, guarded by sCategoryMutex
+static ELogLevel                 sDefaultLevel = LOG_LEVEL_INFO; // level of the categories registered later on, guarded by sCategoryMutex
+
+static CategoryID FindOrRegisterCategory(const char* pName) // assumes sCategoryMutex is locked
+{
+	for (size_t i = 0; i < sCategoryNames.size(); ++i)
+		if (sCategoryNames[i] == pName)
+			return static_cast<CategoryID>(i);
+
+	if (sCategoryNames.size() == MAX_NUM_CATEGORIES)
+		return CATEGORY_DEFAULT;
+
+	const CategoryID ID = static_cast<CategoryID>(sCategoryNames.size());
+	sCategoryNames.push_back(pName);
+	sCategoryLevels[ID].store(sDefaultLevel, std::memory_order_relaxed);
+	return ID;
+}
+
+CategoryID RegisterCategory(const char* pName)
+{
+	CategoryID ID = CATEGORY_DEFAULT;
+	{
+		std::lock_guard<std::mutex> lk(sCategoryMutex);
+		ID = FindOrRegisterCategory(pName);
+	}
+	if (ID == CATEGORY_DEFAULT && strcmp(pName, "Default") != 0)
+		Log::Warning("[Log] Too many log categories (%d), %s uses the default category", (int)MAX_NUM_CATEGORIES, pName);
+	return ID;
+}
+
+void SetLevel(ELogLevel Level)
+{
+	std::lock_guard<std::mutex> lk(sCategoryMutex);
+	sDefaultLevel = Level;
+	for (size_t i = 0; i < MAX_NUM_CATEGORIES; ++i)
+		sCategoryLevels[i].store(Level, std::memory_order_relaxed);
+}
+
+void SetCategoryLevel(const char* pName, ELogLevel Level)
+{
+	const CategoryID ID = RegisterCategory(pName);
+	sCategoryLevels[ID].store(Level, std::memory_order_relaxed);
+}
+
+void SetMode(Mode mode) { sMode.store(mode, std::memory_order_relaxed); }
+void SetTimestampMicroseconds(bool bEnabled) { sbTimestampMicroseconds.store(bEnabled, std::memory_order_relaxed); }
+Mode GetMode() { return static_cast<Mode>(sMode.load(std::memory_order_relaxed)); }
+
+//---------------------------------------------------------------------------------------------
+// Async logging
+//---------------------------------------------------------------------------------------------
+struct FRecordHeader
+{
+	int64_t  Timestamp;      // std::chrono::system_clock ticks, taken on the logging thread
+	uint32_t MessageLength;
+	uint8_t  Type;           // ERecordType
+	uint8_t  bDeferred;      // message is a format string address followed by the encoded arguments
+};
+static_assert(sizeof(FRecordHeader) == 16, "FRecordHeader size is used as the record alignment");
+
+static inline size_t AlignRecordSize(size_t NumBytes) { return (NumBytes + sizeof(FRecordHeader) - 1) & ~(sizeof(FRecordHeader) - 1); }
+
+//
+// Single producer (the logging thread) single consumer (the logger thread) ring buffer of
+// variable sized records. A record is never split: if it doesn't fit into the tail of the
+// buffer, the tail is marked as padding and the record is written at the beginning.
+//
+class ThreadLogBuffer
+{
+public:
+	ThreadLogBuffer(size_t Capacity) : mpData(new unsigned char[Capacity]), mCapacity(Capacity), mMask(Capacity - 1) { assert((Capacity & mMask) == 0); }
+	~ThreadLogBuffer() { delete[] mpData; }
+
+	// messages that could occupy more than a quarter of the buffer are logged synchronously
+	inline size_t GetMaxMessageLength() const { return mCapacity / 4 - sizeof(FRecordHeader); }
+
+	// producer: writes a record with the message @Prefix + @Message, returns false if the buffer is full.
+	// @bCrossedHalfCapacity is set if the buffer became half full with this write.
+	bool TryWrite(ERecordType Type, bool bDeferred, int64_t Timestamp, std::string_view Prefix, std::string_view Message, bool& bCrossedHalfCapacity);
+
+	// consumer: calls @fnVisit(const FRecordHeader&, const char* pMessage) for the published records and
+	// returns the read position past them. The records stay valid until the read position is Release()d.
+	template<class TFunc> uint64_t Peek(TFunc&& fnVisit) const;
+	inline void Release(uint64_t ReadPos) { mReadPos.store(ReadPos, std::memory_order_release); }
+
+	std::atomic<bool> bRetired = false; // set when the owner thread exits
+
+private:
+	unsigned char* mpData;
+	size_t         mCapacity;
+	size_t         mMask;
+	alignas(64) std::atomic<uint64_t> mWritePos = 0;
+	alignas(64) std::atomic<uint64_t> mReadPos = 0;
+};
+
+bool ThreadLogBuffer::TryWrite(ERecordType Type, bool bDeferred, int64_t Timestamp, std::string_view Prefix, std::string_view Message, bool& bCrossedHalfCapacity)
+{
+	const size_t MessageLength = Prefix.size() + Message.size();
+	const size_t RecordSize = AlignRecordSize(sizeof(FRecordHeader) + MessageLength);
+	const uint64_t w = mWritePos.load(std::memory_order_relaxed);
+	const uint64_t r = mReadPos.load(std::memory_order_acquire);
+	const size_t Offset = static_cast<size_t>(w & mMask);
+	const size_t NumContiguousBytes = mCapacity - Offset;
+	const size_t NumRequiredBytes = RecordSize <= NumContiguousBytes ? RecordSize : NumContiguousBytes + RecordSize;
+	if (mCapacity - (w - r) < NumRequiredBytes)
+		return false;
+
+	uint64_t WritePos = w;
+	if (RecordSize > NumContiguousBytes)
+	{
+		reinterpret_cast<FRecordHeader*>(&mpData[Offset])->Type = RECORD_PADDING;
+		WritePos += NumContiguousBytes;
+	}
+
+	FRecordHeader* pHeader = reinterpret_cast<FRecordHeader*>(&mpData[WritePos & mMask]);
+	pHeader->Timestamp = Timestamp;
+	pHeader->MessageLength = static_cast<uint32_t>(MessageLength);
+	pHeader->Type = Type;
+	pHeader->bDeferred = bDeferred ? 1 : 0;
+	char* pMessage = reinterpret_cast<char*>(pHeader + 1);
+	if (!Prefix.empty())
+		memcpy(pMessage, Prefix.data(), Prefix.size());
+	memcpy(pMessage + Prefix.size(), Message.data(), Message.size());
+	mWritePos.store(WritePos + RecordSize, std::memory_order_release);
+
+	const uint64_t HalfCapacity = mCapacity / 2;
+	bCrossedHalfCapacity = (w - r) < HalfCapacity && (WritePos + RecordSize - r) >= HalfCapacity;
+	return true;
+}
+
+template<class TFunc>
+uint64_t ThreadLogBuffer::Peek(TFunc&& fnVisit) const
+{
+	uint64_t r = mReadPos.load(std::memory_order_relaxed);
+	const uint64_t w = mWritePos.load(std::memory_order_acquire);
+	while (r != w)
+	{
+		const FRecordHeader* pHeader = reinterpret_cast<const FRecordHeader*>(&mpData[r & mMask]);
+		if (pHeader->Type == RECORD_PADDING)
+		{
+			r += mCapacity - (r & mMask);
+			continue;
+		}
+		fnVisit(*pHeader, reinterpret_cast<const char*>(pHeader + 1));
+		r += AlignRecordSize(sizeof(FRecordHeader) + pHeader->MessageLength);
+	}
+	return r;
+}
+
+// buffers are owned by the registry, the exiting threads only mark theirs as retired
+// and the logger thread frees them once they're drained.
+// Messages logged from thread_local destructors that run after the holder's are written synchronously:
+// the trivially destructible flag stays readable until the thread is gone.
+static thread_local bool tbThreadLogBufferDestroyed = false;
+struct FThreadLogBufferHolder
+{
+	~FThreadLogBufferHolder()
+	{
+		if (pBuffer)
+			pBuffer->bRetired.store(true, std::memory_order_release);
+		pBuffer = nullptr;
+		tbThreadLogBufferDestroyed = true;
+	}
+	ThreadLogBuffer* pBuffer = nullptr;
+};
+static thread_local FThreadLogBufferHolder tThreadLogBuffer;
+static std::mutex                      sThreadLogBuffersMutex;
+static std::vector<ThreadLogBuffer*>   sThreadLogBuffers;
+
+static FAsyncSettings          sAsyncSettings;
+static std::atomic<bool>       sbAsync = false;
+static std::thread             sLoggerThread;
+static std::mutex              sLoggerMutex;
+static std::condition_variable sLoggerSignal; // wakes up the logger thread
+static std::condition_variable sFlushSignal;  // signaled by the logger thread when a flush request completes
+static bool                    sbLoggerWakeRequested = false; // guarded by sLoggerMutex
+static bool                    sbStopLogger = false;          // guarded by sLoggerMutex
+static uint64_t                sNumFlushRequests = 0;         // guarded by sLoggerMutex
+static uint64_t                sNumFlushesCompleted = 0;      // guarded by sLoggerMutex
+static std::atomic<size_t>     sNumDroppedMessages = 0;
+static std::atomic<size_t>     sNumUnreportedDroppedMessages = 0;
+
+// returns nullptr once the thread's holder is destroyed
+static ThreadLogBuffer* GetThreadLogBuffer()
+{
+	if (tbThreadLogBufferDestroyed)
+		return nullptr;
+
+	ThreadLogBuffer*& pBuffer = tThreadLogBuffer.pBuffer;
+	if (!pBuffer)
+	{
+		pBuffer = new ThreadLogBuffer(sAsyncSettings.ThreadBufferSize);
+		std::lock_guard<std::mutex> lk(sThreadLogBuffersMutex);
+		sThreadLogBuffers.push_back(pBuffer);
+	}
+	return pBuffer;
+}
+
+static void WakeLogger()
+{
+	{
+		std::lock_guard<std::mutex> lk(sLoggerMutex);
+		sbLoggerWakeRequested = true;
+	}
+	sLoggerSignal.notify_one();
+}
+
+// returns false if the message should be written synchronously instead
+static bool TryWriteAsync(ERecordType Type, bool bDeferred, std::string_view Prefix, std::string_view s)
+{
+	ThreadLogBuffer* pBuffer = GetThreadLogBuffer();
+	if (!pBuffer)
+		return false;
+	if (Prefix.size() + s.size() > pBuffer->GetMaxMessageLength())
+		return false;
+
+	const int64_t Timestamp = GetTimestamp();
+	bool bWakeLogger = false;
+	while (!pBuffer->TryWrite(Type, bDeferred, Timestamp, Prefix, s, bWakeLogger))
+	{
+		switch (sAsyncSettings.OverflowPolicy)
+		{
+		case EOverflowPolicy::COUNT:
+			sNumUnreportedDroppedMessages.fetch_add(1, std::memory_order_relaxed);
+			[[fallthrough]];
+		case EOverflowPolicy::DROP:
+			sNumDroppedMessages.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		case EOverflowPolicy::BLOCK:
+			if (!sbAsync.load(std::memory_order_acquire))
+				return false; // logger is stopping, nobody is going to make room
+			WakeLogger();
+			std::this_thread::yield();
+			break;
+		}
+	}
+
+	if (bWakeLogger)
+		WakeLogger();
+	return true;
+}
+
+struct FPendingRecord
+{
+	int64_t          Timestamp;
+	ERecordType      Type;
+	bool             bDeferred;
+	std::string_view Message;
+};
+struct FLoggerContext
+{
+	std::vector<ThreadLogBuffer*> Buffers;
+	std::vector<uint64_t>         ReadPositions;
+	std::vector<bool>             bBuffersRetired;
+	std::vector<FPendingRecord>   Records;
+	std::string                   Batch;
+	std::string                   BinaryBatch;
+	std::vector<const char*>      BinaryBatchFormats; // of the deferred records in BinaryBatch
+	std::string                   DeferredMessage;
+};
+
+// the payload of a deferred record starts with the format string address
+static inline const char* GetDeferredFormat(std::string_view Payload)
+{
+	uint64_t Address = 0;
+	memcpy(&Address, Payload.data(), sizeof(Address));
+	return reinterpret_cast<const char*>(Address);
+}
+
+// writes out the records of all the thread buffers in a single batch, ordered by their timestamps
+static void DrainThreadLogBuffers(FLoggerContext& ctx)
+{
+	{
+		std::lock_guard<std::mutex> lk(sThreadLogBuffersMutex);
+		ctx.Buffers = sThreadLogBuffers;
+	}
+	const size_t NumBuffers = ctx.Buffers.size();
+	ctx.ReadPositions.resize(NumBuffers);
+	ctx.bBuffersRetired.resize(NumBuffers);
+	ctx.Records.clear();
+	for (size_t i = 0; i < NumBuffers; ++i)
+	{
+		// a retired buffer is read after its owner's last write, hence it'll be empty once released
+		ctx.bBuffersRetired[i] = ctx.Buffers[i]->bRetired.load(std::memory_order_acquire);
+		ctx.ReadPositions[i] = ctx.Buffers[i]->Peek([&](const FRecordHeader& Header, const char* pMessage)
+		{
+			ctx.Records.push_back({ Header.Timestamp, static_cast<ERecordType>(Header.Type), Header.bDeferred != 0, std::string_view(pMessage, Header.MessageLength) });
+		});
+	}
+	std::stable_sort(ctx.Records.begin(), ctx.Records.end(), [](const FPendingRecord& a, const FPendingRecord& b) { return a.Timestamp < b.Timestamp; });
+
+	ctx.Batch.clear();
+	ctx.BinaryBatch.clear();
+	ctx.BinaryBatchFormats.clear();
+	for (const FPendingRecord& Record : ctx.Records)
+	{
+		if (Record.bDeferred)
+		{
+			const char* pFormat = GetDeferredFormat(Record.Message);
+			ctx.DeferredMessage.clear();
+			FormatDeferredMessage(ctx.DeferredMessage, pFormat, Record.Message.data() + sizeof(uint64_t), Record.Message.size() - sizeof(uint64_t));
+			AppendLine(ctx.Batch, Record.Type, Record.Timestamp, ctx.DeferredMessage);
+
+			if (sbBinaryLogFile)
+				ctx.BinaryBatchFormats.push_back(pFormat);
+		}
+		else
+		{
+			AppendLine(ctx.Batch, Record.Type, Record.Timestamp, Record.Message);
+		}
+
+		if (sbBinaryLogFile)
+			AppendBinaryRecord(ctx.BinaryBatch, Record.Timestamp, Record.Type, Record.bDeferred, Record.Message);
+	}
+	const size_t NumDroppedMessages = sNumUnreportedDroppedMessages.exchange(0, std::memory_order_relaxed);
+	if (NumDroppedMessages > 0)
+	{
+		const std::string Message = "[Log] " + std::to_string(NumDroppedMessages) + " messages dropped: async log buffer full";
+		const int64_t Timestamp = GetTimestamp();
+		AppendLine(ctx.Batch, RECORD_WARNING, Timestamp, Message);
+		if (sbBinaryLogFile)
+			AppendBinaryRecord(ctx.BinaryBatch, Timestamp, RECORD_WARNING, false, Message);
+	}
+	if (!ctx.Batch.empty())
+		WriteToSinks(ctx.Batch, ctx.BinaryBatch, &ctx.BinaryBatchFormats);
+
+	for (size_t i = 0; i < NumBuffers; ++i)
+		ctx.Buffers[i]->Release(ctx.ReadPositions[i]);
+
+	for (size_t i = 0; i < NumBuffers; ++i)
+	{
+		if (!ctx.bBuffersRetired[i])
+			continue;
+		std::lock_guard<std::mutex> lk(sThreadLogBuffersMutex);
+		sThreadLogBuffers.erase(std::find(sThreadLogBuffers.begin(), sThreadLogBuffers.end(), ctx.Buffers[i]));
+		delete ctx.Buffers[i];
+	}
+}
+
+static void LoggerThreadMain()
+{
+	FLoggerContext ctx;
+	bool bStop = false;
+	while (!bStop)
+	{
+		uint64_t NumFlushRequests = 0;
+		{
+			std::unique_lock<std::mutex> lk(sLoggerMutex);
+			sLoggerSignal.wait_for(lk, std::chrono::milliseconds(sAsyncSettings.FlushIntervalMs), []()
+			{
+				return sbLoggerWakeRequested || sbStopLogger || sNumFlushRequests != sNumFlushesCompleted;
+			});
+			sbLoggerWakeRequested = false;
+			NumFlushRequests = sNumFlushRequests;
+			bStop = sbStopLogger;
+		}
+
+		// the requests observed above were made after their messages were written, the drain picks them up
+		DrainThreadLogBuffers(ctx);
+
+		bool bFlushRequested = false;
+		{
+			std::lock_guard<std::mutex> lk(sLoggerMutex);
+			bFlushRequested = NumFlushRequests != sNumFlushesCompleted;
+		}
+		if (bFlushRequested)
+		{
+			{
+				std::lock_guard<std::mutex> lk(sSinkMutex);
+				sLogFile.Flush();
+				cout.flush();
+			}
+			{
+				std::lock_guard<std::mutex> lk(sLoggerMutex);
+				sNumFlushesCompleted = NumFlushRequests;
+			}
+			sFlushSignal.notify_all();
+		}
+	}
+}
+
+static void StopAsyncLogger()
+{
+	if (!sLoggerThread.joinable())
+		return;
+
+	sbAsync.store(false, std::memory_order_release);
+	{
+		std::lock_guard<std::mutex> lk(sLoggerMutex);
+		sbStopLogger = true;
+	}
+	sLoggerSignal.notify_one();
+	sLoggerThread.join();
+}
+
+static void StartAsyncLogger(const FAsyncSettings& Settings)
+{
+	if (sLoggerThread.joinable()) // started again, e.g. Log::Initialize() called twice: restart with the new settings
+		StopAsyncLogger();
+
+	size_t ThreadBufferSize = 4096;
+	while (ThreadBufferSize < Settings.ThreadBufferSize)
+		ThreadBufferSize <<= 1;
+
+	sAsyncSettings = Settings;
+	sAsyncSettings.ThreadBufferSize = ThreadBufferSize;
+	sbStopLogger = false;
+	sLoggerThread = std::thread(LoggerThreadMain);
+	sbAsync.store(true, std::memory_order_release);
+}
+
+static void RUN_LOG_BENCHMARK()
+{
+	// Each thread logs a short formatted message in a loop, measuring the time spent in Log::Info() or Log::InfoDeferred().
+	// Note: writes NUM_THREADS * NUM_MESSAGES_PER_THREAD lines into the enabled outputs per mode.
+	constexpr int NUM_THREADS = 4;
+	constexpr int NUM_MESSAGES_PER_THREAD = 5000;
+
+	const FAsyncSettings AsyncSettingsBeforeBenchmark = sAsyncSettings;
+	const bool bAsyncBeforeBenchmark = sbAsync.load();
+
+	auto fnBenchmark = [&](bool bDeferred) -> std::vector<int64_t>
+	{
+		std::vector<std::vector<int64_t>> ThreadLatencies(NUM_THREADS, std::vector<int64_t>(NUM_MESSAGES_PER_THREAD));
+		std::vector<std::thread> threads;
+		for (int iThread = 0; iThread < NUM_THREADS; ++iThread)
+		{
+			threads.emplace_back([&, iThread]()
+			{
+				for (int i = 0; i < NUM_MESSAGES_PER_THREAD; ++i)
+				{
+					const auto t0 = std::chrono::high_resolution_clock::now();
+					if (bDeferred) Log::InfoDeferred("Benchmark message #%d from thread %d", i, iThread);
+					else           Log::Info        ("Benchmark message #%d from thread %d", i, iThread);
+					const auto t1 = std::chrono::high_resolution_clock::now();
+					ThreadLatencies[iThread][i] = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+				}
+			});
+		}
+		for (std::thread& th : threads)
+			th.join();
+		Log::Flush();
+
+		std::vector<int64_t> Latencies;
+		for (const std::vector<int64_t>& v : ThreadLatencies)
+			Latencies.insert(Latencies.end(), v.begin(), v.end());
+		std::sort(Latencies.begin(), Latencies.end());
+		return Latencies;
+	};
+
+	StopAsyncLogger();
+	const std::vector<int64_t> SyncLatencies = fnBenchmark(false);
+
+	const EOverflowPolicy Policies[] = { EOverflowPolicy::BLOCK, EOverflowPolicy::COUNT, EOverflowPolicy::BLOCK };
+	const bool bDeferred[]           = { false                 , false                 , true                  };
+	const char* PolicyNames[] = { "Async(Block)", "Async(Count)", "Async(Block)+Deferred" };
+	std::vector<int64_t> AsyncLatencies[_countof(Policies)];
+	for (int iPolicy = 0; iPolicy < _countof(Policies); ++iPolicy)
+	{
+		FAsyncSettings Settings = AsyncSettingsBeforeBenchmark;
+		Settings.OverflowPolicy = Policies[iPolicy];
+		StartAsyncLogger(Settings);
+		AsyncLatencies[iPolicy] = fnBenchmark(bDeferred[iPolicy]);
+		StopAsyncLogger();
+	}
+
+	if (bAsyncBeforeBenchmark)
+		StartAsyncLogger(AsyncSettingsBeforeBenchmark);
+
+	auto fnReport = [](const char* pName, const std::vector<int64_t>& Latencies)
+	{
+		Log::Info("  %-21s : p50=%8lldns  p99=%8lldns  max=%10lldns"
+			, pName
+			, Latencies[Latencies.size() / 2]
+			, Latencies[Latencies.size() * 99 / 100]
+			, Latencies.back()
+		);
+	};
+	Log::Info("Log Benchmark: %d threads x %d messages, call latency", NUM_THREADS, NUM_MESSAGES_PER_THREAD);
+	fnReport("Sync", SyncLatencies);
+	for (int iPolicy = 0; iPolicy < _countof(Policies); ++iPolicy)
+		fnReport(PolicyNames[iPolicy], AsyncLatencies[iPolicy]);
+	Log::Info("  Dropped messages: %d", (int)GetNumDroppedMessages());
+}
+
+#if LOG_RUN_FILTER_BENCHMARK
+VQ_LOG_CATEGORY(LogFilterBenchmark        , LOG_LEVEL_INFO);
+VQ_LOG_CATEGORY(LogFilterBenchmarkStripped, LOG_LEVEL_WARNING);
+
+static int sNumBenchmarkArgEvaluations = 0;
+static int EvaluateBenchmarkArg(int i) { ++sNumBenchmarkArgEvaluations; return i * 3; }
+
+static void RUN_LOG_FILTER_BENCHMARK()
+{
+	// Each call is dropped: Log::Info() by the default category's threshold after evaluating its arguments,
+	// VQ_LOG_INFO() by its category's threshold before evaluating them, or at compile time.
+	constexpr int NUM_CALLS = 10000000;
+
+	const uint8_t DefaultLevelBeforeBenchmark = sCategoryLevels[CATEGORY_DEFAULT].load();
+	sCategoryLevels[CATEGORY_DEFAULT].store(LOG_LEVEL_WARNING);
+	SetCategoryLevel("LogFilterBenchmark", LOG_LEVEL_WARNING);
+
+	volatile int Sink = 0; // keeps the loops from being optimized out
+	auto fnMeasure = [&](auto&& fnCall, int& NumArgEvaluations) -> double
+	{
+		sNumBenchmarkArgEvaluations = 0;
+		const auto t0 = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < NUM_CALLS; ++i)
+		{
+			Sink = i;
+			fnCall(i);
+		}
+		const auto t1 = std::chrono::high_resolution_clock::now();
+		NumArgEvaluations = sNumBenchmarkArgEvaluations;
+		return std::chrono::duration<double, std::nano>(t1 - t0).count() / NUM_CALLS;
+	};
+
+	int NumArgEvaluations[4] = {};
+	const double nsLoop     = fnMeasure([](int) {}, NumArgEvaluations[0]);
+	const double nsInfo     = fnMeasure([](int i) { Log::Info("Filtered message #%d", EvaluateBenchmarkArg(i)); }, NumArgEvaluations[1]);
+	const double nsCategory = fnMeasure([](int i) { VQ_LOG_INFO(LogFilterBenchmark, "Filtered message #%d", EvaluateBenchmarkArg(i)); }, NumArgEvaluations[2]);
+	const double nsStripped = fnMeasure([](int i) { VQ_LOG_INFO(LogFilterBenchmarkStripped, "Stripped message #%d", EvaluateBenchmarkArg(i)); }, NumArgEvaluations[3]);
+
+	sCategoryLevels[CATEGORY_DEFAULT].store(DefaultLevelBeforeBenchmark);
+	SetCategoryLevel("LogFilterBenchmark", LOG_LEVEL_INFO);
+
+	Log::Info("Log Filter Benchmark: %d calls, time per call & argument evaluations", NUM_CALLS);
+	Log::Info("  %-32s : %6.2fns  args=%d", "Empty loop"                   , nsLoop    , NumArgEvaluations[0]);
+	Log::Info("  %-32s : %6.2fns  args=%d", "Log::Info() runtime filtered" , nsInfo    , NumArgEvaluations[1]);
+	Log::Info("  %-32s : %6.2fns  args=%d", "VQ_LOG_INFO() runtime filtered", nsCategory, NumArgEvaluations[2]);
+	Log::Info("  %-32s : %6.2fns  args=%d", "VQ_LOG_INFO() stripped"       , nsStripped, NumArgEvaluations[3]);
+}
+#endif
+
+#if LOG_RUN_TIMESTAMP_BENCHMARK
+static std::string GetTimeAsStringWithStringStream(std::time_t Time) // GetTimeAsString() before TimestampFormatter
+{
+	std::tm tmNow;
+	localtime_s(&tmNow, &Time);
+
+	std::stringstream ss;
+	ss << (tmNow.tm_year + 1900) << "_"
+		<< std::setfill('0') << std::setw(2) << tmNow.tm_mon + 1 << "_"
+		<< std::setfill('0') << std::setw(2) << tmNow.tm_mday << "-"
+		<< std::setfill('0') << std::setw(2) << tmNow.tm_hour << ":"
+		<< std::setfill('0') << std::setw(2) << tmNow.tm_min << ":"
+		<< std::setfill('0') << std::setw(2) << tmNow.tm_sec;
+	return ss.str();
+}
+
+static void RUN_LOG_TIMESTAMP_BENCHMARK()
+{
+	constexpr int NUM_TIMESTAMPS = 1000000;
+
+	size_t NumChars = 0; // keeps the loops from being optimized out
+	auto fnMeasure = [&](auto&& fnTimestamp) -> double
+	{
+		const auto t0 = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < NUM_TIMESTAMPS; ++i)
+			NumChars += fnTimestamp().size();
+		const auto t1 = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::nano>(t1 - t0).count() / NUM_TIMESTAMPS;
+	};
+
+	TimestampFormatter& Formatter = TimestampFormatter::GetThreadLocal();
+	const double nsStringStream = fnMeasure([]() { return GetTimeAsStringWithStringStream(std::time(0)); });
+	const double nsFormatter    = fnMeasure([&]() { return Formatter.Format(TimestampFormatter::Now()); });
+	const double nsFormatterUs  = fnMeasure([&]() { return Formatter.Format(TimestampFormatter::Now(), true); });
+	const double nsBrackets     = fnMeasure([]() { return GetCurrentTimeAsStringWithBrackets(); });
+
+	// both implementations must render the same text, across minute & day boundaries too
+	bool bMatching = true;
+	for (std::time_t Time = std::time(0), End = Time + 2 * 24 * 3600; Time < End; Time += 7)
+		bMatching &= GetTimeAsStringWithStringStream(Time) == Formatter.Format(std::chrono::system_clock::from_time_t(Time));
+
+	Log::Info("Log Timestamp Benchmark: %d timestamps, time per timestamp (%d chars rendered)", NUM_TIMESTAMPS, (int)NumChars);
+	Log::Info("  %-40s : %7.2fns", "localtime + stringstream (std::time)", nsStringStream);
+	Log::Info("  %-40s : %7.2fns", "TimestampFormatter", nsFormatter);
+	Log::Info("  %-40s : %7.2fns", "TimestampFormatter w/ microseconds", nsFormatterUs);
+	Log::Info("  %-40s : %7.2fns", "GetCurrentTimeAsStringWithBrackets()", nsBrackets);
+	Log::Info("  Output matches: %s", bMatching ? "yes" : "NO");
+}
+#endif
+
+#if LOG_RUN_FILE_SINK_BENCHMARK
+static void RUN_LOG_FILE_SINK_BENCHMARK(const std::string& LogFilePath)
+{
+	// Writes the same batches of lines into an ofstream & a memory-mapped sink, with & without rotation
+	constexpr int NUM_BATCHES = 20000;
+	constexpr int NUM_LINES_PER_BATCH = 16;
+	constexpr size_t ROTATED_FILE_SIZE = 8 * 1024 * 1024;
+
+	std::vector<std::string> Batches(64);
+	for (size_t i = 0; i < Batches.size(); ++i)
+		for (int iLine = 0; iLine < NUM_LINES_PER_BATCH; ++iLine)
+			AppendLine(Batches[i], RECORD_INFO, GetTimestamp(), "[Benchmark] File sink benchmark line #" + std::to_string(i * NUM_LINES_PER_BATCH + iLine) + " with some payload");
+
+	struct FResult { double MBps; int64_t p99, max; size_t NumRotations; };
+	auto fnBenchmark = [&](const FLogFileSettings& Settings, const std::string& FilePath) -> FResult
+	{
+		std::vector<int64_t> Latencies(NUM_BATCHES);
+		size_t NumBytes = 0;
+		size_t NumRotations = 0;
+		const auto t0 = std::chrono::high_resolution_clock::now();
+		{
+			LogFileSink Sink;
+			if (!Sink.Open(FilePath, false, Settings, nullptr))
+				return {};
+			for (int i = 0; i < NUM_BATCHES; ++i)
+			{
+				const std::string& Batch = Batches[i % Batches.size()];
+				const auto tw0 = std::chrono::high_resolution_clock::now();
+				Sink.Write(Batch);
+				const auto tw1 = std::chrono::high_resolution_clock::now();
+				Latencies[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(tw1 - tw0).count();
+				NumBytes += Batch.size();
+			}
+			NumRotations = Sink.GetNumRotations();
+		} // includes closing the file
+		const auto t1 = std::chrono::high_resolution_clock::now();
+
+		std::sort(Latencies.begin(), Latencies.end());
+		const double Seconds = std::chrono::duration<double>(t1 - t0).count();
+		return { NumBytes / (1024.0 * 1024.0) / Seconds, Latencies[Latencies.size() * 99 / 100], Latencies.back(), NumRotations };
+	};
+
+	const std::string FileName = LogFilePath.substr(0, LogFilePath.find_last_of("/\\") + 1) + "LogFileSinkBenchmark";
+	const char* Names[] = { "ofstream", "Memory-mapped", "ofstream, rotated", "Memory-mapped, rotated" };
+	FLogFileSettings Settings[4];
+	Settings[1].bMemoryMapped = true;
+	Settings[2].MaxFileSize = ROTATED_FILE_SIZE;
+	Settings[3].bMemoryMapped = true;
+	Settings[3].MaxFileSize = ROTATED_FILE_SIZE;
+	FResult Results[4];
+	for (int i = 0; i < 4; ++i)
+	{
+		Settings[i].MaxNumFiles = 1; // deletes the rotated files as it goes
+		const std::string FilePath = FileName + std::to_string(i) + ".txt";
+		Results[i] = fnBenchmark(Settings[i], FilePath);
+		DeleteFile(FilePath.c_str());
+		for (size_t iFile = 1; iFile <= Results[i].NumRotations; ++iFile)
+			DeleteFile((FileName + std::to_string(i) + "_" + std::to_string(iFile) + ".txt").c_str());
+	}
+
+	Log::Info("Log File Sink Benchmark: %d writes x %d lines", NUM_BATCHES, NUM_LINES_PER_BATCH);
+	for (int i = 0; i < 4; ++i)
+	{
+		Log::Info("  %-24s : %8.1f MB/s  write p99=%7lldns  max=%9lldns  rotations=%d"
+			, Names[i], Results[i].MBps, Results[i].p99, Results[i].max, (int)Results[i].NumRotations);
+	}
+}
+#endif
 
 // checks if the specifiec path is only a file name, construct absolute path
 // - if yes, CurrentPath+FileName
@@ -113,6 +871,26 @@ void CreateFolderHierarchy(std::string_view logfileDir, std::string& errMsg)
 	}
 }
 
+// starts the first log file & the ones rotated to, assumes sSinkMutex is locked
+static void WriteLogFileHeader(std::string& Header, const std::string& FilePath, const std::string& PreviousFilePath)
+{
+	const std::string msg = PreviousFilePath.empty()
+		? GetCurrentTimeAsStringWithBrackets() + "[Log] " + "Logging initialized: " + FilePath + "\n"
+		: GetCurrentTimeAsStringWithBrackets() + "[Log] " + "Continued from: " + PreviousFilePath + "\n";
+	if (!sbBinaryLogFile)
+	{
+		Header += msg;
+		return;
+	}
+
+	// each file can be decoded on its own: repeat the format strings written into the previous files
+	Header.append(BINARY_LOG_FILE_MAGIC, sizeof(BINARY_LOG_FILE_MAGIC));
+	AppendBytes(Header, BINARY_LOG_FILE_VERSION);
+	AppendBinaryText(Header, msg);
+	for (const char* pFormat : sBinaryLogFormatStrings)
+		AppendBinaryFormatString(Header, pFormat);
+}
+
 void InitLogFile(const char* pStrFilePath)
 {
 	const std::string logfileAbsolutePath = ParseAndValidateArgument(pStrFilePath);
@@ -122,11 +900,15 @@ void InitLogFile(const char* pStrFilePath)
 
 	CreateFolderHierarchy(logfileDir, errMsg);
 
-	sOutFile.open(logfileAbsolutePath);
-	if (sOutFile)
+	bool bOpened = false;
+	{
+		std::lock_guard<std::mutex> lk(sSinkMutex);
+		sBinaryLogFormatStrings.clear();
+		bOpened = sLogFile.Open(logfileAbsolutePath, sbBinaryLogFile, sLogFileSettings, WriteLogFileHeader);
+	}
+	if (bOpened)
 	{
 		std::string msg = GetCurrentTimeAsStringWithBrackets() + "[Log] " + "Logging initialized: " + logfileAbsolutePath  + "\n";
-		sOutFile << msg;
 		cout << msg << endl;
 	}
 	else
@@ -185,67 +967,405 @@ void InitConsole()
 	}
 }
 
-void Initialize(bool bLogConsole, bool bLogFile, std::string_view LogFilePath)
+void Initialize(bool bLogConsole, bool bLogFile, std::string_view LogFilePath, const FAsyncSettings& AsyncSettings, const FLogFileSettings& FileSettings)
 {
+	sbBinaryLogFile = AsyncSettings.bBinaryLogFile;
+	sLogFileSettings = FileSettings;
+	SetMode(static_cast<Mode>((bLogConsole ? Mode::CONSOLE : Mode::NONE) | (bLogFile ? Mode::FILE : Mode::NONE)));
 	if (bLogConsole) InitConsole();
 	if (bLogFile)    InitLogFile(LogFilePath.data());
+	if (AsyncSettings.bEnabled) StartAsyncLogger(AsyncSettings);
 
 #if LOG_RUN_UNIT_TEST
 	Log::Info("Test");
 	Log::Error("Test");
 	Log::Warning("Test");
 #endif
+#if LOG_RUN_BENCHMARK
+	RUN_LOG_BENCHMARK();
+#endif
+#if LOG_RUN_FILTER_BENCHMARK
+	RUN_LOG_FILTER_BENCHMARK();
+#endif
+#if LOG_RUN_TIMESTAMP_BENCHMARK
+	RUN_LOG_TIMESTAMP_BENCHMARK();
+#endif
+#if LOG_RUN_FILE_SINK_BENCHMARK
+	if (bLogFile)
+		RUN_LOG_FILE_SINK_BENCHMARK(ParseAndValidateArgument(LogFilePath.data()));
+#endif
 }
 
 void Destroy()
 {
+	StopAsyncLogger(); // drains the thread buffers
+
 	std::string msg = GetCurrentTimeAsStringWithBrackets() + "[Log] Exit()";
-	if (sOutFile.is_open())
+	std::lock_guard<std::mutex> lk(sSinkMutex);
+	if (sLogFile.IsOpen())
 	{
-		sOutFile << msg;
-		sOutFile.close();
+		if (sbBinaryLogFile)
+		{
+			std::string chunk;
+			AppendBinaryText(chunk, msg);
+			sLogFile.Write(chunk);
+		}
+		else
+		{
+			sLogFile.Write(msg);
+		}
+		sLogFile.Close();
 	}
-	cout << msg;
+	if (sMode.load(std::memory_order_relaxed) & Mode::CONSOLE)
+		cout << msg;
 	OutputDebugString(msg.c_str());
 }
 
-void Error(std::string_view s)
+void Flush()
 {
-	std::string err = GetCurrentTimeAsStringWithBrackets();
-	err += "  [ERROR]\t: ";
-	err += s;
-	err += "\n";
-	
-	OutputDebugString(err.c_str());		// vs
-	if (sOutFile.is_open()) 
-		sOutFile << err;				// file
-	cout << err;						// console
+	if (!sbAsync.load(std::memory_order_acquire))
+	{
+		std::lock_guard<std::mutex> lk(sSinkMutex);
+		sLogFile.Flush();
+		cout.flush();
+		return;
+	}
+
+	std::unique_lock<std::mutex> lk(sLoggerMutex);
+	if (sbStopLogger)
+		return;
+
+	const uint64_t FlushRequest = ++sNumFlushRequests;
+	sLoggerSignal.notify_one();
+	sFlushSignal.wait(lk, [FlushRequest]() { return sNumFlushesCompleted >= FlushRequest; });
 }
 
-void Warning(std::string_view s)
+size_t GetNumDroppedMessages() { return sNumDroppedMessages.load(std::memory_order_relaxed); }
+
+void Write(ERecordType Type, std::string_view s)
 {
-	std::string warn = GetCurrentTimeAsStringWithBrackets();
-	warn += "  [WARNING]\t: ";
-	warn += s;
-	warn += "\n";
-	
-	OutputDebugString(warn.c_str());
-	if (sOutFile.is_open()) 
-		sOutFile << warn;
-	cout << warn;
+	if (sbAsync.load(std::memory_order_acquire) && TryWriteAsync(Type, false, std::string_view(), s))
+		return;
+
+	const int64_t Timestamp = GetTimestamp();
+	std::string line;
+	std::string record;
+	AppendLine(line, Type, Timestamp, s);
+	if (sbBinaryLogFile)
+		AppendBinaryRecord(record, Timestamp, Type, false, s);
+	WriteToSinks(line, record);
 }
 
-void Info(std::string_view s)
+bool TryLogDeferred(ERecordType Type, const char* format, const void* pArgBytes, size_t NumArgBytes)
 {
-	std::string info = GetCurrentTimeAsStringWithBrackets();
-	info += "   [INFO]\t: ";
-	info += s;
-	info += "\n";
-	OutputDebugString(info.c_str());
-	
-	if (sOutFile.is_open()) 
-		sOutFile << info;
-	cout << info;
+	if (!sbAsync.load(std::memory_order_acquire))
+		return false;
+
+	const uint64_t FormatAddress = reinterpret_cast<uint64_t>(format);
+	return TryWriteAsync(Type, true
+		, std::string_view(reinterpret_cast<const char*>(&FormatAddress), sizeof(FormatAddress))
+		, std::string_view(static_cast<const char*>(pArgBytes), NumArgBytes)
+	);
+}
+
+void Error(std::string_view s)   { if (IsEnabled(CATEGORY_DEFAULT, RECORD_ERROR))   Write(RECORD_ERROR, s); }
+void Warning(std::string_view s) { if (IsEnabled(CATEGORY_DEFAULT, RECORD_WARNING)) Write(RECORD_WARNING, s); }
+void Info(std::string_view s)    { if (IsEnabled(CATEGORY_DEFAULT, RECORD_INFO))    Write(RECORD_INFO, s); }
+
+//---------------------------------------------------------------------------------------------
+// Deferred formatting & binary log decoding
+//---------------------------------------------------------------------------------------------
+struct FDeferredArg
+{
+	EDeferredArgType Type;
+	union
+	{
+		int64_t  i64;
+		uint64_t u64;
+		double   f64;
+	};
+	std::string_view str;
+};
+
+class DeferredArgReader
+{
+public:
+	DeferredArgReader(const void* pArgBytes, size_t NumArgBytes) : mpCurr(static_cast<const char*>(pArgBytes)), mpEnd(mpCurr + NumArgBytes) {}
+
+	bool TryRead(FDeferredArg& arg)
+	{
+		if (mpCurr >= mpEnd)
+			return false;
+		arg.Type = static_cast<EDeferredArgType>(*mpCurr++);
+		switch (arg.Type)
+		{
+		case DEFERRED_ARG_INT32  : { int32_t  v; if (!TryReadValue(v)) return false; arg.i64 = v; return true; }
+		case DEFERRED_ARG_UINT32 : { uint32_t v; if (!TryReadValue(v)) return false; arg.u64 = v; return true; }
+		case DEFERRED_ARG_INT64  : return TryReadValue(arg.i64);
+		case DEFERRED_ARG_UINT64 : 
+		case DEFERRED_ARG_POINTER: return TryReadValue(arg.u64);
+		case DEFERRED_ARG_DOUBLE : return TryReadValue(arg.f64);
+		case DEFERRED_ARG_STRING :
+		{
+			uint32_t Length = 0;
+			if (!TryReadValue(Length) || mpEnd - mpCurr < static_cast<ptrdiff_t>(Length))
+				return false;
+			arg.str = std::string_view(mpCurr, Length);
+			mpCurr += Length;
+			return true;
+		}
+		}
+		return false; // corrupt data
+	}
+
+private:
+	template<class T> bool TryReadValue(T& value)
+	{
+		if (mpEnd - mpCurr < static_cast<ptrdiff_t>(sizeof(T)))
+			return false;
+		memcpy(&value, mpCurr, sizeof(T));
+		mpCurr += sizeof(T);
+		return true;
+	}
+	const char* mpCurr;
+	const char* mpEnd;
+};
+
+template<class T>
+static void AppendFormatted(std::string& out, const char* pSpec, T value)
+{
+	const int NumChars = snprintf(nullptr, 0, pSpec, value);
+	if (NumChars <= 0)
+		return;
+	const size_t Offset = out.size();
+	out.resize(Offset + NumChars + 1);
+	snprintf(&out[Offset], NumChars + 1, pSpec, value);
+	out.resize(Offset + NumChars);
+}
+
+void FormatDeferredMessage(std::string& out, const char* format, const void* pArgBytes, size_t NumArgBytes)
+{
+	DeferredArgReader Reader(pArgBytes, NumArgBytes);
+	FDeferredArg arg = {};
+
+	const char* p = format;
+	while (*p)
+	{
+		if (*p != '%')
+		{
+			const char* pNext = strchr(p, '%');
+			const size_t NumChars = pNext ? (pNext - p) : strlen(p);
+			out.append(p, NumChars);
+			p += NumChars;
+			continue;
+		}
+		if (p[1] == '%')
+		{
+			out += '%';
+			p += 2;
+			continue;
+		}
+
+		// %[flags][width][.precision][length]conversion: rebuild the spec with a length matching the encoded argument
+		const char* pSpecBegin = p++;
+		std::string Spec = "%";
+		bool bMissingArg = false;
+		auto fnAppendNumberOrStar = [&]()
+		{
+			if (*p == '*')
+			{
+				++p;
+				if (Reader.TryRead(arg)) Spec += std::to_string(arg.i64);
+				else bMissingArg = true;
+				return;
+			}
+			while (*p >= '0' && *p <= '9')
+				Spec += *p++;
+		};
+		while (*p && strchr("-+ #0", *p))
+			Spec += *p++;
+		fnAppendNumberOrStar();
+		if (*p == '.')
+		{
+			Spec += *p++;
+			fnAppendNumberOrStar();
+		}
+		while (*p && strchr("hlLqjztI", *p))
+		{
+			if (*p == 'I') // MSVC I32/I64
+				while (p[1] >= '0' && p[1] <= '9') ++p;
+			++p;
+		}
+
+		const char Conversion = *p;
+		if (Conversion == '\0')
+			break;
+		++p;
+
+		if (bMissingArg || !Reader.TryRead(arg))
+		{
+			out.append(pSpecBegin, p - pSpecBegin);
+			continue;
+		}
+
+		const bool b32Bit = arg.Type == DEFERRED_ARG_INT32 || arg.Type == DEFERRED_ARG_UINT32;
+		switch (Conversion)
+		{
+		case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+			if (arg.Type == DEFERRED_ARG_DOUBLE) { arg.i64 = static_cast<int64_t>(arg.f64); }
+			if (Conversion == 'c' || b32Bit)     { Spec += Conversion; AppendFormatted(out, Spec.c_str(), static_cast<int>(arg.i64)); }
+			else                                 { Spec += "ll"; Spec += Conversion; AppendFormatted(out, Spec.c_str(), arg.i64); }
+			break;
+		case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+			if (arg.Type != DEFERRED_ARG_DOUBLE) { arg.f64 = (arg.Type == DEFERRED_ARG_UINT64 || arg.Type == DEFERRED_ARG_UINT32) ? static_cast<double>(arg.u64) : static_cast<double>(arg.i64); }
+			Spec += Conversion;
+			AppendFormatted(out, Spec.c_str(), arg.f64);
+			break;
+		case 's':
+			if (arg.Type == DEFERRED_ARG_STRING)
+			{
+				Spec += "s";
+				const std::string str(arg.str); // null terminated for snprintf
+				if (Spec == "%s") out += str;
+				else              AppendFormatted(out, Spec.c_str(), str.c_str());
+			}
+			else
+			{
+				out += "(?)";
+			}
+			break;
+		case 'p':
+			Spec += 'p';
+			AppendFormatted(out, Spec.c_str(), reinterpret_cast<const void*>(static_cast<uintptr_t>(arg.u64)));
+			break;
+		default: // unsupported conversion, e.g. %n
+			out.append(pSpecBegin, p - pSpecBegin);
+			break;
+		}
+	}
+}
+
+bool DecodeBinaryLogFile(const std::string& BinaryLogFilePath, const std::string& TextLogFilePath)
+{
+	std::ifstream in(BinaryLogFilePath, std::ios::in | std::ios::binary);
+	if (!in)
+	{
+		Log::Error("DecodeBinaryLogFile(): Cannot open %s", BinaryLogFilePath.c_str());
+		return false;
+	}
+	const std::string Data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+	const char* p = Data.data();
+	const char* pEnd = p + Data.size();
+	auto fnTryRead = [&](void* pValue, size_t NumBytes) -> bool
+	{
+		if (static_cast<size_t>(pEnd - p) < NumBytes)
+			return false;
+		memcpy(pValue, p, NumBytes);
+		p += NumBytes;
+		return true;
+	};
+	auto fnTryReadString = [&](std::string_view& str, size_t NumBytes) -> bool
+	{
+		if (static_cast<size_t>(pEnd - p) < NumBytes)
+			return false;
+		str = std::string_view(p, NumBytes);
+		p += NumBytes;
+		return true;
+	};
+
+	char Magic[sizeof(BINARY_LOG_FILE_MAGIC)] = {};
+	uint32_t Version = 0;
+	if (!fnTryRead(Magic, sizeof(Magic)) || memcmp(Magic, BINARY_LOG_FILE_MAGIC, sizeof(Magic)) != 0 || !fnTryRead(&Version, sizeof(Version)))
+	{
+		Log::Error("DecodeBinaryLogFile(): %s is not a binary log file", BinaryLogFilePath.c_str());
+		return false;
+	}
+	if (Version != BINARY_LOG_FILE_VERSION)
+	{
+		Log::Error("DecodeBinaryLogFile(): %s has version %u, expected %u", BinaryLogFilePath.c_str(), Version, BINARY_LOG_FILE_VERSION);
+		return false;
+	}
+
+	std::unordered_map<uint64_t, std::string> FormatStrings;
+	std::string Text;
+	std::string DeferredMessage;
+	bool bValidChunk = true;
+	bool bEnd = false;
+	while (p < pEnd && bValidChunk && !bEnd)
+	{
+		const EBinaryLogChunk Chunk = static_cast<EBinaryLogChunk>(*p++);
+		switch (Chunk)
+		{
+		case CHUNK_END:
+			bEnd = true;
+			break;
+		case CHUNK_FORMAT_STRING:
+		{
+			uint64_t Id = 0;
+			uint32_t Length = 0;
+			std::string_view str;
+			bValidChunk = fnTryRead(&Id, sizeof(Id)) && fnTryRead(&Length, sizeof(Length)) && fnTryReadString(str, Length);
+			if (bValidChunk)
+				FormatStrings[Id] = std::string(str);
+			break;
+		}
+		case CHUNK_RECORD:
+		{
+			int64_t Timestamp = 0;
+			uint8_t Type = 0;
+			uint8_t bDeferred = 0;
+			uint32_t PayloadSize = 0;
+			std::string_view Payload;
+			bValidChunk = fnTryRead(&Timestamp, sizeof(Timestamp)) && fnTryRead(&Type, sizeof(Type)) && fnTryRead(&bDeferred, sizeof(bDeferred))
+				&& fnTryRead(&PayloadSize, sizeof(PayloadSize)) && fnTryReadString(Payload, PayloadSize)
+				&& Type < RECORD_PADDING && (!bDeferred || Payload.size() >= sizeof(uint64_t));
+			if (!bValidChunk)
+				break;
+
+			if (!bDeferred)
+			{
+				AppendLine(Text, static_cast<ERecordType>(Type), Timestamp, Payload);
+				break;
+			}
+
+			const uint64_t Id = reinterpret_cast<uint64_t>(GetDeferredFormat(Payload));
+			const auto it = FormatStrings.find(Id);
+			bValidChunk = it != FormatStrings.end();
+			if (!bValidChunk)
+				break;
+			DeferredMessage.clear();
+			FormatDeferredMessage(DeferredMessage, it->second.c_str(), Payload.data() + sizeof(uint64_t), Payload.size() - sizeof(uint64_t));
+			AppendLine(Text, static_cast<ERecordType>(Type), Timestamp, DeferredMessage);
+			break;
+		}
+		case CHUNK_TEXT:
+		{
+			uint32_t Length = 0;
+			std::string_view str;
+			bValidChunk = fnTryRead(&Length, sizeof(Length)) && fnTryReadString(str, Length);
+			if (bValidChunk)
+				Text += str;
+			break;
+		}
+		default:
+			bValidChunk = false;
+			break;
+		}
+	}
+	if (!bValidChunk)
+	{
+		Log::Warning("DecodeBinaryLogFile(): %s has a truncated or corrupt chunk, decoded up to it", BinaryLogFilePath.c_str());
+	}
+
+	std::ofstream out(TextLogFilePath);
+	if (!out)
+	{
+		Log::Error("DecodeBinaryLogFile(): Cannot open %s", TextLogFilePath.c_str());
+		return false;
+	}
+	out << Text;
+	return true;
 }
 
 }	// namespace Log
\ No newline at end of file
@@ -0,0 +1,245 @@
+//	VQUtils
+//	Copyright(C) 2020 - Volkan Ilbeyli
+//
+//	This program is free software : you can redistribute it and / or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+//	Contact: volkanilbeyli@gmail.com
+
+#include "LogFileSink.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstring>
+
+#ifndef VC_EXTRALEAN
+#define VC_EXTRALEAN
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+
+namespace Log
+{
+
+// <file>_<Index><ext>, the first file (Index=0) keeps its name
+static std::string GetRotatedFilePath(const std::string& BaseFilePath, size_t Index)
+{
+	if (Index == 0)
+		return BaseFilePath;
+
+	const size_t iFileName = BaseFilePath.find_last_of("/\\");
+	const size_t iExtension = BaseFilePath.find_last_of('.');
+	const bool bHasExtension = iExtension != std::string::npos && (iFileName == std::string::npos || iExtension > iFileName);
+	const size_t iSuffix = bHasExtension ? iExtension : BaseFilePath.size();
+	return BaseFilePath.substr(0, iSuffix) + "_" + std::to_string(Index) + BaseFilePath.substr(iSuffix);
+}
+
+bool LogFileSink::Open(const std::string& FilePath, bool bBinary, const FLogFileSettings& Settings, FileHeaderFn fnWriteHeader)
+{
+	Close();
+	mSettings = Settings;
+	mfnWriteHeader = std::move(fnWriteHeader);
+	mbBinary = bBinary;
+	mBaseFilePath = FilePath;
+	mNumRotations = 0;
+	if (!OpenFile(FilePath))
+		return false;
+
+	std::string Header;
+	if (mfnWriteHeader)
+		mfnWriteHeader(Header, mFilePath, std::string());
+	WriteToFile(Header);
+	mHeaderSize = mFileSize;
+	return true;
+}
+
+void LogFileSink::Close()
+{
+	if (!mbOpen)
+		return;
+	CloseFile();
+	mfnWriteHeader = nullptr;
+}
+
+void LogFileSink::Write(std::string_view Data)
+{
+	if (!mbOpen || Data.empty())
+		return;
+
+	// files only holding their header aren't rotated, a write larger than MaxFileSize gets a file of its own
+	const bool bHasRecords = mFileSize > mHeaderSize;
+	const bool bFileFull = mSettings.MaxFileSize > 0 && mFileSize + Data.size() > mSettings.MaxFileSize;
+	const bool bIntervalElapsed = mSettings.RotationIntervalMinutes > 0
+		&& std::chrono::steady_clock::now() - mFileOpenTime >= std::chrono::minutes(mSettings.RotationIntervalMinutes);
+	if (bHasRecords && (bFileFull || bIntervalElapsed))
+	{
+		Rotate();
+		if (!mbOpen)
+			return;
+	}
+	WriteToFile(Data);
+}
+
+void LogFileSink::Flush()
+{
+	if (!mbOpen)
+		return;
+	if (mSettings.bMemoryMapped)
+		FlushViewOfFile(mpMappedData, mFileSize);
+	else
+		mFile.flush();
+}
+
+bool LogFileSink::OpenFile(const std::string& FilePath)
+{
+	assert(!mbOpen);
+	mFilePath = FilePath;
+	mFileSize = 0;
+	mHeaderSize = 0;
+	mFileOpenTime = std::chrono::steady_clock::now();
+
+	if (!mSettings.bMemoryMapped)
+	{
+		mFile.open(FilePath, mbBinary ? (std::ios::out | std::ios::binary) : std::ios::out);
+		mbOpen = mFile.is_open();
+		return mbOpen;
+	}
+
+	HANDLE hFile = CreateFileA(FilePath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+	mhFile = hFile;
+
+	// preallocate the whole file if it has a size limit, otherwise grow it as needed
+	if (!MapRegion(mSettings.MaxFileSize > 0 ? mSettings.MaxFileSize : MAPPED_REGION_GROWTH))
+	{
+		CloseHandle(hFile);
+		mhFile = nullptr;
+		return false;
+	}
+	mbOpen = true;
+	return true;
+}
+
+void LogFileSink::CloseFile()
+{
+	if (!mSettings.bMemoryMapped)
+	{
+		mFile.close();
+		mbOpen = false;
+		return;
+	}
+
+	UnmapViewOfFile(mpMappedData);
+	CloseHandle(static_cast<HANDLE>(mhMapping));
+	mpMappedData = nullptr;
+	mhMapping = nullptr;
+	mMappedSize = 0;
+
+	// trim the preallocated region that wasn't written to
+	LARGE_INTEGER FileSize;
+	FileSize.QuadPart = static_cast<LONGLONG>(mFileSize);
+	if (SetFilePointerEx(static_cast<HANDLE>(mhFile), FileSize, NULL, FILE_BEGIN))
+		SetEndOfFile(static_cast<HANDLE>(mhFile));
+	CloseHandle(static_cast<HANDLE>(mhFile));
+	mhFile = nullptr;
+	mbOpen = false;
+}
+
+// (re)maps the file with @Size bytes, extending the file with zero bytes if it's smaller
+bool LogFileSink::MapRegion(size_t Size)
+{
+	if (mpMappedData)
+	{
+		UnmapViewOfFile(mpMappedData);
+		CloseHandle(static_cast<HANDLE>(mhMapping));
+		mpMappedData = nullptr;
+		mhMapping = nullptr;
+		mMappedSize = 0;
+	}
+
+	const uint64_t Size64 = Size;
+	HANDLE hMapping = CreateFileMappingA(static_cast<HANDLE>(mhFile), NULL, PAGE_READWRITE, static_cast<DWORD>(Size64 >> 32), static_cast<DWORD>(Size64 & 0xFFFFFFFF), NULL);
+	if (!hMapping)
+		return false;
+
+	void* pData = MapViewOfFile(hMapping, FILE_MAP_WRITE, 0, 0, Size);
+	if (!pData)
+	{
+		CloseHandle(hMapping);
+		return false;
+	}
+	mhMapping = hMapping;
+	mpMappedData = static_cast<char*>(pData);
+	mMappedSize = Size;
+	return true;
+}
+
+void LogFileSink::Rotate()
+{
+	const std::string PreviousFilePath = mFilePath;
+	CloseFile();
+
+	++mNumRotations;
+	if (mSettings.MaxNumFiles > 0 && mNumRotations >= mSettings.MaxNumFiles)
+		DeleteFileA(GetRotatedFilePath(mBaseFilePath, mNumRotations - mSettings.MaxNumFiles).c_str());
+
+	if (!OpenFile(GetRotatedFilePath(mBaseFilePath, mNumRotations)))
+		return; // the file output stops here, there's no log file to report the error to
+
+	std::string Header;
+	if (mfnWriteHeader)
+		mfnWriteHeader(Header, mFilePath, PreviousFilePath);
+	WriteToFile(Header);
+	mHeaderSize = mFileSize;
+}
+
+void LogFileSink::WriteToFile(std::string_view Data)
+{
+	if (Data.empty())
+		return;
+
+	if (!mSettings.bMemoryMapped)
+	{
+		mFile.write(Data.data(), Data.size());
+		mFileSize += Data.size();
+		return;
+	}
+
+	if (mFileSize + Data.size() > mMappedSize)
+	{
+		const size_t RequiredSize = mFileSize + Data.size();
+		const size_t NewSize = (RequiredSize + MAPPED_REGION_GROWTH - 1) / MAPPED_REGION_GROWTH * MAPPED_REGION_GROWTH;
+		if (!MapRegion(NewSize))
+		{
+			CloseFile();
+			return;
+		}
+	}
+
+	// the unwritten region is all zeros: write the first byte once the rest is in place,
+	// so that the data is either fully written or not written at all if the process crashes meanwhile.
+	assert(Data[0] != 0);
+	char* pDst = mpMappedData + mFileSize;
+	memcpy(pDst + 1, Data.data() + 1, Data.size() - 1);
+	std::atomic_thread_fence(std::memory_order_release);
+	*static_cast<volatile char*>(pDst) = Data[0];
+	mFileSize += Data.size();
+}
+
+}	// namespace Log
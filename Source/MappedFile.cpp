@@ -0,0 +1,163 @@
+//	VQUtils
+//	Copyright(C) 2020 - Volkan Ilbeyli
+//
+//	This program is free software : you can redistribute it and / or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+//	Contact: volkanilbeyli@gmail.com
+
+#include "MappedFile.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#ifndef VC_EXTRALEAN
+#define VC_EXTRALEAN
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		std::swap(mpData, other.mpData);
+		std::swap(mSize, other.mSize);
+#ifdef _WIN32
+		std::swap(mhFile, other.mhFile);
+		std::swap(mhMapping, other.mhMapping);
+#endif
+	}
+	return *this;
+}
+
+#ifdef _WIN32
+bool MappedFile::Open(const std::string& FilePath)
+{
+	Close();
+
+	HANDLE hFile = CreateFileA(FilePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER FileSize;
+	if (!GetFileSizeEx(hFile, &FileSize) || FileSize.QuadPart == 0) // empty files can't be mapped
+	{
+		CloseHandle(hFile);
+		return false;
+	}
+
+	HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!hMapping)
+	{
+		CloseHandle(hFile);
+		return false;
+	}
+
+	void* pData = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (!pData)
+	{
+		CloseHandle(hMapping);
+		CloseHandle(hFile);
+		return false;
+	}
+
+	mhFile = hFile;
+	mhMapping = hMapping;
+	mpData = static_cast<const unsigned char*>(pData);
+	mSize = static_cast<size_t>(FileSize.QuadPart);
+	return true;
+}
+
+void MappedFile::Prefetch() const
+{
+	if (!mpData)
+		return;
+	WIN32_MEMORY_RANGE_ENTRY Range;
+	Range.VirtualAddress = const_cast<unsigned char*>(mpData);
+	Range.NumberOfBytes = mSize;
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &Range, 0);
+}
+
+void MappedFile::Close()
+{
+	if (mpData)
+		UnmapViewOfFile(mpData);
+	if (mhMapping)
+		CloseHandle(static_cast<HANDLE>(mhMapping));
+	if (mhFile)
+		CloseHandle(static_cast<HANDLE>(mhFile));
+	mpData = nullptr;
+	mSize = 0;
+	mhMapping = nullptr;
+	mhFile = nullptr;
+}
+#else
+bool MappedFile::Open(const std::string& FilePath)
+{
+	Close();
+
+	const int fd = open(FilePath.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	struct stat FileStat;
+	if (fstat(fd, &FileStat) != 0 || FileStat.st_size == 0) // empty files can't be mapped
+	{
+		close(fd);
+		return false;
+	}
+
+	const size_t Size = static_cast<size_t>(FileStat.st_size);
+	void* pData = mmap(nullptr, Size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // the mapping keeps the file referenced
+	if (pData == MAP_FAILED)
+		return false;
+
+	madvise(pData, Size, MADV_SEQUENTIAL);
+	mpData = static_cast<const unsigned char*>(pData);
+	mSize = Size;
+	return true;
+}
+
+void MappedFile::Prefetch() const
+{
+	if (mpData)
+		madvise(const_cast<unsigned char*>(mpData), mSize, MADV_WILLNEED);
+}
+
+void MappedFile::Close()
+{
+	if (mpData)
+		munmap(const_cast<unsigned char*>(mpData), mSize);
+	mpData = nullptr;
+	mSize = 0;
+}
+#endif
@@ -145,7 +145,7 @@ void ThreadPool::Initialize(size_t numThreads, const std::string& ThreadPoolName
 	for (auto i = 0u; i < numThreads; ++i)
 	{
 		mWorkers.emplace_back(std::thread(&ThreadPool::Execute, this));
-		SetThreadName(mWorkers.back(), StrUtil::ASCIIToUnicode(ThreadPoolName).c_str());
+		SetThreadName(mWorkers.back(), StrUtil::ToWide(ThreadPoolName).c_str());
 	}
 
 #if RUN_THREADPOOL_UNIT_TEST
@@ -0,0 +1,107 @@
+#include "Multithreading/PooledTask.h"
+
+#include <mutex>
+#include <cassert>
+
+static std::atomic<size_t> sNumSlabAllocations = 0;
+
+// allocators of exited threads, reused by the threads created later on
+static std::mutex sOrphanAllocatorsMutex;
+static std::vector<TaskAllocator*> sOrphanAllocators;
+
+struct FTaskAllocatorLease
+{
+	~FTaskAllocatorLease()
+	{
+		if (!pAllocator)
+			return;
+		std::lock_guard<std::mutex> lk(sOrphanAllocatorsMutex);
+		sOrphanAllocators.push_back(pAllocator);
+		pAllocator = nullptr; // blocks freed on this thread from now on go through the remote free list
+	}
+	TaskAllocator* pAllocator = nullptr;
+};
+static thread_local FTaskAllocatorLease tAllocatorLease;
+
+TaskAllocator& TaskAllocator::GetThreadLocal()
+{
+	TaskAllocator*& pAllocator = tAllocatorLease.pAllocator;
+	if (pAllocator)
+		return *pAllocator;
+
+	{
+		std::lock_guard<std::mutex> lk(sOrphanAllocatorsMutex);
+		if (!sOrphanAllocators.empty())
+		{
+			pAllocator = sOrphanAllocators.back();
+			sOrphanAllocators.pop_back();
+		}
+	}
+	if (!pAllocator)
+		pAllocator = new TaskAllocator(); // never destroyed: blocks may be freed into it at any point
+
+	return *pAllocator;
+}
+
+FPooledTask* TaskAllocator::Allocate()
+{
+	if (!mpFreeList)
+		mpFreeList = mpRemoteFreeList.exchange(nullptr, std::memory_order_acquire);
+	if (!mpFreeList)
+		AllocateSlab();
+
+	FPooledTask* pTask = mpFreeList;
+	mpFreeList = pTask->pNext;
+	pTask->pOwner = this;
+	return pTask;
+}
+
+void TaskAllocator::Free(FPooledTask* pTask)
+{
+	assert(pTask->pOwner == this);
+	if (tAllocatorLease.pAllocator == this)
+	{
+		pTask->pNext = mpFreeList;
+		mpFreeList = pTask;
+		return;
+	}
+
+	// the owner only ever takes the whole list, hence no ABA problem here
+	FPooledTask* pHead = mpRemoteFreeList.load(std::memory_order_relaxed);
+	do
+	{
+		pTask->pNext = pHead;
+	} while (!mpRemoteFreeList.compare_exchange_weak(pHead, pTask, std::memory_order_release, std::memory_order_relaxed));
+}
+
+size_t TaskAllocator::GetNumSlabAllocations()
+{
+	return sNumSlabAllocations.load(std::memory_order_relaxed);
+}
+
+void TaskAllocator::AllocateSlab()
+{
+	mSlabs.emplace_back(new FPooledTask[NUM_TASKS_PER_SLAB]);
+	FPooledTask* pSlab = mSlabs.back().get();
+	for (size_t i = 0; i < NUM_TASKS_PER_SLAB; ++i)
+		pSlab[i].pNext = (i + 1 < NUM_TASKS_PER_SLAB) ? &pSlab[i + 1] : mpFreeList;
+	mpFreeList = pSlab;
+	++sNumSlabAllocations;
+}
+
+
+void FPooledTask::Run(FPooledTask* pTask)
+{
+	pTask->pfnInvoke(pTask->Storage);
+	Discard(pTask);
+}
+
+void FPooledTask::Discard(FPooledTask* pTask)
+{
+	// release the captures before signaling the counter, the waiter may own what they reference
+	TaskCounter* pCounter = pTask->pCounter;
+	pTask->pfnDestroy(pTask->Storage);
+	pTask->pOwner->Free(pTask);
+	if (pCounter)
+		pCounter->OnTaskComplete();
+}
@@ -0,0 +1,147 @@
+#include "Multithreading/TaskGraph.h"
+#include "Log.h"
+
+#include <cassert>
+#include <thread>
+
+TaskGraph::NodeID TaskGraph::AddNode(std::function<void()> fn)
+{
+	assert(IsComplete());
+	mNodeTasks.push_back(std::move(fn));
+	mbDirty = true;
+	return static_cast<NodeID>(mNodeTasks.size() - 1);
+}
+
+void TaskGraph::AddEdge(NodeID Predecessor, NodeID Successor)
+{
+	assert(IsComplete());
+	assert(Predecessor < mNodeTasks.size() && Successor < mNodeTasks.size());
+	assert(Predecessor != Successor);
+	mEdges.push_back({ Predecessor, Successor });
+	mbDirty = true;
+}
+
+void TaskGraph::Clear()
+{
+	assert(IsComplete());
+	mNodeTasks.clear();
+	mEdges.clear();
+	mSuccessorOffsets.clear();
+	mSuccessors.clear();
+	mRootNodes.clear();
+	mNumPredecessors.clear();
+	mNumPendingPredecessors.reset();
+	mbDirty = true;
+}
+
+bool TaskGraph::Finalize()
+{
+	const size_t NumNodes = mNodeTasks.size();
+
+	// count successors & predecessors
+	mSuccessorOffsets.assign(NumNodes + 1, 0);
+	mNumPredecessors.assign(NumNodes, 0);
+	for (const std::pair<NodeID, NodeID>& edge : mEdges)
+	{
+		++mSuccessorOffsets[edge.first + 1];
+		++mNumPredecessors[edge.second];
+	}
+	for (size_t i = 0; i < NumNodes; ++i)
+		mSuccessorOffsets[i + 1] += mSuccessorOffsets[i];
+
+	// flatten the successor lists
+	mSuccessors.resize(mEdges.size());
+	std::vector<NodeID> WriteOffsets(mSuccessorOffsets.begin(), mSuccessorOffsets.end() - 1);
+	for (const std::pair<NodeID, NodeID>& edge : mEdges)
+		mSuccessors[WriteOffsets[edge.first]++] = edge.second;
+
+	mRootNodes.clear();
+	for (NodeID i = 0; i < NumNodes; ++i)
+		if (mNumPredecessors[i] == 0)
+			mRootNodes.push_back(i);
+
+	mNumPendingPredecessors.reset(new std::atomic<uint32_t>[NumNodes]);
+
+	// validate: a graph with cycles would never complete (Kahn's algorithm)
+	std::vector<uint32_t> NumPredecessors = mNumPredecessors;
+	std::vector<NodeID> ReadyNodes = mRootNodes;
+	size_t NumVisitedNodes = 0;
+	while (!ReadyNodes.empty())
+	{
+		const NodeID node = ReadyNodes.back();
+		ReadyNodes.pop_back();
+		++NumVisitedNodes;
+		for (NodeID i = mSuccessorOffsets[node]; i < mSuccessorOffsets[node + 1]; ++i)
+			if (--NumPredecessors[mSuccessors[i]] == 0)
+				ReadyNodes.push_back(mSuccessors[i]);
+	}
+	if (NumVisitedNodes != NumNodes)
+	{
+		Log::Error("TaskGraph::Finalize(): graph has cycles, %d/%d nodes reachable", (int)NumVisitedNodes, (int)NumNodes);
+		return false;
+	}
+
+	mbDirty = false;
+	return true;
+}
+
+void TaskGraph::Submit(ThreadPool& pool, ETaskPriority priority)
+{
+	assert(IsComplete()); // previous submission must be complete
+	if (mbDirty && !Finalize())
+		return;
+
+	const size_t NumNodes = mNodeTasks.size();
+	if (NumNodes == 0)
+		return;
+
+	mpPool = &pool;
+	mPriority = priority;
+	for (size_t i = 0; i < NumNodes; ++i)
+		mNumPendingPredecessors[i].store(mNumPredecessors[i], std::memory_order_relaxed);
+	mNumNodesRemaining.store(NumNodes, std::memory_order_release);
+
+	for (NodeID root : mRootNodes)
+		ScheduleNode(root);
+}
+
+void TaskGraph::Wait() const
+{
+	while (!IsComplete())
+		std::this_thread::yield();
+}
+
+void TaskGraph::ScheduleNode(NodeID node)
+{
+	mpPool->Dispatch([this, node]() { RunNode(node); }, mPriority);
+}
+
+void TaskGraph::RunNode(NodeID node)
+{
+	while (true)
+	{
+		mNodeTasks[node]();
+
+		// release the successors: keep the first one that becomes ready to run it on this thread
+		// as a continuation, saving a round trip through the pool, and schedule the others.
+		NodeID NextNode = node;
+		for (NodeID i = mSuccessorOffsets[node]; i < mSuccessorOffsets[node + 1]; ++i)
+		{
+			const NodeID successor = mSuccessors[i];
+			if (mNumPendingPredecessors[successor].fetch_sub(1, std::memory_order_acq_rel) != 1)
+				continue;
+
+			if (NextNode == node)
+				NextNode = successor;
+			else
+				ScheduleNode(successor);
+		}
+
+		// the graph can be re-submitted as soon as the last node completes, don't touch any state after that
+		mNumNodesRemaining.fetch_sub(1, std::memory_order_acq_rel);
+
+		if (NextNode == node)
+			break;
+		node = NextNode;
+	}
+}
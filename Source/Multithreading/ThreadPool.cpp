@@ -1,6 +1,8 @@
 #include "Multithreading/ThreadPool.h"
+#include "Multithreading/ConcurrentQueue.h"
 #include "Utils.h"
 #include "Log.h"
+#include "Timer.h"
 
 #ifndef VC_EXTRALEAN
 #define VC_EXTRALEAN
@@ -13,12 +15,28 @@
 #endif
 #include <Windows.h>
 #include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <new>
 
 
 #define RUN_THREADPOOL_UNIT_TEST 0
+#define RUN_THREADPOOL_BENCHMARK 0
+#define RUN_CONCURRENTQUEUE_BENCHMARK 0
+#define RUN_PARALLELFOR_BENCHMARK 0
+#define RUN_TASKSUBMISSION_BENCHMARK 0
 
 const size_t ThreadPool::sHardwareThreadCount = std::thread::hardware_concurrency();
 
+// identifies the pool & worker index of the calling thread, used for routing
+// AddTask() calls made from within a task into the worker's local queue.
+struct FWorkerContext
+{
+	const ThreadPool* pPool = nullptr;
+	size_t iWorker = 0;
+};
+static thread_local FWorkerContext tWorkerContext;
+
 static void RUN_THREAD_POOL_UNIT_TEST()
 {
 	ThreadPool p;
@@ -93,6 +111,350 @@ static void RUN_THREAD_POOL_UNIT_TEST()
 	Log::Info(strResult);
 }
 
+static void RUN_THREAD_POOL_BENCHMARK()
+{
+	// Measures the scheduling overhead of the pool with tiny tasks for 1..N workers.
+	// - External: the calling thread adds all the tasks (cross-thread submission)
+	// - Nested  : each root task adds its children from within the pool (fork-join style)
+	constexpr int NUM_TASKS = 200000;
+	constexpr int NUM_ROOT_TASKS = 64;
+	constexpr int NUM_CHILD_TASKS = NUM_TASKS / NUM_ROOT_TASKS;
+
+	auto fnTinyTask = [](std::atomic<int>& counter) { counter.fetch_add(1, std::memory_order_relaxed); };
+	auto fnWaitUntil = [](const std::atomic<int>& counter, int target) { while (counter.load() < target) std::this_thread::yield(); };
+
+	auto fnRunExternal = [&](ThreadPool& p)
+	{
+		std::atomic<int> counter = 0;
+		for (int i = 0; i < NUM_TASKS; ++i)
+			p.AddTask([&]() { fnTinyTask(counter); });
+		fnWaitUntil(counter, NUM_TASKS);
+	};
+	auto fnRunNested = [&](ThreadPool& p)
+	{
+		std::atomic<int> counter = 0;
+		for (int i = 0; i < NUM_ROOT_TASKS; ++i)
+		{
+			p.AddTask([&]()
+			{
+				for (int j = 0; j < NUM_CHILD_TASKS; ++j)
+					p.AddTask([&]() { fnTinyTask(counter); });
+			});
+		}
+		fnWaitUntil(counter, NUM_ROOT_TASKS * NUM_CHILD_TASKS);
+	};
+
+	const EThreadPoolScheduler Schedulers[] = { EThreadPoolScheduler::SHARED_QUEUE, EThreadPoolScheduler::WORK_STEALING };
+	const char* SchedulerNames[] = { "SharedQueue ", "WorkStealing" };
+
+	Log::Info("ThreadPool Benchmark: %d tiny tasks, tasks/sec (higher is better)", NUM_TASKS);
+	for (size_t NumWorkers = 1; NumWorkers <= ThreadPool::sHardwareThreadCount; ++NumWorkers)
+	{
+		for (int iScheduler = 0; iScheduler < _countof(Schedulers); ++iScheduler)
+		{
+			ThreadPool p;
+			p.Initialize(NumWorkers, "BENCHMARK POOL", 0xFFAAAAAA, Schedulers[iScheduler]);
+
+			Timer t; t.Reset(); t.Start();
+			fnRunExternal(p);
+			const float ExternalSeconds = t.StopGetDeltaTimeAndReset();
+
+			t.Start();
+			fnRunNested(p);
+			const float NestedSeconds = t.StopGetDeltaTimeAndReset();
+
+			p.Destroy();
+
+			Log::Info("  Workers=%2d  %s : External=%12.0f  Nested=%12.0f"
+				, (int)NumWorkers
+				, SchedulerNames[iScheduler]
+				, NUM_TASKS / ExternalSeconds
+				, (NUM_ROOT_TASKS * NUM_CHILD_TASKS) / NestedSeconds
+			);
+		}
+	}
+}
+
+
+
+static void RUN_CONCURRENT_QUEUE_BENCHMARK()
+{
+	// Measures items/sec moved from P producers to C consumers through
+	// the mutex-guarded ConcurrentQueue and the lock-free BoundedConcurrentQueue.
+	constexpr int NUM_ITEMS = 1000000;
+	constexpr size_t BOUNDED_QUEUE_CAPACITY = 4096;
+	constexpr size_t BULK_SIZE = 32;
+
+	auto fnRun = [&](int NumProducers, int NumConsumers, auto& fnTryEnqueue, auto& fnTryDequeue) -> float
+	{
+		std::atomic<int> NumConsumed = 0;
+		std::atomic<long long> Sum = 0;
+		std::vector<std::thread> threads;
+
+		Timer t; t.Reset(); t.Start();
+		for (int iProducer = 0; iProducer < NumProducers; ++iProducer)
+		{
+			threads.emplace_back([&, iProducer]()
+			{
+				for (int i = iProducer; i < NUM_ITEMS; i += NumProducers)
+					while (!fnTryEnqueue(i))
+						std::this_thread::yield();
+			});
+		}
+		for (int iConsumer = 0; iConsumer < NumConsumers; ++iConsumer)
+		{
+			threads.emplace_back([&]()
+			{
+				long long LocalSum = 0;
+				while (NumConsumed.load(std::memory_order_relaxed) < NUM_ITEMS)
+				{
+					const int NumDequeued = fnTryDequeue(LocalSum);
+					if (NumDequeued == 0)
+						std::this_thread::yield();
+					else
+						NumConsumed += NumDequeued;
+				}
+				Sum += LocalSum;
+			});
+		}
+		for (std::thread& th : threads)
+			th.join();
+		const float Seconds = t.StopGetDeltaTimeAndReset();
+
+		assert(Sum == (long long)NUM_ITEMS * (NUM_ITEMS - 1) / 2);
+		return NUM_ITEMS / Seconds;
+	};
+
+	const int ThreadCounts[] = { 1, 2, 4, 8 };
+	Log::Info("ConcurrentQueue Benchmark: %d items, items/sec (higher is better)", NUM_ITEMS);
+	for (int NumProducers : ThreadCounts)
+	for (int NumConsumers : ThreadCounts)
+	{
+		ConcurrentQueue<int> qMutex(nullptr);
+		auto fnMutexEnqueue = [&](int i) { qMutex.Enqueue(i); return true; };
+		auto fnMutexDequeue = [&](long long& sum) { int i = 0; if (!qMutex.TryDequeue(i)) return 0; sum += i; return 1; };
+
+		BoundedConcurrentQueue<int> qBounded(BOUNDED_QUEUE_CAPACITY);
+		auto fnBoundedEnqueue = [&](int i) { return qBounded.TryEnqueue(i); };
+		auto fnBoundedDequeue = [&](long long& sum) { int i = 0; if (!qBounded.TryDequeue(i)) return 0; sum += i; return 1; };
+
+		BoundedConcurrentQueue<int> qBoundedBulk(BOUNDED_QUEUE_CAPACITY);
+		auto fnBulkDequeue = [&](long long& sum)
+		{
+			int items[BULK_SIZE];
+			const size_t NumDequeued = qBoundedBulk.TryDequeueBulk(items, BULK_SIZE);
+			for (size_t i = 0; i < NumDequeued; ++i)
+				sum += items[i];
+			return static_cast<int>(NumDequeued);
+		};
+		auto fnBulkEnqueue = [&](int i) { return qBoundedBulk.TryEnqueue(i); };
+
+		const float MutexItemsPerSec   = fnRun(NumProducers, NumConsumers, fnMutexEnqueue  , fnMutexDequeue  );
+		const float BoundedItemsPerSec = fnRun(NumProducers, NumConsumers, fnBoundedEnqueue, fnBoundedDequeue);
+		const float BulkItemsPerSec    = fnRun(NumProducers, NumConsumers, fnBulkEnqueue   , fnBulkDequeue   );
+		Log::Info("  P=%d C=%d : Mutex=%12.0f  LockFree=%12.0f  LockFreeBulkDequeue=%12.0f"
+			, NumProducers, NumConsumers
+			, MutexItemsPerSec, BoundedItemsPerSec, BulkItemsPerSec
+		);
+	}
+}
+
+static void RUN_PARALLEL_FOR_BENCHMARK()
+{
+	// Compares ParallelFor/ParallelReduce against the static partitioning with
+	// PartitionWorkItemsIntoRanges() + AddTask() + future.get(), for uniform and skewed per-item cost.
+	constexpr size_t NUM_ITEMS = 1 << 16;
+	constexpr size_t GRAIN = 64;
+	constexpr int NUM_ITERATIONS = 10;
+
+	ThreadPool p;
+	p.Initialize(ThreadPool::sHardwareThreadCount, "BENCHMARK POOL");
+
+	// the item cost is in 'spin iterations', skewed cost puts most of the work into the first items
+	auto fnCostUniform = [](size_t) -> size_t { return 200; };
+	auto fnCostSkewed  = [](size_t i) -> size_t { return i < NUM_ITEMS / 16 ? 3000 : 10; };
+	auto fnWork = [](size_t NumIterations) -> float
+	{
+		float f = 0.0f;
+		for (size_t i = 0; i < NumIterations; ++i)
+			f += std::sqrt(static_cast<float>(i));
+		return f;
+	};
+
+	std::vector<float> Results(NUM_ITEMS);
+	auto fnBenchmark = [&](const char* pName, auto& fnCost)
+	{
+		Timer t;
+
+		t.Reset(); t.Start();
+		for (int iter = 0; iter < NUM_ITERATIONS; ++iter)
+		{
+			const std::vector<std::pair<size_t, size_t>> Ranges = PartitionWorkItemsIntoRanges(NUM_ITEMS, p.GetThreadPoolSize());
+			std::vector<std::future<void>> futures;
+			for (const std::pair<size_t, size_t>& r : Ranges)
+			{
+				futures.push_back(p.AddTask([&, r]()
+				{
+					for (size_t i = r.first; i <= r.second; ++i)
+						Results[i] = fnWork(fnCost(i));
+				}));
+			}
+			for (std::future<void>& f : futures)
+				f.get();
+		}
+		const float StaticPartitionMs = t.StopGetDeltaTimeAndReset() * 1000.0f / NUM_ITERATIONS;
+
+		t.Start();
+		for (int iter = 0; iter < NUM_ITERATIONS; ++iter)
+		{
+			p.ParallelFor(0, NUM_ITEMS, GRAIN, [&](size_t i) { Results[i] = fnWork(fnCost(i)); });
+		}
+		const float ParallelForMs = t.StopGetDeltaTimeAndReset() * 1000.0f / NUM_ITERATIONS;
+
+		t.Start();
+		double Sum = 0.0;
+		for (int iter = 0; iter < NUM_ITERATIONS; ++iter)
+		{
+			Sum += p.ParallelReduce(0, NUM_ITEMS, GRAIN, 0.0
+				, [&](double acc, size_t i) { return acc + fnWork(fnCost(i)); }
+				, [](double a, double b) { return a + b; }
+			);
+		}
+		const float ParallelReduceMs = t.StopGetDeltaTimeAndReset() * 1000.0f / NUM_ITERATIONS;
+
+		Log::Info("  %-8s : StaticPartition=%8.3fms  ParallelFor=%8.3fms  ParallelReduce=%8.3fms (sum=%.0f)"
+			, pName, StaticPartitionMs, ParallelForMs, ParallelReduceMs, Sum);
+	};
+
+	Log::Info("ParallelFor Benchmark: %d items, %d workers (lower is better)", (int)NUM_ITEMS, (int)p.GetThreadPoolSize());
+	fnBenchmark("Uniform", fnCostUniform);
+	fnBenchmark("Skewed" , fnCostSkewed);
+
+	p.Destroy();
+}
+
+// counts the heap allocations made by the process while the benchmark is enabled
+static std::atomic<size_t> sNumHeapAllocations = 0;
+#if RUN_TASKSUBMISSION_BENCHMARK
+void* operator new(size_t size)
+{
+	++sNumHeapAllocations;
+	if (void* p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+// FPooledTask slabs are over-aligned and go through the aligned overloads
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	++sNumHeapAllocations;
+	const size_t Alignment = static_cast<size_t>(alignment);
+#ifdef _MSC_VER
+	if (void* p = _aligned_malloc(size ? size : 1, Alignment))
+#else
+	if (void* p = std::aligned_alloc(Alignment, ((size ? size : 1) + Alignment - 1) & ~(Alignment - 1)))
+#endif
+		return p;
+	throw std::bad_alloc();
+}
+void* operator new[](size_t size, std::align_val_t alignment) { return operator new(size, alignment); }
+#ifdef _MSC_VER
+void operator delete(void* p, std::align_val_t) noexcept { _aligned_free(p); }
+#else
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+#endif
+void operator delete(void* p, size_t, std::align_val_t alignment) noexcept { operator delete(p, alignment); }
+void operator delete[](void* p, std::align_val_t alignment) noexcept { operator delete(p, alignment); }
+void operator delete[](void* p, size_t, std::align_val_t alignment) noexcept { operator delete(p, alignment); }
+#endif
+
+static void RUN_TASK_SUBMISSION_BENCHMARK()
+{
+	// Compares AddTask() (packaged_task + future) against Dispatch() (pooled task + TaskCounter)
+	// for tiny tasks submitted from outside the pool: heap allocations & time per task.
+	constexpr int NUM_TASKS = 200000;
+	constexpr int NUM_WARMUP_TASKS = 10000;
+
+	ThreadPool p;
+	p.Initialize(ThreadPool::sHardwareThreadCount, "BENCHMARK POOL");
+
+	std::atomic<int> counter = 0;
+	auto fnTinyTask = [&counter]() { counter.fetch_add(1, std::memory_order_relaxed); };
+
+	// returns the time spent submitting, the total time is measured by the caller
+	std::vector<std::future<void>> futures;
+	futures.reserve(NUM_TASKS);
+	auto fnRunAddTask = [&](int NumTasks) -> float
+	{
+		futures.clear();
+		Timer t; t.Reset(); t.Start();
+		for (int i = 0; i < NumTasks; ++i)
+			futures.push_back(p.AddTask(fnTinyTask));
+		const float SubmitSeconds = t.StopGetDeltaTimeAndReset();
+		for (std::future<void>& f : futures)
+			f.get();
+		return SubmitSeconds;
+	};
+	auto fnRunDispatch = [&](int NumTasks) -> float
+	{
+		TaskCounter tc;
+		Timer t; t.Reset(); t.Start();
+		for (int i = 0; i < NumTasks; ++i)
+			p.Dispatch(fnTinyTask, ETaskPriority::NORMAL, &tc);
+		const float SubmitSeconds = t.StopGetDeltaTimeAndReset();
+		tc.Wait();
+		return SubmitSeconds;
+	};
+
+	auto fnBenchmark = [&](const char* pName, auto& fnRun)
+	{
+		fnRun(NUM_WARMUP_TASKS); // warm up the queues & the task allocators
+
+		Timer t; t.Reset(); t.Start();
+		const size_t NumAllocationsBegin = sNumHeapAllocations.load();
+		const float SubmitSeconds = fnRun(NUM_TASKS);
+		const size_t NumAllocations = sNumHeapAllocations.load() - NumAllocationsBegin;
+		const float TotalSeconds = t.StopGetDeltaTimeAndReset();
+
+		Log::Info("  %-9s: %6.2f allocations/task (%7zu total)  %8.1f ns/submit  %8.1f ns/task (submit+complete)"
+			, pName
+			, (float)NumAllocations / NUM_TASKS
+			, NumAllocations
+			, SubmitSeconds * 1e9f / NUM_TASKS
+			, TotalSeconds * 1e9f / NUM_TASKS
+		);
+	};
+
+	Log::Info("Task Submission Benchmark: %d tiny tasks, %d workers", NUM_TASKS, (int)p.GetThreadPoolSize());
+	fnBenchmark("AddTask", fnRunAddTask);
+	fnBenchmark("Dispatch", fnRunDispatch);
+	Log::Info("  TaskAllocator slabs: %d", (int)TaskAllocator::GetNumSlabAllocations());
+
+	p.Destroy();
+}
+
+static void RUN_BENCHMARKS()
+{
+	static bool sbBenchmarksRan = false; // benchmarks initialize thread pools of their own
+	if (sbBenchmarksRan)
+		return;
+	sbBenchmarksRan = true;
+
+#if RUN_THREADPOOL_BENCHMARK
+	RUN_THREAD_POOL_BENCHMARK();
+#endif
+#if RUN_CONCURRENTQUEUE_BENCHMARK
+	RUN_CONCURRENT_QUEUE_BENCHMARK();
+#endif
+#if RUN_PARALLELFOR_BENCHMARK
+	RUN_PARALLEL_FOR_BENCHMARK();
+#endif
+#if RUN_TASKSUBMISSION_BENCHMARK
+	RUN_TASK_SUBMISSION_BENCHMARK();
+#endif
+}
 
 static void SetThreadName(std::thread& th, const wchar_t* threadName) {
 	HRESULT hr = SetThreadDescription(th.native_handle(), threadName);
@@ -100,20 +462,35 @@ static void SetThreadName(std::thread& th, const wchar_t* threadName) {
 		// Handle error if needed
 	}
 }
-void ThreadPool::Initialize(size_t numThreads, const std::string& ThreadPoolName, unsigned int MarkerColor)
+void ThreadPool::Initialize(size_t numThreads, const std::string& ThreadPoolName, unsigned int MarkerColor, EThreadPoolScheduler Scheduler)
 {
 	mMarkerColor = MarkerColor;
 	mThreadPoolName = ThreadPoolName;
+	mScheduler = Scheduler;
 	mbStopWorkers.store(false);
+
+	if (mScheduler == EThreadPoolScheduler::WORK_STEALING)
+	{
+		// create all the local queues before any worker starts stealing from them
+		for (auto i = 0u; i < numThreads; ++i)
+			mLocalQueues.emplace_back(std::make_unique<WorkStealingQueue<FPooledTask*>>());
+	}
+
 	for (auto i = 0u; i < numThreads; ++i)
 	{
-		mWorkers.emplace_back(std::thread(&ThreadPool::Execute, this));
-		SetThreadName(mWorkers.back(), StrUtil::ASCIIToUnicode(ThreadPoolName).c_str());
+		if (mScheduler == EThreadPoolScheduler::WORK_STEALING)
+			mWorkers.emplace_back(std::thread(&ThreadPool::ExecuteWorkStealing, this, static_cast<size_t>(i)));
+		else
+			mWorkers.emplace_back(std::thread(&ThreadPool::Execute, this));
+		SetThreadName(mWorkers.back(), StrUtil::ToWide(ThreadPoolName).c_str());
 	}
 
 #if RUN_THREADPOOL_UNIT_TEST
 	RUN_THREAD_POOL_UNIT_TEST();
 #endif
+#if RUN_THREADPOOL_BENCHMARK || RUN_CONCURRENTQUEUE_BENCHMARK || RUN_PARALLELFOR_BENCHMARK || RUN_TASKSUBMISSION_BENCHMARK
+	RUN_BENCHMARKS();
+#endif
 }
 void ThreadPool::Destroy()
 {
@@ -132,20 +509,65 @@ void ThreadPool::Destroy()
 		}
 		worker.join();
 	}
+
+	// workers are gone, free the tasks that were never picked up
+	FPooledTask* pTask = nullptr;
+	while (mTaskQueue.TryPopTask(pTask))
+	{
+		FPooledTask::Discard(pTask);
+		mTaskQueue.OnTaskComplete();
+	}
+	for (std::unique_ptr<WorkStealingQueue<FPooledTask*>>& pQueue : mLocalQueues)
+	{
+		while (pQueue->Pop(pTask))
+		{
+			FPooledTask::Discard(pTask);
+			--mNumQueuedLocalTasks;
+			--mNumActiveLocalTasks;
+		}
+	}
+	mLocalQueues.clear();
 }
 
 void ThreadPool::RunRemainingTasksOnThisThread()
 {
-	Task task; 
-	while (mTaskQueue.TryPopTask(task))
+	FPooledTask* pTask = nullptr;
+	while (mTaskQueue.TryPopTask(pTask))
 	{ 
-		task(); 
+		FPooledTask::Run(pTask);
 		mTaskQueue.OnTaskComplete(); 
 	}
+
+	// steal whatever is left in the workers' local queues
+	for (std::unique_ptr<WorkStealingQueue<FPooledTask*>>& pQueue : mLocalQueues)
+	{
+		while (pQueue->Steal(pTask))
+		{
+			--mNumQueuedLocalTasks;
+			RunLocalTask(pTask);
+		}
+	}
+}
+
+bool ThreadPool::IsWorkerThread() const
+{
+	return tWorkerContext.pPool == this;
+}
+void ThreadPool::EnqueueTask(FPooledTask* pTask, ETaskPriority priority)
+{
+	if (mScheduler != EThreadPoolScheduler::WORK_STEALING || !TryPushLocalTask(pTask))
+	{
+		mTaskQueue.AddTask(pTask, priority);
+		//Log::Info("[%s] TaskQueue::AddTask()", this->mThreadPoolName.c_str());
+	}
+
+	mSignal.NotifyOne();
+	//Log::Info("[%s] EventSignal::NotifyOne()", this->mThreadPoolName.c_str());
 }
+
 void ThreadPool::Execute()
 {
-	Task task;
+	FPooledTask* pTask = nullptr;
 
 	while (!mbStopWorkers.load())
 	{
@@ -154,7 +576,7 @@ void ThreadPool::Execute()
 		if (mbStopWorkers)
 			break;
 		
-		if (!mTaskQueue.TryPopTask(task))
+		if (!mTaskQueue.TryPopTask(pTask))
 		{
 			// Spurious wake-ups can happen before a notify_one() is called on the mSignal.
 			// This means we can run into the following scenario:
@@ -166,19 +588,116 @@ void ThreadPool::Execute()
 			continue;
 		}
 
-		task();
+		FPooledTask::Run(pTask);
 		mTaskQueue.OnTaskComplete();
 	}
 }
 
-bool TaskQueue::TryPopTask(Task& task)
+void ThreadPool::ExecuteWorkStealing(size_t iWorker)
+{
+	tWorkerContext.pPool = this;
+	tWorkerContext.iWorker = iWorker;
+
+	// number of failed attempts to find work before going to sleep on mSignal
+	constexpr int NUM_SPIN_ITERATIONS_BEFORE_SLEEP = 64;
+
+	FPooledTask* pTask = nullptr;
+	int NumFailedAttempts = 0;
+	while (!mbStopWorkers.load())
+	{
+		// 1. own queue (LIFO), 2. shared queue (priority), 3. steal from others (FIFO)
+		if (mLocalQueues[iWorker]->Pop(pTask))
+		{
+			--mNumQueuedLocalTasks;
+			RunLocalTask(pTask);
+			NumFailedAttempts = 0;
+			continue;
+		}
+		if (mTaskQueue.TryPopTask(pTask))
+		{
+			FPooledTask::Run(pTask);
+			mTaskQueue.OnTaskComplete();
+			NumFailedAttempts = 0;
+			continue;
+		}
+		if (TryStealLocalTask(iWorker, pTask))
+		{
+			RunLocalTask(pTask);
+			NumFailedAttempts = 0;
+			continue;
+		}
+
+		if (++NumFailedAttempts < NUM_SPIN_ITERATIONS_BEFORE_SLEEP)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		NumFailedAttempts = 0;
+		mSignal.Wait([&] { return mbStopWorkers || HasQueuedTasks(); });
+	}
+
+	tWorkerContext = FWorkerContext{};
+}
+
+bool ThreadPool::TryPushLocalTask(FPooledTask* pTask)
+{
+	if (tWorkerContext.pPool != this)
+		return false;
+
+	++mNumActiveLocalTasks;
+	++mNumQueuedLocalTasks;
+	mLocalQueues[tWorkerContext.iWorker]->Push(pTask);
+	return true;
+}
+
+bool ThreadPool::TryStealLocalTask(size_t iWorker, FPooledTask*& pTask)
+{
+	if (mNumQueuedLocalTasks.load(std::memory_order_relaxed) <= 0)
+		return false;
+
+	// visit the other workers starting from our neighbor so that thieves spread out
+	const size_t NumQueues = mLocalQueues.size();
+	for (size_t i = 1; i < NumQueues; ++i)
+	{
+		WorkStealingQueue<FPooledTask*>& q = *mLocalQueues[(iWorker + i) % NumQueues];
+		if (q.IsEmpty())
+			continue;
+		if (q.Steal(pTask))
+		{
+			--mNumQueuedLocalTasks;
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::RunLocalTask(FPooledTask* pTask)
+{
+	FPooledTask::Run(pTask);
+	--mNumActiveLocalTasks;
+}
+
+bool ThreadPool::HasQueuedTasks() const
+{
+	return mNumQueuedLocalTasks.load() > 0 || !mTaskQueue.IsQueueEmpty();
+}
+
+void TaskQueue::AddTask(FPooledTask* pTask, ETaskPriority priority)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	queue.push(TaskEntry{ pTask, priority, sequenceCounter++ });
+	++activeTasks;
+}
+
+bool TaskQueue::TryPopTask(FPooledTask*& pTask)
 {
 	std::lock_guard<std::mutex> lk(mutex);
 	
 	if (queue.empty())
 		return false;
 	
-	task = std::move(queue.top().task);
+	pTask = queue.top().pTask;
 	queue.pop();
 	return true;
 }
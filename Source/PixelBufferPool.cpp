@@ -0,0 +1,222 @@
+//	VQUtils
+//	Copyright(C) 2020 - Volkan Ilbeyli
+//
+//	This program is free software : you can redistribute it and / or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+//	Contact: volkanilbeyli@gmail.com
+
+#include "PixelBufferPool.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+
+namespace
+{
+    constexpr int      MIN_POOLED_SIZE_LOG2 = 16;
+    constexpr int      MAX_POOLED_SIZE_LOG2 = 40; // 1TB, larger allocations aren't pooled
+    constexpr int      NUM_BUCKETS_PER_POW2 = 4;
+    constexpr int      NUM_BUCKETS = (MAX_POOLED_SIZE_LOG2 - MIN_POOLED_SIZE_LOG2) * NUM_BUCKETS_PER_POW2;
+    constexpr int      UNPOOLED_BUCKET = -1;
+    constexpr uint32_t HEADER_MAGIC = 0x4C4F4F50; // "POOL"
+    static_assert(PixelBufferPool::MIN_POOLED_SIZE == (size_t(1) << MIN_POOLED_SIZE_LOG2), "");
+
+    // in front of each buffer, keeps the buffer 16-byte aligned
+    struct alignas(16) FBufferHeader
+    {
+        size_t   Capacity;
+        int32_t  Bucket;
+        uint32_t Magic;
+    };
+    static_assert(sizeof(FBufferHeader) == 16, "");
+
+    struct FBucket
+    {
+        std::mutex         Mutex;
+        std::vector<void*> FreeBuffers; // headers
+    };
+}
+
+static FBucket                 sBuckets[NUM_BUCKETS];
+static std::atomic<size_t>     sMaxCachedBytes = 256ull * 1024 * 1024;
+static std::atomic<size_t>     sNumBytesCached = 0;
+static std::atomic<size_t>     sPeakBytesCached = 0;
+static std::atomic<uint64_t>   sNumAllocations = 0;
+static std::atomic<uint64_t>   sNumSystemAllocations = 0;
+static std::atomic<uint64_t>   sNumSystemFrees = 0;
+
+// bucket of @Size & its capacity: each power of two (2^Log2, 2^(Log2+1)] is split into NUM_BUCKETS_PER_POW2 steps
+static int GetBucket(size_t Size, size_t& Capacity)
+{
+    Capacity = Size;
+    if (Size <= PixelBufferPool::MIN_POOLED_SIZE)
+        return UNPOOLED_BUCKET;
+
+    int Log2 = MIN_POOLED_SIZE_LOG2;
+    while (((Size - 1) >> (Log2 + 1)) != 0)
+        ++Log2;
+    if (Log2 >= MAX_POOLED_SIZE_LOG2)
+        return UNPOOLED_BUCKET;
+
+    const size_t Step = size_t(1) << (Log2 - 2); // (2^Log2, 2^(Log2+1)] / NUM_BUCKETS_PER_POW2
+    Capacity = (Size + Step - 1) & ~(Step - 1);
+    const int iStep = static_cast<int>(Capacity / Step) - (NUM_BUCKETS_PER_POW2 + 1); // Capacity / Step in [5, 8]
+    return (Log2 - MIN_POOLED_SIZE_LOG2) * NUM_BUCKETS_PER_POW2 + iStep;
+}
+
+static inline FBufferHeader* GetHeader(void* p) { return static_cast<FBufferHeader*>(p) - 1; }
+
+static void FreeToSystem(FBufferHeader* pHeader)
+{
+    ++sNumSystemFrees;
+    free(pHeader);
+}
+
+namespace PixelBufferPool
+{
+
+void* Allocate(size_t Size)
+{
+    ++sNumAllocations;
+    size_t Capacity = 0;
+    const int Bucket = GetBucket(Size, Capacity);
+    if (Bucket != UNPOOLED_BUCKET)
+    {
+        FBucket& b = sBuckets[Bucket];
+        std::lock_guard<std::mutex> lk(b.Mutex);
+        if (!b.FreeBuffers.empty())
+        {
+            FBufferHeader* pHeader = static_cast<FBufferHeader*>(b.FreeBuffers.back());
+            b.FreeBuffers.pop_back();
+            sNumBytesCached -= pHeader->Capacity;
+            return pHeader + 1;
+        }
+    }
+
+    ++sNumSystemAllocations;
+    FBufferHeader* pHeader = static_cast<FBufferHeader*>(malloc(sizeof(FBufferHeader) + Capacity));
+    if (!pHeader)
+        return nullptr;
+    pHeader->Capacity = Capacity;
+    pHeader->Bucket = Bucket;
+    pHeader->Magic = HEADER_MAGIC;
+    return pHeader + 1;
+}
+
+void* Reallocate(void* p, size_t NewSize)
+{
+    if (!p)
+        return Allocate(NewSize);
+    if (NewSize == 0)
+    {
+        Free(p);
+        return nullptr;
+    }
+
+    const FBufferHeader* pHeader = GetHeader(p);
+    assert(pHeader->Magic == HEADER_MAGIC);
+    if (NewSize <= pHeader->Capacity)
+    {
+        // shrinking a pooled buffer keeps its bucket, the capacity is reused when it's freed
+        ++sNumAllocations;
+        return p;
+    }
+
+    void* pNew = Allocate(NewSize);
+    if (pNew)
+    {
+        memcpy(pNew, p, pHeader->Capacity);
+        Free(p);
+    }
+    return pNew;
+}
+
+void Free(void* p)
+{
+    if (!p)
+        return;
+
+    FBufferHeader* pHeader = GetHeader(p);
+    assert(pHeader->Magic == HEADER_MAGIC);
+    if (pHeader->Bucket == UNPOOLED_BUCKET)
+    {
+        FreeToSystem(pHeader);
+        return;
+    }
+
+    // reserve the space in the cache before publishing the buffer
+    const size_t NumBytesCached = sNumBytesCached.fetch_add(pHeader->Capacity) + pHeader->Capacity;
+    if (NumBytesCached > sMaxCachedBytes.load())
+    {
+        sNumBytesCached -= pHeader->Capacity;
+        FreeToSystem(pHeader);
+        return;
+    }
+    size_t PeakBytesCached = sPeakBytesCached.load();
+    while (NumBytesCached > PeakBytesCached && !sPeakBytesCached.compare_exchange_weak(PeakBytesCached, NumBytesCached));
+
+    FBucket& b = sBuckets[pHeader->Bucket];
+    std::lock_guard<std::mutex> lk(b.Mutex);
+    b.FreeBuffers.push_back(pHeader);
+}
+
+void SetMaxCachedBytes(size_t MaxCachedBytes)
+{
+    sMaxCachedBytes = MaxCachedBytes;
+    if (sNumBytesCached.load() > MaxCachedBytes)
+        Trim();
+}
+
+size_t GetMaxCachedBytes() { return sMaxCachedBytes.load(); }
+
+void Trim()
+{
+    for (FBucket& b : sBuckets)
+    {
+        std::lock_guard<std::mutex> lk(b.Mutex);
+        for (void* pBuffer : b.FreeBuffers)
+        {
+            FBufferHeader* pHeader = static_cast<FBufferHeader*>(pBuffer);
+            sNumBytesCached -= pHeader->Capacity;
+            FreeToSystem(pHeader);
+        }
+        b.FreeBuffers.clear();
+        b.FreeBuffers.shrink_to_fit();
+    }
+}
+
+FPixelBufferPoolStats GetStats()
+{
+    FPixelBufferPoolStats Stats;
+    Stats.NumAllocations = sNumAllocations.load();
+    Stats.NumSystemAllocations = sNumSystemAllocations.load();
+    Stats.NumSystemFrees = sNumSystemFrees.load();
+    Stats.NumBytesCached = sNumBytesCached.load();
+    Stats.PeakBytesCached = sPeakBytesCached.load();
+    return Stats;
+}
+
+void ResetStats()
+{
+    sNumAllocations = 0;
+    sNumSystemAllocations = 0;
+    sNumSystemFrees = 0;
+    sPeakBytesCached = sNumBytesCached.load();
+}
+
+}
@@ -0,0 +1,239 @@
+//	VQUtils
+//	Copyright(C) 2020 - Volkan Ilbeyli
+//
+//	This program is free software : you can redistribute it and / or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+//	Contact: volkanilbeyli@gmail.com
+
+#include "utils.h"
+#include "Log.h"
+
+#include <charconv>
+#include <cstring>
+
+// Formats 1M byte counts & numbers with the buffer versions against the previous ostringstream/string reversing
+// implementations, runs once on the first call to FormatByte().
+#define STRUTIL_RUN_FORMAT_BENCHMARK 0
+
+#if STRUTIL_RUN_FORMAT_BENCHMARK
+#include <chrono>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <vector>
+#endif
+
+// [EByteUnits][power]
+static const char* BYTE_UNIT_NAMES[3][7] =
+{
+	{ "B", "KB" , "MB" , "GB" , "TB" , "PB" , "EB"  },
+	{ "B", "KiB", "MiB", "GiB", "TiB", "PiB", "EiB" },
+	{ "B", "kB" , "MB" , "GB" , "TB" , "PB" , "EB"  },
+};
+
+// 64-bit integers & byte magnitudes with up to MAX_BYTE_PRECISION decimals fit in this
+constexpr size_t MAX_NUMBER_LENGTH = 48;
+constexpr int    MAX_BYTE_PRECISION = 20;
+
+// copies @s truncated to @BufferSize - 1 characters & null terminates, returns the number of characters copied
+static size_t CopyToBuffer(char* pBuffer, size_t BufferSize, std::string_view s)
+{
+	if (BufferSize == 0)
+		return 0;
+	const size_t NumChars = s.size() < BufferSize - 1 ? s.size() : BufferSize - 1;
+	memcpy(pBuffer, s.data(), NumChars);
+	pBuffer[NumChars] = '\0';
+	return NumChars;
+}
+
+// writes @Digits with a @Separator every 3 digits from the right, the sign is kept in front
+static size_t GroupDigits(char* pBuffer, size_t BufferSize, std::string_view Digits, char Separator)
+{
+	if (BufferSize == 0)
+		return 0;
+
+	size_t NumSignChars = 0;
+	if (!Digits.empty() && (Digits[0] == '-' || Digits[0] == '+'))
+		NumSignChars = 1;
+
+	const size_t NumDigits = Digits.size() - NumSignChars;
+	const size_t NumSeparators = NumDigits > 0 ? (NumDigits - 1) / 3 : 0;
+	const size_t Length = Digits.size() + NumSeparators;
+	if (Length > BufferSize - 1)
+	{
+		// rare: group into a temporary big enough for any buffer that's too small & truncate
+		char Grouped[MAX_NUMBER_LENGTH];
+		if (Length > sizeof(Grouped) - 1)
+			return CopyToBuffer(pBuffer, BufferSize, Digits);
+		return CopyToBuffer(pBuffer, BufferSize, std::string_view(Grouped, GroupDigits(Grouped, sizeof(Grouped), Digits, Separator)));
+	}
+
+	char* pOut = pBuffer;
+	if (NumSignChars)
+		*pOut++ = Digits[0];
+	const char* pDigit = Digits.data() + NumSignChars;
+	for (size_t NumDigitsInGroup = NumDigits - NumSeparators * 3; NumDigitsInGroup > 0; --NumDigitsInGroup) // the leftmost group has 1-3 digits
+		*pOut++ = *pDigit++;
+	for (size_t iGroup = 0; iGroup < NumSeparators; ++iGroup)
+	{
+		pOut[0] = Separator;
+		pOut[1] = pDigit[0];
+		pOut[2] = pDigit[1];
+		pOut[3] = pDigit[2];
+		pOut += 4;
+		pDigit += 3;
+	}
+	*pOut = '\0';
+	return Length;
+}
+
+
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+//
+// Benchmark
+//
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+#if STRUTIL_RUN_FORMAT_BENCHMARK
+// previous implementations, for comparison
+static std::string FormatByte_Legacy(unsigned long long bytes)
+{
+	std::string unit = "B";
+	double newMagnitudeInUnits = static_cast<double>(bytes);
+	if (bytes > 1024ull)                        { unit = "KB"; newMagnitudeInUnits /= 1024.0; }
+	if (bytes > 1024ull * 1024)                 { unit = "MB"; newMagnitudeInUnits /= 1024.0; }
+	if (bytes > 1024ull * 1024 * 1024)          { unit = "GB"; newMagnitudeInUnits /= 1024.0; }
+	if (bytes > 1024ull * 1024 * 1024 * 1024)   { unit = "TB"; newMagnitudeInUnits /= 1024.0; }
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(0) << newMagnitudeInUnits << unit;
+	return ss.str();
+}
+static std::string CommaSeparatedNumber_Legacy(const std::string& num)
+{
+	std::string _num = "";
+	int i = 0;
+	for (auto it = num.rbegin(); it != num.rend(); ++it)
+	{
+		if (i % 3 == 0 && i != 0)
+			_num += ",";
+		_num += *it;
+		++i;
+	}
+	return std::string(_num.rbegin(), _num.rend());
+}
+
+static void RUN_STRUTIL_FORMAT_BENCHMARK()
+{
+	static bool sbBenchmarkRun = false;
+	if (sbBenchmarkRun)
+		return;
+	sbBenchmarkRun = true;
+
+	constexpr size_t NUM_VALUES = 1000000;
+	std::mt19937_64 rng(42);
+	std::vector<unsigned long long> Values(NUM_VALUES);
+	std::vector<std::string> NumberStrings(NUM_VALUES);
+	for (size_t i = 0; i < NUM_VALUES; ++i)
+	{
+		Values[i] = rng() >> (rng() % 64);
+		NumberStrings[i] = std::to_string(Values[i]);
+	}
+
+	size_t Checksum = 0;
+	auto fnMeasure = [&](const char* pLabel, auto&& fnFormat)
+	{
+		const auto t0 = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < NUM_VALUES; ++i)
+			Checksum += fnFormat(i);
+		const auto t1 = std::chrono::high_resolution_clock::now();
+		const double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+		Log::Info("  %-36s : %7.2fms | %6.1f ns/call", pLabel, ms, ms * 1e6 / NUM_VALUES);
+	};
+
+	Log::Info("StrUtil Format Benchmark: %zu values", NUM_VALUES);
+	char Buffer[64];
+	fnMeasure("FormatByte (previous)", [&](size_t i) { return FormatByte_Legacy(Values[i]).size(); });
+	fnMeasure("FormatByte -> std::string", [&](size_t i) { return StrUtil::FormatByte(Values[i]).size(); });
+	fnMeasure("FormatByte -> char buffer", [&](size_t i) { return StrUtil::FormatByte(Buffer, sizeof(Buffer), Values[i]); });
+	fnMeasure("FormatByte -> char buffer, 2 decimals", [&](size_t i) { return StrUtil::FormatByte(Buffer, sizeof(Buffer), Values[i], 2, StrUtil::EByteUnits::IEC); });
+	fnMeasure("FormatByte -> FInlineString", [&](size_t i) { StrUtil::FInlineString<31> s; return StrUtil::FormatByte(s, Values[i]).size(); });
+	fnMeasure("CommaSeparatedNumber (previous)", [&](size_t i) { return CommaSeparatedNumber_Legacy(NumberStrings[i]).size(); });
+	fnMeasure("CommaSeparatedNumber -> std::string", [&](size_t i) { return StrUtil::CommaSeparatedNumber(NumberStrings[i]).size(); });
+	fnMeasure("CommaSeparatedNumber -> char buffer", [&](size_t i) { return StrUtil::CommaSeparatedNumber(Buffer, sizeof(Buffer), static_cast<long long>(Values[i] >> 1)); });
+	Log::Info("  checksum: %zu", Checksum);
+}
+#endif
+
+
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+//
+// StrUtil
+//
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+namespace StrUtil
+{
+	size_t FormatByte(char* pBuffer, size_t BufferSize, unsigned long long Bytes, int Precision, EByteUnits Units)
+	{
+#if STRUTIL_RUN_FORMAT_BENCHMARK
+		RUN_STRUTIL_FORMAT_BENCHMARK();
+#endif
+		// the next unit is picked once the value exceeds the base (1024 -> "1024B"), JEDEC stops at TB like the previous FormatByte()
+		const unsigned long long Base = Units == EByteUnits::SI ? 1000ull : 1024ull;
+		const int MaxPower = Units == EByteUnits::JEDEC ? 4 : 6;
+		unsigned long long Divisor = 1;
+		int Power = 0;
+		while (Power < MaxPower && Bytes > Divisor * Base)
+		{
+			Divisor *= Base;
+			++Power;
+		}
+
+		char Formatted[MAX_NUMBER_LENGTH];
+		char* pEnd = Formatted + sizeof(Formatted);
+		char* pOut = Power == 0
+			? std::to_chars(Formatted, pEnd, Bytes).ptr
+			: std::to_chars(Formatted, pEnd, static_cast<double>(Bytes) / static_cast<double>(Divisor), std::chars_format::fixed
+				, Precision < 0 ? 0 : (Precision > MAX_BYTE_PRECISION ? MAX_BYTE_PRECISION : Precision)).ptr;
+
+		const char* pUnit = BYTE_UNIT_NAMES[static_cast<int>(Units)][Power];
+		const size_t UnitLength = strlen(pUnit);
+		memcpy(pOut, pUnit, UnitLength);
+		pOut += UnitLength;
+		return CopyToBuffer(pBuffer, BufferSize, std::string_view(Formatted, pOut - Formatted));
+	}
+
+	size_t CommaSeparatedNumber(char* pBuffer, size_t BufferSize, long long Number, char Separator)
+	{
+		char Digits[MAX_NUMBER_LENGTH];
+		const std::to_chars_result ToChars = std::to_chars(Digits, Digits + sizeof(Digits), Number);
+		return GroupDigits(pBuffer, BufferSize, std::string_view(Digits, ToChars.ptr - Digits), Separator);
+	}
+
+	size_t CommaSeparatedNumber(char* pBuffer, size_t BufferSize, std::string_view Digits, char Separator)
+	{
+		return GroupDigits(pBuffer, BufferSize, Digits, Separator);
+	}
+
+	std::string FormatByte(unsigned long long bytes)
+	{
+		char Buffer[MAX_NUMBER_LENGTH];
+		return std::string(Buffer, FormatByte(Buffer, sizeof(Buffer), bytes));
+	}
+
+	std::string CommaSeparatedNumber(const std::string& num)
+	{
+		std::string Grouped(num.size() + num.size() / 3 + 1, '\0');
+		Grouped.resize(GroupDigits(Grouped.data(), Grouped.size(), num, ','));
+		return Grouped;
+	}
+}
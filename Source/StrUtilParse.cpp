@@ -0,0 +1,383 @@
+//	VQUtils
+//	Copyright(C) 2020 - Volkan Ilbeyli
+//
+//	This program is free software : you can redistribute it and / or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+//	Contact: volkanilbeyli@gmail.com
+
+#include "utils.h"
+#include "SystemInfo.h"
+#include "Log.h"
+
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include <charconv>
+#include <limits>
+#include <type_traits>
+#include <cstring>
+
+// Parses columns of integers & floats with the Try*() parsers against the previous atoi/atof/istringstream
+// implementations and std::from_chars(), runs once on the first call to TryParseInt().
+#define STRUTIL_RUN_PARSE_BENCHMARK 0
+
+#if STRUTIL_RUN_PARSE_BENCHMARK
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <vector>
+#endif
+
+using VQSystemInfo::ESIMDLevel;
+using StrUtil::EParseError;
+using StrUtil::FParseResult;
+
+// any 19 decimal digits fit in 64 bits
+constexpr size_t MAX_NUM_DIGITS_WITHOUT_OVERFLOW = 19;
+
+static inline unsigned FindLowestSetBit(uint32_t Mask) // @Mask != 0
+{
+#ifdef _MSC_VER
+	unsigned long Index;
+	_BitScanForward(&Index, Mask);
+	return Index;
+#else
+	return __builtin_ctz(Mask);
+#endif
+}
+
+// Converts 8 digits at @p if they are all digits, 8 bytes at once in a 64-bit register.
+// https://lemire.me/blog/2022/01/21/swar-explained-parsing-eight-digits/
+static inline bool ParseEightDigits_SWAR(const char* p, uint32_t& Value)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	const bool bAllDigits = ((v & 0xF0F0F0F0F0F0F0F0ull) | (((v + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull;
+	if (!bAllDigits)
+		return false;
+	v -= 0x3030303030303030ull;
+	v = (v * 10) + (v >> 8); // 2-digit values in every other byte
+	v = (((v & 0x000000FF000000FFull) * (100 + (1000000ull << 32))) + (((v >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))) >> 32;
+	Value = static_cast<uint32_t>(v);
+	return true;
+}
+
+// Converts the run of up to 16 digits at the start of the 16 bytes at @p, returns the number of digits.
+// The digits are right-aligned with a byte shuffle so their place values line up with the multipliers of the
+// 2, 4 & 8-digit multiply-adds. Requires SSSE3 & SSE4.1, implied by ESIMDLevel::SSE42.
+static inline unsigned ParseDigits16_SSE42(const char* p, uint64_t& Value)
+{
+	alignas(16) static const int8_t RIGHT_ALIGN_SHUFFLE[32] =
+	{
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15
+	};
+
+	const __m128i v = _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), _mm_set1_epi8('0'));
+	const __m128i vIsDigit = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(9)), v);
+	const uint32_t NotDigitMask = ~static_cast<uint32_t>(_mm_movemask_epi8(vIsDigit)) & 0xFFFF;
+	const unsigned NumDigits = NotDigitMask ? FindLowestSetBit(NotDigitMask) : 16;
+
+	const __m128i vShuffle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(RIGHT_ALIGN_SHUFFLE + NumDigits));
+	const __m128i vDigits = _mm_shuffle_epi8(v, vShuffle); // leading lanes are zeroed
+	const __m128i v2 = _mm_maddubs_epi16(vDigits, _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1));
+	const __m128i v4 = _mm_madd_epi16(v2, _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1));
+	const __m128i v8 = _mm_madd_epi16(_mm_packus_epi32(v4, v4), _mm_setr_epi16(10000, 1, 10000, 1, 10000, 1, 10000, 1));
+	Value = static_cast<uint64_t>(static_cast<uint32_t>(_mm_cvtsi128_si32(v8))) * 100000000ull
+		+ static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(v8, 4)));
+	return NumDigits;
+}
+
+// Converts the decimal digits at the start of [p, pEnd) into @Value, returns the end of the digits.
+// @bOverflow is set if the number doesn't fit in 64 bits, in which case the digits are still consumed.
+static const char* ParseDecimalDigits(const char* p, const char* pEnd, ESIMDLevel SIMDLevel, uint64_t& Value, bool& bOverflow)
+{
+	Value = 0;
+	bOverflow = false;
+
+	while (p != pEnd && *p == '0') // leading zeros don't count towards MAX_NUM_DIGITS_WITHOUT_OVERFLOW
+		++p;
+
+	size_t NumDigits = 0;
+	if (SIMDLevel >= ESIMDLevel::SSE42 && pEnd - p >= 16)
+	{
+		NumDigits = ParseDigits16_SSE42(p, Value);
+		p += NumDigits;
+		if (NumDigits < 16)
+			return p;
+	}
+	else
+	{
+		uint32_t EightDigits;
+		while (pEnd - p >= 8 && NumDigits + 8 <= MAX_NUM_DIGITS_WITHOUT_OVERFLOW && ParseEightDigits_SWAR(p, EightDigits))
+		{
+			Value = Value * 100000000ull + EightDigits;
+			p += 8;
+			NumDigits += 8;
+		}
+	}
+
+	for (; p != pEnd; ++p, ++NumDigits)
+	{
+		const unsigned Digit = static_cast<unsigned char>(*p - '0');
+		if (Digit > 9)
+			break;
+		if (NumDigits >= MAX_NUM_DIGITS_WITHOUT_OVERFLOW && !bOverflow)
+			bOverflow = Value > (std::numeric_limits<uint64_t>::max() - Digit) / 10;
+		if (!bOverflow)
+			Value = Value * 10 + Digit;
+	}
+	return p;
+}
+
+template<class T>
+static FParseResult<T> ParseInteger(std::string_view s, ESIMDLevel SIMDLevel)
+{
+	FParseResult<T> Result;
+	const char* pBegin = s.data();
+	const char* pEnd = pBegin + s.size();
+	const char* p = pBegin;
+
+	bool bNegative = false;
+	if (p != pEnd && (*p == '-' || *p == '+'))
+	{
+		bNegative = *p == '-';
+		++p;
+	}
+	if (bNegative && !std::is_signed_v<T>)
+		return Result;
+
+	uint64_t Magnitude = 0;
+	bool bOverflow = false;
+	const char* pDigits = p;
+	p = ParseDecimalDigits(p, pEnd, SIMDLevel, Magnitude, bOverflow);
+	if (p == pDigits)
+		return Result;
+
+	Result.NumCharsConsumed = p - pBegin;
+	const uint64_t MaxMagnitude = static_cast<uint64_t>(std::numeric_limits<T>::max()) + (bNegative ? 1 : 0);
+	if (bOverflow || Magnitude > MaxMagnitude)
+	{
+		Result.Error = EParseError::OUT_OF_RANGE;
+		return Result;
+	}
+	Result.Value = static_cast<T>(bNegative ? 0 - Magnitude : Magnitude);
+	Result.Error = EParseError::NONE;
+	return Result;
+}
+
+template<class T>
+static FParseResult<T> ParseFloatingPoint(std::string_view s)
+{
+	FParseResult<T> Result;
+	const char* pBegin = s.data();
+	const char* pEnd = pBegin + s.size();
+	const char* p = pBegin;
+
+	// std::from_chars() accepts '-' but not '+'
+	if (p != pEnd && *p == '+')
+	{
+		++p;
+		if (p != pEnd && *p == '-')
+			return Result;
+	}
+
+	T Value = T();
+	const std::from_chars_result FromChars = std::from_chars(p, pEnd, Value, std::chars_format::general);
+	if (FromChars.ec == std::errc::invalid_argument)
+		return Result;
+
+	Result.NumCharsConsumed = FromChars.ptr - pBegin;
+	if (FromChars.ec == std::errc::result_out_of_range)
+	{
+		Result.Error = EParseError::OUT_OF_RANGE;
+		return Result;
+	}
+	Result.Value = Value;
+	Result.Error = EParseError::NONE;
+	return Result;
+}
+
+static inline bool StartsWithIgnoreCase(std::string_view s, std::string_view Lowercase)
+{
+	if (s.size() < Lowercase.size())
+		return false;
+	for (size_t i = 0; i < Lowercase.size(); ++i)
+		if ((s[i] | 0x20) != Lowercase[i])
+			return false;
+	return true;
+}
+
+
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+//
+// Benchmark
+//
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+#if STRUTIL_RUN_PARSE_BENCHMARK
+static void RUN_STRUTIL_PARSE_BENCHMARK()
+{
+	static bool sbBenchmarkRun = false;
+	if (sbBenchmarkRun)
+		return;
+	sbBenchmarkRun = true;
+
+	constexpr size_t NUM_VALUES = 1000000;
+	constexpr int    NUM_ITERATIONS = 4;
+
+	// columns of ints of 1-10 digits, 16-19 digit ids & floats in various notations
+	std::mt19937_64 rng(42);
+	std::vector<std::string> Ints(NUM_VALUES), LongInts(NUM_VALUES), Floats(NUM_VALUES);
+	for (size_t i = 0; i < NUM_VALUES; ++i)
+	{
+		int Modulus = 10;
+		for (int NumDigits = 1 + static_cast<int>(rng() % 9); NumDigits > 1; --NumDigits)
+			Modulus *= 10;
+		const int Value = static_cast<int>(rng() % Modulus);
+		Ints[i] = std::to_string(rng() % 4 == 0 ? -Value : Value);
+		LongInts[i] = std::to_string(1000000000000000ull + rng() % 9000000000000000000ull);
+		std::uniform_real_distribution<float> Distribution(-1000.0f, 1000.0f);
+		char Buffer[32];
+		snprintf(Buffer, sizeof(Buffer), (i % 3 == 0) ? "%.3e" : "%.6f", Distribution(rng));
+		Floats[i] = Buffer;
+	}
+
+	size_t Checksum = 0;
+	auto fnMeasure = [&](const char* pColumn, const char* pLabel, auto&& fnParse)
+	{
+		const auto t0 = std::chrono::high_resolution_clock::now();
+		for (int it = 0; it < NUM_ITERATIONS; ++it)
+			Checksum += fnParse();
+		const auto t1 = std::chrono::high_resolution_clock::now();
+		const double ms = std::chrono::duration<double, std::milli>(t1 - t0).count() / NUM_ITERATIONS;
+		Log::Info("  %-9s %-22s : %7.2fms | %6.1f M values/s", pColumn, pLabel, ms, NUM_VALUES / (ms * 1000.0));
+	};
+
+	Log::Info("StrUtil Parse Benchmark: %zu values per column", NUM_VALUES);
+	const ESIMDLevel SIMDLevel = VQSystemInfo::GetSIMDLevel();
+	const struct { const char* pName; const std::vector<std::string>* pColumn; } IntColumns[] = { { "int", &Ints }, { "long int", &LongInts } };
+	for (const auto& Column : IntColumns)
+	{
+		const std::vector<std::string>& Values = *Column.pColumn;
+		fnMeasure(Column.pName, "atoll (previous)", [&]() { long long Sum = 0; for (const std::string& s : Values) Sum += std::atoll(s.c_str()); return static_cast<size_t>(Sum); });
+		fnMeasure(Column.pName, "std::from_chars", [&]()
+		{
+			long long Sum = 0;
+			for (const std::string& s : Values) { long long v = 0; std::from_chars(s.data(), s.data() + s.size(), v); Sum += v; }
+			return static_cast<size_t>(Sum);
+		});
+		fnMeasure(Column.pName, "TryParseInt64 SWAR", [&]()
+		{
+			long long Sum = 0;
+			for (const std::string& s : Values) Sum += ParseInteger<int64_t>(s, ESIMDLevel::SCALAR).Value;
+			return static_cast<size_t>(Sum);
+		});
+		if (SIMDLevel >= ESIMDLevel::SSE42)
+		{
+			fnMeasure(Column.pName, "TryParseInt64 SSE4.2", [&]()
+			{
+				long long Sum = 0;
+				for (const std::string& s : Values) Sum += ParseInteger<int64_t>(s, ESIMDLevel::SSE42).Value;
+				return static_cast<size_t>(Sum);
+			});
+		}
+	}
+
+	fnMeasure("float", "atof (previous)", [&]() { double Sum = 0; for (const std::string& s : Floats) Sum += std::atof(s.c_str()); return static_cast<size_t>(Sum); });
+	fnMeasure("float", "TryParseFloat", [&]() { double Sum = 0; for (const std::string& s : Floats) Sum += StrUtil::TryParseFloat(s).Value; return static_cast<size_t>(Sum); });
+
+	fnMeasure("bool", "istringstream (previous)", [&]()
+	{
+		size_t NumTrue = 0;
+		for (size_t i = 0; i < NUM_VALUES; ++i) { bool b = false; std::istringstream((i & 1) ? "true" : "false") >> std::boolalpha >> b; NumTrue += b; }
+		return NumTrue;
+	});
+	fnMeasure("bool", "TryParseBool", [&]()
+	{
+		size_t NumTrue = 0;
+		for (size_t i = 0; i < NUM_VALUES; ++i) NumTrue += StrUtil::TryParseBool((i & 1) ? "true" : "false").Value;
+		return NumTrue;
+	});
+	Log::Info("  checksum: %zu", Checksum);
+}
+#endif
+
+
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+//
+// StrUtil
+//
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+namespace StrUtil
+{
+	FParseResult<int> TryParseInt(std::string_view s)
+	{
+#if STRUTIL_RUN_PARSE_BENCHMARK
+		RUN_STRUTIL_PARSE_BENCHMARK();
+#endif
+		return ParseInteger<int>(s, VQSystemInfo::GetSIMDLevel());
+	}
+	FParseResult<int64_t>  TryParseInt64 (std::string_view s) { return ParseInteger<int64_t>(s, VQSystemInfo::GetSIMDLevel()); }
+	FParseResult<uint64_t> TryParseUInt64(std::string_view s) { return ParseInteger<uint64_t>(s, VQSystemInfo::GetSIMDLevel()); }
+	FParseResult<float>    TryParseFloat (std::string_view s) { return ParseFloatingPoint<float>(s); }
+	FParseResult<double>   TryParseDouble(std::string_view s) { return ParseFloatingPoint<double>(s); }
+
+	FParseResult<bool> TryParseBool(std::string_view s)
+	{
+		FParseResult<bool> Result;
+		if (StartsWithIgnoreCase(s, "true"))       { Result.Value = true;  Result.NumCharsConsumed = 4; }
+		else if (StartsWithIgnoreCase(s, "false")) { Result.Value = false; Result.NumCharsConsumed = 5; }
+		else if (!s.empty() && (s[0] == '1' || s[0] == '0')) { Result.Value = s[0] == '1'; Result.NumCharsConsumed = 1; }
+		else return Result;
+		Result.Error = EParseError::NONE;
+		return Result;
+	}
+
+	FParseResult<uint64_t> TryParseHex(std::string_view s)
+	{
+		FParseResult<uint64_t> Result;
+		const char* pBegin = s.data();
+		const char* pEnd = pBegin + s.size();
+		const bool bPrefix = s.size() >= 2 && s[0] == '0' && (s[1] | 0x20) == 'x';
+
+		uint64_t Value = 0;
+		const std::from_chars_result FromChars = std::from_chars(pBegin + (bPrefix ? 2 : 0), pEnd, Value, 16);
+		if (FromChars.ec == std::errc::invalid_argument)
+		{
+			if (bPrefix) // "0x" without hex digits is the number 0 followed by 'x'
+			{
+				Result.NumCharsConsumed = 1;
+				Result.Error = EParseError::NONE;
+			}
+			return Result;
+		}
+
+		Result.NumCharsConsumed = FromChars.ptr - pBegin;
+		if (FromChars.ec == std::errc::result_out_of_range)
+		{
+			Result.Error = EParseError::OUT_OF_RANGE;
+			return Result;
+		}
+		Result.Value = Value;
+		Result.Error = EParseError::NONE;
+		return Result;
+	}
+
+	bool  ParseBool (const std::string& s) { return TryParseBool (TrimView(s)).Value; }
+	int   ParseInt  (const std::string& s) { return TryParseInt  (TrimView(s)).Value; }
+	float ParseFloat(const std::string& s) { return TryParseFloat(TrimView(s)).Value; }
+}
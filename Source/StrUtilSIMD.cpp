@@ -0,0 +1,502 @@
+//	VQUtils
+//	Copyright(C) 2020 - Volkan Ilbeyli
+//
+//	This program is free software : you can redistribute it and / or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+//	Contact: volkanilbeyli@gmail.com
+
+#include "utils.h"
+#include "SystemInfo.h"
+#include "Log.h"
+
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include <cstring>
+#include <cstdint>
+
+// Measures case conversion, trim & IsNumber against the previous std::transform/std::tolower/std::isdigit
+// implementations for each SIMD level, runs once on the first call to one of them.
+#define STRUTIL_RUN_SIMD_BENCHMARK 0
+
+#if STRUTIL_RUN_SIMD_BENCHMARK
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <random>
+#include <vector>
+#endif
+
+using VQSystemInfo::ESIMDLevel;
+
+// strings shorter than a SSE2 register are processed with the scalar kernels without dispatching
+constexpr size_t SIMD_MIN_LENGTH = 16;
+
+namespace
+{
+	// Case conversion toggles bit 0x20 of the 26 letters starting at @FirstLetter: 'A' lowercases, 'a' uppercases.
+	// @pDst may be equal to @pSrc.
+	using FnConvertCase = void(*)(char* pDst, const char* pSrc, size_t Length, char FirstLetter);
+
+	// returns the index of the first non-whitespace character, @Length if there is none
+	using FnFindFirstNotWhitespace = size_t(*)(const char* pStr, size_t Length);
+
+	// returns the index past the last non-whitespace character, 0 if there is none
+	using FnFindEndOfNotWhitespace = size_t(*)(const char* pStr, size_t Length);
+
+	using FnIsAllDigits = bool(*)(const char* pStr, size_t Length);
+}
+
+static inline unsigned FindLowestSetBit(uint32_t Mask) // @Mask != 0
+{
+#ifdef _MSC_VER
+	unsigned long Index;
+	_BitScanForward(&Index, Mask);
+	return Index;
+#else
+	return __builtin_ctz(Mask);
+#endif
+}
+static inline unsigned FindHighestSetBit(uint32_t Mask) // @Mask != 0
+{
+#ifdef _MSC_VER
+	unsigned long Index;
+	_BitScanReverse(&Index, Mask);
+	return Index;
+#else
+	return 31 - __builtin_clz(Mask);
+#endif
+}
+
+static inline bool IsWhitespace(char c) { return c == ' ' || static_cast<unsigned char>(c - '\t') <= '\r' - '\t'; }
+
+
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+//
+// Scalar
+//
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+static void ConvertCase_Scalar(char* pDst, const char* pSrc, size_t Length, char FirstLetter)
+{
+	for (size_t i = 0; i < Length; ++i)
+	{
+		const char c = pSrc[i];
+		pDst[i] = static_cast<unsigned char>(c - FirstLetter) < 26 ? static_cast<char>(c ^ 0x20) : c;
+	}
+}
+static size_t FindFirstNotWhitespace_Scalar(const char* pStr, size_t Length)
+{
+	size_t i = 0;
+	while (i < Length && IsWhitespace(pStr[i]))
+		++i;
+	return i;
+}
+static size_t FindEndOfNotWhitespace_Scalar(const char* pStr, size_t Length)
+{
+	size_t i = Length;
+	while (i > 0 && IsWhitespace(pStr[i - 1]))
+		--i;
+	return i;
+}
+static bool IsAllDigits_Scalar(const char* pStr, size_t Length)
+{
+	for (size_t i = 0; i < Length; ++i)
+		if (static_cast<unsigned char>(pStr[i] - '0') > 9)
+			return false;
+	return true;
+}
+
+
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+//
+// SSE2
+//
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+// SSE2 only has signed byte comparisons: ranges are tested by subtracting the first value & comparing the unsigned minimum.
+static inline __m128i IsInRange_SSE2(__m128i v, __m128i vFirst, __m128i vLastMinusFirst)
+{
+	const __m128i vOffset = _mm_sub_epi8(v, vFirst);
+	return _mm_cmpeq_epi8(_mm_min_epu8(vOffset, vLastMinusFirst), vOffset);
+}
+static inline __m128i IsWhitespace_SSE2(__m128i v)
+{
+	return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), IsInRange_SSE2(v, _mm_set1_epi8('\t'), _mm_set1_epi8('\r' - '\t')));
+}
+
+static void ConvertCase_SSE2(char* pDst, const char* pSrc, size_t Length, char FirstLetter)
+{
+	if (Length < 16)
+		return ConvertCase_Scalar(pDst, pSrc, Length, FirstLetter);
+
+	const __m128i vFirstLetter = _mm_set1_epi8(FirstLetter);
+	const __m128i vLastMinusFirst = _mm_set1_epi8(25);
+	const __m128i vCaseBit = _mm_set1_epi8(0x20);
+	auto fnConvert16 = [&](size_t i)
+	{
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i));
+		const __m128i vIsLetter = IsInRange_SSE2(v, vFirstLetter, vLastMinusFirst);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i), _mm_xor_si128(v, _mm_and_si128(vIsLetter, vCaseBit)));
+	};
+
+	size_t i = 0;
+	for (; i + 16 <= Length; i += 16)
+		fnConvert16(i);
+
+	// the last 16 bytes overlap converted ones: converting is idempotent, so this also holds in-place where they are read back
+	if (i < Length)
+		fnConvert16(Length - 16);
+}
+static size_t FindFirstNotWhitespace_SSE2(const char* pStr, size_t Length)
+{
+	size_t i = 0;
+	for (; i + 16 <= Length; i += 16)
+	{
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pStr + i));
+		const uint32_t NotWhitespaceMask = ~static_cast<uint32_t>(_mm_movemask_epi8(IsWhitespace_SSE2(v))) & 0xFFFF;
+		if (NotWhitespaceMask)
+			return i + FindLowestSetBit(NotWhitespaceMask);
+	}
+	return i + FindFirstNotWhitespace_Scalar(pStr + i, Length - i);
+}
+static size_t FindEndOfNotWhitespace_SSE2(const char* pStr, size_t Length)
+{
+	size_t i = Length;
+	for (; i >= 16; i -= 16)
+	{
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pStr + i - 16));
+		const uint32_t NotWhitespaceMask = ~static_cast<uint32_t>(_mm_movemask_epi8(IsWhitespace_SSE2(v))) & 0xFFFF;
+		if (NotWhitespaceMask)
+			return i - 16 + FindHighestSetBit(NotWhitespaceMask) + 1;
+	}
+	return FindEndOfNotWhitespace_Scalar(pStr, i);
+}
+static bool IsAllDigits_SSE2(const char* pStr, size_t Length)
+{
+	const __m128i vZero = _mm_set1_epi8('0');
+	const __m128i vNine = _mm_set1_epi8(9);
+	size_t i = 0;
+	for (; i + 16 <= Length; i += 16)
+	{
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pStr + i));
+		if (_mm_movemask_epi8(IsInRange_SSE2(v, vZero, vNine)) != 0xFFFF)
+			return false;
+	}
+	return IsAllDigits_Scalar(pStr + i, Length - i);
+}
+
+
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+//
+// AVX2
+//
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+static inline __m256i IsInRange_AVX2(__m256i v, __m256i vFirst, __m256i vLastMinusFirst)
+{
+	const __m256i vOffset = _mm256_sub_epi8(v, vFirst);
+	return _mm256_cmpeq_epi8(_mm256_min_epu8(vOffset, vLastMinusFirst), vOffset);
+}
+static inline __m256i IsWhitespace_AVX2(__m256i v)
+{
+	return _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), IsInRange_AVX2(v, _mm256_set1_epi8('\t'), _mm256_set1_epi8('\r' - '\t')));
+}
+
+static void ConvertCase_AVX2(char* pDst, const char* pSrc, size_t Length, char FirstLetter)
+{
+	if (Length < 32)
+		return ConvertCase_SSE2(pDst, pSrc, Length, FirstLetter);
+
+	const __m256i vFirstLetter = _mm256_set1_epi8(FirstLetter);
+	const __m256i vLastMinusFirst = _mm256_set1_epi8(25);
+	const __m256i vCaseBit = _mm256_set1_epi8(0x20);
+	auto fnConvert32 = [&](size_t i)
+	{
+		const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i));
+		const __m256i vIsLetter = IsInRange_AVX2(v, vFirstLetter, vLastMinusFirst);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + i), _mm256_xor_si256(v, _mm256_and_si256(vIsLetter, vCaseBit)));
+	};
+
+	size_t i = 0;
+	for (; i + 32 <= Length; i += 32)
+		fnConvert32(i);
+	if (i < Length)
+		fnConvert32(Length - 32); // overlaps converted bytes, see ConvertCase_SSE2()
+	_mm256_zeroupper();
+}
+static size_t FindFirstNotWhitespace_AVX2(const char* pStr, size_t Length)
+{
+	size_t i = 0;
+	for (; i + 32 <= Length; i += 32)
+	{
+		const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pStr + i));
+		const uint32_t NotWhitespaceMask = ~static_cast<uint32_t>(_mm256_movemask_epi8(IsWhitespace_AVX2(v)));
+		if (NotWhitespaceMask)
+		{
+			_mm256_zeroupper();
+			return i + FindLowestSetBit(NotWhitespaceMask);
+		}
+	}
+	_mm256_zeroupper();
+	return i + FindFirstNotWhitespace_SSE2(pStr + i, Length - i);
+}
+static size_t FindEndOfNotWhitespace_AVX2(const char* pStr, size_t Length)
+{
+	size_t i = Length;
+	for (; i >= 32; i -= 32)
+	{
+		const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pStr + i - 32));
+		const uint32_t NotWhitespaceMask = ~static_cast<uint32_t>(_mm256_movemask_epi8(IsWhitespace_AVX2(v)));
+		if (NotWhitespaceMask)
+		{
+			_mm256_zeroupper();
+			return i - 32 + FindHighestSetBit(NotWhitespaceMask) + 1;
+		}
+	}
+	_mm256_zeroupper();
+	return FindEndOfNotWhitespace_SSE2(pStr, i);
+}
+static bool IsAllDigits_AVX2(const char* pStr, size_t Length)
+{
+	const __m256i vZero = _mm256_set1_epi8('0');
+	const __m256i vNine = _mm256_set1_epi8(9);
+	size_t i = 0;
+	for (; i + 32 <= Length; i += 32)
+	{
+		const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pStr + i));
+		if (static_cast<uint32_t>(_mm256_movemask_epi8(IsInRange_AVX2(v, vZero, vNine))) != 0xFFFFFFFFu)
+		{
+			_mm256_zeroupper();
+			return false;
+		}
+	}
+	_mm256_zeroupper();
+	return IsAllDigits_SSE2(pStr + i, Length - i);
+}
+
+
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+//
+// Dispatch
+//
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+static FnConvertCase GetConvertCaseFunction(ESIMDLevel SIMDLevel)
+{
+	switch (SIMDLevel)
+	{
+	case ESIMDLevel::AVX2 : return ConvertCase_AVX2;
+	case ESIMDLevel::SSE42:
+	case ESIMDLevel::SSE2 : return ConvertCase_SSE2;
+	default: break;
+	}
+	return ConvertCase_Scalar;
+}
+static FnFindFirstNotWhitespace GetFindFirstNotWhitespaceFunction(ESIMDLevel SIMDLevel)
+{
+	switch (SIMDLevel)
+	{
+	case ESIMDLevel::AVX2 : return FindFirstNotWhitespace_AVX2;
+	case ESIMDLevel::SSE42:
+	case ESIMDLevel::SSE2 : return FindFirstNotWhitespace_SSE2;
+	default: break;
+	}
+	return FindFirstNotWhitespace_Scalar;
+}
+static FnFindEndOfNotWhitespace GetFindEndOfNotWhitespaceFunction(ESIMDLevel SIMDLevel)
+{
+	switch (SIMDLevel)
+	{
+	case ESIMDLevel::AVX2 : return FindEndOfNotWhitespace_AVX2;
+	case ESIMDLevel::SSE42:
+	case ESIMDLevel::SSE2 : return FindEndOfNotWhitespace_SSE2;
+	default: break;
+	}
+	return FindEndOfNotWhitespace_Scalar;
+}
+static FnIsAllDigits GetIsAllDigitsFunction(ESIMDLevel SIMDLevel)
+{
+	switch (SIMDLevel)
+	{
+	case ESIMDLevel::AVX2 : return IsAllDigits_AVX2;
+	case ESIMDLevel::SSE42:
+	case ESIMDLevel::SSE2 : return IsAllDigits_SSE2;
+	default: break;
+	}
+	return IsAllDigits_Scalar;
+}
+
+static inline ESIMDLevel GetSIMDLevelForLength(size_t Length)
+{
+	return Length < SIMD_MIN_LENGTH ? ESIMDLevel::SCALAR : VQSystemInfo::GetSIMDLevel();
+}
+
+
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+//
+// Benchmark
+//
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+#if STRUTIL_RUN_SIMD_BENCHMARK
+static void RUN_STRUTIL_SIMD_BENCHMARK()
+{
+	static bool sbBenchmarkRun = false;
+	if (sbBenchmarkRun)
+		return;
+	sbBenchmarkRun = true;
+
+	constexpr size_t NUM_CHARS = 64 * 1024 * 1024;
+	constexpr int    NUM_ITERATIONS = 8;
+
+	// mixed case text for case conversion, a digit string for IsNumber & a whitespace padded word for trim
+	std::string Text(NUM_CHARS, ' ');
+	std::mt19937 rng(42);
+	const char Alphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 _-./\\";
+	for (char& c : Text)
+		c = Alphabet[rng() % (sizeof(Alphabet) - 1)];
+	const std::string Digits(NUM_CHARS, '7');
+	std::string Padded(NUM_CHARS, ' ');
+	for (size_t i = 0; i < NUM_CHARS; i += 7)
+		Padded[i] = "\t\n\r "[i % 4];
+	Padded[NUM_CHARS / 2] = 'x';
+	std::string Output(NUM_CHARS, '\0');
+
+	size_t Checksum = 0;
+	auto fnMeasure = [&](const char* pLabel, const char* pSIMDLevel, auto&& fnRun)
+	{
+		fnRun(); // warm up
+		const auto t0 = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < NUM_ITERATIONS; ++i)
+			Checksum += fnRun();
+		const auto t1 = std::chrono::high_resolution_clock::now();
+		const double ms = std::chrono::duration<double, std::milli>(t1 - t0).count() / NUM_ITERATIONS;
+		Log::Info("  %-14s %-8s : %7.2fms | %6.2f GB/s", pLabel, pSIMDLevel, ms, NUM_CHARS / (ms * 1e6));
+	};
+
+	Log::Info("StrUtil SIMD Benchmark: %.1f MB strings", NUM_CHARS / (1024.0 * 1024.0));
+	fnMeasure("Lowercase", "Previous", [&]()
+	{
+		std::transform(Text.begin(), Text.end(), Output.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		return static_cast<size_t>(Output[NUM_CHARS / 3]);
+	});
+	fnMeasure("Trim", "Previous", [&]()
+	{
+		return Padded.find_first_not_of(" \n\r\t\f\v") + Padded.find_last_not_of(" \n\r\t\f\v");
+	});
+	fnMeasure("IsNumber", "Previous", [&]()
+	{
+		return static_cast<size_t>(std::all_of(Digits.begin(), Digits.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)) != 0; }));
+	});
+
+	const ESIMDLevel SupportedSIMDLevel = VQSystemInfo::GetSIMDLevel();
+	const ESIMDLevel SIMDLevels[] = { ESIMDLevel::SCALAR, ESIMDLevel::SSE2, ESIMDLevel::AVX2 };
+	const char* SIMDLevelNames[] = { "Scalar", "SSE2", "AVX2" };
+	for (int iLevel = 0; iLevel < 3; ++iLevel)
+	{
+		const ESIMDLevel SIMDLevel = SIMDLevels[iLevel];
+		if (SIMDLevel > SupportedSIMDLevel)
+			continue;
+		const FnConvertCase            fnConvertCase = GetConvertCaseFunction(SIMDLevel);
+		const FnFindFirstNotWhitespace fnFindFirst = GetFindFirstNotWhitespaceFunction(SIMDLevel);
+		const FnFindEndOfNotWhitespace fnFindEnd = GetFindEndOfNotWhitespaceFunction(SIMDLevel);
+		const FnIsAllDigits            fnIsAllDigits = GetIsAllDigitsFunction(SIMDLevel);
+		fnMeasure("Lowercase", SIMDLevelNames[iLevel], [&]()
+		{
+			fnConvertCase(Output.data(), Text.data(), NUM_CHARS, 'A');
+			return static_cast<size_t>(Output[NUM_CHARS / 3]);
+		});
+		fnMeasure("Trim", SIMDLevelNames[iLevel], [&]() { return fnFindFirst(Padded.data(), NUM_CHARS) + fnFindEnd(Padded.data(), NUM_CHARS); });
+		fnMeasure("IsNumber", SIMDLevelNames[iLevel], [&]() { return static_cast<size_t>(fnIsAllDigits(Digits.data(), NUM_CHARS)); });
+	}
+	Log::Info("  checksum: %zu", Checksum);
+}
+#endif
+
+
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+//
+// StrUtil
+//
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+namespace StrUtil
+{
+	bool IsNumber(std::string_view s)
+	{
+#if STRUTIL_RUN_SIMD_BENCHMARK
+		RUN_STRUTIL_SIMD_BENCHMARK();
+#endif
+		return !s.empty() && GetIsAllDigitsFunction(GetSIMDLevelForLength(s.size()))(s.data(), s.size());
+	}
+
+	std::string_view TrimView(std::string_view s)
+	{
+#if STRUTIL_RUN_SIMD_BENCHMARK
+		RUN_STRUTIL_SIMD_BENCHMARK();
+#endif
+		const ESIMDLevel SIMDLevel = GetSIMDLevelForLength(s.size());
+		const size_t Begin = GetFindFirstNotWhitespaceFunction(SIMDLevel)(s.data(), s.size());
+		if (Begin == s.size())
+			return std::string_view();
+		const size_t End = GetFindEndOfNotWhitespaceFunction(SIMDLevel)(s.data() + Begin, s.size() - Begin) + Begin;
+		return s.substr(Begin, End - Begin);
+	}
+
+	std::string trim(std::string_view s)
+	{
+		return std::string(TrimView(s));
+	}
+
+	void TrimInPlace(std::string& s)
+	{
+		const std::string_view Trimmed = TrimView(s);
+		if (Trimmed.empty())
+		{
+			s.clear();
+			return;
+		}
+		const size_t Begin = Trimmed.data() - s.data();
+		s.erase(Begin + Trimmed.size());
+		s.erase(0, Begin);
+	}
+
+	void MakeLowercase(char* pStr, size_t Length)
+	{
+#if STRUTIL_RUN_SIMD_BENCHMARK
+		RUN_STRUTIL_SIMD_BENCHMARK();
+#endif
+		GetConvertCaseFunction(GetSIMDLevelForLength(Length))(pStr, pStr, Length, 'A');
+	}
+	void MakeUppercase(char* pStr, size_t Length)
+	{
+		GetConvertCaseFunction(GetSIMDLevelForLength(Length))(pStr, pStr, Length, 'a');
+	}
+	void MakeLowercase(std::string& str) { MakeLowercase(str.data(), str.size()); }
+	void MakeUppercase(std::string& str) { MakeUppercase(str.data(), str.size()); }
+
+	std::string GetLowercased(std::string_view str)
+	{
+#if STRUTIL_RUN_SIMD_BENCHMARK
+		RUN_STRUTIL_SIMD_BENCHMARK();
+#endif
+		std::string lowercased(str.size(), '\0');
+		GetConvertCaseFunction(GetSIMDLevelForLength(str.size()))(lowercased.data(), str.data(), str.size(), 'A');
+		return lowercased;
+	}
+
+	std::string GetUppercased(std::string_view str)
+	{
+		std::string uppercased(str.size(), '\0');
+		GetConvertCaseFunction(GetSIMDLevelForLength(str.size()))(uppercased.data(), str.data(), str.size(), 'a');
+		return uppercased;
+	}
+}
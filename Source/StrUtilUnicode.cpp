@@ -0,0 +1,758 @@
+//	VQUtils
+//	Copyright(C) 2020 - Volkan Ilbeyli
+//
+//	This program is free software : you can redistribute it and / or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+//
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with this program.If not, see <http://www.gnu.org/licenses/>.
+//
+//	Contact: volkanilbeyli@gmail.com
+
+#include "utils.h"
+#include "SystemInfo.h"
+#include "Log.h"
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cstdint>
+
+// Transcodes ASCII-heavy & mixed-script text for each SIMD level against the previous byte widening and
+// std::wstring_convert, runs once on the first call to ToUTF16() or ToWide().
+#define STRUTIL_RUN_UNICODE_BENCHMARK 0
+
+#if STRUTIL_RUN_UNICODE_BENCHMARK
+#include <chrono>
+#include <locale>
+#include <random>
+#include <vector>
+#endif
+
+using VQSystemInfo::ESIMDLevel;
+using StrUtil::EUnicodeError;
+using StrUtil::FTranscodeResult;
+
+constexpr char32_t REPLACEMENT_CHARACTER = 0xFFFD;
+
+template<class TUnit> static inline uint32_t ToCodeUnit(TUnit c) { return static_cast<std::make_unsigned_t<TUnit>>(c); }
+
+namespace
+{
+	// Decode() returns the number of code units of the code point at @p, 0 if the sequence is invalid.
+	// GetEncodedLength() & Encode() expect valid code points.
+	struct FUTF8Codec
+	{
+		using Unit = char;
+		static inline size_t Decode(const char* pChars, size_t Remaining, char32_t& CodePoint)
+		{
+			const uint8_t* p = reinterpret_cast<const uint8_t*>(pChars);
+			const uint8_t b0 = p[0];
+			if (b0 < 0x80)
+			{
+				CodePoint = b0;
+				return 1;
+			}
+			if (b0 < 0xC2) // continuation byte or overlong 2-byte sequence
+				return 0;
+			if (b0 < 0xE0)
+			{
+				if (Remaining < 2 || (p[1] & 0xC0) != 0x80)
+					return 0;
+				CodePoint = ((b0 & 0x1F) << 6) | (p[1] & 0x3F);
+				return 2;
+			}
+			if (b0 < 0xF0)
+			{
+				// E0 is followed by A0-BF (overlongs), ED by 80-9F (surrogates)
+				const uint8_t Min = b0 == 0xE0 ? 0xA0 : 0x80;
+				const uint8_t Max = b0 == 0xED ? 0x9F : 0xBF;
+				if (Remaining < 3 || p[1] < Min || p[1] > Max || (p[2] & 0xC0) != 0x80)
+					return 0;
+				CodePoint = ((b0 & 0x0F) << 12) | ((p[1] & 0x3F) << 6) | (p[2] & 0x3F);
+				return 3;
+			}
+			if (b0 < 0xF5)
+			{
+				// F0 is followed by 90-BF (overlongs), F4 by 80-8F (past U+10FFFF)
+				const uint8_t Min = b0 == 0xF0 ? 0x90 : 0x80;
+				const uint8_t Max = b0 == 0xF4 ? 0x8F : 0xBF;
+				if (Remaining < 4 || p[1] < Min || p[1] > Max || (p[2] & 0xC0) != 0x80 || (p[3] & 0xC0) != 0x80)
+					return 0;
+				CodePoint = ((b0 & 0x07) << 18) | ((p[1] & 0x3F) << 12) | ((p[2] & 0x3F) << 6) | (p[3] & 0x3F);
+				return 4;
+			}
+			return 0;
+		}
+		static inline size_t GetEncodedLength(char32_t CodePoint)
+		{
+			return CodePoint < 0x80 ? 1 : (CodePoint < 0x800 ? 2 : (CodePoint < 0x10000 ? 3 : 4));
+		}
+		static inline void Encode(char32_t CodePoint, char* p)
+		{
+			if (CodePoint < 0x80)
+			{
+				p[0] = static_cast<char>(CodePoint);
+			}
+			else if (CodePoint < 0x800)
+			{
+				p[0] = static_cast<char>(0xC0 | (CodePoint >> 6));
+				p[1] = static_cast<char>(0x80 | (CodePoint & 0x3F));
+			}
+			else if (CodePoint < 0x10000)
+			{
+				p[0] = static_cast<char>(0xE0 | (CodePoint >> 12));
+				p[1] = static_cast<char>(0x80 | ((CodePoint >> 6) & 0x3F));
+				p[2] = static_cast<char>(0x80 | (CodePoint & 0x3F));
+			}
+			else
+			{
+				p[0] = static_cast<char>(0xF0 | (CodePoint >> 18));
+				p[1] = static_cast<char>(0x80 | ((CodePoint >> 12) & 0x3F));
+				p[2] = static_cast<char>(0x80 | ((CodePoint >> 6) & 0x3F));
+				p[3] = static_cast<char>(0x80 | (CodePoint & 0x3F));
+			}
+		}
+	};
+
+	// @TUnit is char16_t, or wchar_t on Windows
+	template<class TUnit> struct FUTF16Codec
+	{
+		using Unit = TUnit;
+		static inline size_t Decode(const TUnit* p, size_t Remaining, char32_t& CodePoint)
+		{
+			const uint32_t u0 = ToCodeUnit(p[0]);
+			if (u0 - 0xD800 >= 0x800) // not a surrogate
+			{
+				CodePoint = u0;
+				return 1;
+			}
+			if (u0 >= 0xDC00 || Remaining < 2) // unpaired low or high surrogate
+				return 0;
+			const uint32_t u1 = ToCodeUnit(p[1]);
+			if (u1 - 0xDC00 >= 0x400)
+				return 0;
+			CodePoint = 0x10000 + ((u0 - 0xD800) << 10) + (u1 - 0xDC00);
+			return 2;
+		}
+		static inline size_t GetEncodedLength(char32_t CodePoint) { return CodePoint < 0x10000 ? 1 : 2; }
+		static inline void Encode(char32_t CodePoint, TUnit* p)
+		{
+			if (CodePoint < 0x10000)
+			{
+				p[0] = static_cast<TUnit>(CodePoint);
+				return;
+			}
+			p[0] = static_cast<TUnit>(0xD800 + ((CodePoint - 0x10000) >> 10));
+			p[1] = static_cast<TUnit>(0xDC00 + ((CodePoint - 0x10000) & 0x3FF));
+		}
+	};
+
+	// @TUnit is char32_t, or wchar_t outside Windows
+	template<class TUnit> struct FUTF32Codec
+	{
+		using Unit = TUnit;
+		static inline size_t Decode(const TUnit* p, size_t, char32_t& CodePoint)
+		{
+			CodePoint = ToCodeUnit(p[0]);
+			return (CodePoint > 0x10FFFF || CodePoint - 0xD800 < 0x800) ? 0 : 1;
+		}
+		static inline size_t GetEncodedLength(char32_t) { return 1; }
+		static inline void Encode(char32_t CodePoint, TUnit* p) { p[0] = static_cast<TUnit>(CodePoint); }
+	};
+
+	using FWideCodec = std::conditional_t<sizeof(wchar_t) == 2, FUTF16Codec<wchar_t>, FUTF32Codec<wchar_t>>;
+
+	// Converts the leading ASCII characters of @pSrc, up to @Length, returns the number converted
+	template<class TSrc, class TDst> using FnConvertASCII = size_t(*)(const TSrc* pSrc, size_t Length, TDst* pDst);
+
+	using FnCountUTF8LeadBytes = void(*)(const char* p, size_t Length, size_t& NumLeadBytes, size_t& NumFourByteLeadBytes);
+	using FnGetUTF8LengthOfUTF16 = size_t(*)(const char16_t* p, size_t Length);
+	using FnGetUTF8LengthOfUTF32 = size_t(*)(const char32_t* p, size_t Length);
+}
+
+
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+//
+// Scalar
+//
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+template<class TSrc, class TDst>
+static size_t ConvertASCII_Scalar(const TSrc* pSrc, size_t Length, TDst* pDst)
+{
+	size_t i = 0;
+	for (; i < Length && ToCodeUnit(pSrc[i]) < 0x80; ++i)
+		pDst[i] = static_cast<TDst>(pSrc[i]);
+	return i;
+}
+
+static void CountUTF8LeadBytes_Scalar(const char* p, size_t Length, size_t& NumLeadBytes, size_t& NumFourByteLeadBytes)
+{
+	for (size_t i = 0; i < Length; ++i)
+	{
+		const uint8_t b = static_cast<uint8_t>(p[i]);
+		NumLeadBytes += (b & 0xC0) != 0x80;
+		NumFourByteLeadBytes += b >= 0xF0;
+	}
+}
+static size_t GetUTF8LengthOfUTF16_Scalar(const char16_t* p, size_t Length)
+{
+	size_t NumBytes = 0;
+	for (size_t i = 0; i < Length; ++i)
+	{
+		const uint32_t u = p[i];
+		const bool bSurrogate = u - 0xD800 < 0x800; // 2 bytes for each half of a 4-byte pair
+		NumBytes += 1 + (u >= 0x80) + (u >= 0x800 && !bSurrogate);
+	}
+	return NumBytes;
+}
+static size_t GetUTF8LengthOfUTF32_Scalar(const char32_t* p, size_t Length)
+{
+	size_t NumBytes = 0;
+	for (size_t i = 0; i < Length; ++i)
+		NumBytes += FUTF8Codec::GetEncodedLength(p[i]);
+	return NumBytes;
+}
+
+
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+//
+// SSE2
+//
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+static inline size_t HorizontalSumBytes_SSE2(__m128i v)
+{
+	const __m128i vSums = _mm_sad_epu8(v, _mm_setzero_si128());
+	return static_cast<size_t>(_mm_cvtsi128_si32(vSums)) + static_cast<size_t>(_mm_cvtsi128_si32(_mm_srli_si128(vSums, 8)));
+}
+
+template<class TDst>
+static size_t ConvertASCII_8To16_SSE2(const char* pSrc, size_t Length, TDst* pDst)
+{
+	static_assert(sizeof(TDst) == 2, "");
+	const __m128i vZero = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 16 <= Length; i += 16)
+	{
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i));
+		if (_mm_movemask_epi8(v))
+			break;
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i + 0), _mm_unpacklo_epi8(v, vZero));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i + 8), _mm_unpackhi_epi8(v, vZero));
+	}
+	return i + ConvertASCII_Scalar(pSrc + i, Length - i, pDst + i);
+}
+template<class TDst>
+static size_t ConvertASCII_8To32_SSE2(const char* pSrc, size_t Length, TDst* pDst)
+{
+	static_assert(sizeof(TDst) == 4, "");
+	const __m128i vZero = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 16 <= Length; i += 16)
+	{
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i));
+		if (_mm_movemask_epi8(v))
+			break;
+		const __m128i vLo = _mm_unpacklo_epi8(v, vZero);
+		const __m128i vHi = _mm_unpackhi_epi8(v, vZero);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i +  0), _mm_unpacklo_epi16(vLo, vZero));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i +  4), _mm_unpackhi_epi16(vLo, vZero));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i +  8), _mm_unpacklo_epi16(vHi, vZero));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i + 12), _mm_unpackhi_epi16(vHi, vZero));
+	}
+	return i + ConvertASCII_Scalar(pSrc + i, Length - i, pDst + i);
+}
+template<class TSrc>
+static size_t ConvertASCII_16To8_SSE2(const TSrc* pSrc, size_t Length, char* pDst)
+{
+	static_assert(sizeof(TSrc) == 2, "");
+	const __m128i vNonASCIIBits = _mm_set1_epi16(static_cast<short>(0xFF80));
+	size_t i = 0;
+	for (; i + 16 <= Length; i += 16)
+	{
+		const __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i + 0));
+		const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i + 8));
+		const __m128i vNonASCII = _mm_and_si128(_mm_or_si128(v0, v1), vNonASCIIBits);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi16(vNonASCII, _mm_setzero_si128())) != 0xFFFF)
+			break;
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i), _mm_packus_epi16(v0, v1));
+	}
+	return i + ConvertASCII_Scalar(pSrc + i, Length - i, pDst + i);
+}
+template<class TSrc>
+static size_t ConvertASCII_32To8_SSE2(const TSrc* pSrc, size_t Length, char* pDst)
+{
+	static_assert(sizeof(TSrc) == 4, "");
+	const __m128i vNonASCIIBits = _mm_set1_epi32(static_cast<int>(0xFFFFFF80));
+	size_t i = 0;
+	for (; i + 16 <= Length; i += 16)
+	{
+		const __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i +  0));
+		const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i +  4));
+		const __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i +  8));
+		const __m128i v3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i + 12));
+		const __m128i vNonASCII = _mm_and_si128(_mm_or_si128(_mm_or_si128(v0, v1), _mm_or_si128(v2, v3)), vNonASCIIBits);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(vNonASCII, _mm_setzero_si128())) != 0xFFFF)
+			break;
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i), _mm_packus_epi16(_mm_packs_epi32(v0, v1), _mm_packs_epi32(v2, v3)));
+	}
+	return i + ConvertASCII_Scalar(pSrc + i, Length - i, pDst + i);
+}
+
+// lead bytes are the bytes that aren't continuation bytes (80-BF), 4-byte sequences start with F0-F4
+static void CountUTF8LeadBytes_SSE2(const char* p, size_t Length, size_t& NumLeadBytes, size_t& NumFourByteLeadBytes)
+{
+	const __m128i vContinuationMax = _mm_set1_epi8(static_cast<char>(0xBF)); // signed compare: 80-BF are the smallest values
+	const __m128i vFourByteLeadMin = _mm_set1_epi8(static_cast<char>(0xF0));
+	size_t i = 0;
+	while (i + 16 <= Length)
+	{
+		// per byte counters, summed before they can overflow
+		__m128i vNumLeads = _mm_setzero_si128();
+		__m128i vNumFourByteLeads = _mm_setzero_si128();
+		const size_t NumBlocks = std::min<size_t>((Length - i) / 16, 255);
+		for (size_t iBlock = 0; iBlock < NumBlocks; ++iBlock, i += 16)
+		{
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+			vNumLeads = _mm_sub_epi8(vNumLeads, _mm_cmpgt_epi8(v, vContinuationMax));
+			vNumFourByteLeads = _mm_sub_epi8(vNumFourByteLeads, _mm_cmpeq_epi8(_mm_max_epu8(v, vFourByteLeadMin), v));
+		}
+		NumLeadBytes += HorizontalSumBytes_SSE2(vNumLeads);
+		NumFourByteLeadBytes += HorizontalSumBytes_SSE2(vNumFourByteLeads);
+	}
+	CountUTF8LeadBytes_Scalar(p + i, Length - i, NumLeadBytes, NumFourByteLeadBytes);
+}
+static size_t GetUTF8LengthOfUTF16_SSE2(const char16_t* p, size_t Length)
+{
+	// SSE2 only has signed 16-bit compares: flipping the sign bit orders the unsigned values
+	const __m128i vSignBit = _mm_set1_epi16(static_cast<short>(0x8000));
+	const __m128i v7F = _mm_set1_epi16(static_cast<short>(0x007F ^ 0x8000));
+	const __m128i v7FF = _mm_set1_epi16(static_cast<short>(0x07FF ^ 0x8000));
+	const __m128i vSurrogateMask = _mm_set1_epi16(static_cast<short>(0xF800));
+	const __m128i vSurrogate = _mm_set1_epi16(static_cast<short>(0xD800));
+	const __m128i vOne = _mm_set1_epi16(1);
+	size_t NumBytes = 0;
+	size_t i = 0;
+	while (i + 8 <= Length)
+	{
+		// per unit counters add up to 3 per block, summed before they can overflow
+		__m128i vNumBytes = _mm_setzero_si128();
+		const size_t NumBlocks = std::min<size_t>((Length - i) / 8, 8192);
+		for (size_t iBlock = 0; iBlock < NumBlocks; ++iBlock, i += 8)
+		{
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+			const __m128i vSigned = _mm_xor_si128(v, vSignBit);
+			vNumBytes = _mm_add_epi16(vNumBytes, vOne);
+			vNumBytes = _mm_sub_epi16(vNumBytes, _mm_cmpgt_epi16(vSigned, v7F));
+			vNumBytes = _mm_sub_epi16(vNumBytes, _mm_cmpgt_epi16(vSigned, v7FF));
+			vNumBytes = _mm_add_epi16(vNumBytes, _mm_cmpeq_epi16(_mm_and_si128(v, vSurrogateMask), vSurrogate));
+		}
+		const __m128i vSums = _mm_madd_epi16(vNumBytes, vOne);
+		alignas(16) int32_t Sums[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(Sums), vSums);
+		NumBytes += static_cast<size_t>(Sums[0]) + Sums[1] + Sums[2] + Sums[3];
+	}
+	return NumBytes + GetUTF8LengthOfUTF16_Scalar(p + i, Length - i);
+}
+
+
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+//
+// AVX2
+//
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+template<class TDst>
+static size_t ConvertASCII_8To16_AVX2(const char* pSrc, size_t Length, TDst* pDst)
+{
+	static_assert(sizeof(TDst) == 2, "");
+	size_t i = 0;
+	for (; i + 32 <= Length; i += 32)
+	{
+		const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i));
+		if (_mm256_movemask_epi8(v))
+			break;
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + i +  0), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + i + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1)));
+	}
+	_mm256_zeroupper();
+	return i + ConvertASCII_8To16_SSE2(pSrc + i, Length - i, pDst + i);
+}
+template<class TDst>
+static size_t ConvertASCII_8To32_AVX2(const char* pSrc, size_t Length, TDst* pDst)
+{
+	static_assert(sizeof(TDst) == 4, "");
+	size_t i = 0;
+	for (; i + 32 <= Length; i += 32)
+	{
+		const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i));
+		if (_mm256_movemask_epi8(v))
+			break;
+		const __m128i vLo = _mm256_castsi256_si128(v);
+		const __m128i vHi = _mm256_extracti128_si256(v, 1);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + i +  0), _mm256_cvtepu8_epi32(vLo));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + i +  8), _mm256_cvtepu8_epi32(_mm_srli_si128(vLo, 8)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + i + 16), _mm256_cvtepu8_epi32(vHi));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + i + 24), _mm256_cvtepu8_epi32(_mm_srli_si128(vHi, 8)));
+	}
+	_mm256_zeroupper();
+	return i + ConvertASCII_8To32_SSE2(pSrc + i, Length - i, pDst + i);
+}
+template<class TSrc>
+static size_t ConvertASCII_16To8_AVX2(const TSrc* pSrc, size_t Length, char* pDst)
+{
+	static_assert(sizeof(TSrc) == 2, "");
+	const __m256i vNonASCIIBits = _mm256_set1_epi16(static_cast<short>(0xFF80));
+	size_t i = 0;
+	for (; i + 32 <= Length; i += 32)
+	{
+		const __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i +  0));
+		const __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i + 16));
+		if (!_mm256_testz_si256(_mm256_or_si256(v0, v1), vNonASCIIBits))
+			break;
+		// packs interleave the 128-bit lanes of the 2 sources
+		const __m256i vPacked = _mm256_permute4x64_epi64(_mm256_packus_epi16(v0, v1), _MM_SHUFFLE(3, 1, 2, 0));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + i), vPacked);
+	}
+	_mm256_zeroupper();
+	return i + ConvertASCII_16To8_SSE2(pSrc + i, Length - i, pDst + i);
+}
+template<class TSrc>
+static size_t ConvertASCII_32To8_AVX2(const TSrc* pSrc, size_t Length, char* pDst)
+{
+	static_assert(sizeof(TSrc) == 4, "");
+	const __m256i vNonASCIIBits = _mm256_set1_epi32(static_cast<int>(0xFFFFFF80));
+	const __m256i vDwordOrder = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	size_t i = 0;
+	for (; i + 32 <= Length; i += 32)
+	{
+		const __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i +  0));
+		const __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i +  8));
+		const __m256i v2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i + 16));
+		const __m256i v3 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i + 24));
+		if (!_mm256_testz_si256(_mm256_or_si256(_mm256_or_si256(v0, v1), _mm256_or_si256(v2, v3)), vNonASCIIBits))
+			break;
+		// lanes hold [v0 v1 v2 v3] 0-3 | [v0 v1 v2 v3] 4-7 as dwords of 4 characters after the packs
+		const __m256i vPacked = _mm256_packus_epi16(_mm256_packus_epi32(v0, v1), _mm256_packus_epi32(v2, v3));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + i), _mm256_permutevar8x32_epi32(vPacked, vDwordOrder));
+	}
+	_mm256_zeroupper();
+	return i + ConvertASCII_32To8_SSE2(pSrc + i, Length - i, pDst + i);
+}
+
+static void CountUTF8LeadBytes_AVX2(const char* p, size_t Length, size_t& NumLeadBytes, size_t& NumFourByteLeadBytes)
+{
+	const __m256i vContinuationMax = _mm256_set1_epi8(static_cast<char>(0xBF));
+	const __m256i vFourByteLeadMin = _mm256_set1_epi8(static_cast<char>(0xF0));
+	auto fnHorizontalSumBytes = [](__m256i v)
+	{
+		const __m256i vSums = _mm256_sad_epu8(v, _mm256_setzero_si256());
+		const __m128i vSums2 = _mm_add_epi64(_mm256_castsi256_si128(vSums), _mm256_extracti128_si256(vSums, 1));
+		return static_cast<size_t>(_mm_cvtsi128_si32(vSums2)) + static_cast<size_t>(_mm_cvtsi128_si32(_mm_srli_si128(vSums2, 8)));
+	};
+	size_t i = 0;
+	while (i + 32 <= Length)
+	{
+		__m256i vNumLeads = _mm256_setzero_si256();
+		__m256i vNumFourByteLeads = _mm256_setzero_si256();
+		const size_t NumBlocks = std::min<size_t>((Length - i) / 32, 255);
+		for (size_t iBlock = 0; iBlock < NumBlocks; ++iBlock, i += 32)
+		{
+			const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+			vNumLeads = _mm256_sub_epi8(vNumLeads, _mm256_cmpgt_epi8(v, vContinuationMax));
+			vNumFourByteLeads = _mm256_sub_epi8(vNumFourByteLeads, _mm256_cmpeq_epi8(_mm256_max_epu8(v, vFourByteLeadMin), v));
+		}
+		NumLeadBytes += fnHorizontalSumBytes(vNumLeads);
+		NumFourByteLeadBytes += fnHorizontalSumBytes(vNumFourByteLeads);
+	}
+	_mm256_zeroupper();
+	CountUTF8LeadBytes_SSE2(p + i, Length - i, NumLeadBytes, NumFourByteLeadBytes);
+}
+
+
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+//
+// Dispatch
+//
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+template<class TSrc, class TDst>
+static FnConvertASCII<TSrc, TDst> GetConvertASCIIFunction(ESIMDLevel SIMDLevel)
+{
+	constexpr size_t SRC_SIZE = sizeof(TSrc);
+	constexpr size_t DST_SIZE = sizeof(TDst);
+	const bool bAVX2 = SIMDLevel == ESIMDLevel::AVX2;
+	const bool bSSE2 = SIMDLevel >= ESIMDLevel::SSE2;
+	if constexpr (SRC_SIZE == 1 && DST_SIZE == 2) { if (bAVX2) return ConvertASCII_8To16_AVX2<TDst>; if (bSSE2) return ConvertASCII_8To16_SSE2<TDst>; }
+	if constexpr (SRC_SIZE == 1 && DST_SIZE == 4) { if (bAVX2) return ConvertASCII_8To32_AVX2<TDst>; if (bSSE2) return ConvertASCII_8To32_SSE2<TDst>; }
+	if constexpr (SRC_SIZE == 2 && DST_SIZE == 1) { if (bAVX2) return ConvertASCII_16To8_AVX2<TSrc>; if (bSSE2) return ConvertASCII_16To8_SSE2<TSrc>; }
+	if constexpr (SRC_SIZE == 4 && DST_SIZE == 1) { if (bAVX2) return ConvertASCII_32To8_AVX2<TSrc>; if (bSSE2) return ConvertASCII_32To8_SSE2<TSrc>; }
+	return ConvertASCII_Scalar<TSrc, TDst>;
+}
+static FnCountUTF8LeadBytes GetCountUTF8LeadBytesFunction(ESIMDLevel SIMDLevel)
+{
+	switch (SIMDLevel)
+	{
+	case ESIMDLevel::AVX2 : return CountUTF8LeadBytes_AVX2;
+	case ESIMDLevel::SSE42:
+	case ESIMDLevel::SSE2 : return CountUTF8LeadBytes_SSE2;
+	default: break;
+	}
+	return CountUTF8LeadBytes_Scalar;
+}
+static FnGetUTF8LengthOfUTF16 GetUTF8LengthOfUTF16Function(ESIMDLevel SIMDLevel)
+{
+	return SIMDLevel >= ESIMDLevel::SSE2 ? GetUTF8LengthOfUTF16_SSE2 : GetUTF8LengthOfUTF16_Scalar;
+}
+
+
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+//
+// Transcoding
+//
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+// Invalid sequences stop the conversion, or are replaced with U+FFFD one code unit at a time if @bReplaceInvalid.
+template<class TSrcCodec, class TDstCodec>
+static FTranscodeResult Transcode(const typename TSrcCodec::Unit* pSrc, size_t SrcLength, typename TDstCodec::Unit* pDst, size_t DstSize
+	, bool bReplaceInvalid, ESIMDLevel SIMDLevel)
+{
+	using TSrc = typename TSrcCodec::Unit;
+	using TDst = typename TDstCodec::Unit;
+	const FnConvertASCII<TSrc, TDst> fnConvertASCII = GetConvertASCIIFunction<TSrc, TDst>(SIMDLevel);
+
+	FTranscodeResult Result;
+	size_t i = 0;
+	size_t o = 0;
+	while (i < SrcLength)
+	{
+		if (ToCodeUnit(pSrc[i]) < 0x80)
+		{
+			const size_t NumASCIIChars = fnConvertASCII(pSrc + i, std::min(SrcLength - i, DstSize - o), pDst + o);
+			i += NumASCIIChars;
+			o += NumASCIIChars;
+			if (i == SrcLength)
+				break;
+		}
+
+		char32_t CodePoint;
+		size_t NumUnitsRead = TSrcCodec::Decode(pSrc + i, SrcLength - i, CodePoint);
+		if (NumUnitsRead == 0)
+		{
+			if (!bReplaceInvalid)
+			{
+				Result.Error = EUnicodeError::INVALID_SEQUENCE;
+				break;
+			}
+			CodePoint = REPLACEMENT_CHARACTER;
+			NumUnitsRead = 1;
+		}
+
+		const size_t NumUnitsWritten = TDstCodec::GetEncodedLength(CodePoint);
+		if (DstSize - o < NumUnitsWritten)
+		{
+			Result.Error = EUnicodeError::BUFFER_TOO_SMALL;
+			break;
+		}
+		TDstCodec::Encode(CodePoint, pDst + o);
+		i += NumUnitsRead;
+		o += NumUnitsWritten;
+	}
+	Result.NumCharsRead = i;
+	Result.NumCharsWritten = o;
+	return Result;
+}
+
+static size_t GetUTF16Length(const char* p, size_t Length, ESIMDLevel SIMDLevel)
+{
+	size_t NumLeadBytes = 0;
+	size_t NumFourByteLeadBytes = 0; // encoded as surrogate pairs
+	GetCountUTF8LeadBytesFunction(SIMDLevel)(p, Length, NumLeadBytes, NumFourByteLeadBytes);
+	return NumLeadBytes + NumFourByteLeadBytes;
+}
+static size_t GetUTF32Length(const char* p, size_t Length, ESIMDLevel SIMDLevel)
+{
+	size_t NumLeadBytes = 0;
+	size_t NumFourByteLeadBytes = 0;
+	GetCountUTF8LeadBytesFunction(SIMDLevel)(p, Length, NumLeadBytes, NumFourByteLeadBytes);
+	return NumLeadBytes;
+}
+
+// Converts valid input into a string of the exact length, invalid input is converted again with replacement characters
+// into a string sized for the worst case of @MaxDstUnitsPerSrcUnit.
+template<class TSrcCodec, class TDstCodec, class TDstString>
+static TDstString TranscodeToString(const typename TSrcCodec::Unit* pSrc, size_t SrcLength, size_t DstLength, size_t MaxDstUnitsPerSrcUnit, ESIMDLevel SIMDLevel)
+{
+	TDstString Dst(DstLength, typename TDstCodec::Unit());
+	const FTranscodeResult Result = Transcode<TSrcCodec, TDstCodec>(pSrc, SrcLength, Dst.data(), Dst.size(), false, SIMDLevel);
+	if (Result && Result.NumCharsWritten == DstLength)
+		return Dst;
+
+	Dst.assign(SrcLength * MaxDstUnitsPerSrcUnit, typename TDstCodec::Unit());
+	Dst.resize(Transcode<TSrcCodec, TDstCodec>(pSrc, SrcLength, Dst.data(), Dst.size(), true, SIMDLevel).NumCharsWritten);
+	return Dst;
+}
+
+
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+//
+// Benchmark
+//
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+#if STRUTIL_RUN_UNICODE_BENCHMARK
+#ifdef _MSC_VER
+#pragma warning(disable : 4996) // std::wstring_convert is deprecated in C++17
+#endif
+static void RUN_STRUTIL_UNICODE_BENCHMARK()
+{
+	static bool sbBenchmarkRun = false;
+	if (sbBenchmarkRun)
+		return;
+	sbBenchmarkRun = true;
+
+	constexpr size_t NUM_BYTES = 16 * 1024 * 1024;
+	constexpr int    NUM_ITERATIONS = 4;
+
+	// file paths with a few accented characters, and text mixing Latin, Cyrillic, CJK & emoji
+	std::mt19937 rng(42);
+	std::string ASCIIHeavy, MixedScript;
+	const char* Words[] = { "Data/", "Textures/", "sky_", "Models/", "character", "_albedo", ".png", "caf\xC3\xA9", "na\xC3\xAFve " };
+	while (ASCIIHeavy.size() < NUM_BYTES)
+		ASCIIHeavy += Words[rng() % (rng() % 8 == 0 ? 9 : 7)];
+	const char* Scripts[] = { "hello ", "\xD0\xBF\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82 ", "\xE4\xBD\xA0\xE5\xA5\xBD", "\xF0\x9F\x98\x80", "\xCE\xB1\xCE\xB2\xCE\xB3 " };
+	while (MixedScript.size() < NUM_BYTES)
+		MixedScript += Scripts[rng() % 5];
+
+	std::vector<char16_t> UTF16(NUM_BYTES);
+	std::vector<char32_t> UTF32(NUM_BYTES);
+	std::vector<char>     UTF8(NUM_BYTES);
+
+	size_t Checksum = 0;
+	auto fnMeasure = [&](const char* pInput, const char* pLabel, const char* pSIMDLevel, size_t NumBytes, auto&& fnRun)
+	{
+		Checksum += fnRun(); // warm up
+		const auto t0 = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < NUM_ITERATIONS; ++i)
+			Checksum += fnRun();
+		const auto t1 = std::chrono::high_resolution_clock::now();
+		const double ms = std::chrono::duration<double, std::milli>(t1 - t0).count() / NUM_ITERATIONS;
+		Log::Info("  %-11s %-26s %-8s : %7.2fms | %6.2f GB/s of UTF-8", pInput, pLabel, pSIMDLevel, ms, NumBytes / (ms * 1e6));
+	};
+
+	Log::Info("StrUtil Unicode Benchmark: %.1f MB of UTF-8", NUM_BYTES / (1024.0 * 1024.0));
+	const ESIMDLevel SupportedSIMDLevel = VQSystemInfo::GetSIMDLevel();
+	const ESIMDLevel SIMDLevels[] = { ESIMDLevel::SCALAR, ESIMDLevel::SSE2, ESIMDLevel::AVX2 };
+	const char* SIMDLevelNames[] = { "Scalar", "SSE2", "AVX2" };
+	const struct { const char* pName; const std::string* pText; } Inputs[] = { { "ASCII-heavy", &ASCIIHeavy }, { "Mixed", &MixedScript } };
+	for (const auto& Input : Inputs)
+	{
+		const std::string& Text = *Input.pText;
+		const size_t UTF16Length = GetUTF16Length(Text.data(), Text.size(), ESIMDLevel::SCALAR);
+
+		fnMeasure(Input.pName, "byte widening (previous)", "", Text.size(), [&]() { return std::wstring(Text.begin(), Text.end()).size(); });
+		fnMeasure(Input.pName, "std::wstring_convert", "", Text.size(), [&]()
+		{
+			std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t> Converter;
+			return Converter.from_bytes(Text.data(), Text.data() + Text.size()).size();
+		});
+		for (int iLevel = 0; iLevel < 3; ++iLevel)
+		{
+			const ESIMDLevel SIMDLevel = SIMDLevels[iLevel];
+			if (SIMDLevel > SupportedSIMDLevel)
+				continue;
+			fnMeasure(Input.pName, "GetUTF16Length", SIMDLevelNames[iLevel], Text.size(), [&]() { return GetUTF16Length(Text.data(), Text.size(), SIMDLevel); });
+			fnMeasure(Input.pName, "UTF-8 -> UTF-16", SIMDLevelNames[iLevel], Text.size(), [&]()
+			{
+				return Transcode<FUTF8Codec, FUTF16Codec<char16_t>>(Text.data(), Text.size(), UTF16.data(), UTF16.size(), false, SIMDLevel).NumCharsWritten;
+			});
+			fnMeasure(Input.pName, "UTF-16 -> UTF-8", SIMDLevelNames[iLevel], Text.size(), [&]()
+			{
+				return Transcode<FUTF16Codec<char16_t>, FUTF8Codec>(UTF16.data(), UTF16Length, UTF8.data(), UTF8.size(), false, SIMDLevel).NumCharsWritten;
+			});
+			fnMeasure(Input.pName, "UTF-8 -> UTF-32", SIMDLevelNames[iLevel], Text.size(), [&]()
+			{
+				return Transcode<FUTF8Codec, FUTF32Codec<char32_t>>(Text.data(), Text.size(), UTF32.data(), UTF32.size(), false, SIMDLevel).NumCharsWritten;
+			});
+		}
+	}
+	Log::Info("  checksum: %zu", Checksum);
+}
+#endif
+
+
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+//
+// StrUtil
+//
+// ----------------------------------------------------------------------------------------------------------------------------------------------
+namespace StrUtil
+{
+	FTranscodeResult UTF8ToUTF16(std::string_view Src, char16_t* pDst, size_t DstSize)
+	{
+		return Transcode<FUTF8Codec, FUTF16Codec<char16_t>>(Src.data(), Src.size(), pDst, DstSize, false, VQSystemInfo::GetSIMDLevel());
+	}
+	FTranscodeResult UTF8ToUTF32(std::string_view Src, char32_t* pDst, size_t DstSize)
+	{
+		return Transcode<FUTF8Codec, FUTF32Codec<char32_t>>(Src.data(), Src.size(), pDst, DstSize, false, VQSystemInfo::GetSIMDLevel());
+	}
+	FTranscodeResult UTF16ToUTF8(std::u16string_view Src, char* pDst, size_t DstSize)
+	{
+		return Transcode<FUTF16Codec<char16_t>, FUTF8Codec>(Src.data(), Src.size(), pDst, DstSize, false, VQSystemInfo::GetSIMDLevel());
+	}
+	FTranscodeResult UTF32ToUTF8(std::u32string_view Src, char* pDst, size_t DstSize)
+	{
+		return Transcode<FUTF32Codec<char32_t>, FUTF8Codec>(Src.data(), Src.size(), pDst, DstSize, false, VQSystemInfo::GetSIMDLevel());
+	}
+
+	size_t GetUTF16Length(std::string_view Utf8) { return ::GetUTF16Length(Utf8.data(), Utf8.size(), VQSystemInfo::GetSIMDLevel()); }
+	size_t GetUTF32Length(std::string_view Utf8) { return ::GetUTF32Length(Utf8.data(), Utf8.size(), VQSystemInfo::GetSIMDLevel()); }
+	size_t GetUTF8Length(std::u16string_view Utf16) { return GetUTF8LengthOfUTF16Function(VQSystemInfo::GetSIMDLevel())(Utf16.data(), Utf16.size()); }
+	size_t GetUTF8Length(std::u32string_view Utf32) { return GetUTF8LengthOfUTF32_Scalar(Utf32.data(), Utf32.size()); }
+
+	// a UTF-8 byte converts to at most 1 UTF-16/32 code unit, a UTF-16/32 code unit to at most 3/4 UTF-8 bytes
+	std::u16string ToUTF16(std::string_view Utf8)
+	{
+#if STRUTIL_RUN_UNICODE_BENCHMARK
+		RUN_STRUTIL_UNICODE_BENCHMARK();
+#endif
+		const ESIMDLevel SIMDLevel = VQSystemInfo::GetSIMDLevel();
+		return TranscodeToString<FUTF8Codec, FUTF16Codec<char16_t>, std::u16string>(Utf8.data(), Utf8.size(), ::GetUTF16Length(Utf8.data(), Utf8.size(), SIMDLevel), 1, SIMDLevel);
+	}
+	std::u32string ToUTF32(std::string_view Utf8)
+	{
+		const ESIMDLevel SIMDLevel = VQSystemInfo::GetSIMDLevel();
+		return TranscodeToString<FUTF8Codec, FUTF32Codec<char32_t>, std::u32string>(Utf8.data(), Utf8.size(), ::GetUTF32Length(Utf8.data(), Utf8.size(), SIMDLevel), 1, SIMDLevel);
+	}
+	std::wstring ToWide(std::string_view Utf8)
+	{
+#if STRUTIL_RUN_UNICODE_BENCHMARK
+		RUN_STRUTIL_UNICODE_BENCHMARK();
+#endif
+		const ESIMDLevel SIMDLevel = VQSystemInfo::GetSIMDLevel();
+		const size_t WideLength = sizeof(wchar_t) == 2
+			? ::GetUTF16Length(Utf8.data(), Utf8.size(), SIMDLevel)
+			: ::GetUTF32Length(Utf8.data(), Utf8.size(), SIMDLevel);
+		return TranscodeToString<FUTF8Codec, FWideCodec, std::wstring>(Utf8.data(), Utf8.size(), WideLength, 1, SIMDLevel);
+	}
+
+	std::string ToUTF8(std::u16string_view Utf16)
+	{
+		const ESIMDLevel SIMDLevel = VQSystemInfo::GetSIMDLevel();
+		return TranscodeToString<FUTF16Codec<char16_t>, FUTF8Codec, std::string>(Utf16.data(), Utf16.size(), GetUTF8LengthOfUTF16Function(SIMDLevel)(Utf16.data(), Utf16.size()), 3, SIMDLevel);
+	}
+	std::string ToUTF8(std::u32string_view Utf32)
+	{
+		return TranscodeToString<FUTF32Codec<char32_t>, FUTF8Codec, std::string>(Utf32.data(), Utf32.size(), GetUTF8LengthOfUTF32_Scalar(Utf32.data(), Utf32.size()), 4, VQSystemInfo::GetSIMDLevel());
+	}
+	std::string ToUTF8(std::wstring_view Wide)
+	{
+		if constexpr (sizeof(wchar_t) == 2)
+			return ToUTF8(std::u16string_view(reinterpret_cast<const char16_t*>(Wide.data()), Wide.size()));
+		else
+			return ToUTF8(std::u32string_view(reinterpret_cast<const char32_t*>(Wide.data()), Wide.size()));
+	}
+}
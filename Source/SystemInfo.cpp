@@ -582,7 +582,7 @@ std::vector<FMonitorInfo> GetDisplayInfo()
 				for (int i = 0; i < monitors.size(); ++i)
 				{
 					std::vector<std::string> tokens_m = StrUtil::split(monitors[i].DeviceName, { '\\', '.' });
-					std::vector<std::string> tokens_d = StrUtil::split(StrUtil::UnicodeToASCII<256>(desc.DeviceName), { '\\', '.' });
+					std::vector<std::string> tokens_d = StrUtil::split(StrUtil::ToUTF8(desc.DeviceName), { '\\', '.' });
 					{
 						std::set<std::string> s0(tokens_m.begin(), tokens_m.end());
 						std::set<std::string> s1(tokens_d.begin(), tokens_d.end());
@@ -597,7 +597,7 @@ std::vector<FMonitorInfo> GetDisplayInfo()
 				return FMonitorInfo(); // this should never happen, we expect to have a match with 'DISPLAY#' string in the tokens
 			}(desc, monitors);
 
-			i.LogicalDeviceName = StrUtil::UnicodeToASCII(desc.DeviceName);
+			i.LogicalDeviceName = StrUtil::ToUTF8(desc.DeviceName);
 
 			switch (desc.Rotation)
 			{
@@ -739,7 +739,7 @@ std::vector<FGPUInfo> GetGPUInfo(/*TODO: feature level*/)
 		FGPUInfo GPUInfo = {};
 		GPUInfo.DedicatedGPUMemory = desc.DedicatedVideoMemory;
 		GPUInfo.DeviceID = desc.DeviceId;
-		GPUInfo.DeviceName = StrUtil::UnicodeToASCII<1024>(desc.Description);
+		GPUInfo.DeviceName = StrUtil::ToUTF8(desc.Description);
 		GPUInfo.VendorID = desc.VendorId;
 		///GPUInfo.MaxSupportedFeatureLevel = FEATURE_LEVEL;
 		pAdapter->QueryInterface(IID_PPV_ARGS(&GPUInfo.pAdapter));
@@ -770,7 +770,7 @@ std::vector<FGPUInfo> GetGPUInfo(/*TODO: feature level*/)
 		}
 		else
 		{
-			const std::string AdapterDesc = StrUtil::UnicodeToASCII(desc.Description);
+			const std::string AdapterDesc = StrUtil::ToUTF8(desc.Description);
 			//Log::Warning("Device::Create(): D3D12CreateDevice() with Feature Level 12_1 failed with adapter=%s, retrying with Feature Level 12_0", AdapterDesc.c_str());
 			hr = D3D12CreateDevice(pAdapter, D3D_FEATURE_LEVEL_12_0, _uuidof(ID3D12Device), nullptr);
 			if (SUCCEEDED(hr))
@@ -797,6 +797,63 @@ std::vector<FGPUInfo> GetGPUInfo(/*TODO: feature level*/)
 // CPU
 //
 // ----------------------------------------------------------------------------------------------------------------------------------------------
+static ESIMDLevel DetectSIMDLevel()
+{
+	// https://en.wikipedia.org/wiki/CPUID#EAX=1:_Processor_Info_and_Feature_Bits
+	std::array<int, 4> cpui;
+	__cpuid(cpui.data(), 0);
+	const int nIds = cpui[0];
+	if (nIds < 1)
+		return ESIMDLevel::SCALAR;
+
+	__cpuid(cpui.data(), 1);
+	const bool bSSE2    = (cpui[3] & (1 << 26)) != 0;
+	const bool bSSE42   = (cpui[2] & (1 << 20)) != 0;
+	const bool bOSXSAVE = (cpui[2] & (1 << 27)) != 0;
+	const bool bAVX     = (cpui[2] & (1 << 28)) != 0;
+
+	bool bAVX2 = false;
+	if (nIds >= 7)
+	{
+		__cpuidex(cpui.data(), 7, 0);
+		bAVX2 = (cpui[1] & (1 << 5)) != 0;
+	}
+
+	// AVX registers are only usable if the OS saves their state on context switches (XCR0 bits 1 & 2)
+	const bool bOSSupportsAVX = bOSXSAVE && bAVX && (_xgetbv(0) & 0x6) == 0x6;
+
+	if (bAVX2 && bOSSupportsAVX) return ESIMDLevel::AVX2;
+	if (bSSE42)                  return ESIMDLevel::SSE42;
+	if (bSSE2)                   return ESIMDLevel::SSE2;
+	return ESIMDLevel::SCALAR;
+}
+
+ESIMDLevel GetSIMDLevel()
+{
+	static const ESIMDLevel sSIMDLevel = DetectSIMDLevel();
+	return sSIMDLevel;
+}
+
+static bool DetectF16C()
+{
+	std::array<int, 4> cpui;
+	__cpuid(cpui.data(), 0);
+	if (cpui[0] < 1)
+		return false;
+
+	__cpuid(cpui.data(), 1);
+	const bool bF16C    = (cpui[2] & (1 << 29)) != 0;
+	const bool bOSXSAVE = (cpui[2] & (1 << 27)) != 0;
+	const bool bAVX     = (cpui[2] & (1 << 28)) != 0;
+	return bF16C && bOSXSAVE && bAVX && (_xgetbv(0) & 0x6) == 0x6; // VEX encoded: needs the OS to save the AVX state as well
+}
+
+bool HasF16C()
+{
+	static const bool sbF16C = DetectF16C();
+	return sbF16C;
+}
+
 FCPUInfo GetCPUInfo()
 {
 	FCPUInfo i;
@@ -1041,7 +1098,7 @@ static void INFO(std::string& s, const char* format, Args&&... args)
 	s += "\n";
 }
 
-inline static std::string FORMAT_BYTE(unsigned long long bytes) { return StrUtil::FormatByte(bytes); }
+inline static StrUtil::FInlineString<31> FORMAT_BYTE(unsigned long long bytes) { StrUtil::FInlineString<31> s; return StrUtil::FormatByte(s, bytes); }
 
 std::string PrintSystemInfo(const FSystemInfo& i, const bool bDetailed /*= false*/)
 {
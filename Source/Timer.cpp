@@ -19,6 +19,9 @@
 
 #include "Timer.h"
 
+#include <ctime>
+#include <cstdio>
+
 Timer::Timer()
 	:
 	bIsStopped(true)
@@ -108,3 +111,63 @@ float Timer::GetStopDuration() const
 	return stopDuration.count();
 }
 
+
+
+TimestampFormatter& TimestampFormatter::GetThreadLocal()
+{
+	static thread_local TimestampFormatter tFormatter;
+	return tFormatter;
+}
+
+TimeStamp TimestampFormatter::Now()
+{
+	return std::chrono::system_clock::now();
+}
+
+std::string_view TimestampFormatter::Format(TimeStamp Time, bool bMicroseconds)
+{
+	const int64_t TotalMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(Time.time_since_epoch()).count();
+
+	// floored divisions, for the time points before the epoch
+	int64_t Seconds      = TotalMicroseconds / 1000000;
+	int64_t Microseconds = TotalMicroseconds % 1000000;
+	if (Microseconds < 0) { Microseconds += 1000000; --Seconds; }
+	int64_t Minute = Seconds / 60;
+	int64_t Second = Seconds % 60;
+	if (Second < 0) { Second += 60; --Minute; }
+
+	// time zone offsets are whole minutes, so the local seconds are the same as the UTC ones
+	if (Minute != mCachedMinute)
+	{
+		const std::time_t MinuteStart = static_cast<std::time_t>(Minute * 60);
+		std::tm tmMinute;
+		localtime_s(&tmMinute, &MinuteStart);
+		mPrefixLength = snprintf(mBuffer, LEN_BUFFER, "%d_%02d_%02d-%02d:%02d:"
+			, tmMinute.tm_year + 1900
+			, tmMinute.tm_mon + 1
+			, tmMinute.tm_mday
+			, tmMinute.tm_hour
+			, tmMinute.tm_min
+		);
+		mCachedMinute = Minute;
+		mCachedSecond = -1;
+	}
+
+	char* pSecond = mBuffer + mPrefixLength;
+	if (Second != mCachedSecond)
+	{
+		pSecond[0] = static_cast<char>('0' + Second / 10);
+		pSecond[1] = static_cast<char>('0' + Second % 10);
+		mCachedSecond = Second;
+	}
+	if (!bMicroseconds)
+		return std::string_view(mBuffer, mPrefixLength + 2);
+
+	pSecond[2] = '.';
+	for (int i = 8; i >= 3; --i)
+	{
+		pSecond[i] = static_cast<char>('0' + Microseconds % 10);
+		Microseconds /= 10;
+	}
+	return std::string_view(mBuffer, mPrefixLength + 9);
+}
@@ -17,6 +17,7 @@
 //	Contact: volkanilbeyli@gmail.com
 
 #include "utils.h"
+#include "Timer.h"
 #include <iostream>
 #include <sstream>
 #include <iomanip>
@@ -57,6 +58,14 @@ namespace filesys = std::filesystem;
 
 #include "Log.h"
 
+// Splits ~16MB of delimited words with split() & SplitView against the previous split() implementations,
+// runs once on the first call to split(const char*, char).
+#define STRUTIL_RUN_SPLIT_BENCHMARK 0
+
+#if STRUTIL_RUN_SPLIT_BENCHMARK
+#include <chrono>
+#endif
+
 namespace StrUtil
 {
 	using std::vector;
@@ -64,34 +73,34 @@ namespace StrUtil
 	using std::cout;
 	using std::endl;
 
-	bool  ParseBool (const std::string& s) { bool b; std::istringstream(s) >> std::boolalpha >> b; return b; }
-	int   ParseInt  (const std::string& s) { return std::atoi(s.c_str()); }
-	float ParseFloat(const std::string& s) { return static_cast<float>(std::atof(s.c_str())); }
-	
-	bool IsNumber(const std::string& s)
+	size_t SplitView::Count() const
 	{
-		// https://stackoverflow.com/a/4654718/2034041
-		std::string::const_iterator it = s.begin();
-		while (it != s.end() && std::isdigit(*it)) ++it;
-		return !s.empty() && it == s.end();
+		size_t NumTokens = 0;
+		for (Iterator it = begin(); it != end(); ++it)
+			++NumTokens;
+		return NumTokens;
 	}
 
-	vector<string> split(const char* s, char c)
+	std::vector<std::string_view> SplitView::ToVector() const
 	{
-		vector<string> result;
-		do
-		{
-			const char* begin = s;
-
-			if (*begin == c || *begin == '\0') 
-				continue;	// skip delimiter character
-
-			while (*s != c && *s)	
-				s++;	// iterate until delimiter is found
+		std::vector<std::string_view> result;
+		for (std::string_view Token : *this)
+			result.push_back(Token);
+		return result;
+	}
 
-			result.push_back(string(begin, s));
+#if STRUTIL_RUN_SPLIT_BENCHMARK
+	static void RUN_SPLIT_BENCHMARK();
+#endif
 
-		} while (*s++);
+	vector<string> split(const char* s, char c)
+	{
+#if STRUTIL_RUN_SPLIT_BENCHMARK
+		RUN_SPLIT_BENCHMARK();
+#endif
+		vector<string> result;
+		for (std::string_view Token : SplitView(s, c))
+			result.emplace_back(Token);
 		return result;
 	}
 
@@ -103,121 +112,90 @@ namespace StrUtil
 	std::vector<std::string> split(std::string_view s, const std::vector<char>& delimiters)
 	{
 		vector<string> result;
-		const char* ps = s.data();
-		auto& IsDelimiter = [&delimiters](const char c)
-		{
-			return std::find(delimiters.begin(), delimiters.end(), c) != delimiters.end();
-		};
+		for (std::string_view Token : SplitView(s, FDelimiterSet(delimiters)))
+			result.emplace_back(Token);
+		return result;
+	}
 
+#if STRUTIL_RUN_SPLIT_BENCHMARK
+	// previous split() implementations, for comparison
+	static vector<string> split_Legacy(const char* s, char c)
+	{
+		vector<string> result;
+		do
+		{
+			const char* begin = s;
+			if (*begin == c || *begin == '\0')
+				continue;
+			while (*s != c && *s)
+				s++;
+			result.push_back(string(begin, s));
+		} while (*s++);
+		return result;
+	}
+	static vector<string> split_Legacy(std::string_view s, const std::vector<char>& delimiters)
+	{
+		vector<string> result;
+		const char* ps = s.data();
+		auto IsDelimiter = [&delimiters](const char c) { return std::find(delimiters.begin(), delimiters.end(), c) != delimiters.end(); };
 		do
 		{
 			const char* begin = ps;
-
-			if (IsDelimiter(*begin) || (*begin == '\0')) 
-				continue;	// skip delimiter characters
-
-			while (!IsDelimiter(*ps) && *ps) 
-				ps++;	// iterate until delimiter is found or string has ended
-
+			if (IsDelimiter(*begin) || (*begin == '\0'))
+				continue;
+			while (!IsDelimiter(*ps) && *ps)
+				ps++;
 			result.push_back(string(begin, ps));
-
 		} while (*ps++);
 		return result;
 	}
 
-	std::string trim(const std::string& s)
-	{
-		size_t end = s.find_last_not_of(" \n\r\t\f\v");
-		size_t begin = s.find_first_not_of(" \n\r\t\f\v");
-		size_t range = end + 1 - begin;
-		return (end == std::string::npos) ? "" : s.substr(begin, range);
-	}
-
-	void MakeLowercase(std::string& str)
+	static void RUN_SPLIT_BENCHMARK()
 	{
-		std::transform(str.begin(), str.end(), str.begin(), [](unsigned char c) { return std::tolower(c); });
-	}
-
-	std::string GetLowercased(const std::string& str)
-	{
-		std::string lowercased(str.size(), '\0');
-		std::transform(str.begin(), str.end(), lowercased.begin(), [](unsigned char c) { return std::tolower(c); });
-		return lowercased;
-	}
-
-	std::string GetUppercased(const std::string& str)
-	{
-		std::string uppercased(str.size(), '\0');
-		std::transform(str.begin(), str.end(), uppercased.begin(), [](unsigned char c) { return std::toupper(c); });
-		return uppercased;
-	}
-
-
-	std::string CommaSeparatedNumber(const std::string& num)
-	{
-		std::string _num = "";
-		int i = 0;
-		for (auto it = num.rbegin(); it != num.rend(); ++it)
+		static bool sbBenchmarkRun = false;
+		if (sbBenchmarkRun)
+			return;
+		sbBenchmarkRun = true;
+
+		// ~16MB of space/comma/tab separated words with runs of delimiters, like settings & scene files
+		constexpr size_t NUM_CHARS = 16 * 1024 * 1024;
+		constexpr int    NUM_ITERATIONS = 4;
+		std::mt19937 rng(42);
+		std::string Text;
+		Text.reserve(NUM_CHARS + 64);
+		while (Text.size() < NUM_CHARS)
 		{
-			if (i % 3 == 0 && i != 0)
-			{
-				_num += ",";
-			}
-			_num += *it;
-			++i;
+			const size_t WordLength = 1 + rng() % 12;
+			for (size_t i = 0; i < WordLength; ++i)
+				Text.push_back(static_cast<char>('a' + rng() % 26));
+			const char Separators[] = { ' ', ' ', ' ', ',', '\t' };
+			const size_t NumSeparators = 1 + (rng() % 8 == 0);
+			for (size_t i = 0; i < NumSeparators; ++i)
+				Text.push_back(Separators[rng() % _countof(Separators)]);
 		}
-		return std::string(_num.rbegin(), _num.rend());
-	}
-	std::string UnicodeToASCII(const PWSTR pwstr)
-	{
-		const std::wstring wstr(pwstr);
-#if _WIN32
-		// https://codingtidbit.com/2020/02/09/c17-codecvt_utf8-is-deprecated/
-		if (wstr.empty()) return std::string();
-		int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-		std::string strTo(size_needed, 0);
-		WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-		return strTo;
-#else
-		return std::string(wstr.begin(), wstr.end());  // results in warning in C++17
-#endif
-	}
-
-	std::string FormatByte(unsigned long long bytes)
-	{
-		constexpr unsigned long long KILOBYTE = 1024ull;
-		constexpr unsigned long long MEGABYTE = 1024ull * KILOBYTE;
-		constexpr unsigned long long GIGABYTE = 1024ull * MEGABYTE;
-		constexpr unsigned long long TERABYTE = 1024ull * GIGABYTE;
-
-		std::string unit = "B";
-		double newMagnitudeInUnits = static_cast<double>(bytes);
+		const std::vector<char> Delimiters = { ' ', ',', '\t' };
 
-		if (bytes > KILOBYTE)
+		size_t Checksum = 0;
+		auto fnMeasure = [&](const char* pLabel, auto&& fnSplit)
 		{
-			unit = "KB";
-			newMagnitudeInUnits /= 1024.0;
-		}
-		if (bytes > MEGABYTE)
-		{
-			unit = "MB";
-			newMagnitudeInUnits /= 1024.0;
-		}
-		if (bytes > GIGABYTE)
-		{
-			unit = "GB";
-			newMagnitudeInUnits /= 1024.0;
-		}
-		if (bytes > TERABYTE)
-		{
-			unit = "TB";
-			newMagnitudeInUnits /= 1024.0;
-		}
+			const auto t0 = std::chrono::high_resolution_clock::now();
+			for (int i = 0; i < NUM_ITERATIONS; ++i)
+				Checksum += fnSplit();
+			const auto t1 = std::chrono::high_resolution_clock::now();
+			const double ms = std::chrono::duration<double, std::milli>(t1 - t0).count() / NUM_ITERATIONS;
+			Log::Info("  %-24s : %7.2fms | %7.1f MB/s", pLabel, ms, NUM_CHARS / (1024.0 * 1024.0) / (ms / 1000.0));
+		};
 
-		std::ostringstream ss;
-		ss << std::fixed << std::setprecision(0) << newMagnitudeInUnits << unit;
-		return ss.str();
+		Log::Info("StrUtil Split Benchmark: %.1f MB input, average of %d iterations", NUM_CHARS / (1024.0 * 1024.0), NUM_ITERATIONS);
+		fnMeasure("split_Legacy(char)", [&]() { return split_Legacy(Text.c_str(), ' ').size(); });
+		fnMeasure("split(char)", [&]() { return split(Text.c_str(), ' ').size(); });
+		fnMeasure("SplitView(char)", [&]() { return SplitView(Text, ' ').Count(); });
+		fnMeasure("split_Legacy(delimiters)", [&]() { return split_Legacy(Text, Delimiters).size(); });
+		fnMeasure("split(delimiters)", [&]() { return split(Text, Delimiters).size(); });
+		fnMeasure("SplitView(FDelimiterSet)", [&]() { return SplitView(Text, FDelimiterSet(Delimiters)).Count(); });
+		Log::Info("  checksum: %zu", Checksum);
 	}
+#endif
 }
 
 //---------------------------------------------------------------------------------------------
@@ -226,13 +204,10 @@ namespace DirectoryUtil
 {
 	std::vector<std::string> GetFilesInPath(const std::string& path)
 	{
-		constexpr size_t MAX_FILE_PATH_LENGTH = 300;
-
 		std::vector<std::string> files;
 		for (const auto& entry : filesys::directory_iterator(path))
 		{
-			std::string filePath = StrUtil::UnicodeToASCII<MAX_FILE_PATH_LENGTH>(entry.path().c_str());
-			files.push_back(filePath);
+			files.push_back(entry.path().u8string()); // UTF-8 whatever the native path encoding is (UTF-16 on Windows)
 		}
 		return files;
 	}
@@ -265,7 +240,7 @@ namespace DirectoryUtil
 			// Log::Error("SHGetKnownFolderPath() returned %s.", hr == E_FAIL ? "E_FAIL" : "E_INVALIDARG");
 			return "";
 		}
-		return StrUtil::UnicodeToASCII(retPath);
+		return StrUtil::ToUTF8(retPath);
 #else
 		assert(false);	// IMPLEMENT: platform-specific logic for other platforms
 		return "";
@@ -448,23 +423,21 @@ namespace MathUtil
 
 // GLOBAL NAMESPACE
 //
-std::string GetCurrentTimeAsString()
+std::string GetCurrentTimeAsString() { return std::string(TimestampFormatter::GetThreadLocal().Format(TimestampFormatter::Now())); }
+std::string GetTimeAsString(std::time_t Time)
+{
+	return std::string(TimestampFormatter::GetThreadLocal().Format(std::chrono::system_clock::from_time_t(Time)));
+}
+std::string GetCurrentTimeAsStringWithBrackets()
 {
-	const std::time_t now = std::time(0);
-	std::tm tmNow;	// current time
-	localtime_s(&tmNow, &now);
-
-	// YYYY-MM-DD_HH-MM-SS
-	std::stringstream ss;
-	ss << (tmNow.tm_year + 1900) << "_"
-		<< std::setfill('0') << std::setw(2) << tmNow.tm_mon + 1 << "_"
-		<< std::setfill('0') << std::setw(2) << tmNow.tm_mday << "-"
-		<< std::setfill('0') << std::setw(2) << tmNow.tm_hour << ":"
-		<< std::setfill('0') << std::setw(2) << tmNow.tm_min << ":"
-		<< std::setfill('0') << std::setw(2) << tmNow.tm_sec;
-	return ss.str();
+	const std::string_view Time = TimestampFormatter::GetThreadLocal().Format(TimestampFormatter::Now());
+	std::string s;
+	s.reserve(Time.size() + 2);
+	s += '[';
+	s += Time;
+	s += ']';
+	return s;
 }
-std::string GetCurrentTimeAsStringWithBrackets() { return "[" + GetCurrentTimeAsString() + "]"; }
 
 
 